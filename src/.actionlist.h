@@ -0,0 +1,218 @@
+/* This file is automatically generated from the contents
+ * of the "actions" directory
+ */
+
+#ifndef _AUTO_ActionTask_H_
+#define _AUTO_ActionTask_H_
+
+/** @defgroup ActionTask Action actions
+ *
+ * Automatically generated list of ActionTask. @{
+ */
+
+/** List ActionTask types.
+ */
+enum ActionTaskType {
+  
+  ATT_Alter = 0, /**<
+            <b>alter [prop]</b> Alter the given proportion of bits. The proportion
+          being given on 1/1,000,000 */
+  ATT_CancelSyscall = 1, /**<
+            <b>cancel-syscall</b> force the syscall to be skipped */
+  ATT_Drop = 2, /**<
+            <b>drop</b> Drop the given packet: cancel the syscall and mark the
+          state as correct. */
+  ATT_Dump = 3, /**<
+            <b>dump [file]</b> the current event to the given file. The informations
+          are stored in the following order:
+          - current time (8 bytes, milliseconds)
+          - type (1 byte, Connecting, Reading, Writing, Closing, Accepting...)
+          - proto (1 byte, TCP, UDP, Unix)
+          - localport (2 bytes local port - 0 on connection)
+          - address (4 bytes IPv4 address, 0 for a Unix socket)
+          - port (2 bytes port)
+          - success (1 byte: -1 for error, 0 for syscall not performed, 1 for success)
+          - length (4 bytes, errno on error)
+          - data...
+          
+          The default installation, install a script named injecthexdump that can
+          read the content of a dump file and print it on stdout with hexdump -C format
+          for data, and the log action format for actions. */
+  ATT_Echo = 4, /**<
+            <b>echo [word]</b> display the given word */
+  ATT_Emit = 5, /**<
+            <b>emit [signame]</b> Emit the given signal and set the corresponding error. */
+  ATT_Error = 6, /**<
+            <b>error [errname]</b> Make the process return the given error.
+          Warning, this has the same level than syscall and mark the call as
+          being aborted. The available errors are EAGAIN, EBADF, EFAULT,
+          EINVAL, EIO and should be used properly in their context. */
+  ATT_Hang = 7, /**<
+            <b>hang [ms]</b> immediately hang the given amount of time given in milliseconds (on a non-blocking socket the call fails with EAGAIN until the end of the hang, and the socket is withheld from poll, select and epoll meanwhile) */
+  ATT_LocalHang = 8, /**<
+            <b>local-hang [ms]</b> hang in order to simulate a local hang. This
+          is similar to hang if writing, but it will ensure the socket has
+          been read in case of reading. */
+  ATT_Log = 9, /**<
+            <b>log [file]</b> log packet information to the given file. If this
+          is -, stderr is assumed. The default installation install a script
+          named injectgraph that can build a set of graph of network activity
+          from the output of this action. This script can also be used in
+          conjunction of injecthexdump to graph the output of the dump action. */
+  ATT_MarkDone = 10, /**<
+            <b>mark-done [type] [line]</b> Remove the given line of the rule set.
+          The type can be "call" or "socket". */
+  ATT_Nop = 11, /**<
+            <b>nop</b> do nothing */
+  ATT_RemoteHang = 12, /**<
+            <b>remote-hang [ms]</b> hang in order to simulate a hang in the remote system */
+  ATT_Remove = 13, /**<
+            <b>remove [line]</b> Remove the given line of the rule set. You
+          can't remove system lines */
+  ATT_Replay = 14, /**<
+            <b>replay [file]</b> The file must be a dump trace (produced using
+          the dump command). It's read to feed read/write actions.
+          
+          If you want to replay the dump at the other hand of a connection
+          (eg: you dumped the server and want to inject the result in the client)
+          you can use the -r option of injecthexdump. @sa ReadDump
+          
+          WARNING: you should not use the same instance of this action for
+          both reading and writing. */
+  ATT_Reset = 15, /**<
+            <b>reset</b> reset the connection.
+          WARNING: reset action must always issue to a 'stop' next rule
+          identifier. */
+  ATT_Split = 16, /**<
+            <b>split [percent]</b> split the requested action in multiple
+          subactions. So, if you are reading, and you call split, you read
+          will be performed in only the given percentage of data.
+          eg: split 50 on a read of 200 bytes will require only 100 bytes
+          When writing, split perform 2 effective writes the first one
+          having the specified percentage of the global size. */
+  ATT_Syscall = 17, /**<
+            <b>syscall</b> do the system call */
+  ATT_Truncate = 18, /**<
+            <b>truncate [size]</b> send/receive at most the given size */
+  ATT_Number = 19   /**< Number of ActionTaskType */
+};
+
+
+/** Register Alter
+ */
+ActionTaskRegisterer ActionAlter_register;
+
+/** Register CancelSyscall
+ */
+ActionTaskRegisterer ActionCancelSyscall_register;
+
+/** Register Drop
+ */
+ActionTaskRegisterer ActionDrop_register;
+
+/** Register Dump
+ */
+ActionTaskRegisterer ActionDump_register;
+
+/** Register Echo
+ */
+ActionTaskRegisterer ActionEcho_register;
+
+/** Register Emit
+ */
+ActionTaskRegisterer ActionEmit_register;
+
+/** Register Error
+ */
+ActionTaskRegisterer ActionError_register;
+
+/** Register Hang
+ */
+ActionTaskRegisterer ActionHang_register;
+/** perform Hang
+ */
+ActionPerformer ActionHang_perform;
+
+/** Register LocalHang
+ */
+ActionTaskRegisterer ActionLocalHang_register;
+
+/** Register Log
+ */
+ActionTaskRegisterer ActionLog_register;
+/** perform Log
+ */
+ActionPerformer ActionLog_perform;
+
+/** Register MarkDone
+ */
+ActionTaskRegisterer ActionMarkDone_register;
+
+/** Register Nop
+ */
+ActionTaskRegisterer ActionNop_register;
+
+/** Register RemoteHang
+ */
+ActionTaskRegisterer ActionRemoteHang_register;
+
+/** Register Remove
+ */
+ActionTaskRegisterer ActionRemove_register;
+
+/** Register Replay
+ */
+ActionTaskRegisterer ActionReplay_register;
+
+/** Register Reset
+ */
+ActionTaskRegisterer ActionReset_register;
+
+/** Register Split
+ */
+ActionTaskRegisterer ActionSplit_register;
+
+/** Register Syscall
+ */
+ActionTaskRegisterer ActionSyscall_register;
+/** perform Syscall
+ */
+ActionPerformer ActionSyscall_perform;
+
+/** Register Truncate
+ */
+ActionTaskRegisterer ActionTruncate_register;
+/** perform Truncate
+ */
+ActionPerformer ActionTruncate_perform;
+
+
+/** Macro to run to register all the ActionTask
+ *
+ * @param set The definition set to initialize.
+ */
+#define BUILD_INIT_AT(set) \
+  ActionAlter_register((set) + ATT_Alter); \
+  ActionCancelSyscall_register((set) + ATT_CancelSyscall); \
+  ActionDrop_register((set) + ATT_Drop); \
+  ActionDump_register((set) + ATT_Dump); \
+  ActionEcho_register((set) + ATT_Echo); \
+  ActionEmit_register((set) + ATT_Emit); \
+  ActionError_register((set) + ATT_Error); \
+  ActionHang_register((set) + ATT_Hang); \
+  ActionLocalHang_register((set) + ATT_LocalHang); \
+  ActionLog_register((set) + ATT_Log); \
+  ActionMarkDone_register((set) + ATT_MarkDone); \
+  ActionNop_register((set) + ATT_Nop); \
+  ActionRemoteHang_register((set) + ATT_RemoteHang); \
+  ActionRemove_register((set) + ATT_Remove); \
+  ActionReplay_register((set) + ATT_Replay); \
+  ActionReset_register((set) + ATT_Reset); \
+  ActionSplit_register((set) + ATT_Split); \
+  ActionSyscall_register((set) + ATT_Syscall); \
+  ActionTruncate_register((set) + ATT_Truncate); \
+  
+
+/** @} */
+
+#endif
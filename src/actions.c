@@ -30,10 +30,12 @@
 /******************************************************************************/
 
 #include <stdlib.h>
+#include <ctype.h>
 #include <pthread.h>
 #include <string.h>
 #include <netdb.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <errno.h>
 #include <unistd.h>
 
@@ -41,7 +43,11 @@
 #include "actions.h"
 #include "actionsdk.h"
 #include "socketinfo.h"
-#include "ligHT.h"
+#include "slab.h"
+#include "epoch.h"
+#include "arena.h"
+#include "payload.h"
+#include "binding.h"
 
 
 /******************************************************************************
@@ -54,9 +60,16 @@ static struct ActionConditionDefinition  conditionSet[ACT_Number];
 #define Action(action)    (taskSet[(action)->task.type])
 #define Condition(action) (conditionSet[(action)->condition.type])
 
+/** Allocator of the socket data.
+ */
+static Slab* socketDataSlab = NULL;
+
 void ActionSet_init(void) {
   BUILD_INIT_AT(taskSet);
   BUILD_INIT_AC(conditionSet);
+  if (!socketDataSlab) {
+    socketDataSlab = Slab_init(sizeof(ActionSocketData));
+  }
 }
 
 
@@ -68,7 +81,7 @@ void ActionSet_init(void) {
  */
 enum ActionMode {
   AM_Normal        = 0, /**< Do the action each time a match occured. */
-  AM_Once          = 1, /**< Do the action only once (action is removed after it execution). */
+  AM_Once          = 1, /**< Do the action only once (action is retired after it execution). */
   AM_OncePerCall   = 2, /**< Do the action only once per call. */
   AM_OncePerSocket = 3  /**< Do the action only once per socket. */
 };
@@ -100,18 +113,181 @@ struct Action {
   SocketInfoDirection direction; /**< Direction of the data. */
   HostAddress from;   /**< Source address. */
   HostAddress to;     /**< Destination address. */
+  struct ActionPattern* paths[2]; /**< Compiled path of the source and destination (unix rules). */
 
   struct ActionCondition condition;  /**< Condition of matching. */
   enum ActionMode        mode;       /**< 'Do'-Mode. */
   struct ActionTask      task;       /**< The task to execute. */
   struct ActionGoto      next;       /**< Next action to execute. */
 
-  int             accessors; /**< Number of processing using this action. */
-  bool            emptying;  /**< Do not allow more accessors. */
-  pthread_mutex_t mtx;       /**< Mutex to protect the number of accessors. */
-  pthread_cond_t  cond;      /**< Condition for waiting for accessor. */
+  volatile int    fired;     /**< Set when a do-once action has been triggered, the action
+                              *   is then removed by the next modification of the queue. */
+  struct Action*  released;  /**< Next action released along with the same snapshot. */
+};
+
+/** A part of a path pattern between two '*'.
+ */
+struct ActionPatternSegment {
+  const char* text; /**< Text of the segment, in the source of the pattern. */
+  size_t      len;  /**< Length of the segment. */
+};
+
+/** A compiled path pattern.
+ *
+ * The pattern is split on its '*' into segments that may contain '?'. The
+ * first segment is anchored at the beginning of the path, the last one at
+ * its end and the others are searched from left to right.
+ */
+struct ActionPattern {
+  bool   star;      /**< The pattern contains a '*'. */
+  size_t minLength; /**< Length of the shortest matching path. */
+  size_t count;     /**< Number of segments. */
+  struct ActionPatternSegment segments[1]; /**< The segments. */
 };
 
+/** Compile a path pattern.
+ *
+ * @param source The pattern, must outlive the compiled pattern.
+ * @return The compiled pattern, or NULL.
+ */
+static struct ActionPattern* ActionPattern_compile(const char* source) {
+  struct ActionPattern* pattern;
+  const char* star;
+  size_t count = 1;
+  size_t i;
+
+  for (star = strchr(source, '*') ; star != NULL ; star = strchr(star + 1, '*')) {
+    ++count;
+  }
+  pattern = (struct ActionPattern*)malloc(sizeof(struct ActionPattern)
+                                          + (count - 1) * sizeof(struct ActionPatternSegment));
+  if (pattern == NULL) {
+    return NULL;
+  }
+  pattern->star      = count > 1;
+  pattern->minLength = 0;
+  pattern->count     = count;
+  for (i = 0 ; i < count ; ++i) {
+    star = strchr(source, '*');
+    pattern->segments[i].text = source;
+    pattern->segments[i].len  = star ? (size_t)(star - source) : strlen(source);
+    pattern->minLength += pattern->segments[i].len;
+    source = star + 1;
+  }
+  return pattern;
+}
+
+/** Check if a segment of a pattern matches the beginning of a text.
+ */
+static inline bool ActionPattern_segment(const struct ActionPatternSegment* segment,
+                                         const char* text) {
+  size_t i;
+
+  for (i = 0 ; i < segment->len ; ++i) {
+    if (segment->text[i] != '?' && segment->text[i] != text[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Check if a path matches a compiled pattern.
+ *
+ * @param pattern The pattern.
+ * @param path    The path.
+ * @return true if the path matches.
+ */
+static bool ActionPattern_match(const struct ActionPattern* pattern, const char* path) {
+  const struct ActionPatternSegment* last = &pattern->segments[pattern->count - 1];
+  const size_t len = strlen(path);
+  size_t pos;
+  size_t end;
+  size_t i;
+
+  if (len < pattern->minLength) {
+    return false;
+  }
+  if (!pattern->star) {
+    return len == last->len && ActionPattern_segment(last, path);
+  }
+  end = len - last->len;
+  if (!ActionPattern_segment(&pattern->segments[0], path)
+      || !ActionPattern_segment(last, path + end)) {
+    return false;
+  }
+  pos = pattern->segments[0].len;
+  for (i = 1 ; i + 1 < pattern->count ; ++i) {
+    const struct ActionPatternSegment* segment = &pattern->segments[i];
+    while (pos + segment->len <= end && !ActionPattern_segment(segment, path + pos)) {
+      ++pos;
+    }
+    if (pos + segment->len > end) {
+      return false;
+    }
+    pos += segment->len;
+  }
+  return true;
+}
+
+/** Resolve the address of a rule.
+ *
+ * The address is an IPv4 or IPv6 address or a host name, optionally followed
+ * by the length of a prefix (10.2.0.0/16, fd00::/8). A host name is resolved
+ * to its first IPv4 address, or to its first IPv6 address if it has none.
+ *
+ * @param addr The address, modified.
+ * @param host Receive the address and the length of the prefix.
+ * @return An error message, or NULL on success.
+ */
+static const char* Action_resolve_host(char* addr, struct HostAddress* host) {
+  struct addrinfo hints;
+  struct addrinfo* res = NULL;
+  const struct addrinfo* pos;
+  const struct addrinfo* found = NULL;
+  char* slash = strchr(addr, '/');
+  long bits = -1;
+  int max;
+  int i;
+
+  if (slash) {
+    char* end;
+    *slash = '\0';
+    bits = strtol(slash + 1, &end, 10);
+    if (end == slash + 1 || *end != '\0' || bits < 0) {
+      return "Invalid prefix length";
+    }
+  }
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(addr, NULL, &hints, &res) != 0) {
+    return "Invalid host name";
+  }
+  for (pos = res ; pos != NULL ; pos = pos->ai_next) {
+    if (pos->ai_family == AF_INET || (found == NULL && pos->ai_family == AF_INET6)) {
+      found = pos;
+      if (pos->ai_family == AF_INET) {
+        break;
+      }
+    }
+  }
+  if (found == NULL
+      || !IPAddress_fromSockaddr(&host->addr, NULL, found->ai_addr, found->ai_addrlen)) {
+    freeaddrinfo(res);
+    return "Invalid host name";
+  }
+  freeaddrinfo(res);
+  max = IPAddress_isV4(&host->addr) ? IP_ADDRESS_BITS - IP_V4_PREFIX : IP_ADDRESS_BITS;
+  if (bits > max) {
+    return "Invalid prefix length";
+  }
+  host->prefix = bits < 0 ? IP_ADDRESS_BITS : IP_ADDRESS_BITS - max + (int)bits;
+  for (i = host->prefix ; i < IP_ADDRESS_BITS ; ++i) {
+    host->addr.bytes[i >> 3] &= ~(0x80 >> (i & 7));
+  }
+  return NULL;
+}
+
 static bool Action_parse_host(const char** from, void* dest,
                               const void* constraint, ParserStatus* status) {
   static Parse_enumData specialHosts[] = {
@@ -127,8 +303,11 @@ static bool Action_parse_host(const char** from, void* dest,
   Parser* parser;
   Parser* subparser;
 
-  host->addr = 0;
-  host->port = -1;
+  memset(&host->addr, 0, sizeof(host->addr));
+  host->prefix = 0;
+  host->port   = -1;
+  free(host->path);
+  host->path   = NULL;
 
   parser = Parser_init();
   Parser_addSpacedConstant(parser, constraint);
@@ -153,14 +332,22 @@ static bool Action_parse_host(const char** from, void* dest,
   if (!ok) {
     return false;
   }
-  if (ok && host->type == AH_Address) {
-    struct hostent* hostaddr = NULL;
-    hostaddr = gethostbyname(addr);
+  if (ok && host->type == AH_Address && (addr[0] == '/' || addr[0] == '@')) {
+    /* Path of a Unix socket */
+    if (host->port != -1 || service != NULL) {
+      free(addr);
+      free(service);
+      return SET_PARSE_ERROR(*from, "A Unix path takes no port");
+    }
+    host->type = AH_Path;
+    host->path = addr;
+  } else if (ok && host->type == AH_Address) {
+    const char* err = Action_resolve_host(addr, host);
     free(addr);
-    if (hostaddr == NULL) {
-      return SET_PARSE_ERROR(*from, "Invalid host name");
+    if (err != NULL) {
+      free(service);
+      return SET_PARSE_ERROR(*from, err);
     }
-    host->addr = ntohl(*(in_addr_t*)(hostaddr->h_addr));
   }
   if (ok && service != NULL) {
     struct servent* serv = NULL;
@@ -197,18 +384,26 @@ static bool Action_parse_close(const char** from, void* dest,
       && (*dir = Closing);
 }
 
-static bool Action_parse_condition(const char** from, void* dest,
-                                   const void* constraint, ParserStatus* status) {
+static bool Action_parse_accept(const char** from, void* dest,
+                                const void* constraint, ParserStatus* status) {
+  SocketInfoDirection* dir = (SocketInfoDirection*)dest;
+  return Parse_word(from, NULL, (void*)"accept", status)
+      && (*dir = Accepting);
+}
+
+/** Parse a single condition.
+ */
+static bool Action_parse_term(const char** from, struct ActionCondition* condition,
+                              ParserStatus* status) {
   const char* source = *from;
   char* action;
-  struct ActionCondition* condition = (struct ActionCondition*)dest;
   int i;
 
   if (!Parse_word(&source, &action, NULL, status)) {
     return false;
   }
   for (i = 0 ; i < ACT_Number ; ++i) {
-    if (strcmp(action, conditionSet[i].name) == 0) {
+    if (i != ACT_Expression && strcmp(action, conditionSet[i].name) == 0) {
       bool ret = true;
       if (conditionSet[i].argument) {
         ret = Parse_space(&source, NULL, NULL, status)
@@ -217,7 +412,10 @@ static bool Action_parse_condition(const char** from, void* dest,
       free(action);
       if (ret) {
         *from      = source;
-        condition->type = i;
+        condition->type        = i;
+        condition->usesData    = conditionSet[i].usesData;
+        condition->usesCall    = conditionSet[i].usesCall || conditionSet[i].usesData;
+        condition->countsCalls = conditionSet[i].countsCalls;
       }
       return ret;
     }
@@ -226,6 +424,400 @@ static bool Action_parse_condition(const char** from, void* dest,
   return SET_PARSE_ERROR(*from, "Condition name expected");
 }
 
+
+/******************************************************************************
+ * ActionExpression
+ *****************************************************************************/
+
+/** Maximum number of conditions in a composite condition.
+ */
+#define ACTION_EXPRESSION_TERMS 8
+
+/** Maximum nesting of the operators of a composite condition.
+ */
+#define ACTION_EXPRESSION_DEPTH 16
+
+/** Operators of the composite conditions.
+ */
+typedef enum ActionOperator {
+  AOP_Term, /**< A single condition. */
+  AOP_Not,  /**< Negation of the operand. */
+  AOP_And,  /**< All the operands hold. */
+  AOP_Or    /**< One of the operands holds. */
+} ActionOperator;
+
+/** Node of a composite condition.
+ *
+ * The conditions of a rule are compiled to a tree whose operands are sorted
+ * by cost, so that the operands that may be evaluated at each call are
+ * checked first and the evaluation stops as soon as the result is known.
+ */
+struct ActionExpression {
+  ActionOperator op;        /**< The operator. */
+  ActionCost     cost;      /**< Highest cost of the conditions of the node. */
+  bool           usesCall;  /**< True if a condition of the node looks at the call. */
+  int            count;     /**< Number of operands. */
+  struct ActionExpression* operands[ACTION_EXPRESSION_TERMS]; /**< Operands, the cheapest
+                                                                   first. */
+  struct ActionCondition   term; /**< The condition of a term. */
+};
+
+/** State of the parsing of a composite condition.
+ */
+struct ActionExpressionParser {
+  int terms; /**< Number of conditions read. */
+  int depth; /**< Current nesting. */
+};
+
+/** Release a node of a composite condition and its operands.
+ */
+static void ActionExpression_destroy(struct ActionExpression* node) {
+  int i;
+
+  if (node == NULL) {
+    return;
+  }
+  if (node->op == AOP_Term && conditionSet[node->term.type].close) {
+    conditionSet[node->term.type].close(node->term.data);
+  }
+  for (i = 0 ; i < node->count ; ++i) {
+    ActionExpression_destroy(node->operands[i]);
+  }
+  free(node);
+}
+
+/** Read an operator keyword, with the spaces around it.
+ *
+ * @return true if the keyword has been read.
+ */
+static bool ActionExpression_keyword(const char** from, const char* keyword) {
+  const char* source = *from;
+  const size_t len = strlen(keyword);
+
+  while (isspace((unsigned char)*source)) {
+    ++source;
+  }
+  if (strncmp(source, keyword, len) != 0
+      || !(isspace((unsigned char)source[len]) || source[len] == '(')) {
+    return false;
+  }
+  source += len;
+  while (isspace((unsigned char)*source)) {
+    ++source;
+  }
+  *from = source;
+  return true;
+}
+
+/** Add an operand to a node, the operands of a node of the same operator are
+ * merged, and keep the operands sorted by cost.
+ */
+static void ActionExpression_add(struct ActionExpression* node,
+                                 struct ActionExpression* operand) {
+  int i;
+
+  if (operand->op == node->op) {
+    for (i = 0 ; i < operand->count ; ++i) {
+      ActionExpression_add(node, operand->operands[i]);
+    }
+    operand->count = 0;
+    ActionExpression_destroy(operand);
+    return;
+  }
+  /* Stable insertion: equal costs keep the order of the rule */
+  for (i = node->count ; i > 0 && node->operands[i - 1]->cost > operand->cost ; --i) {
+    node->operands[i] = node->operands[i - 1];
+  }
+  node->operands[i] = operand;
+  ++node->count;
+  if (operand->cost > node->cost) {
+    node->cost = operand->cost;
+  }
+  node->usesCall = node->usesCall || operand->usesCall;
+}
+
+static bool ActionExpression_parseOr(const char** from, struct ActionExpression** dest,
+                                     struct ActionExpressionParser* parser,
+                                     ParserStatus* status);
+
+/** Parse a condition, a negation or a parenthesized expression.
+ */
+static bool ActionExpression_parseFactor(const char** from, struct ActionExpression** dest,
+                                         struct ActionExpressionParser* parser,
+                                         ParserStatus* status) {
+  const char* source = *from;
+  struct ActionExpression* node;
+  bool ok;
+
+  if (parser->depth >= ACTION_EXPRESSION_DEPTH) {
+    return SET_PARSE_ERROR(*from, "Condition nested too deep");
+  }
+  ++parser->depth;
+  if (ActionExpression_keyword(&source, "not")) {
+    ok = ActionExpression_parseFactor(&source, &node, parser, status);
+    if (ok) {
+      struct ActionExpression* operand = node;
+      if ((node = (struct ActionExpression*)calloc(1, sizeof(*node))) == NULL) {
+        ActionExpression_destroy(operand);
+        ok = SET_PARSE_ERROR(*from, "Cannot allocate the condition");
+      } else {
+        node->op          = AOP_Not;
+        node->cost        = operand->cost;
+        node->usesCall    = operand->usesCall;
+        node->count       = 1;
+        node->operands[0] = operand;
+      }
+    }
+  } else if (*source == '(') {
+    ++source;
+    while (isspace((unsigned char)*source)) {
+      ++source;
+    }
+    ok = ActionExpression_parseOr(&source, &node, parser, status);
+    while (ok && isspace((unsigned char)*source)) {
+      ++source;
+    }
+    if (ok && *source != ')') {
+      ActionExpression_destroy(node);
+      ok = SET_PARSE_ERROR(source, "')' expected");
+    } else {
+      ++source;
+    }
+  } else if (parser->terms >= ACTION_EXPRESSION_TERMS) {
+    ok = SET_PARSE_ERROR(*from, "Too many conditions");
+  } else if ((node = (struct ActionExpression*)calloc(1, sizeof(*node))) == NULL) {
+    ok = SET_PARSE_ERROR(*from, "Cannot allocate the condition");
+  } else {
+    ++parser->terms;
+    node->op = AOP_Term;
+    ok = Action_parse_term(&source, &node->term, status);
+    if (ok) {
+      node->cost     = node->term.usesData ? ACC_Data : conditionSet[node->term.type].cost;
+      node->usesCall = node->term.usesCall;
+    } else {
+      free(node);
+    }
+  }
+  --parser->depth;
+  if (ok) {
+    *from = source;
+    *dest = node;
+  }
+  return ok;
+}
+
+/** Parse operands separated by an operator.
+ *
+ * @param next     Parser of the operands.
+ * @param op       The operator.
+ * @param keyword  The keyword of the operator.
+ */
+static bool ActionExpression_parseList(const char** from, struct ActionExpression** dest,
+                                       struct ActionExpressionParser* parser,
+                                       ParserStatus* status,
+                                       bool (*next)(const char**, struct ActionExpression**,
+                                                    struct ActionExpressionParser*,
+                                                    ParserStatus*),
+                                       ActionOperator op, const char* keyword) {
+  const char* source = *from;
+  struct ActionExpression* node = NULL;
+  struct ActionExpression* operand;
+
+  if (!next(&source, &operand, parser, status)) {
+    return false;
+  }
+  while (ActionExpression_keyword(&source, keyword)) {
+    if (node == NULL) {
+      if ((node = (struct ActionExpression*)calloc(1, sizeof(*node))) == NULL) {
+        ActionExpression_destroy(operand);
+        return SET_PARSE_ERROR(*from, "Cannot allocate the condition");
+      }
+      node->op = op;
+      ActionExpression_add(node, operand);
+    }
+    if (!next(&source, &operand, parser, status)) {
+      ActionExpression_destroy(node);
+      return false;
+    }
+    ActionExpression_add(node, operand);
+  }
+  *from = source;
+  *dest = node ? node : operand;
+  return true;
+}
+
+static bool ActionExpression_parseAnd(const char** from, struct ActionExpression** dest,
+                                      struct ActionExpressionParser* parser,
+                                      ParserStatus* status) {
+  return ActionExpression_parseList(from, dest, parser, status,
+                                    ActionExpression_parseFactor, AOP_And, "and");
+}
+
+static bool ActionExpression_parseOr(const char** from, struct ActionExpression** dest,
+                                     struct ActionExpressionParser* parser,
+                                     ParserStatus* status) {
+  return ActionExpression_parseList(from, dest, parser, status,
+                                    ActionExpression_parseAnd, AOP_Or, "or");
+}
+
+/** Collect the flags of the conditions of a node.
+ */
+static void ActionExpression_flags(const struct ActionExpression* node,
+                                   struct ActionCondition* condition) {
+  int i;
+
+  if (node->op == AOP_Term) {
+    condition->usesData    = condition->usesData || node->term.usesData;
+    condition->usesCall    = condition->usesCall || node->term.usesCall;
+    condition->countsCalls = condition->countsCalls || node->term.countsCalls;
+  }
+  for (i = 0 ; i < node->count ; ++i) {
+    ActionExpression_flags(node->operands[i], condition);
+  }
+}
+
+static bool ActionExpression_eval(const struct ActionExpression* node, SocketInfo* si,
+                                  SocketInfoDirection direction, bool matched,
+                                  ActionCallData* state) {
+  int i;
+
+  switch (node->op) {
+   case AOP_Not:
+    return !ActionExpression_eval(node->operands[0], si, direction, matched, state);
+   case AOP_And:
+    for (i = 0 ; i < node->count ; ++i) {
+      if (!ActionExpression_eval(node->operands[i], si, direction, matched, state)) {
+        return false;
+      }
+    }
+    return true;
+   case AOP_Or:
+    for (i = 0 ; i < node->count ; ++i) {
+      if (ActionExpression_eval(node->operands[i], si, direction, matched, state)) {
+        return true;
+      }
+    }
+    return false;
+   default:
+    return conditionSet[node->term.type].match((ActionData*)node->term.data, si, direction,
+                                               matched, state);
+  }
+}
+
+bool ActionExpression_match(ActionData* data, SocketInfo* si,
+                            SocketInfoDirection direction, bool matched,
+                            ActionCallData* state) {
+  const struct ActionExpression* root = (const struct ActionExpression*)data[0].p;
+
+  /* The whole expression is checked once the call is known, so that the
+   * conditions drawing or updating a state are evaluated once per call */
+  if (state == NULL && root->usesCall) {
+    return true;
+  }
+  return ActionExpression_eval(root, si, direction, matched, state);
+}
+
+static void ActionExpression_writeNode(char** buffer, const char* end,
+                                       struct ActionExpression* node) {
+  int i;
+
+  switch (node->op) {
+   case AOP_Term:
+    if (conditionSet[node->term.type].write) {
+      conditionSet[node->term.type].write(buffer, end, node->term.data);
+    } else {
+      Action_print(buffer, end, "%s ", conditionSet[node->term.type].name);
+    }
+    return;
+   case AOP_Not:
+    Action_print(buffer, end, "not ");
+    break;
+   default:
+    break;
+  }
+  for (i = 0 ; i < node->count ; ++i) {
+    const bool nested = node->operands[i]->op == AOP_And || node->operands[i]->op == AOP_Or;
+    if (i > 0) {
+      Action_print(buffer, end, node->op == AOP_And ? "and " : "or ");
+    }
+    Action_print(buffer, end, nested ? "( " : "");
+    ActionExpression_writeNode(buffer, end, node->operands[i]);
+    Action_print(buffer, end, nested ? ") " : "");
+  }
+}
+
+void ActionExpression_write(char** buffer, const char* end, ActionData* data) {
+  ActionExpression_writeNode(buffer, end, (struct ActionExpression*)data[0].p);
+}
+
+void ActionExpression_close(ActionData* data) {
+  ActionExpression_destroy((struct ActionExpression*)data[0].p);
+  data[0].p = NULL;
+}
+
+static int ActionExpression_listPayloads(struct ActionExpression* node,
+                                         const Payload** payloads, int max) {
+  int count = 0;
+  int i;
+
+  if (node->op == AOP_Term && conditionSet[node->term.type].payloads) {
+    return conditionSet[node->term.type].payloads(node->term.data, payloads, max);
+  }
+  for (i = 0 ; i < node->count ; ++i) {
+    count += ActionExpression_listPayloads(node->operands[i], payloads + count, max - count);
+  }
+  return count;
+}
+
+int ActionExpression_payloads(ActionData* data, const Payload** payloads, int max) {
+  return ActionExpression_listPayloads((struct ActionExpression*)data[0].p, payloads, max);
+}
+
+static void ActionExpression_countNode(struct ActionExpression* node, SocketInfo* si,
+                                       SocketInfoDirection direction, uint64_t bytes) {
+  int i;
+
+  if (node->op == AOP_Term && conditionSet[node->term.type].count) {
+    conditionSet[node->term.type].count(node->term.data, si, direction, bytes);
+  }
+  for (i = 0 ; i < node->count ; ++i) {
+    ActionExpression_countNode(node->operands[i], si, direction, bytes);
+  }
+}
+
+void ActionExpression_count(ActionData* data, SocketInfo* si,
+                            SocketInfoDirection direction, uint64_t bytes) {
+  ActionExpression_countNode((struct ActionExpression*)data[0].p, si, direction, bytes);
+}
+
+/** Parse the condition of a rule.
+ *
+ * A single condition is stored as is, a composite one is compiled to an
+ * expression tree (see ActionExpression).
+ */
+static bool Action_parse_condition(const char** from, void* dest,
+                                   const void* constraint, ParserStatus* status) {
+  struct ActionCondition* condition = (struct ActionCondition*)dest;
+  struct ActionExpressionParser parser;
+  struct ActionExpression* root;
+
+  parser.terms = 0;
+  parser.depth = 0;
+  if (!ActionExpression_parseOr(from, &root, &parser, status)) {
+    return false;
+  }
+  if (root->op == AOP_Term) {
+    *condition = root->term;
+    free(root);
+    return true;
+  }
+  memset(condition, 0, sizeof(*condition));
+  condition->type      = ACT_Expression;
+  condition->data[0].p = root;
+  ActionExpression_flags(root, condition);
+  return true;
+}
+
 static bool Action_parse_action(const char** from, void* dest,
                                 const void* constraint, ParserStatus* status) {
   const char* source = *from;
@@ -289,6 +881,7 @@ static bool Action_parse(Action* action, const char* instruction, ParserStatus*
     { "ip",  AP_IP },
     { "tcp", AP_TCP },
     { "udp", AP_UDP },
+    { "unix", AP_UNIX },
     { NULL,  0 } };
   static Parse_enumData domodes[] = {
     { "do",                 AM_Normal },
@@ -315,11 +908,12 @@ static bool Action_parse(Action* action, const char* instruction, ParserStatus*
   Parser_add(subparser2, Action_parse_with, action, NULL, NULL);
   /*   talk-with */
   Parser_addSpaced(subparser, Action_parse_host, &action->from, (void*)"talk-with", NULL);
-  /*   or (connect|from) */
+  /*   or (connect|close|accept|from) */
   subparser = Parser_newSubParser(subparser, PB_suite);
   subparser2 = Parser_newSubParser(subparser, PB_first);
   Parser_addSpaced(subparser2, Action_parse_connect, &action->direction, NULL, NULL);
   Parser_addSpaced(subparser2, Action_parse_close, &action->direction, NULL, NULL);
+  Parser_addSpaced(subparser2, Action_parse_accept, &action->direction, NULL, NULL);
   Parser_addSpaced(subparser2, Action_parse_host, &action->from, (void*)"from", NULL);
   /*      and to */
   Parser_addSpaced(subparser, Action_parse_host, &action->to, (void*)"to", NULL);
@@ -341,25 +935,66 @@ static bool Action_parse(Action* action, const char* instruction, ParserStatus*
   /* Default values */
   action->direction      = Data;
   action->condition.type = ACT_Always;
+  action->condition.usesData    = false;
+  action->condition.usesCall    = false;
+  action->condition.countsCalls = false;
   action->mode           = AM_Normal;
   action->task.type      = ATT_Nop;
   action->from.type      = AH_None;
   action->to.type        = AH_None;
+  action->from.path      = NULL;
+  action->to.path        = NULL;
+  action->paths[0]       = NULL;
+  action->paths[1]       = NULL;
 
   return Parser_run(parser, instruction, PB_suite, true, status);
 }
 
+/** Check that the hosts of a rule fit its protocol.
+ *
+ * @return An error message, or NULL if the hosts are valid.
+ */
+static const char* Action_checkHosts(const Action* action) {
+  const struct HostAddress* hosts[2];
+  int i;
+
+  hosts[0] = &action->from;
+  hosts[1] = &action->to;
+  for (i = 0 ; i < 2 ; ++i) {
+    if (hosts[i]->type == AH_Path && action->proto != AP_UNIX) {
+      return "Unix paths require the unix protocol";
+    }
+    if ((hosts[i]->type == AH_Address || hosts[i]->type == AH_DNS)
+        && action->proto == AP_UNIX) {
+      return "IP addresses require an IP protocol";
+    }
+  }
+  return NULL;
+}
+
 Action* Action_init(const char* instruction, ParserStatus* status) {
   Action* action;
+  const char* err;
   action = (Action*)malloc(sizeof(Action));
   if (!Action_parse(action, instruction, status)) {
+    free(action->from.path);
+    free(action->to.path);
     free(action);
     return NULL;
   }
-  action->accessors = 0;
-  action->emptying  = false;
-  pthread_mutex_init(&action->mtx, NULL);
-  pthread_cond_init(&action->cond, NULL);
+  if ((err = Action_checkHosts(action)) != NULL) {
+    (void)FORCE_PARSE_ERROR(instruction, err);
+    Action_destroy(action);
+    return NULL;
+  }
+  /* Path patterns are compiled once, sockets only run the compiled form */
+  if ((action->from.path && !(action->paths[0] = ActionPattern_compile(action->from.path)))
+      || (action->to.path && !(action->paths[1] = ActionPattern_compile(action->to.path)))) {
+    Action_destroy(action);
+    return NULL;
+  }
+  action->fired    = 0;
+  action->released = NULL;
   return action;
 }
 
@@ -373,24 +1008,60 @@ void Action_destroy(Action* action) {
   if (Action(action).close) {
     Action(action).close(action->task.data);
   }
-  pthread_mutex_destroy(&action->mtx);
-  pthread_cond_destroy(&action->cond);
+  free(action->paths[0]);
+  free(action->paths[1]);
+  free(action->from.path);
+  free(action->to.path);
   free(action);
 }
 
-static bool Action_addressMatch(const struct HostAddress* address,
-                                const struct HostAddress* sockAddr) {
+/** Address fields of a rule.
+ */
+enum ActionField {
+  AAF_From = 0, /**< Source address. */
+  AAF_To   = 1  /**< Destination address. */
+};
+
+/** Lines whose address prefixes contain the addresses of a socket.
+ *
+ * The sets are filled by a walk of the address trie of the rules (see
+ * ActionTrie_walk), indexed by the field of the rule.
+ */
+struct ActionAddressLines {
+  ActionLineSet local[2];  /**< Prefixes containing the local address. */
+  ActionLineSet remote[2]; /**< Prefixes containing the remote address. */
+};
+
+/** Test if an address of a rule matches an end of a socket.
+ *
+ * @param action   The action.
+ * @param field    The field of the rule.
+ * @param sockAddr The end of the socket.
+ * @param sockPath The path of that end for a Unix socket, NULL otherwise.
+ * @param prefixes The lines whose prefixes contain the address of that end,
+ *                 NULL to compare the prefix of the rule.
+ * @return true if the address matches.
+ */
+static bool Action_addressMatch(const Action* action, enum ActionField field,
+                                const struct HostAddress* sockAddr,
+                                const char* sockPath,
+                                const ActionLineSet* prefixes) {
+  const struct HostAddress* address = field == AAF_From ? &action->from : &action->to;
   const bool canBeMe  = sockAddr->type == AH_Me;
   const bool dns      = sockAddr->type == AH_DNS;
   const bool samePort = (address->port == -1 || address->port == sockAddr->port);
-  const bool sameHost = (sockAddr->addr != address->addr);
   switch (address->type) {
    case AH_Me:
     return canBeMe && samePort;
    case AH_DNS:
     return dns;
    case AH_Address:
-    return sameHost && samePort;
+    if (prefixes) {
+      return samePort && ActionLineSet_contains(&prefixes[field], action->pos);
+    }
+    return samePort && IPAddress_inPrefix(&sockAddr->addr, &address->addr, address->prefix);
+   case AH_Path:
+    return sockPath != NULL && ActionPattern_match(action->paths[field], sockPath);
    case AH_Any:
     return samePort;
    default:
@@ -398,103 +1069,188 @@ static bool Action_addressMatch(const struct HostAddress* address,
   }
 }
 
-inline bool Action_match(Action* action, SocketInfo* si,
-                         SocketInfoDirection direction, bool matched) {
-  if (!(action->direction & direction)) {
-    return false;
-  }
-  if (!Condition(action).match(action->condition.data, si, direction, matched)
-       || !(si->proto & action->proto)) {
+/** Test if the socket matches the static part of the rule.
+ *
+ * The static part of the rule is everything but the condition: its result
+ * only depends on the socket and the direction.
+ *
+ * @param action The action.
+ * @param si     The socket to test.
+ * @param direction Data direction.
+ * @param lines  The result of the walk of the address trie for the socket,
+ *               or NULL.
+ * @return true if the socket matches the static part of the rule.
+ */
+static inline bool Action_matchSocket(const Action* action, const SocketInfo* si,
+                                      SocketInfoDirection direction,
+                                      const struct ActionAddressLines* lines) {
+  const ActionLineSet* local  = lines ? lines->local : NULL;
+  const ActionLineSet* remote = lines ? lines->remote : NULL;
+  const char* localPath  = si->paths ? si->paths->local : NULL;
+  const char* remotePath = si->paths ? si->paths->remote : NULL;
+
+  if (!(action->direction & direction) || !(si->proto & action->proto)) {
     return false;
   }
   switch (action->direction) {
    case Data: case Writing: case Reading:
     if (action->to.type != AH_None) {
-      return Action_addressMatch(direction == Writing ? &action->from : &action->to, &si->local)
-          && Action_addressMatch(direction == Reading ? &action->from : &action->to, &si->remote);
+      return Action_addressMatch(action, direction == Writing ? AAF_From : AAF_To,
+                                 &si->local, localPath, local)
+          && Action_addressMatch(action, direction == Reading ? AAF_From : AAF_To,
+                                 &si->remote, remotePath, remote);
     }
+    /* fall through */
    case Any_Dir:
-    return Action_addressMatch(&action->from, &si->local)
-        || Action_addressMatch(&action->from, &si->remote);
+    return Action_addressMatch(action, AAF_From, &si->local, localPath, local)
+        || Action_addressMatch(action, AAF_From, &si->remote, remotePath, remote);
    case Connecting: case Closing:
-    return Action_addressMatch(&action->to, &si->remote);
+    return Action_addressMatch(action, AAF_To, &si->remote, remotePath, remote);
+   case Accepting:
+    return Action_addressMatch(action, AAF_To, &si->local, localPath, local);
    default:
     return false;
   }
 }
 
+/** Test if the condition of the rule is fulfilled.
+ *
+ * The conditions looking at the data match as long as the call data is
+ * not given.
+ */
+static inline bool Action_matchCondition(Action* action, SocketInfo* si,
+                                         SocketInfoDirection direction, bool matched,
+                                         ActionCallData* state) {
+  return Condition(action).match(action->condition.data, si, direction, matched, state);
+}
+
+inline bool Action_match(Action* action, SocketInfo* si,
+                         SocketInfoDirection direction, bool matched) {
+  return Action_matchSocket(action, si, direction, NULL)
+      && Action_matchCondition(action, si, direction, matched, NULL);
+}
+
+static void ActionSocketData_unhang(ActionSocketData* data, SocketInfo* si,
+                                    SocketInfoDirection direction);
+
 bool Action_process(Action* action, SocketInfo* si, ActionCallData* state) {
   struct ActionSocketData* socketState;
-  socketState = ActionSocketData_get(si, state->queue);
-  if (state->direction == Reading && socketState->hanging) {
-    socketState->hanging = false;
+  bool ret;
+  socketState = (ActionSocketData*)si->data;
+  if (socketState && (socketState->hanging & state->direction)) {
+    ActionSocketData_unhang(socketState, si, state->direction);
     if (action->task.type == ATT_Hang) {
       return true;
     }
   }
-  return Action(action).perform(action->pos, action->task.data, si, state);
+  /* The I/O of the action itself (logs, dumps...) must not be intercepted */
+  Binding_enter();
+  ret = Action(action).perform(action->pos, action->task.data, si, state);
+  Binding_leave();
+  return ret;
 }
 
-static inline  void Action_show_address(const char* kw, struct HostAddress* addr, char** buffer) {
-  switch (addr->type) {
-   case AH_Me:      *buffer += sprintf(*buffer, "%s me ", kw); break;
-   case AH_Any:     *buffer += sprintf(*buffer, "%s any ", kw); break;
-   case AH_DNS:     *buffer += sprintf(*buffer, "%s dns ", kw); break;
-   case AH_Address: *buffer += sprintf(*buffer, "%s %d.%d.%d.%d ", kw, SHOW_ADDR(addr->addr)); break;
-   default:         *buffer += sprintf(*buffer, "%s ?none? ", kw); break;
+void Action_print(char** buffer, const char* end, const char* format, ...) {
+  va_list args;
+  int ret;
+
+  if (*buffer >= end) {
+    return;
   }
-  if (addr->port != -1 && addr->type != AH_DNS) {
-    *buffer += sprintf(*buffer, "port %d ", addr->port);
+  va_start(args, format);
+  ret = vsnprintf(*buffer, end - *buffer, format, args);
+  va_end(args);
+  if (ret < 0) {
+    **buffer = '\0';
+  } else if (ret >= end - *buffer) {
+    *buffer += end - *buffer - 1;
+  } else {
+    *buffer += ret;
   }
 }
 
-void Action_show(Action* action, int fd) {
-  char buffer[1024];
+static inline  void Action_show_address(const char* kw, struct HostAddress* addr, char** buffer,
+                                        const char* end) {
+  char ip[IP_ADDRESS_STRLEN];
+  int  prefix = addr->prefix;
+
+  switch (addr->type) {
+   case AH_Me:      Action_print(buffer, end, "%s me ", kw); break;
+   case AH_Any:     Action_print(buffer, end, "%s any ", kw); break;
+   case AH_DNS:     Action_print(buffer, end, "%s dns ", kw); break;
+   case AH_Path:    Action_print(buffer, end, "%s %s ", kw, addr->path); break;
+   case AH_Address:
+    Action_print(buffer, end, "%s %s", kw, IPAddress_format(&addr->addr, ip));
+    if (IPAddress_isV4(&addr->addr) && prefix >= IP_V4_PREFIX) {
+      prefix -= IP_V4_PREFIX;
+      if (prefix < IP_ADDRESS_BITS - IP_V4_PREFIX) {
+        Action_print(buffer, end, "/%d", prefix);
+      }
+    } else if (prefix < IP_ADDRESS_BITS) {
+      Action_print(buffer, end, "/%d", prefix);
+    }
+    Action_print(buffer, end, " ");
+    break;
+   default:         Action_print(buffer, end, "%s ?none? ", kw); break;
+  }
+  if (addr->port != -1 && addr->type != AH_DNS) {
+    Action_print(buffer, end, "port %d ", addr->port);
+  }
+}
+
+void Action_show(Action* action, int fd) {
+  char buffer[8192] = "";
   char *ptr = buffer;
+  /* Keep room for the end of line */
+  const char* end = buffer + sizeof(buffer) - 1;
+
   switch (action->proto) {
-   case AP_UDP: ptr += sprintf(ptr, "%d on udp ", action->pos); break;
-   case AP_TCP: ptr += sprintf(ptr, "%d on tcp ", action->pos); break;
-   case AP_IP:  ptr += sprintf(ptr, "%d on ip ", action->pos); break;
+   case AP_UDP: Action_print(&ptr, end, "%d on udp ", action->pos); break;
+   case AP_TCP: Action_print(&ptr, end, "%d on tcp ", action->pos); break;
+   case AP_IP:  Action_print(&ptr, end, "%d on ip ", action->pos); break;
+   case AP_UNIX: Action_print(&ptr, end, "%d on unix ", action->pos); break;
+   default: break;
   }
   switch (action->direction) {
-   case Any_Dir: Action_show_address("with", &action->from, &ptr); break;
-   case Connecting: Action_show_address("connect to", &action->to, &ptr); break;
-   case Closing: Action_show_address("close to", &action->to, &ptr); break;
+   case Any_Dir: Action_show_address("with", &action->from, &ptr, end); break;
+   case Connecting: Action_show_address("connect to", &action->to, &ptr, end); break;
+   case Closing: Action_show_address("close to", &action->to, &ptr, end); break;
+   case Accepting: Action_show_address("accept to", &action->to, &ptr, end); break;
    default:
     if (action->to.type == AH_None) {
-      Action_show_address("talk-with", &action->from, &ptr);
+      Action_show_address("talk-with", &action->from, &ptr, end);
     } else {
-      Action_show_address("from", &action->from, &ptr);
-      Action_show_address("to", &action->to, &ptr);
+      Action_show_address("from", &action->from, &ptr, end);
+      Action_show_address("to", &action->to, &ptr, end);
     }
     break;
   }
   if (Condition(action).write) {
-    ptr += sprintf(ptr, "when ");
-    Condition(action).write(&ptr, action->condition.data);
+    Action_print(&ptr, end, "when ");
+    Condition(action).write(&ptr, end, action->condition.data);
   } else {
-    ptr += sprintf(ptr, "when %s ", Condition(action).name);
+    Action_print(&ptr, end, "when %s ", Condition(action).name);
   }
   switch (action->mode) {
-   case AM_Normal:        ptr += sprintf(ptr, "do "); break;
-   case AM_Once:          ptr += sprintf(ptr, "do-once "); break;
-   case AM_OncePerCall:   ptr += sprintf(ptr, "do-once-per-call "); break;
-   case AM_OncePerSocket: ptr += sprintf(ptr, "do-once-per-socket "); break;
+   case AM_Normal:        Action_print(&ptr, end, "do "); break;
+   case AM_Once:          Action_print(&ptr, end, "do-once "); break;
+   case AM_OncePerCall:   Action_print(&ptr, end, "do-once-per-call "); break;
+   case AM_OncePerSocket: Action_print(&ptr, end, "do-once-per-socket "); break;
   }
   if (Action(action).write) {
-    Action(action).write(&ptr, action->task.data);
+    Action(action).write(&ptr, end, action->task.data);
   } else {
-    ptr += sprintf(ptr, "%s ",  Action(action).name);
+    Action_print(&ptr, end, "%s ",  Action(action).name);
   }
   switch (action->next.type) {
-   case AGT_Continue: ptr += sprintf(ptr, "continue"); break;
-   case AGT_Goto:     ptr += sprintf(ptr, "goto %d", action->next.line); break;
-   case AGT_Next:     ptr += sprintf(ptr, "next"); break;
-   case AGT_Do:       ptr += sprintf(ptr, "exec %d", action->next.line); break;
-   case AGT_Stop:     ptr += sprintf(ptr, "stop"); break;
+   case AGT_Continue: Action_print(&ptr, end, "continue"); break;
+   case AGT_Goto:     Action_print(&ptr, end, "goto %d", action->next.line); break;
+   case AGT_Next:     Action_print(&ptr, end, "next"); break;
+   case AGT_Do:       Action_print(&ptr, end, "exec %d", action->next.line); break;
+   case AGT_Stop:     Action_print(&ptr, end, "stop"); break;
   }
-  ptr += sprintf(ptr, "\n");
-  write(fd, buffer, ptr - buffer);
+  *ptr++ = '\n';
+  (void)Binding_write(fd, buffer, ptr - buffer);
 }
 
 bool Action_error(const char* message) {
@@ -502,269 +1258,1721 @@ bool Action_error(const char* message) {
   return false;
 }
 
+/** Operators of the comparisons, the longest first.
+ */
+static const struct {
+  const char*      name; /**< The operator. */
+  ActionComparison type; /**< Its type. */
+} comparisons[] = {
+  { "<=", ACMP_LessEqual },
+  { ">=", ACMP_GreaterEqual },
+  { "==", ACMP_Equal },
+  { "!=", ACMP_NotEqual },
+  { "<",  ACMP_Less },
+  { ">",  ACMP_Greater },
+  { NULL, ACMP_Equal }
+};
+
+bool ActionComparison_parse(const char** from, void* dest, const void* constraint,
+                            ParserStatus* status) {
+  ActionData* data = (ActionData*)dest;
+  const char* source = *from;
+  uint64_t value = 0;
+  int i;
+
+  for (i = 0 ; comparisons[i].name != NULL ; ++i) {
+    if (strncmp(source, comparisons[i].name, strlen(comparisons[i].name)) == 0) {
+      break;
+    }
+  }
+  if (comparisons[i].name == NULL) {
+    return SET_PARSE_ERROR(*from, "Comparison operator expected");
+  }
+  source += strlen(comparisons[i].name);
+  if (!Parse_space(&source, NULL, NULL, status)) {
+    return false;
+  }
+  if (*source < '0' || *source > '9') {
+    return SET_PARSE_ERROR(source, "Not an integer value");
+  }
+  while (*source >= '0' && *source <= '9') {
+    if (value > (UINT64_MAX - (*source - '0')) / 10) {
+      return SET_PARSE_ERROR(source, "Value too large");
+    }
+    value = value * 10 + (*source++ - '0');
+  }
+  data[0].i  = comparisons[i].type;
+  data[1].ul = value;
+  *from = source;
+  return CLEAR_PARSE_ERROR;
+}
+
+void ActionComparison_write(char** buffer, const char* end, const ActionData* data) {
+  int i;
+
+  for (i = 0 ; comparisons[i].name != NULL ; ++i) {
+    if ((int)comparisons[i].type == data[0].i) {
+      break;
+    }
+  }
+  Action_print(buffer, end, "%s %llu ", comparisons[i].name ? comparisons[i].name : "==",
+                     (unsigned long long)data[1].ul);
+}
+
+/** Scopes of the rate conditions, the default one last.
+ */
+static const struct {
+  const char*     name;  /**< The keyword of the scope. */
+  ActionRateScope scope; /**< Its type. */
+} rateScopes[] = {
+  { "per peer",   ARS_Peer },
+  { "per rule",   ARS_Rule },
+  { "per socket", ARS_Socket },
+  { NULL,         ARS_Socket }
+};
+
+bool ActionRate_parse(const char** from, void* dest, const void* constraint,
+                      ParserStatus* status) {
+  static const char multipliers[] = "KMG";
+  ActionData* data = (ActionData*)dest;
+  const char* unit = (const char*)constraint;
+  const char* source = *from;
+  const char* multiplier;
+  int i;
+
+  for (i = 0 ; rateScopes[i].name != NULL ; ++i) {
+    if (strncmp(source, rateScopes[i].name, strlen(rateScopes[i].name)) == 0) {
+      source += strlen(rateScopes[i].name);
+      if (!Parse_space(&source, NULL, NULL, status)) {
+        return false;
+      }
+      break;
+    }
+  }
+  if (!ActionComparison_parse(&source, data, NULL, status)) {
+    return false;
+  }
+  if (*source != '\0' && (multiplier = strchr(multipliers, *source)) != NULL) {
+    const char* pos;
+    for (pos = multipliers ; pos <= multiplier ; ++pos) {
+      if (data[1].ul > UINT64_MAX / 1000) {
+        return SET_PARSE_ERROR(source, "Value too large");
+      }
+      data[1].ul *= 1000;
+    }
+    ++source;
+  }
+  if (unit && strncmp(source, unit, strlen(unit)) == 0) {
+    source += strlen(unit);
+  }
+  if (strncmp(source, "/s", 2) != 0) {
+    return SET_PARSE_ERROR(source, "Rate per second expected");
+  }
+  source += 2;
+  data[2].i = rateScopes[i].scope;
+  /* The window of a rule scope is allocated by the first counted call: the
+   * closer is not run if the rest of the rule fails to parse */
+  data[3].p = NULL;
+  *from = source;
+  return CLEAR_PARSE_ERROR;
+}
+
+void ActionRate_write(char** buffer, const char* end, const ActionData* data) {
+  int i;
+
+  for (i = 0 ; rateScopes[i].name != NULL ; ++i) {
+    if ((int)rateScopes[i].scope == data[2].i) {
+      break;
+    }
+  }
+  if (rateScopes[i].name != NULL && rateScopes[i].scope != ARS_Socket) {
+    Action_print(buffer, end, "%s ", rateScopes[i].name);
+  }
+  ActionComparison_write(buffer, end, data);
+  /* The unit replaces the trailing space */
+  if ((*buffer)[-1] == ' ') {
+    --*buffer;
+  }
+  Action_print(buffer, end, "/s ");
+}
+
+void ActionRate_count(ActionData* data, SocketInfo* si,
+                      SocketInfoDirection direction, uint64_t bytes) {
+  RateWindow* window;
+
+  if (data[2].i != ARS_Rule) {
+    return;
+  }
+  window = (RateWindow*)data[3].p;
+  if (window == NULL) {
+    window = (RateWindow*)calloc(1, sizeof(RateWindow));
+    if (window == NULL) {
+      return;
+    }
+    if (!__sync_bool_compare_and_swap(&data[3].p, NULL, window)) {
+      free(window);
+      window = (RateWindow*)data[3].p;
+    }
+  }
+  RateWindow_add(window, Clock_coarse(), bytes);
+}
+
+void ActionRate_close(ActionData* data) {
+  free(data[3].p);
+  data[3].p = NULL;
+}
+
 
 /******************************************************************************
  * ActionQueue
  *****************************************************************************/
 
-#define ACQUIRE_READ                                                          \
-  if (mt) {                                                                   \
-    pthread_rwlock_rdlock(&queue->lock);                                      \
-}
 #define ACQUIRE_WRITE                                                         \
   if (mt) {                                                                   \
-    pthread_rwlock_wrlock(&queue->lock);                                      \
+    pthread_mutex_lock(&queue->lock);                                         \
   }
 #define RELEASE                                                               \
   if (mt) {                                                                   \
-    pthread_rwlock_unlock(&queue->lock);                                      \
+    pthread_mutex_unlock(&queue->lock);                                       \
   }
-#define LOCK_ACTION(action)                                                   \
-  if (mt) {                                                                   \
-    pthread_mutex_lock(&action->mtx);                                         \
-    if (action->emptying) {                                                   \
-      pthread_mutex_unlock(&action->mtx);                                     \
-      action = NULL;                                                          \
-    } else {                                                                  \
-      ++(action->accessors);                                                  \
-      pthread_mutex_unlock(&action->mtx);                                     \
-    }                                                                         \
-  }
-#define UNLOCK_ACTION(action)                                                 \
-  pthread_mutex_lock(&action->mtx);                                           \
-  --(action->accessors);                                                      \
-  if (action->accessors == 0 && action->emptying) {                           \
-    pthread_cond_signal(&action->cond);                                       \
-  }                                                                           \
-  pthread_mutex_unlock(&action->mtx);
-#define EMPTY_ACTION(action)                                                  \
-  if (mt) {                                                                   \
-    RELEASE                                                                   \
-    pthread_mutex_lock(&action->mtx);                                         \
-    action->emptying = true;                                                  \
-    while (action->accessors > 0) {                                           \
-      pthread_cond_wait(&action->cond, &action->mtx);                         \
-    }                                                                         \
-    pthread_mutex_unlock(&action->mtx);                                       \
-    ACQUIRE_WRITE                                                             \
+
+/** Number of port buckets of the index.
+ */
+#define INDEX_PORT_BUCKETS 64
+
+/** Number of protocols of the index (TCP, UDP, Unix).
+ */
+#define INDEX_PROTOS 3
+
+/** Index of the rules of a queue.
+ *
+ * Each set contains the lines whose rule may match a socket having the
+ * corresponding attribute, so that the candidates for a socket are found by
+ * intersecting a few sets instead of matching every rule of the queue.
+ */
+struct ActionIndex {
+  ActionLineSet directions[ACTION_DIRECTIONS]; /**< Rules per direction (Reading, Writing, Connecting, Closing, Accepting). */
+  ActionLineSet protos[INDEX_PROTOS]; /**< Rules per protocol (TCP, UDP, Unix). */
+  ActionLineSet anyPort;          /**< Rules that do not require a given port. */
+  ActionLineSet ports[INDEX_PORT_BUCKETS]; /**< Rules requiring a port, by port bucket. */
+  ActionLineSet notDns;           /**< Rules that may match non-DNS sockets. */
+  ActionLineSet remotePort;       /**< Rules requiring a port on the remote end only. */
+};
+
+/** Address of a rule in the address trie.
+ */
+struct ActionTrieEntry {
+  int line;  /**< Line of the rule. */
+  int field; /**< Field of the address in the rule (see ActionField). */
+  int next;  /**< Next entry of the same node (or -1). */
+};
+
+/** Node of the address trie.
+ */
+struct ActionTrieNode {
+  IPAddress key;      /**< Prefix of the node. */
+  int       bits;     /**< Length of the prefix. */
+  int       child[2]; /**< Children by the bit following the prefix (or -1). */
+  int       entries;  /**< First address of a rule having exactly this prefix (or -1). */
+};
+
+/** Path-compressed radix trie of the addresses of the rules.
+ *
+ * The trie is compiled from all the rules each time the rules change, in a
+ * single block. A walk from the root to the longest prefix containing an
+ * address gives all the rules whose address contains it. A trie of n
+ * addresses has at most 2n nodes.
+ */
+struct ActionTrie {
+  int root;                        /**< The root node (or -1). */
+  int nodeCount;                   /**< Number of nodes in use. */
+  int entryCount;                  /**< Number of addresses. */
+  struct ActionTrieEntry* entries; /**< The addresses (after the nodes). */
+  struct ActionTrieNode nodes[1];  /**< The nodes. */
+};
+
+/** Get a bit of an address.
+ */
+static inline int ActionTrie_bit(const IPAddress* ip, int bit) {
+  return (ip->bytes[bit >> 3] >> (7 - (bit & 7))) & 1;
+}
+
+/** Get the length of the common prefix of two addresses.
+ */
+static inline int ActionTrie_common(const IPAddress* a, const IPAddress* b, int max) {
+  int i = 0;
+
+  while (i + 8 <= max && a->bytes[i >> 3] == b->bytes[i >> 3]) {
+    i += 8;
+  }
+  while (i < max && ActionTrie_bit(a, i) == ActionTrie_bit(b, i)) {
+    ++i;
+  }
+  return i;
+}
+
+/** Allocate a node of the trie.
+ */
+static inline int ActionTrie_node(struct ActionTrie* trie, const IPAddress* key, int bits) {
+  struct ActionTrieNode* node = &trie->nodes[trie->nodeCount];
+
+  node->key      = *key;
+  node->bits     = bits;
+  node->child[0] = -1;
+  node->child[1] = -1;
+  node->entries  = -1;
+  return trie->nodeCount++;
+}
+
+/** Attach an address of a rule to a node.
+ */
+static inline void ActionTrie_attach(struct ActionTrie* trie, int node, int line, int field) {
+  struct ActionTrieEntry* entry = &trie->entries[trie->entryCount];
+
+  entry->line  = line;
+  entry->field = field;
+  entry->next  = trie->nodes[node].entries;
+  trie->nodes[node].entries = trie->entryCount++;
+}
+
+/** Insert an address of a rule in the trie.
+ */
+static void ActionTrie_insert(struct ActionTrie* trie, const struct HostAddress* address,
+                              int line, int field) {
+  int* slot = &trie->root;
+
+  for (;;) {
+    const struct ActionTrieNode* node;
+    int common;
+    int mid;
+
+    if (*slot < 0) {
+      *slot = ActionTrie_node(trie, &address->addr, address->prefix);
+      ActionTrie_attach(trie, *slot, line, field);
+      return;
+    }
+    node   = &trie->nodes[*slot];
+    common = ActionTrie_common(&node->key, &address->addr,
+                               node->bits < address->prefix ? node->bits : address->prefix);
+    if (common == node->bits && common == address->prefix) {
+      ActionTrie_attach(trie, *slot, line, field);
+      return;
+    }
+    if (common == node->bits) {
+      slot = &trie->nodes[*slot].child[ActionTrie_bit(&address->addr, common)];
+      continue;
+    }
+
+    /* The prefixes diverge (or the new one is shorter): split the node */
+    mid = ActionTrie_node(trie, &address->addr, common);
+    trie->nodes[mid].child[ActionTrie_bit(&node->key, common)] = *slot;
+    *slot = mid;
+    if (common == address->prefix) {
+      ActionTrie_attach(trie, mid, line, field);
+      return;
+    }
+    slot = &trie->nodes[mid].child[ActionTrie_bit(&address->addr, common)];
+  }
+}
+
+/** Compile the address trie of a set of rules.
+ *
+ * @param queue    The rules.
+ * @param capacity The number of lines.
+ * @return The trie, NULL if no rule uses an address or on error.
+ */
+static struct ActionTrie* ActionTrie_build(Action* const* queue, size_t capacity) {
+  struct ActionTrie* trie;
+  size_t count = 0;
+  size_t i;
+
+  for (i = 0 ; i < capacity ; ++i) {
+    if (queue[i] && queue[i]->from.type == AH_Address) {
+      ++count;
+    }
+    if (queue[i] && queue[i]->to.type == AH_Address) {
+      ++count;
+    }
+  }
+  if (count == 0) {
+    return NULL;
+  }
+  trie = (struct ActionTrie*)malloc(sizeof(struct ActionTrie)
+                                    + (2 * count - 1) * sizeof(struct ActionTrieNode)
+                                    + count * sizeof(struct ActionTrieEntry));
+  if (trie == NULL) {
+    return NULL;
+  }
+  trie->root       = -1;
+  trie->nodeCount  = 0;
+  trie->entryCount = 0;
+  trie->entries    = (struct ActionTrieEntry*)&trie->nodes[2 * count];
+  for (i = 0 ; i < capacity ; ++i) {
+    if (queue[i] && queue[i]->from.type == AH_Address) {
+      ActionTrie_insert(trie, &queue[i]->from, (int)i, AAF_From);
+    }
+    if (queue[i] && queue[i]->to.type == AH_Address) {
+      ActionTrie_insert(trie, &queue[i]->to, (int)i, AAF_To);
+    }
+  }
+  return trie;
+}
+
+/** Find the rules whose addresses contain an address.
+ *
+ * @param trie   The trie.
+ * @param ip     The address.
+ * @param fields Receive the lines, by field of the rule.
+ */
+static void ActionTrie_walk(const struct ActionTrie* trie, const IPAddress* ip,
+                            ActionLineSet fields[2]) {
+  int n = trie->root;
+
+  while (n >= 0) {
+    const struct ActionTrieNode* node = &trie->nodes[n];
+    int e;
+
+    if (!IPAddress_inPrefix(ip, &node->key, node->bits)) {
+      return;
+    }
+    for (e = node->entries ; e >= 0 ; e = trie->entries[e].next) {
+      ActionLineSet_add(&fields[trie->entries[e].field], trie->entries[e].line);
+    }
+    if (node->bits == IP_ADDRESS_BITS) {
+      return;
+    }
+    n = node->child[ActionTrie_bit(ip, node->bits)];
+  }
+}
+
+/** Compile the payloads searched by a set of rules.
+ *
+ * @param queue    The rules.
+ * @param capacity The number of lines.
+ * @return The scanner, NULL if no rule looks for a payload or on error.
+ */
+static PayloadScanner* ActionScanner_build(Action* const* queue, size_t capacity) {
+  const Payload** payloads;
+  PayloadScanner* scanner;
+  int size  = 64;
+  int count = 0;
+  size_t i;
+
+  if ((payloads = (const Payload**)malloc(size * sizeof(Payload*))) == NULL) {
+    return NULL;
+  }
+  for (i = 0 ; i < capacity ; ++i) {
+    int got;
+    if (!queue[i] || !Condition(queue[i]).payloads) {
+      continue;
+    }
+    /* Grow the array until all the payloads of the rule fit in */
+    while ((got = Condition(queue[i]).payloads(queue[i]->condition.data, payloads + count,
+                                               size - count)) == size - count) {
+      const int grown = size * 2;
+      const Payload** more = (const Payload**)realloc(payloads, grown * sizeof(Payload*));
+      if (more == NULL) {
+        free(payloads);
+        return NULL;
+      }
+      payloads = more;
+      size     = grown;
+    }
+    count += got;
+  }
+  scanner = PayloadScanner_init(payloads, count);
+  free(payloads);
+  return scanner;
+}
+
+/** An immutable version of the rules of a queue.
+ *
+ * Readers load the current snapshot in an epoch critical section (see
+ * @ref Epoch). A call that goes on using it once it leaves the critical
+ * section (to sleep or to perform the syscall) takes a reference on it
+ * first. Writers publish a modified copy of the snapshot and retire the
+ * previous one: it is released with its last reference, together with the
+ * actions the next snapshot does not reference anymore.
+ *
+ * Each snapshot holds a reference on the next one, so that the snapshots
+ * are released in the order of their publication: an action dropped by a
+ * snapshot may still be referenced by all the previous ones.
+ */
+struct ActionSnapshot {
+  unsigned int       generation;  /**< Incremented each time the rules change. */
+  struct ActionIndex index;       /**< Index of the rules. */
+  struct ActionTrie* trie;        /**< Addresses of the rules (NULL if none). */
+  PayloadScanner*    scanner;     /**< Payloads of the rules (NULL if none). */
+  volatile int       refs;        /**< References (publication, calls, previous snapshot). */
+  struct ActionSnapshot* next;    /**< Snapshot published after this one (NULL if none). */
+  Action*            released;    /**< Actions dropped by the next snapshot. */
+  Action*            queue[1];    /**< Table of Actions. */
+};
+
+/** An action queue.
+ */
+struct ActionQueue {
+  struct ActionSnapshot* volatile snapshot; /**< Current rules. */
+  size_t   capacity;      /**< Capacity of the table */
+
+  volatile int* slots;    /**< Index of the done flag of each line (or -1). */
+  volatile int  slotCount;/**< Number of done flags in use. */
+
+  volatile unsigned int summary; /**< Directions and protocols having rules (see ActionIndex_summary). */
+  volatile uint64_t     ports;   /**< Remote port buckets required by a rule. */
+  volatile bool         counting; /**< True if a rule reads the call counters of the sockets. */
+  volatile bool         feeding;  /**< True if the condition of a rule counts the calls itself
+                                       (see ActionCounter). */
+
+  pthread_mutex_t lock;   /**< Serialize the writers. */
+};
+
+/** Allocate a snapshot for the queue.
+ *
+ * @param queue The queue.
+ * @param from  The snapshot to copy (or NULL to build an empty snapshot).
+ * @return A new snapshot, or NULL on error.
+ */
+static struct ActionSnapshot* ActionSnapshot_init(ActionQueue* queue,
+                                                  const struct ActionSnapshot* from) {
+  struct ActionSnapshot* snapshot;
+  const size_t size = sizeof(struct ActionSnapshot) + (queue->capacity - 1) * sizeof(Action*);
+
+  snapshot = (struct ActionSnapshot*)malloc(size);
+  if (snapshot == NULL) {
+    return NULL;
+  }
+  if (from) {
+    memcpy(snapshot, from, size);
+  } else {
+    memset(snapshot, 0, size);
+  }
+  snapshot->refs     = 1;
+  snapshot->next     = NULL;
+  snapshot->released = NULL;
+  return snapshot;
+}
+
+ActionQueue* ActionQueue_init(size_t capacity) {
+  ActionQueue* queue;
+
+  queue = (ActionQueue*)malloc(sizeof(ActionQueue));
+  if (queue) {
+    if (capacity > ACTION_MAX_LINES) {
+      capacity = ACTION_MAX_LINES;
+    }
+    if (capacity == 0) {
+      capacity = 1;
+    }
+    queue->capacity = capacity;
+    queue->snapshot = ActionSnapshot_init(queue, NULL);
+    queue->slots = (volatile int*)malloc(capacity * sizeof(int));
+    if (!queue->snapshot || !queue->slots) {
+      free(queue->snapshot);
+      free((void*)queue->slots);
+      free(queue);
+      return NULL;
+    }
+    memset((void*)queue->slots, 0xff, capacity * sizeof(int));
+    queue->slotCount = 0;
+    queue->summary   = 0;
+    queue->ports     = 0;
+    queue->counting  = false;
+    queue->feeding   = false;
+    pthread_mutex_init(&queue->lock, NULL);
+  }
+  return queue;
+}
+
+/** Drop a reference on a snapshot.
+ *
+ * The snapshot is freed with its last reference, along with the actions
+ * dropped by the next snapshot, and the reference it holds on the next
+ * snapshot is dropped in turn.
+ */
+static void ActionSnapshot_unref(struct ActionSnapshot* snapshot) {
+  while (snapshot && __sync_sub_and_fetch(&snapshot->refs, 1) == 0) {
+    struct ActionSnapshot* next = snapshot->next;
+    while (snapshot->released) {
+      Action* action = snapshot->released;
+      snapshot->released = action->released;
+      Action_destroy(action);
+    }
+    free(snapshot->trie);
+    PayloadScanner_destroy(snapshot->scanner);
+    free(snapshot);
+    snapshot = next;
+  }
+}
+
+/** Drop the reference of the publication of a retired snapshot.
+ */
+static void ActionSnapshot_release(void* snapshot) {
+  ActionSnapshot_unref((struct ActionSnapshot*)snapshot);
+}
+
+/** Take a reference on the current snapshot of a queue.
+ *
+ * The snapshot stays valid until the matching ActionSnapshot_unref, even
+ * out of any epoch critical section.
+ */
+static struct ActionSnapshot* ActionQueue_pin(ActionQueue* queue) {
+  struct ActionSnapshot* snapshot;
+
+  Epoch_enter();
+  snapshot = queue->snapshot;
+  (void)__sync_fetch_and_add(&snapshot->refs, 1);
+  Epoch_leave();
+  return snapshot;
+}
+
+void ActionQueue_destroy(ActionQueue* queue) {
+  off_t i;
+  for (i = 0 ; i < (off_t)queue->capacity ; ++i) {
+    Action_destroy(queue->snapshot->queue[i]);
+  }
+  /* The previous snapshots may still be waiting for their grace period */
+  ActionSnapshot_unref(queue->snapshot);
+  free((void*)queue->slots);
+  pthread_mutex_destroy(&queue->lock);
+  free(queue);
+}
+
+/** Get the port a socket must use for an address to match it.
+ *
+ * @param address The address.
+ * @return The port, or -1 if any port may match.
+ */
+static inline int ActionIndex_port(const struct HostAddress* address) {
+  return address->type == AH_DNS ? -1 : address->port;
+}
+
+/** Add a rule to the index.
+ *
+ * The key of the rule is computed from the constraints every matching
+ * socket must fulfill (see Action_match): a port that the socket must use
+ * on one of its ends, and whether the remote end must be a DNS server.
+ *
+ * @param index  The index.
+ * @param action The rule.
+ */
+static void ActionIndex_add(struct ActionIndex* index, const Action* action) {
+  const int line = action->pos;
+  int  port;
+  bool dns;
+  int  i;
+
+  switch (action->direction) {
+   case Connecting: case Closing: case Accepting:
+    port = ActionIndex_port(&action->to);
+    dns  = action->to.type == AH_DNS;
+    break;
+   case Data:
+    if (action->to.type != AH_None) {
+      port = ActionIndex_port(&action->to);
+      if (port == -1) {
+        port = ActionIndex_port(&action->from);
+      }
+      dns = action->to.type == AH_DNS || action->from.type == AH_DNS;
+      break;
+    }
+    /* fall through */
+   default:
+    port = ActionIndex_port(&action->from);
+    dns  = action->from.type == AH_DNS;
+    break;
+  }
+  for (i = 0 ; i < ACTION_DIRECTIONS ; ++i) {
+    if (action->direction & (1 << i)) {
+      ActionLineSet_add(&index->directions[i], line);
+    }
+  }
+  for (i = 0 ; i < INDEX_PROTOS ; ++i) {
+    if (action->proto & (1 << i)) {
+      ActionLineSet_add(&index->protos[i], line);
+    }
+  }
+  if (port == -1) {
+    ActionLineSet_add(&index->anyPort, line);
+  } else {
+    ActionLineSet_add(&index->ports[port % INDEX_PORT_BUCKETS], line);
+    if (!(action->direction & ~(Connecting | Closing))) {
+      ActionLineSet_add(&index->remotePort, line);
+    }
+  }
+  if (!dns) {
+    ActionLineSet_add(&index->notDns, line);
+  }
+}
+
+/** Remove a line from the index.
+ *
+ * @param index The index.
+ * @param line  The line.
+ */
+static void ActionIndex_remove(struct ActionIndex* index, int line) {
+  int i;
+
+  for (i = 0 ; i < ACTION_DIRECTIONS ; ++i) {
+    ActionLineSet_remove(&index->directions[i], line);
+  }
+  for (i = 0 ; i < INDEX_PROTOS ; ++i) {
+    ActionLineSet_remove(&index->protos[i], line);
+  }
+  ActionLineSet_remove(&index->anyPort, line);
+  for (i = 0 ; i < INDEX_PORT_BUCKETS ; ++i) {
+    ActionLineSet_remove(&index->ports[i], line);
+  }
+  ActionLineSet_remove(&index->notDns, line);
+  ActionLineSet_remove(&index->remotePort, line);
+}
+
+/** Get a word of the set of the candidate rules for a socket.
+ *
+ * @param index The index.
+ * @param si    The socket.
+ * @param direction Data direction.
+ * @param word  The offset of the word to compute.
+ * @return The bits of the lines that may match the socket.
+ */
+static inline uint64_t ActionIndex_candidates(const struct ActionIndex* index,
+                                              const SocketInfo* si,
+                                              SocketInfoDirection direction, int word) {
+  uint64_t dirs  = 0;
+  uint64_t protos = 0;
+  uint64_t ports;
+  int i;
+
+  for (i = 0 ; i < ACTION_DIRECTIONS ; ++i) {
+    if (direction & (1 << i)) {
+      dirs |= index->directions[i].bits[word];
+    }
+  }
+  for (i = 0 ; i < INDEX_PROTOS ; ++i) {
+    if (si->proto & (1 << i)) {
+      protos |= index->protos[i].bits[word];
+    }
+  }
+  ports = index->anyPort.bits[word]
+        | index->ports[(unsigned int)si->local.port % INDEX_PORT_BUCKETS].bits[word]
+        | index->ports[(unsigned int)si->remote.port % INDEX_PORT_BUCKETS].bits[word];
+  if (si->remote.type != AH_DNS) {
+    ports &= index->notDns.bits[word];
+  }
+  return dirs & protos & ports;
+}
+
+/** Get the summary bits of the given directions and protocols.
+ *
+ * The summary has one bit per direction and protocol having at least one
+ * rule. The same bits, shifted by 16, are set when one of these rules may
+ * match whatever the remote port of the socket is.
+ *
+ * @param direction The directions.
+ * @param proto     The protocols.
+ * @return The summary bits.
+ */
+static inline unsigned int ActionIndex_summaryMask(SocketInfoDirection direction, Proto proto) {
+  unsigned int mask = 0;
+  int i;
+
+  for (i = 0 ; i < ACTION_DIRECTIONS ; ++i) {
+    if (direction & (1 << i)) {
+      mask |= (unsigned int)(proto & AP_All) << (INDEX_PROTOS * i);
+    }
+  }
+  return mask;
+}
+
+/** Summarize the content of the index.
+ *
+ * @param index   The index.
+ * @param summary Receive the directions and protocols having rules.
+ * @param ports   Receive the remote port buckets required by at least a rule.
+ */
+static void ActionIndex_summary(const struct ActionIndex* index,
+                                unsigned int* summary, uint64_t* ports) {
+  int i, p, w;
+
+  *summary = 0;
+  *ports   = 0;
+  for (w = 0 ; w < ACTION_MAX_LINES / 64 ; ++w) {
+    for (i = 0 ; i < ACTION_DIRECTIONS ; ++i) {
+      for (p = 0 ; p < INDEX_PROTOS ; ++p) {
+        const uint64_t bits = index->directions[i].bits[w] & index->protos[p].bits[w];
+        const unsigned int bit = 1u << (INDEX_PROTOS * i + p);
+        if (bits) {
+          *summary |= bit;
+        }
+        if (bits & (index->anyPort.bits[w] | ~index->remotePort.bits[w])) {
+          *summary |= bit << 16;
+        }
+      }
+    }
+    for (i = 0 ; i < INDEX_PORT_BUCKETS ; ++i) {
+      if (index->ports[i].bits[w] & index->remotePort.bits[w]) {
+        *ports |= UINT64_C(1) << i;
+      }
+    }
+  }
+}
+
+/** Get the protocols of the rules reading the call counters of the sockets.
+ *
+ * @param snapshot The rules.
+ * @param capacity The number of lines.
+ * @param feeding  Set to true if the condition of a rule counts the calls itself.
+ * @return The protocols (0 if no rule reads the counters).
+ */
+static Proto ActionSnapshot_counted(const struct ActionSnapshot* snapshot, size_t capacity,
+                                    bool* feeding) {
+  unsigned int protos = 0;
+  size_t i;
+
+  *feeding = false;
+  for (i = 0 ; i < capacity ; ++i) {
+    if (snapshot->queue[i] && snapshot->queue[i]->condition.countsCalls) {
+      protos |= snapshot->queue[i]->proto;
+      *feeding = *feeding || Condition(snapshot->queue[i]).count != NULL;
+    }
+  }
+  return (Proto)protos;
+}
+
+/** Get the index of the done flag of a line.
+ *
+ * Indexes are given on demand to the lines that need a do-once-per-socket
+ * flag. A line keeps its index when its rule is replaced, so the done flags
+ * of a line survive a rule update.
+ *
+ * @param queue The queue.
+ * @param line  The line.
+ * @param alloc If true, give an index to the line if it has none (the
+ *              writer lock must be held).
+ * @return The index, or -1 if the line has none.
+ */
+static inline int ActionQueue_slot(ActionQueue* queue, int line, bool alloc) {
+  int slot;
+
+  if (line < 0 || line >= (int)queue->capacity) {
+    return -1;
+  }
+  slot = queue->slots[line];
+  if (slot >= 0 || !alloc) {
+    return slot;
+  }
+  if (queue->slotCount >= ACTION_MAX_LINES) {
+    return -1;
+  }
+  /* The writer lock serializes the allocations, the readers only see the
+   * published index */
+  slot = queue->slotCount++;
+  queue->slots[line] = slot;
+  return slot;
+}
+
+/** Get a snapshot that can be modified.
+ *
+ * Must be called with the writer lock held.
+ *
+ * @param queue The queue.
+ * @param mt    If false, the current snapshot is modified in place.
+ * @return The snapshot, or NULL on error.
+ */
+static inline struct ActionSnapshot* ActionQueue_edit(ActionQueue* queue, bool mt) {
+  return mt ? ActionSnapshot_init(queue, queue->snapshot) : queue->snapshot;
+}
+
+/** Release an action that a modified snapshot does not reference anymore.
+ *
+ * Must be called with the writer lock held. In multi-thread mode the action
+ * is released along with the current snapshot, the last one to reference it.
+ */
+static inline void ActionQueue_drop(ActionQueue* queue, Action* action, bool mt) {
+  if (action == NULL) {
+    return;
+  } else if (mt) {
+    action->released = queue->snapshot->released;
+    queue->snapshot->released = action;
+  } else {
+    Action_destroy(action);
+  }
+}
+
+/** Remove the do-once actions that have been triggered from a snapshot.
+ *
+ * Must be called with the writer lock held, on the snapshot returned by
+ * ActionQueue_edit. The actions are removed by identity: a rule that
+ * replaced a triggered one on the same line is kept.
+ *
+ * @param queue    The queue.
+ * @param snapshot The snapshot being modified.
+ * @param mt       Must be the value given to ActionQueue_edit.
+ */
+static inline void ActionQueue_compact(ActionQueue* queue, struct ActionSnapshot* snapshot,
+                                       bool mt) {
+  size_t i;
+
+  for (i = 0 ; i < queue->capacity ; ++i) {
+    Action* action = snapshot->queue[i];
+    if (action == NULL || action->mode != AM_Once || !action->fired) {
+      continue;
+    }
+    snapshot->queue[i] = NULL;
+    ActionIndex_remove(&snapshot->index, i);
+    ActionQueue_drop(queue, action, mt);
+  }
+}
+
+/** Publish a modified snapshot.
+ *
+ * Must be called with the writer lock held.
+ *
+ * @param queue    The queue.
+ * @param snapshot The snapshot returned by ActionQueue_edit.
+ * @param old      The action removed from the queue by the modification.
+ * @param mt       Must be the value given to ActionQueue_edit.
+ */
+static inline void ActionQueue_publish(ActionQueue* queue, struct ActionSnapshot* snapshot,
+                                       Action* old, bool mt) {
+  struct ActionTrie* trie = snapshot->trie;
+  PayloadScanner* scanner = snapshot->scanner;
+  unsigned int summary;
+  unsigned int counted;
+  bool feeding;
+  uint64_t ports;
+
+  ActionQueue_compact(queue, snapshot, mt);
+  ++snapshot->generation;
+  snapshot->trie    = ActionTrie_build(snapshot->queue, queue->capacity);
+  snapshot->scanner = ActionScanner_build(snapshot->queue, queue->capacity);
+  ActionIndex_summary(&snapshot->index, &summary, &ports);
+  /* The counters are only exact if all the data calls go through the queue */
+  counted = ActionIndex_summaryMask(Data, ActionSnapshot_counted(snapshot, queue->capacity,
+                                                                  &feeding));
+  queue->summary  = summary | counted | (counted << 16);
+  queue->ports    = ports;
+  queue->counting = counted != 0;
+  queue->feeding  = feeding;
+  ActionQueue_drop(queue, old, mt);
+  if (mt) {
+    /* The previous trie and scanner are released with the previous snapshot */
+    struct ActionSnapshot* previous = queue->snapshot;
+    previous->next = snapshot;
+    snapshot->refs = 2;
+    __sync_synchronize();
+    queue->snapshot = snapshot;
+    Epoch_retire(previous, ActionSnapshot_release);
+  } else {
+    free(trie);
+    PayloadScanner_destroy(scanner);
+  }
+}
+
+bool ActionQueue_put(ActionQueue* queue, const char* instruction,
+                     ParserStatus* status, bool replace, bool mt) {
+  struct ActionSnapshot* snapshot;
+  Action* action;
+  Action* old;
+
+  action = Action_init(instruction, status);
+  if (!action) {
+    return false;
+  }
+  if (action->pos < 0 || action->pos >= (int)queue->capacity) {
+    Action_destroy(action);
+    return FORCE_PARSE_ERROR(instruction, "Line number out of range");
+  }
+  action->queue = queue;
+
+  ACQUIRE_WRITE
+  if ((queue->snapshot->queue[action->pos] != NULL && !replace)
+      || (snapshot = ActionQueue_edit(queue, mt)) == NULL) {
+    RELEASE
+    Action_destroy(action);
+    return false;
+  }
+  if (action->mode == AM_OncePerSocket) {
+    (void)ActionQueue_slot(queue, action->pos, true);
+  }
+  if (action->task.type == ATT_MarkDone && action->task.data[0].i == 2) {
+    /* mark-done socket sets the flag of its target line */
+    (void)ActionQueue_slot(queue, action->task.data[1].i, true);
+  }
+  old = snapshot->queue[action->pos];
+  snapshot->queue[action->pos] = action;
+  ActionIndex_remove(&snapshot->index, action->pos);
+  ActionIndex_add(&snapshot->index, action);
+  ActionQueue_publish(queue, snapshot, old, mt);
+  RELEASE
+  return true;
+}
+
+bool ActionQueue_mayMatch(ActionQueue* queue, SocketInfoDirection direction,
+                          Proto proto, int port) {
+  const unsigned int summary = queue->summary;
+  const unsigned int mask    = ActionIndex_summaryMask(direction, proto);
+
+  if (!(summary & mask)) {
+    return false;
+  }
+  if (port < 0 || (summary & (mask << 16))) {
+    return true;
+  }
+  return (queue->ports >> (port % INDEX_PORT_BUCKETS)) & 1;
+}
+
+/** Get the action of a line of a snapshot.
+ */
+static inline Action* ActionSnapshot_get(const struct ActionSnapshot* snapshot,
+                                         size_t capacity, off_t pos) {
+  if (pos < 0 || pos >= (off_t)capacity) {
+    return NULL;
+  }
+  return snapshot->queue[pos];
+}
+
+/** Get the first action of a snapshot from the given line.
+ */
+static inline Action* ActionSnapshot_getFrom(const struct ActionSnapshot* snapshot,
+                                             size_t capacity, off_t pos) {
+  off_t i;
+
+  for (i = pos < 0 ? 0 : pos ; i < (off_t)capacity ; ++i) {
+    if (snapshot->queue[i]) {
+      return snapshot->queue[i];
+    }
+  }
+  return NULL;
+}
+
+Action* ActionQueue_get(ActionQueue* queue, off_t pos, bool mt) {
+  Action* action;
+
+  Epoch_enter();
+  action = ActionSnapshot_get(queue->snapshot, queue->capacity, pos);
+  Epoch_leave();
+  return action;
+}
+
+Action* ActionQueue_getFrom(ActionQueue* queue, off_t pos, bool mt) {
+  Action* action;
+
+  Epoch_enter();
+  action = ActionSnapshot_getFrom(queue->snapshot, queue->capacity, pos);
+  Epoch_leave();
+  return action;
+}
+
+Action* ActionQueue_getMatch(ActionQueue* queue, SocketInfo* si, SocketInfoDirection direction,
+                             bool matched, off_t pos, bool mt) {
+  const struct ActionSnapshot* snapshot;
+  const int words = (queue->capacity + 63) / 64;
+  Action* action = NULL;
+  int word;
+
+  if (pos < 0) {
+    pos = 0;
+  }
+  Epoch_enter();
+  snapshot = queue->snapshot;
+  for (word = pos / 64 ; word < words && action == NULL ; ++word) {
+    uint64_t candidates = ActionIndex_candidates(&snapshot->index, si, direction, word);
+    if (word == pos / 64) {
+      candidates &= ~UINT64_C(0) << (pos & 63);
+    }
+    while (candidates) {
+      const int i = word * 64 + __builtin_ctzll(candidates);
+      candidates &= candidates - 1;
+      if (snapshot->queue[i] && Action_match(snapshot->queue[i], si, direction, matched)) {
+        action = snapshot->queue[i];
+        break;
+      }
+    }
+  }
+  Epoch_leave();
+  return action;
+}
+
+/** Lines whose rule statically matches a socket in a given direction.
+ */
+struct ActionCandidates {
+  unsigned int generation;  /**< Generation of the queue the list was built for. */
+  int          localPort;   /**< Local port of the socket when the list was built. */
+  int          count;       /**< Number of lines. */
+  bool         usesData;    /**< True if a rule reached from the lines uses the data. */
+  int          lines[1];    /**< The lines, in increasing order. */
+};
+
+/** Check if the data of a call may be used by the rules reached from a list.
+ *
+ * The rules reached through 'next' or 'do' are not in the list, so all the
+ * rules are checked when one of these jumps is used.
+ *
+ * @param snapshot The rules.
+ * @param lines    The lines of the list.
+ * @param count    The number of lines.
+ * @param capacity The capacity of the queue.
+ * @return true if an action may use the data.
+ */
+static bool ActionCandidates_usesData(const struct ActionSnapshot* snapshot,
+                                      const int* lines, int count, size_t capacity) {
+  bool jumps = false;
+  size_t i;
+
+  for (i = 0 ; i < (size_t)count ; ++i) {
+    const Action* action = snapshot->queue[lines[i]];
+    if (Action(action).usesData || action->condition.usesData) {
+      return true;
+    }
+    jumps = jumps || action->next.type == AGT_Next || action->next.type == AGT_Do;
+  }
+  for (i = 0 ; jumps && i < capacity ; ++i) {
+    if (snapshot->queue[i] && (Action(snapshot->queue[i]).usesData
+                               || snapshot->queue[i]->condition.usesData)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/** Build the list of the candidate rules for a socket.
+ *
+ * A condition looking at the data of a read performs the read: the rules
+ * whose action must run before the syscall are left out of the list from
+ * there (including the rule of the condition itself), they could only fail.
+ *
+ * The list is built in the arena of the thread, the addresses of the socket
+ * are only looked up in the trie once a rule of the index may match it.
+ *
+ * @param queue    The queue.
+ * @param snapshot The rules.
+ * @param si       The socket.
+ * @param direction Data direction.
+ * @return A new list in the arena, or NULL on error.
+ */
+static struct ActionCandidates* ActionCandidates_build(const ActionQueue* queue,
+                                                       const struct ActionSnapshot* snapshot,
+                                                       const SocketInfo* si,
+                                                       SocketInfoDirection direction) {
+  struct ActionCandidates* list;
+  struct ActionAddressLines* walk = NULL;
+  const int words = (queue->capacity + 63) / 64;
+  bool read = false;
+  int count = 0;
+  int word;
+
+  list = (struct ActionCandidates*)Arena_alloc(sizeof(struct ActionCandidates)
+                                               + queue->capacity * sizeof(int));
+  if (list == NULL) {
+    return NULL;
+  }
+  for (word = 0 ; word < words ; ++word) {
+    uint64_t candidates = ActionIndex_candidates(&snapshot->index, si, direction, word);
+    if (candidates && snapshot->trie && walk == NULL) {
+      /* Walk the trie once per end instead of comparing each address */
+      if ((walk = (struct ActionAddressLines*)Arena_alloc(sizeof(*walk))) == NULL) {
+        return NULL;
+      }
+      memset(walk, 0, sizeof(*walk));
+      ActionTrie_walk(snapshot->trie, &si->local.addr, walk->local);
+      ActionTrie_walk(snapshot->trie, &si->remote.addr, walk->remote);
+    }
+    while (candidates) {
+      const int i = word * 64 + __builtin_ctzll(candidates);
+      const Action* action = snapshot->queue[i];
+      candidates &= candidates - 1;
+      if (action == NULL || !Action_matchSocket(action, si, direction, walk)) {
+        continue;
+      }
+      if (direction == Reading && Action(action).beforeCall
+          && (read || action->condition.usesData)) {
+        continue;
+      }
+      read = read || (direction == Reading && action->condition.usesData);
+      list->lines[count++] = i;
+    }
+  }
+  list->generation = snapshot->generation;
+  list->localPort  = si->local.port;
+  list->count      = count;
+  list->usesData   = ActionCandidates_usesData(snapshot, list->lines, count, queue->capacity);
+  return list;
+}
+
+/** Check if a candidate list is still valid.
+ */
+static inline bool ActionCandidates_valid(const struct ActionCandidates* list,
+                                          const struct ActionSnapshot* snapshot,
+                                          const SocketInfo* si) {
+  return list != NULL && list->generation == snapshot->generation
+      && list->localPort == si->local.port;
+}
+
+/** Get the candidate list of a socket.
+ *
+ * The list is rebuilt if the rules changed since it has been computed. It is
+ * kept in the data associated with the socket, which is only allocated when
+ * a rule may match: a socket no rule may match gets a list in the arena.
+ *
+ * Must be called inside an epoch critical section, the list is only valid
+ * until the end of the critical section (or the release of the arena).
+ *
+ * @param queue The queue.
+ * @param snapshot The rules.
+ * @param si    The socket.
+ * @param socketState Receive the data associated with the socket (NULL if none).
+ * @param direction Data direction.
+ * @return The list, or NULL on error.
+ */
+static const struct ActionCandidates* ActionSocketData_candidates(ActionQueue* queue,
+                                                                  const struct ActionSnapshot* snapshot,
+                                                                  SocketInfo* si,
+                                                                  ActionSocketData** socketState,
+                                                                  SocketInfoDirection direction) {
+  struct ActionCandidates* volatile* slot;
+  struct ActionCandidates* built;
+  struct ActionCandidates* list;
+  struct ActionCandidates* old = NULL;
+  size_t size;
+
+  *socketState = (ActionSocketData*)si->data;
+  if (*socketState) {
+    old = (*socketState)->candidates[__builtin_ctz(direction)];
+    if (ActionCandidates_valid(old, snapshot, si)) {
+      return old;
+    }
+  }
+  if ((built = ActionCandidates_build(queue, snapshot, si, direction)) == NULL) {
+    return NULL;
+  }
+  if (built->count == 0 && *socketState == NULL) {
+    return built;
+  }
+  if (*socketState == NULL && (*socketState = ActionSocketData_get(si, queue)) == NULL) {
+    /* The rules can't keep their state: the call is performed alone */
+    return NULL;
+  }
+  slot = &(*socketState)->candidates[__builtin_ctz(direction)];
+  size = sizeof(struct ActionCandidates) + built->count * sizeof(int);
+  if ((list = (struct ActionCandidates*)malloc(size)) == NULL) {
+    /* Not cached, rebuilt by the next call */
+    return built;
+  }
+  (void)memcpy(list, built, size);
+  if (__sync_bool_compare_and_swap(slot, old, list)) {
+    Epoch_retire(old, free);
+  } else {
+    Epoch_retire(list, free);
   }
+  return list;
+}
 
-/** An action queue.
+/** Copy a candidate list in the arena of the thread.
+ *
+ * @return The copy, or NULL on error.
  */
-struct ActionQueue {
-  Action** queue;         /**< Table of Actions */
-  size_t   capacity;      /**< Capacity of the table */
+static struct ActionCandidates* ActionCandidates_copy(const struct ActionCandidates* list) {
+  const size_t size = sizeof(struct ActionCandidates) + list->count * sizeof(int);
+  struct ActionCandidates* copy;
 
-  pthread_rwlock_t lock;  /**< A lock for mt accesses */
-};
+  copy = (struct ActionCandidates*)Arena_alloc(size);
+  if (copy != NULL) {
+    (void)memcpy(copy, list, size);
+  }
+  return copy;
+}
 
-ActionQueue* ActionQueue_init(size_t capacity) {
-  ActionQueue* queue;
+/** Get the first rule of a candidate list matching a socket from the given line.
+ *
+ * @param snapshot The rules the list has been built for.
+ * @param list  The candidate list of the socket.
+ * @param si    The socket.
+ * @param direction Data direction.
+ * @param matched True if the socket already matched a rule.
+ * @param pos   Position from which the search must start.
+ * @param state Call data (NULL if not known yet).
+ * @return The first action found, or NULL.
+ */
+static Action* ActionQueue_nextMatch(const struct ActionSnapshot* snapshot,
+                                     const struct ActionCandidates* list, SocketInfo* si,
+                                     SocketInfoDirection direction, bool matched, off_t pos,
+                                     ActionCallData* state) {
+  int i;
 
-  queue = (ActionQueue*)malloc(sizeof(ActionQueue));
-  if (queue) {
-    queue->queue = (Action**)calloc(capacity, sizeof(Action*));
-    if (!queue->queue) {
-      free(queue);
-      return NULL;
+  for (i = 0 ; i < list->count ; ++i) {
+    Action* candidate = snapshot->queue[list->lines[i]];
+    if (list->lines[i] >= pos && candidate != NULL
+        && Action_matchCondition(candidate, si, direction, matched, state)) {
+      return candidate;
     }
-    queue->capacity = capacity;
-    pthread_rwlock_init(&queue->lock, NULL);
   }
-  return queue;
+  return NULL;
 }
 
-void ActionQueue_destroy(ActionQueue* queue) {
-  off_t i;
-  for (i = 0 ; i < (off_t)queue->capacity ; ++i) {
-    Action_destroy(queue->queue[i]);
+/** Check if the action must be skipped.
+ *
+ * @param action      The action.
+ * @param socketState Data associated with the socket.
+ * @param state       Call state.
+ * @return true if the action must not be performed.
+ */
+static inline bool Action_skip(Action* action, ActionSocketData* socketState,
+                               ActionCallData* state) {
+  switch (action->mode) {
+   case AM_Once:
+    return action->fired || !__sync_bool_compare_and_swap(&action->fired, 0, 1);
+   case AM_OncePerCall:
+    return ActionLineSet_contains(&state->calledLines, action->pos);
+   case AM_OncePerSocket:
+    return ActionSocketData_isDone(socketState, state->queue, action->pos);
+   default:
+    return false;
   }
-  free(queue->queue);
-  pthread_rwlock_destroy(&queue->lock);
-  free(queue);
 }
 
-bool ActionQueue_put(ActionQueue* queue, const char* instruction,
-                     ParserStatus* status, bool replace, bool mt) {
-  Action* action;
-  action = Action_init(instruction, status);
-  if (!action) {
-    return false;
+/** Copy the beginning of the materialized buffer back to the user vectors.
+ */
+static void ActionCallData_scatter(ActionCallData* data, size_t len) {
+  const char* pos = data->buf;
+  int i;
+
+  for (i = 0 ; i < data->iovcnt && len > 0 ; ++i) {
+    size_t chunk = len > data->iov[i].iov_len ? data->iov[i].iov_len : len;
+    (void)memcpy(data->iov[i].iov_base, pos, chunk);
+    pos += chunk;
+    len -= chunk;
   }
+}
 
-  ACQUIRE_WRITE
-  if (queue->queue[action->pos] == NULL || replace) {
-    if (queue->queue[action->pos]) {
-      EMPTY_ACTION(queue->queue[action->pos]);
+/** Move the position of the other end of a spliced call forward.
+ */
+static void ActionSplice_skip(ActionSplice* splice, size_t len) {
+  char buf[4096];
+  ssize_t ret;
+
+  if (splice->hasOffset) {
+    splice->offset += len;
+    return;
+  }
+  if (lseek(splice->fd, (off_t)len, SEEK_CUR) != -1) {
+    return;
+  }
+  /* Not seekable: consume the data */
+  while (len > 0) {
+    ret = Binding_read(splice->fd, buf, len > sizeof(buf) ? sizeof(buf) : len);
+    if (ret <= 0) {
+      return;
     }
-    Action_destroy(queue->queue[action->pos]);
-    queue->queue[action->pos] = action;
-    action->queue             = queue;
-    RELEASE
-    return true;
+    len -= ret;
   }
-  RELEASE
-  Action_destroy(action);
-  return false;
 }
 
-Action* ActionQueue_get(ActionQueue* queue, off_t pos, bool mt) {
-  if (pos >= (off_t)queue->capacity) {
-    return NULL;
-  } else {
-    Action* action;
-    ACQUIRE_READ
-    action = queue->queue[pos];
-    LOCK_ACTION(action);
-    RELEASE
-    return action;
+/** Read the data to be sent from the other end of a spliced call.
+ *
+ * The data is left in place when the file descriptor is seekable or a pipe,
+ * the position is moved once the data has actually been sent.
+ *
+ * @return The number of bytes read, or -1 on error.
+ */
+static ssize_t ActionCallData_peek(ActionCallData* data, void* buf, size_t len) {
+  ActionSplice* splice = data->splice;
+  off_t pos;
+  ssize_t ret;
+
+  if (splice->hasOffset) {
+    return pread(splice->fd, buf, len, (off_t)splice->offset);
+  }
+  if ((pos = lseek(splice->fd, 0, SEEK_CUR)) != -1) {
+    return pread(splice->fd, buf, len, pos);
+  }
+  if ((ret = Binding_peek(splice->fd, buf, len)) != -1 || errno != EINVAL) {
+    return ret;
+  }
+  /* Neither seekable nor a pipe: the data read is gone */
+  ret = Binding_read(splice->fd, buf, len);
+  if (ret > 0) {
+    data->spliced += ret;
   }
+  return ret;
 }
 
-Action* ActionQueue_getFrom(ActionQueue* queue, off_t pos, bool mt) {
-  Action* action = NULL;
-  off_t   i;
-
-  ACQUIRE_READ
-  for (i = pos ; i < (off_t)queue->capacity ; ++i) {
-    if (queue->queue[i]) {
-      action = queue->queue[i];
-      LOCK_ACTION(action)
+/** Write received data to the other end of a spliced call.
+ *
+ * @return The number of bytes written, or -1 if nothing has been written.
+ */
+static ssize_t ActionCallData_flush(ActionCallData* data, const char* buf, size_t len) {
+  ActionSplice* splice = data->splice;
+  size_t done = 0;
+  ssize_t ret;
+
+  while (done < len) {
+    if (splice->hasOffset) {
+      ret = pwrite(splice->fd, buf + done, len - done, (off_t)splice->offset);
+    } else {
+      ret = Binding_write(splice->fd, buf + done, len - done);
+    }
+    if (ret <= 0) {
       break;
     }
+    if (splice->hasOffset) {
+      splice->offset += ret;
+    }
+    done += ret;
   }
-  RELEASE
-  return action;
+  return done == 0 ? -1 : (ssize_t)done;
 }
 
-Action* ActionQueue_getMatch(ActionQueue* queue, SocketInfo* si, SocketInfoDirection direction,
-                             bool matched, off_t pos, bool mt) {
-  Action* action = NULL;
-  off_t   i;
+/** Make the other end of a spliced call agree with the result of the call.
+ *
+ * The data that has not been moved by the kernel (because it has been
+ * bounced through a buffer, or because the call has been dropped) is moved
+ * there.
+ */
+static void ActionCallData_settle(ActionCallData* data) {
+  const size_t len = data->result > (ssize_t)data->spliced ? data->result - data->spliced : 0;
+  const char* buf  = data->buf;
+  ssize_t ret;
 
-  ACQUIRE_READ
-  for (i = pos ; i < (off_t)queue->capacity ; ++i) {
-    if (queue->queue[i] && Action_match(queue->queue[i], si, direction, matched)) {
-      action = queue->queue[i];
-      LOCK_ACTION(action)
-      break;
+  if (data->direction == Writing) {
+    ActionSplice_skip(data->splice, len);
+    return;
+  }
+  if (buf == NULL) {
+    /* Dropped read: nothing has been received */
+    if ((buf = Arena_alloc(len)) == NULL) {
+      data->result = -1;
+      data->err    = ENOMEM;
+      return;
     }
+    memset((char*)buf, 0, len);
+  }
+  ret = ActionCallData_flush(data, buf, len);
+  if (ret == -1 && data->spliced == 0) {
+    data->result = -1;
+    data->err    = errno;
+  } else if (ret < (ssize_t)len) {
+    data->result = data->spliced + (ret > 0 ? ret : 0);
   }
-  RELEASE
-  return action;
 }
 
-ssize_t ActionQueue_process(ActionQueue* queue, SocketInfo* si,
-                            SocketInfoDirection direction, Action_syscall callback,
-                            void* buf, size_t len, int flags, void* data) {
-  Action* action;
-  ActionCallData state;
-  ActionSocketData* socketState;
+/** Let the conditions of the rules that may match a socket count a call.
+ *
+ * The rules only reached through 'next' or 'do' jumps are not in the
+ * candidate list of the socket and don't see the call. The caller holds a
+ * reference on the snapshot and a private copy of the list.
+ *
+ * @param si        The socket.
+ * @param direction Direction of the call.
+ * @param bytes     Bytes transferred by the call.
+ * @param snapshot  The rules the list was built from.
+ * @param list      Candidate list of the socket.
+ */
+static void ActionQueue_feed(SocketInfo* si, SocketInfoDirection direction, uint64_t bytes,
+                             const struct ActionSnapshot* snapshot,
+                             const struct ActionCandidates* list) {
+  int i;
 
-  action = ActionQueue_getFirstMatch(queue, si, direction, true);
-  if (!action) {
-    return callback(si->fd, buf, len, flags, data);
+  for (i = 0 ; i < list->count ; ++i) {
+    Action* action = snapshot->queue[list->lines[i]];
+    if (action != NULL && Condition(action).count) {
+      Condition(action).count(action->condition.data, si, direction, bytes);
+    }
   }
+}
 
-  socketState = ActionSocketData_get(si, queue);
-  if (direction == Reading && socketState->hanging && socketState->msec > getMSecTime()) {
-    errno = EAGAIN;
-    return -1;
-  } else if (direction == Reading && socketState->hanging) {
-    if (queue->queue[socketState->pos]) {
-      action = queue->queue[socketState->pos];
-    } else {
-      action = ActionQueue_getMatch(queue, si, direction, socketState->pos, true, true);
+/** Account a call in the counters of the socket.
+ *
+ * @param queue     The queue.
+ * @param si        The socket.
+ * @param direction Direction of the call.
+ * @param result    Result of the call.
+ * @param snapshot  The rules the list was built from.
+ * @param list      Copy of the candidate list of the socket, NULL when no rule
+ *                  may match it.
+ */
+static inline void ActionQueue_count(ActionQueue* queue, SocketInfo* si,
+                                     SocketInfoDirection direction, ssize_t result,
+                                     const struct ActionSnapshot* snapshot,
+                                     const struct ActionCandidates* list) {
+  if (queue->counting && result >= 0 && (direction == Reading || direction == Writing)) {
+    const int slot = COUNTER_SLOT(direction);
+    const uint64_t now = Clock_coarse();
+    (void)__sync_fetch_and_add(&si->counters.calls[slot], 1);
+    (void)__sync_fetch_and_add(&si->counters.bytes[slot], (uint64_t)result);
+    RateWindow_add(&si->counters.rate, now, (uint64_t)result);
+    if (si->counters.peer) {
+      RateWindow_add(si->counters.peer, now, (uint64_t)result);
+    }
+    if (queue->feeding && list != NULL) {
+      ActionQueue_feed(si, direction, (uint64_t)result, snapshot, list);
+    }
+  }
+}
+
+/** Perform a call without looking at the rules.
+ */
+static inline ssize_t ActionQueue_pass(ActionQueue* queue, SocketInfo* si,
+                                       SocketInfoDirection direction, ActionCallData* call,
+                                       const struct ActionSnapshot* snapshot,
+                                       const struct ActionCandidates* list) {
+  ssize_t result;
+
+  if (call->iov) {
+    result = call->vcallback(si->fd, call->iov, call->iovcnt, call->flags, call->data);
+  } else {
+    result = call->callback(si->fd, call->origBuf, call->origLen, call->flags, call->data);
+  }
+  ActionQueue_count(queue, si, direction, result, snapshot, list);
+  return result;
+}
+
+/** Process a call once its state is initialized.
+ */
+static ssize_t ActionQueue_run(ActionQueue* queue, SocketInfo* si,
+                               SocketInfoDirection direction, ActionCallData* call) {
+  Action* action;
+  ActionCallData state;
+  ActionSocketData* socketState;
+  struct ActionSnapshot* snapshot;
+  const struct ActionCandidates* list;
+  ArenaMark mark;
+  bool pending;
+
+  mark = Arena_mark();
+  Epoch_enter();
+  snapshot = queue->snapshot;
+  list     = ActionSocketData_candidates(queue, snapshot, si, &socketState, direction);
+  action   = list ? ActionQueue_nextMatch(snapshot, list, si, direction, false, 0, NULL) : NULL;
+  pending = action && action->condition.usesCall;
+  if (action && (socketState->hanging & direction)) {
+    const int slot = HANG_SLOT(direction);
+    if (socketState->until[slot] > Clock_now()) {
+      Epoch_leave();
+      Arena_release(mark);
+      errno = EAGAIN;
+      return -1;
+    }
+    action  = ActionSnapshot_get(snapshot, queue->capacity, socketState->pos[slot]);
+    pending = false;
+    if (!action) {
+      action  = ActionQueue_nextMatch(snapshot, list, si, direction, true,
+                                      socketState->pos[slot], NULL);
+      pending = action && action->condition.usesCall;
     }
     if (!action) {
-      socketState->hanging = false;
-      return callback(si->fd, buf, len, flags, data);
+      ActionSocketData_unhang(socketState, si, direction);
+    }
+  }
+  if (!action) {
+    ssize_t result;
+    if (!queue->feeding || list == NULL || list->count == 0) {
+      Epoch_leave();
+      Arena_release(mark);
+      return ActionQueue_pass(queue, si, direction, call, NULL, NULL);
     }
+    /* Only the conditions that count the calls need the rules */
+    (void)__sync_fetch_and_add(&snapshot->refs, 1);
+    list = ActionCandidates_copy(list);
+    Epoch_leave();
+    result = ActionQueue_pass(queue, si, direction, call, snapshot, list);
+    Arena_release(mark);
+    ActionSnapshot_unref(snapshot);
+    return result;
   }
 
+  /* The call may sleep and blocks in the syscall: it keeps the rules and its
+   * candidate list out of the critical section, so that it never holds back
+   * the reclamation of the retired objects. */
+  (void)__sync_fetch_and_add(&snapshot->refs, 1);
+  list = ActionCandidates_copy(list);
+  Epoch_leave();
+  if (list == NULL) {
+    Arena_release(mark);
+    ActionSnapshot_unref(snapshot);
+    return ActionQueue_pass(queue, si, direction, call, NULL, NULL);
+  }
+
+  state = *call;
   state.queue     = queue;
-  state.callback  = callback;
-  state.origBuf   = buf;
-  state.origLen   = len;
-  if (direction == Writing) {
+  state.snapshot  = snapshot;
+  if (state.iov || state.splice) {
+    state.buf = NULL;
+    state.len = state.origLen;
+  } else if (direction == Writing) {
     state.buf = NULL;
     state.len = 0;
   } else {
     state.buf = state.origBuf;
     state.len = state.origLen;
   }
-  state.flags     = flags;
-  state.data      = data;
   state.direction = direction;
   state.aborted   = false;
   state.done      = false;
-  state.calledLines = LigHT_init(queue->capacity, NULL);
+  ActionLineSet_clear(&state.calledLines);
+  state.scan.scanner = NULL;
   state.keepError = false;
   state.err       = errno;
   state.result    = 0;
+  if (state.splice && list->usesData) {
+    /* The data must be bounced before the kernel moves it */
+    (void)ActionCallData_prepareBuffer(&state);
+  }
+  if (pending) {
+    /* The condition of the first rule has been checked without the data
+     * (after the end of a hang, the search resumes as a matched socket) */
+    action = ActionQueue_nextMatch(snapshot, list, si, direction,
+                                   (socketState->hanging & direction) != 0, action->pos,
+                                   &state);
+  }
 
   while (action) {
     Action* next = NULL;
-    if ((action->mode == AM_OncePerCall && LigHT_contains(state.calledLines, action->pos, false))
-        || (action->mode == AM_OncePerSocket && LigHT_contains(socketState->calledLines, action->pos, true))) {
-      UNLOCK_ACTION(action)
-      action = ActionQueue_getMatch(queue, si, direction, true, action->pos + 1, true);
+    if (Action_skip(action, socketState, &state)) {
+      action = ActionQueue_nextMatch(snapshot, list, si, direction, true, action->pos + 1,
+                                     &state);
       continue;
     }
-    if (!Action_process(action, si, &state) || socketState->hanging) {
-      UNLOCK_ACTION(action)
+    if (!Action_process(action, si, &state) || (socketState->hanging & direction)) {
       break;
     }
-    (void)LigHT_put(state.calledLines, action->pos, (void*)"OK", true, false);
-    (void)LigHT_put(socketState->calledLines, action->pos, (void*)"OK", true, true);
+    /* The action may have changed the data */
+    state.scan.scanner = NULL;
+    ActionLineSet_add(&state.calledLines, action->pos);
+    if (action->mode == AM_OncePerSocket) {
+      ActionSocketData_markDone(socketState, queue, action->pos);
+    }
     switch (action->next.type) {
      case AGT_Continue:
-      next = ActionQueue_getMatch(queue, si, direction, true, action->pos + 1, true);
+      next = ActionQueue_nextMatch(snapshot, list, si, direction, true, action->pos + 1,
+                                   &state);
       break;
      case AGT_Goto:
-      next = ActionQueue_getMatch(queue, si, direction, true, action->next.line, true);
+      next = ActionQueue_nextMatch(snapshot, list, si, direction, true, action->next.line,
+                                   &state);
       break;
      case AGT_Next:
-      next = ActionQueue_getFrom(queue, action->pos + 1, true);
+      next = ActionSnapshot_getFrom(snapshot, queue->capacity, action->pos + 1);
       break;
      case AGT_Do:
-      next = ActionQueue_getFrom(queue, action->next.line, true);
+      next = ActionSnapshot_getFrom(snapshot, queue->capacity, action->next.line);
       break;
      default:
       next = NULL;
     }
-    if (action->mode == AM_Once) {
-      ActionQueue_remove(queue, action->pos, true);
-    }
-    UNLOCK_ACTION(action)
     action = next;
   }
-  LigHT_destroy(state.calledLines);
   if (!state.done && !state.aborted) {
     (void)ActionSyscall_perform(-1, NULL, si, &state);
   }
-  if (direction == Writing) {
-    free(state.buf);
+  if (state.iov && state.buf && direction == Reading && state.result > 0) {
+    ActionCallData_scatter(&state, state.result);
   }
+  if (state.splice && state.result > 0 && (size_t)state.result > state.spliced) {
+    ActionCallData_settle(&state);
+  }
+  ActionQueue_count(queue, si, direction, state.result, snapshot, list);
+  Arena_release(mark);
+  ActionSnapshot_unref(snapshot);
   errno = state.err;
   return state.result;
 }
 
+ssize_t ActionQueue_process(ActionQueue* queue, SocketInfo* si,
+                            SocketInfoDirection direction, Action_syscall callback,
+                            void* buf, size_t len, int flags, void* data) {
+  ActionCallData call;
+
+  call.callback  = callback;
+  call.vcallback = NULL;
+  call.origBuf   = buf;
+  call.origLen   = len;
+  call.iov       = NULL;
+  call.iovcnt    = 0;
+  call.iovOffset = 0;
+  call.splice    = NULL;
+  call.spliced   = 0;
+  call.flags     = flags;
+  call.data      = data;
+  return ActionQueue_run(queue, si, direction, &call);
+}
+
+ssize_t ActionQueue_processv(ActionQueue* queue, SocketInfo* si,
+                             SocketInfoDirection direction, Action_syscall callback,
+                             Action_vsyscall vcallback, const struct iovec* iov,
+                             int iovcnt, int flags, void* data) {
+  ActionCallData call;
+  int i;
+
+  call.callback  = callback;
+  call.vcallback = vcallback;
+  call.origBuf   = NULL;
+  call.origLen   = 0;
+  for (i = 0 ; i < iovcnt ; ++i) {
+    call.origLen += iov[i].iov_len;
+  }
+  call.iov       = iov;
+  call.iovcnt    = iovcnt;
+  call.iovOffset = 0;
+  call.splice    = NULL;
+  call.spliced   = 0;
+  call.flags     = flags;
+  call.data      = data;
+  return ActionQueue_run(queue, si, direction, &call);
+}
+
+ssize_t ActionQueue_splice(ActionQueue* queue, SocketInfo* si,
+                           SocketInfoDirection direction, Action_syscall callback,
+                           ActionSplice* splice, size_t len, int flags, void* data) {
+  ActionCallData call;
+
+  call.callback  = callback;
+  call.vcallback = NULL;
+  call.origBuf   = NULL;
+  call.origLen   = len;
+  call.iov       = NULL;
+  call.iovcnt    = 0;
+  call.iovOffset = 0;
+  call.splice    = splice;
+  call.spliced   = 0;
+  call.flags     = flags;
+  call.data      = data;
+  return ActionQueue_run(queue, si, direction, &call);
+}
+
 void ActionQueue_remove(ActionQueue* queue, off_t pos, bool mt) {
+  struct ActionSnapshot* snapshot;
+  Action* old;
+
+  if (pos < 0 || pos >= (off_t)queue->capacity) {
+    return;
+  }
   ACQUIRE_WRITE
-  EMPTY_ACTION(queue->queue[pos])
-  Action_destroy(queue->queue[pos]);
-  queue->queue[pos] = NULL;
+  if (queue->snapshot->queue[pos] == NULL
+      || (snapshot = ActionQueue_edit(queue, mt)) == NULL) {
+    RELEASE
+    return;
+  }
+  old = snapshot->queue[pos];
+  snapshot->queue[pos] = NULL;
+  ActionIndex_remove(&snapshot->index, pos);
+  ActionQueue_publish(queue, snapshot, old, mt);
   RELEASE
 }
 
 void ActionQueue_list(ActionQueue* queue, int fd) {
+  struct ActionSnapshot* snapshot;
   size_t i;
+
+  /* Writing to the descriptor may block */
+  snapshot = ActionQueue_pin(queue);
   for (i = 0 ; i < queue->capacity ; ++i) {
-    if (queue->queue[i] != NULL) {
-      Action_show(queue->queue[i], fd);
+    Action* action = snapshot->queue[i];
+    if (action != NULL && (action->mode != AM_Once || !action->fired)) {
+      Action_show(action, fd);
     }
   }
+  ActionSnapshot_unref(snapshot);
 }
 
 
@@ -772,36 +2980,445 @@ void ActionQueue_list(ActionQueue* queue, int fd) {
  * ActionData
  *****************************************************************************/
 
+/** Number of done flags stored in ActionSocketData::done.
+ */
+#define INLINE_DONE_FLAGS 64
+
+/** Number of words of ActionSocketData::moreDone.
+ */
+#define MORE_DONE_WORDS ((ACTION_MAX_LINES - INLINE_DONE_FLAGS + 63) / 64)
+
+/** Largest amount of data bounced through memory by a spliced call.
+ *
+ * Half of the largest arena block, so that the bounce buffer is recycled by
+ * the arena instead of hitting malloc.
+ */
+#define SPLICE_BOUNCE_MAX (ARENA_LARGEST_BLOCK / 2)
+
 static void ActionSocketData_destroy(SocketInfo* si) {
   if (si) {
     struct ActionSocketData* data = (struct ActionSocketData*)(si->data);
-    LigHT_destroy(data->calledLines);
-    free(data);
+    int i;
+    for (i = 0 ; i < ACTION_DIRECTIONS ; ++i) {
+      free(data->candidates[i]);
+    }
+    free(data->moreDone);
+    Slab_free(socketDataSlab, data);
     si->data = NULL;
   }
 }
 
+/** Sockets hanging asynchronously.
+ *
+ * The list is read by the readiness calls (poll, select, epoll), it holds a
+ * reference on each socket until the end of its hang, or until the socket is
+ * closed. The references are released with the lock held: this is safe as
+ * long as ActionSocketData_destroy does not take it.
+ */
+static pthread_mutex_t hangLock     = PTHREAD_MUTEX_INITIALIZER;
+static SocketInfo**    hangList     = NULL;
+static volatile int    hangCount    = 0;
+static int             hangCapacity = 0;
+
+/** Remove an entry of the list of the hanging sockets.
+ *
+ * Must be called with hangLock held.
+ *
+ * @param i The index of the entry, it receives the last entry of the list.
+ */
+static void ActionSocketData_unlist(int i) {
+  SocketInfo* si = hangList[i];
+
+  ((ActionSocketData*)si->data)->listed = false;
+  hangList[i] = hangList[hangCount - 1];
+  hangCount   = hangCount - 1;
+  SocketInfo_unlock(si);
+}
+
+/** End the hang of a socket in a direction.
+ *
+ * The socket leaves the list of the hanging sockets as soon as it neither
+ * hangs nor is masked from an epoll set, without waiting for a readiness
+ * call. The caller must hold a reference on the socket.
+ */
+static void ActionSocketData_unhang(ActionSocketData* data, SocketInfo* si,
+                                    SocketInfoDirection direction) {
+  int i;
+
+  if (__sync_and_and_fetch(&data->hanging, ~(unsigned int)direction) != 0
+      || !data->listed || SocketInfo_masked(si)) {
+    return;
+  }
+  pthread_mutex_lock(&hangLock);
+  /* A new hang may have started meanwhile */
+  if (data->listed && data->hanging == 0 && !SocketInfo_masked(si)) {
+    for (i = 0 ; i < hangCount ; ++i) {
+      if (hangList[i] == si) {
+        ActionSocketData_unlist(i);
+        break;
+      }
+    }
+  }
+  pthread_mutex_unlock(&hangLock);
+}
+
+void ActionSocketData_hang(ActionSocketData* data, SocketInfo* si,
+                           SocketInfoDirection direction, int pos, int msec) {
+  const int slot = HANG_SLOT(direction);
+
+  data->pos[slot]  = pos;
+  data->until[slot] = Clock_now() + Clock_fromMSec(msec);
+  (void)__sync_fetch_and_or(&data->hanging, (unsigned int)direction);
+  pthread_mutex_lock(&hangLock);
+  if (!data->listed) {
+    if (hangCount == hangCapacity) {
+      const int capacity = hangCapacity ? 2 * hangCapacity : 16;
+      SocketInfo** list = (SocketInfo**)realloc(hangList, capacity * sizeof(SocketInfo*));
+      if (list == NULL) {
+        pthread_mutex_unlock(&hangLock);
+        return;
+      }
+      hangList     = list;
+      hangCapacity = capacity;
+    }
+    SocketInfo_lock(si);
+    hangList[hangCount] = si;
+    hangCount    = hangCount + 1;
+    data->listed = true;
+  }
+  pthread_mutex_unlock(&hangLock);
+}
+
+bool Action_hanging(void) {
+  return hangCount > 0;
+}
+
+int Action_hangDelay(SocketInfo* si, SocketInfoDirection direction) {
+  const ActionSocketData* data = (const ActionSocketData*)si->data;
+  const int slot = HANG_SLOT(direction);
+  uint64_t now;
+
+  if (data == NULL || !(data->hanging & direction)) {
+    return 0;
+  }
+  now = Clock_now();
+  if (data->until[slot] <= now) {
+    return 0;
+  }
+  /* Round up: waking up before the end of the hang would be useless */
+  return (int)Clock_toMSec(data->until[slot] - now + CLOCK_NSEC_PER_MSEC - 1);
+}
+
+void Action_forgetHanging(unsigned int first, unsigned int last) {
+  int i = 0;
+
+  if (hangCount == 0) {
+    return;
+  }
+  pthread_mutex_lock(&hangLock);
+  while (i < hangCount) {
+    SocketInfo* si = hangList[i];
+    if ((unsigned int)si->fd >= first && (unsigned int)si->fd <= last) {
+      /* The registration of a closed descriptor must never be touched again */
+      ((ActionSocketData*)si->data)->hanging = 0;
+      SocketInfo_unwatch(si);
+      ActionSocketData_unlist(i);
+    } else {
+      ++i;
+    }
+  }
+  pthread_mutex_unlock(&hangLock);
+}
+
+SocketInfo** Action_hangingSockets(int* count) {
+  SocketInfo** list;
+  SocketInfo** over;
+  int kept = 0;
+  int done = 0;
+  int i;
+
+  if (hangCount == 0) {
+    *count = 0;
+    return NULL;
+  }
+  pthread_mutex_lock(&hangLock);
+  list = (SocketInfo**)Arena_alloc(hangCount * sizeof(SocketInfo*));
+  over = (SocketInfo**)Arena_alloc(hangCount * sizeof(SocketInfo*));
+  if (list == NULL || over == NULL) {
+    pthread_mutex_unlock(&hangLock);
+    *count = 0;
+    return NULL;
+  }
+  for (i = 0 ; i < hangCount ; ++i) {
+    SocketInfo* si = hangList[i];
+    if (!SocketInfo_masked(si) && Action_hangDelay(si, Reading) == 0
+        && Action_hangDelay(si, Writing) == 0) {
+      ((ActionSocketData*)si->data)->listed = false;
+      over[done++] = si;
+    } else {
+      SocketInfo_lock(si);
+      hangList[kept] = si;
+      list[kept++]   = si;
+    }
+  }
+  hangCount = kept;
+  pthread_mutex_unlock(&hangLock);
+  for (i = 0 ; i < done ; ++i) {
+    SocketInfo_unlock(over[i]);
+  }
+  *count = kept;
+  return list;
+}
+
 struct ActionSocketData* ActionSocketData_get(SocketInfo* si, ActionQueue* queue) {
   if (!si->data) {
     ActionSocketData* data;
-    data = (ActionSocketData*)malloc(sizeof(ActionSocketData));
-    data->calledLines = LigHT_init(queue->capacity, NULL);
+    if ((data = (ActionSocketData*)Slab_alloc(socketDataSlab)) == NULL) {
+      return NULL;
+    }
+    data->done     = 0;
+    data->moreDone = NULL;
+    data->hanging  = 0;
+    data->listed   = false;
+    memset(data->until, 0, sizeof(data->until));
+    memset(data->pos, 0, sizeof(data->pos));
+    memset((void*)data->candidates, 0, sizeof(data->candidates));
     SocketInfo_setData(si, data, ActionSocketData_destroy);
-    data->hanging    = false;
-    data->msec       = 0;
   }
   return (ActionSocketData*)si->data;
 }
 
+bool ActionSocketData_isDone(ActionSocketData* data, ActionQueue* queue, int line) {
+  int slot = ActionQueue_slot(queue, line, false);
+  uint64_t* more;
+
+  if (slot < 0) {
+    return false;
+  } else if (slot < INLINE_DONE_FLAGS) {
+    return (data->done >> slot) & 1;
+  }
+  slot -= INLINE_DONE_FLAGS;
+  more  = data->moreDone;
+  return more && ((more[slot >> 6] >> (slot & 63)) & 1);
+}
+
+void ActionSocketData_markDone(ActionSocketData* data, ActionQueue* queue, int line) {
+  int slot = ActionQueue_slot(queue, line, false);
+  uint64_t* more;
+
+  if (slot < 0) {
+    return;
+  } else if (slot < INLINE_DONE_FLAGS) {
+    (void)__sync_fetch_and_or(&data->done, UINT64_C(1) << slot);
+    return;
+  }
+  slot -= INLINE_DONE_FLAGS;
+  more  = data->moreDone;
+  if (more == NULL) {
+    more = (uint64_t*)calloc(MORE_DONE_WORDS, sizeof(uint64_t));
+    if (more == NULL) {
+      return;
+    }
+    if (!__sync_bool_compare_and_swap(&data->moreDone, NULL, more)) {
+      free(more);
+      more = data->moreDone;
+    }
+  }
+  (void)__sync_fetch_and_or(&more[slot >> 6], UINT64_C(1) << (slot & 63));
+}
+
 bool ActionCallData_prepareBuffer(ActionCallData* data) {
+  const struct iovec* vect;
+  size_t len;
+  size_t skip;
+  char*  pos;
+  int    i;
+
   if (data->buf) {
     return true;
   }
-  data->buf = malloc(data->origLen);
+  if (data->splice && data->done) {
+    /* The data has already been moved by the kernel */
+    return false;
+  }
+  len = READ_BUFFER_LENGTH(data);
+  if (data->splice && len > SPLICE_BOUNCE_MAX) {
+    /* The call moves less data than requested, like a short transfer */
+    len = SPLICE_BOUNCE_MAX;
+  }
+  if (data->splice && data->direction == Reading && !data->splice->hasOffset) {
+    /* Don't receive more than a pipe can take, it would be lost */
+    ssize_t room = Binding_pipeRoom(data->splice->fd);
+    if (room == 0) {
+      /* Let the kernel wait or fail as it would */
+      return false;
+    }
+    if (room > 0 && (size_t)room < len) {
+      len = room;
+    }
+  }
+  data->buf = Arena_alloc(len);
   if (!data->buf) {
     return false;
   }
-  (void)memcpy(data->buf, data->origBuf, data->origLen);
-  data->len = data->origLen;
+  if (data->splice) {
+    if (data->direction == Writing) {
+      ssize_t ret = ActionCallData_peek(data, data->buf, len);
+      if (ret < 0) {
+        data->buf = NULL;
+        return false;
+      }
+      len = ret;
+    }
+  } else if (!data->iov) {
+    (void)memcpy(data->buf, data->origBuf, len);
+  } else if (data->direction == Writing || data->done) {
+    /* Gather only the data of the call */
+    vect = data->iov;
+    skip = data->iovOffset;
+    pos  = data->buf;
+    for (i = 0 ; i < data->iovcnt && pos < (char*)data->buf + len ; ++i) {
+      size_t chunk;
+      if (skip >= vect[i].iov_len) {
+        skip -= vect[i].iov_len;
+        continue;
+      }
+      chunk = vect[i].iov_len - skip;
+      if (chunk > (size_t)((char*)data->buf + len - pos)) {
+        chunk = (char*)data->buf + len - pos;
+      }
+      (void)memcpy(pos, (char*)vect[i].iov_base + skip, chunk);
+      pos += chunk;
+      skip = 0;
+    }
+  }
+  data->len = len;
   return true;
 }
+
+/** Get the user vectors covering exactly the data of a vectored call.
+ *
+ * The vectors are only rebuilt (in the arena) when the data doesn't start
+ * at the beginning of a vector or ends before the end of one, the data
+ * stays in place.
+ *
+ * @param count Receive the number of vectors (0 when there is no data left).
+ * @return The vectors, or NULL if they could not be allocated.
+ */
+static const struct iovec* ActionCallData_slice(ActionCallData* data, int* count) {
+  const struct iovec* from = data->iov;
+  struct iovec* vect;
+  size_t skip  = data->iovOffset;
+  size_t total = 0;
+  int left = data->iovcnt;
+  int n;
+
+  while (left > 0 && skip > 0 && skip >= from->iov_len) {
+    skip -= from->iov_len;
+    ++from;
+    --left;
+  }
+  if (data->len == 0) {
+    *count = 0;
+    return from;
+  }
+  for (n = 0 ; n < left && total < skip + data->len ; ++n) {
+    total += from[n].iov_len;
+  }
+  *count = n;
+  if (n == 0 || (skip == 0 && total <= data->len)) {
+    return from;
+  }
+  vect = (struct iovec*)Arena_alloc(n * sizeof(struct iovec));
+  if (vect == NULL) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  (void)memcpy(vect, from, n * sizeof(struct iovec));
+  vect[0].iov_base = (char*)vect[0].iov_base + skip;
+  vect[0].iov_len -= skip;
+  vect[n - 1].iov_len -= total - skip - data->len;
+  return vect;
+}
+
+const struct iovec* ActionCallData_view(ActionCallData* data, struct iovec* single,
+                                        int* count) {
+  const struct iovec* vect;
+
+  if (IS_VECTORED(data)) {
+    if ((vect = ActionCallData_slice(data, count)) == NULL) {
+      *count = 0;
+      return single;
+    }
+    return vect;
+  }
+  if (data->splice && !ActionCallData_prepareBuffer(data)) {
+    *count = 0;
+    return single;
+  }
+  single->iov_base = READ_BUFFER(data);
+  single->iov_len  = READ_BUFFER_LENGTH(data);
+  *count = 1;
+  return single;
+}
+
+bool ActionCallData_contains(ActionCallData* data, SocketInfo* si, const Payload* payload) {
+  const PayloadScanner* scanner;
+  const struct iovec* vect;
+  struct iovec single;
+  size_t left;
+  int slot = -1;
+  int count;
+  int i;
+
+  if (data == NULL) {
+    return true;
+  }
+  if (data->direction == Reading && !data->done && !data->aborted) {
+    (void)ActionSyscall_perform(-1, NULL, si, data);
+  }
+  scanner = data->snapshot->scanner;
+  if (scanner) {
+    slot = PayloadScanner_find(scanner, payload);
+  }
+  if (slot < 0) {
+    /* Not compiled (the rules are being changed): search it alone */
+    if (!ActionCallData_prepareBuffer(data)) {
+      return false;
+    }
+    return Payload_search(payload, data->buf, data->len);
+  }
+  if (data->scan.scanner != scanner) {
+    PayloadScan_start(&data->scan, scanner, data->found);
+    vect = ActionCallData_view(data, &single, &count);
+    left = READ_BUFFER_LENGTH(data);
+    for (i = 0 ; i < count && left > 0 ; ++i) {
+      size_t chunk = vect[i].iov_len > left ? left : vect[i].iov_len;
+      PayloadScan_feed(&data->scan, (const char*)vect[i].iov_base, chunk);
+      left -= chunk;
+    }
+  }
+  return PayloadScan_found(&data->scan, slot);
+}
+
+ssize_t ActionCallData_syscall(ActionCallData* data, int fd) {
+  const struct iovec* vect;
+  int count;
+
+  if (!IS_VECTORED(data)) {
+    ssize_t ret = data->callback(fd, READ_BUFFER(data), READ_BUFFER_LENGTH(data),
+                                 data->flags, data->data);
+    if (data->splice && !data->buf && ret > 0) {
+      data->spliced += ret;
+    }
+    return ret;
+  }
+  if ((vect = ActionCallData_slice(data, &count)) == NULL) {
+    return -1;
+  }
+  if (count == 0) {
+    /* No data left after the offset */
+    return 0;
+  }
+  return data->vcallback(fd, vect, count, data->flags, data->data);
+}
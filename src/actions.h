@@ -33,6 +33,7 @@
 #define _ACTIONS_H_
 
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <stdbool.h>
 
 #include "socketinfo.h"
@@ -58,7 +59,7 @@ typedef struct Action Action;
 /** Build a new action from an action description.
  *
  * An @p instruction has te following structure :<br>
- * <code><i>line</i> on <i>proto</i> [[from <i>source</i>|connect|close]
+ * <code><i>line</i> on <i>proto</i> [[from <i>source</i>|connect|close|accept]
  * to <i>dest</i>|with <i>host</i>|talk-with <i>host</i>] [when <i>cond</i>]
  * [<i>domode</i> <i>action</i>] <i>next</i></code>
  *
@@ -66,8 +67,9 @@ typedef struct Action Action;
  * - <b>line</b> Line is the id of the instruction. The set of instruction
  *     is processed in increasing id order. Lines 0 to 9 are system rules and must
  *     not be defined by user even if there is no test to check user's behaviour.
- * - <b>proto</b> Protocole of the socket. This can be <code>tcp, udp or ip</code>.
- *     ip matches both tcp and udp
+ * - <b>proto</b> Protocole of the socket. This can be <code>tcp, udp, ip or
+ *     unix</code>. ip matches both tcp and udp, unix matches the stream and
+ *     datagram Unix domain sockets.
  * - <b>host</b>, <b>dest</b> or <b>source</b> Address to match. An adress as the
  *     following structure:
  *      <code>host (port port)</code>
@@ -77,7 +79,24 @@ typedef struct Action Action;
  *          host match the rule. If host is dns, the port is ignored
  *          and is always 53. The port must be a valid number or a service
  *          name (listed in /etc/services)
+ *      .
+ *     The host of a <code>unix</code> rule is <code>me</code>, <code>any</code>
+ *     or the path of the socket: an absolute path or an abstract name written
+ *     with a leading <code>@</code> (eg. <code>@sidecar</code>). The path may
+ *     contain the wildcards <code>*</code> (any sequence of characters,
+ *     including '/') and <code>?</code> (any character), it takes no port.
+ *     For <code>connect</code> and <code>close</code>, <b>dest</b> is the remote
+ *     end of the socket. For <code>accept</code>, <b>dest</b> is the local end
+ *     on which the connection is accepted (eg. <code>accept to me port 80</code>).
  * - <b>cond</b> A matching condition. This parameters is optional. @ref ActionConditionType
+ *     The payload conditions (<code>contains</code>, <code>matches-any</code>)
+ *     look at the data of the call: a read is performed before they are
+ *     checked, so the actions of the rule see the received data.
+ *     Conditions can be combined with <code>and</code>, <code>or</code>,
+ *     <code>not</code> and parentheses, <code>and</code> binding tighter than
+ *     <code>or</code> (eg. <code>when prob 5 and after 60000 and not matched</code>).
+ *     The operands are checked the cheapest first, whatever their order in
+ *     the rule: the data is only read if the other operands hold.
  * - <b>domode</b> The domode explains what to do with the action when it has
  *      been processed. There are currently 4 modes:
  *      - <b>do</b> do nothing more
@@ -116,7 +135,8 @@ void Action_destroy(Action* action);
  * @param si     The socket to test.
  * @param direction Data direction.
  * @param matched True if the socket already matched rule.
- * @return true if the socket matches the rule.
+ * @return true if the socket matches the rule. The conditions looking at
+ *         the calls or their data are considered fulfilled.
  */
 bool Action_match(Action* action, SocketInfo* si, SocketInfoDirection direction,
                   bool matched);
@@ -125,6 +145,22 @@ bool Action_match(Action* action, SocketInfo* si, SocketInfoDirection direction,
  */
 typedef ssize_t (Action_syscall)(int fd, void* buf, size_t len, int flags, void* data);
 
+/** Call back for apply user requested action on a scatter/gather vector.
+ */
+typedef ssize_t (Action_vsyscall)(int fd, const struct iovec* iov, int iovcnt,
+                                  int flags, void* data);
+
+/** Other end of a call moving data between two file descriptors.
+ *
+ * Calls like sendfile or splice move the data between a socket and another
+ * file descriptor without copying it to the user space.
+ */
+typedef struct ActionSplice {
+  int     fd;        /**< The other file descriptor. */
+  bool    hasOffset; /**< If true, use offset instead of the file position. */
+  int64_t offset;    /**< Offset in the other file descriptor. */
+} ActionSplice;
+
 /** Call state structure.
  */
 typedef struct ActionCallData ActionCallData;
@@ -150,6 +186,45 @@ bool Action_process(Action* action, SocketInfo* si, ActionCallData* state);
  */
 void Action_show(Action* action, int fd);
 
+/** Check if some sockets hang asynchronously.
+ *
+ * This is a cheap check to be done before looking for the hanging sockets
+ * of a readiness call (poll, select, epoll).
+ *
+ * @return true if a socket may be hanging.
+ */
+bool Action_hanging(void);
+
+/** Get the remaining time of the asynchronous hang of a socket.
+ *
+ * @param si        The socket.
+ * @param direction Reading or Writing.
+ * @return The remaining time in milliseconds, 0 if the socket does not hang.
+ */
+int Action_hangDelay(SocketInfo* si, SocketInfoDirection direction);
+
+/** Get the sockets that hang asynchronously.
+ *
+ * The sockets whose notifications are still masked (see SocketInfo::watch)
+ * are kept in the list after the end of their hang, so that they can be
+ * unmasked. The list is allocated in the arena of the calling thread and each
+ * socket is locked and must be released using SocketInfo_unlock.
+ *
+ * @param count Receive the number of sockets.
+ * @return The sockets (NULL if none).
+ */
+SocketInfo** Action_hangingSockets(int* count);
+
+/** Drop the sockets of closed file descriptors from the hanging sockets.
+ *
+ * Their hang ends and their epoll registration is forgotten, so that the
+ * readiness calls never mask a new file descriptor with the same number.
+ *
+ * @param first The first closed file descriptor.
+ * @param last  The last closed file descriptor (included).
+ */
+void Action_forgetHanging(unsigned int first, unsigned int last);
+
 /** @} */
 
 
@@ -158,16 +233,29 @@ void Action_show(Action* action, int fd);
  * This is just a set of ordered actions that allow you to find actions. The
  * action queue offers a set of function that help accessing the @ref Action
  * rules either by enumerating them or by finding the rules matching a given
- * condition. @{
+ * condition.
+ *
+ * Readers never lock the queue: the actions returned by the lookup functions
+ * remain valid until the caller leaves its epoch critical section (see
+ * @ref Epoch), even if they are concurrently removed from the queue. Writers
+ * are serialized and never wait for the readers. @{
  */
 
 /** An action queue.
  */
 typedef struct ActionQueue ActionQueue;
 
+/** Maximum number of lines of an action queue.
+ */
+#define ACTION_MAX_LINES 2048
+
+/** Number of directions a call can have (see SocketInfoDirection).
+ */
+#define ACTION_DIRECTIONS 5
+
 /** Create a new Action Queue of the given size.
  *
- * @param capacity The size of the queue.
+ * @param capacity The size of the queue (at most ACTION_MAX_LINES).
  * @return NULL on error, or a new well initialized ActionQueue structure.
  */
 ActionQueue* ActionQueue_init(size_t capacity);
@@ -188,7 +276,9 @@ void ActionQueue_destroy(ActionQueue* queue);
  *                offset of the action is already filled by another
  *                action. If true, the slot requested by the action
  *                if first freed.
- * @param mt      If true, the function lock the accesses to the queue.
+ * @param mt      If true, concurrent readers may use the queue: the rules
+ *                are updated by publishing a new version of the queue. If
+ *                false, the queue is modified in place.
  * @return false if the function failed, true if it succeed.
  */
 bool ActionQueue_put(ActionQueue* queue, const char* instruction,
@@ -198,7 +288,7 @@ bool ActionQueue_put(ActionQueue* queue, const char* instruction,
  *
  * @param queue The queue
  * @param pos   The requested offset.
- * @param mt    If true, the function lock the accesses to the queue.
+ * @param mt    Unused (lookups are lock-free).
  * @return The action at the given offset, of NULL.
  */
 Action* ActionQueue_get(ActionQueue* queue, off_t pos, bool mt);
@@ -207,7 +297,7 @@ Action* ActionQueue_get(ActionQueue* queue, off_t pos, bool mt);
  *
  * @param queue The queue.
  * @param pos   Position from which the search much start
- * @param mt    If true, the function lock the accesses to the queue.
+ * @param mt    Unused (lookups are lock-free).
  * @return The first action found, or NULL.
  */
 Action* ActionQueue_getFrom(ActionQueue* queue, off_t pos, bool mt);
@@ -227,7 +317,7 @@ Action* ActionQueue_getFrom(ActionQueue* queue, off_t pos, bool mt);
  * @param direction Data direction (Reading|Writing)
  * @param matched True if the socket already matched a rule.
  * @param pos   Position from which the search much start
- * @param mt    If true, the function lock the accesses to the queue.
+ * @param mt    Unused (lookups are lock-free).
  * @return The first action found, or NULL.
  */
 Action* ActionQueue_getMatch(ActionQueue* queue, SocketInfo* si, SocketInfoDirection direction,
@@ -244,6 +334,21 @@ Action* ActionQueue_getMatch(ActionQueue* queue, SocketInfo* si, SocketInfoDirec
 #define ActionQueue_getFirstMatch(queue, si, direction, mt) \
   ActionQueue_getMatch(queue, si, direction, false, 0, mt)
 
+/** Check if a rule of the queue may match a call.
+ *
+ * This only looks at an atomically published summary of the queue, so it can
+ * be used before fetching anything about the socket. False positives are
+ * possible, but if it returns false, no rule can match the call.
+ *
+ * @param queue The queue.
+ * @param direction Data direction.
+ * @param proto The protocol of the socket (AP_All if unknown).
+ * @param port  The remote port of the socket (-1 if unknown).
+ * @return false if no rule can match.
+ */
+bool ActionQueue_mayMatch(ActionQueue* queue, SocketInfoDirection direction,
+                          Proto proto, int port);
+
 /** Process a socket against an action queue.
  *
  * @param queue The queue
@@ -260,11 +365,58 @@ ssize_t ActionQueue_process(ActionQueue* queue, SocketInfo* si,
                             SocketInfoDirection direction, Action_syscall callback,
                             void* buf, size_t len, int flags, void* data);
 
+/** Process a vectored call against an action queue.
+ *
+ * The data stays in the caller's vectors: they are passed as is to @p
+ * vcallback unless an action needs to edit the data. In that case only the
+ * data of the call is gathered in a contiguous buffer, and @p callback is used
+ * on that buffer (when reading, the buffer is scattered back to the vectors
+ * at the end of the processing).
+ *
+ * @param queue The queue
+ * @param si    The socket.
+ * @param direction Data direction (Reading|Writing)
+ * @param callback Callback to execute the system call on a contiguous buffer.
+ * @param vcallback Callback to execute the system call on a vector.
+ * @param iov    The vectors.
+ * @param iovcnt Number of vectors.
+ * @param flags system call flags.
+ * @param data  User data to be passed to the system call callbacks.
+ * @return Size read/written
+ */
+ssize_t ActionQueue_processv(ActionQueue* queue, SocketInfo* si,
+                             SocketInfoDirection direction, Action_syscall callback,
+                             Action_vsyscall vcallback, const struct iovec* iov,
+                             int iovcnt, int flags, void* data);
+
+/** Process a call moving data between a socket and another file descriptor.
+ *
+ * The data is not copied as long as the actions don't look at it: @p callback
+ * is called with a NULL buffer and must move the data itself between the
+ * socket and @p splice, updating the offset of @p splice. If an action needs
+ * the data, it is bounced through a buffer: @p callback is then called with
+ * that buffer and must only perform the I/O on the socket, the other file
+ * descriptor is read (when writing) or written (when reading) by the queue.
+ *
+ * @param queue  The queue
+ * @param si     The socket.
+ * @param direction Data direction (Reading|Writing)
+ * @param callback Callback to execute the system call.
+ * @param splice The other end of the call.
+ * @param len    Maximum length of the data.
+ * @param flags  system call flags.
+ * @param data   User data to be passed to the system call callback.
+ * @return Size read/written
+ */
+ssize_t ActionQueue_splice(ActionQueue* queue, SocketInfo* si,
+                           SocketInfoDirection direction, Action_syscall callback,
+                           ActionSplice* splice, size_t len, int flags, void* data);
+
 /** Remove an action.
  *
  * @param queue The queue
  * @param pos   The offset of the action to be removed.
- * @param mt    If true, the function lock the accesses to the queue.
+ * @param mt    If true, concurrent readers may use the queue (see ActionQueue_put).
  */
 void ActionQueue_remove(ActionQueue* queue, off_t pos, bool mt);
 
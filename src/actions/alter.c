@@ -42,8 +42,8 @@ static bool ActionAlter_argument(const char** from, void* dest,
   return Parse_int(from, &data[0].i, NULL, status);
 }
 
-static void ActionAlter_write(char** buffer, ActionData* data) {
-  *buffer += sprintf(*buffer, "alter %d ", data[0].i);
+static void ActionAlter_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "alter %d ", data[0].i);
 }
 
 static bool ActionAlter_perform(int pos, ActionData* data, SocketInfo* si,
@@ -61,12 +61,12 @@ static bool ActionAlter_perform(int pos, ActionData* data, SocketInfo* si,
     return Action_error("Can't allocate the edition buffer");
   }
   length = state->len;
-  while (length > 0) {
+  while (length > 0 && data[0].i > 0) {
     int batch = length > 1024 ? 1024 : length;
-    uint32_t val = rand() % (data[0].i * 2);
+    uint32_t val = Random_below(data[0].i * 2);
     val = (val * batch * 8 / 1000000);
     for (i = 0 ; i < (int)val ; ++i) {
-      int sub = rand() % (8 * batch);
+      int sub = Random_below(8 * batch);
       int oct = sub / 8;
       int bit = 1 << (sub - (8 * oct));
       uint8_t* buf = ((uint8_t*)state->buf) + off + oct;
@@ -85,4 +85,5 @@ void ActionAlter_register(ActionTaskDefinition* definition) {
   definition->perform  = ActionAlter_perform;
   definition->write    = ActionAlter_write;
   definition->close    = NULL;
+  definition->usesData = true;
 }
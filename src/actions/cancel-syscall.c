@@ -52,4 +52,5 @@ void ActionCancelSyscall_register(ActionTaskDefinition* definition) {
   definition->perform  = ActionCancelSyscall_perform;
   definition->write    = NULL;
   definition->close    = NULL;
+  definition->beforeCall = true;
 }
@@ -53,4 +53,5 @@ void ActionDrop_register(ActionTaskDefinition* definition) {
   definition->perform  = ActionDrop_perform;
   definition->write    = NULL;
   definition->close    = NULL;
+  definition->beforeCall = true;
 }
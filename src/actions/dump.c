@@ -40,10 +40,10 @@
  * @@DOC@@    <b>dump [file]</b> the current event to the given file. The informations
  * @@DOC@@    are stored in the following order:
  * @@DOC@@      - current time (8 bytes, milliseconds)
- * @@DOC@@      - type (1 byte, Connecting, Reading, Writing, Closing...)
- * @@DOC@@      - proto (1 byte, TCP, UDP)
+ * @@DOC@@      - type (1 byte, Connecting, Reading, Writing, Closing, Accepting...)
+ * @@DOC@@      - proto (1 byte, TCP, UDP, Unix)
  * @@DOC@@      - localport (2 bytes local port - 0 on connection)
- * @@DOC@@      - address (4 bytes IPv4 address)
+ * @@DOC@@      - address (4 bytes IPv4 address, 0 for a Unix socket)
  * @@DOC@@      - port (2 bytes port)
  * @@DOC@@      - success (1 byte: -1 for error, 0 for syscall not performed, 1 for success)
  * @@DOC@@      - length (4 bytes, errno on error)
@@ -71,6 +71,10 @@ static bool ActionDump_perform(int pos, ActionData* data, SocketInfo* si,
   int8_t oneByte;
   int16_t twoBytes;
   int32_t fourBytes;
+  const struct iovec* vect;
+  struct iovec single;
+  int count;
+  int i;
   uint64_t timer = getMSecTime();
 
   pthread_mutex_lock(&data[2].mtx);
@@ -92,10 +96,17 @@ static bool ActionDump_perform(int pos, ActionData* data, SocketInfo* si,
   fwrite(&oneByte, 1, 1, file);
   oneByte = si->proto;
   fwrite(&oneByte, 1, 1, file);
-  twoBytes = si->local.port;
+  /* Unix sockets have no port, their paths are not part of the format */
+  twoBytes = si->paths ? 0 : si->local.port;
   fwrite(&twoBytes, 2, 1, file);
-  fwrite(&si->remote.addr, 4, 1, file);
-  twoBytes = si->remote.port;
+  /* The format only holds IPv4 addresses, IPv6 peers are dumped as 0.0.0.0 */
+  fourBytes = 0;
+  if (IPAddress_isV4(&si->remote.addr)) {
+    fourBytes = ((uint32_t)si->remote.addr.bytes[12] << 24) | (si->remote.addr.bytes[13] << 16)
+              | (si->remote.addr.bytes[14] << 8) | si->remote.addr.bytes[15];
+  }
+  fwrite(&fourBytes, 4, 1, file);
+  twoBytes = si->paths ? 0 : si->remote.port;
   fwrite(&twoBytes, 2, 1, file);
   if (state->done || state->aborted) {
     oneByte = state->result == -1 ? -1 : 1;
@@ -108,17 +119,23 @@ static bool ActionDump_perform(int pos, ActionData* data, SocketInfo* si,
     fwrite(&oneByte, 1, 1, file);
   }
   if ((Data & state->direction) && state->result != -1) {
-    fourBytes = READ_BUFFER_LENGTH(state);
+    size_t left = READ_BUFFER_LENGTH(state);
+    fourBytes = left;
     fwrite(&fourBytes, 4, 1, file);
-    fwrite(READ_BUFFER(state), 1, fourBytes, file);
+    vect = ActionCallData_view(state, &single, &count);
+    for (i = 0 ; i < count && left > 0 ; ++i) {
+      size_t chunk = left > vect[i].iov_len ? vect[i].iov_len : left;
+      fwrite(vect[i].iov_base, 1, chunk, file);
+      left -= chunk;
+    }
   }
   fflush(file);
   pthread_mutex_unlock(&data[2].mtx);
   return true;
 }
 
-static void ActionDump_write(char** buffer,  ActionData* data) {
-  *buffer += sprintf(*buffer, "dump %s ", data[1].str);
+static void ActionDump_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "dump %s ", data[1].str);
 }
 
 static void ActionDump_close(ActionData* data) {
@@ -136,4 +153,5 @@ void ActionDump_register(ActionTaskDefinition* definition) {
   definition->perform  = ActionDump_perform;
   definition->write    = ActionDump_write;
   definition->close    = ActionDump_close;
+  definition->usesData = true;
 }
@@ -54,8 +54,8 @@ static bool ActionEcho_perform(int pos, ActionData* data, SocketInfo* si,
   return true;
 }
 
-static void ActionEcho_write(char** buffer,  ActionData* data) {
-  *buffer += sprintf(*buffer, "echo %s ", data[0].str);
+static void ActionEcho_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "echo %s ", data[0].str);
 }
 
 static void ActionEcho_close(ActionData* data) {
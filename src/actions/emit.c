@@ -102,15 +102,15 @@ static bool ActionEmit_argument(const char** from, void* dest,
   return Parse_enum(from, &data[0].i, signals, status);
 }
 
-static void ActionEmit_write(char** buffer, ActionData* data) {
+static void ActionEmit_write(char** buffer, const char* end, ActionData* data) {
   Parse_enumData* src = signals;
   while (src->constant) {
     if (data[0].i == src->value) {
-      *buffer += sprintf(*buffer, "emit %s ", src->constant);
+      Action_print(buffer, end, "emit %s ", src->constant);
       return;
     }
   }
-  *buffer += sprintf(*buffer, "emit ???? ");
+  Action_print(buffer, end, "emit ???? ");
 }
 
 static bool ActionEmit_perform(int pos, ActionData* data, SocketInfo* si,
@@ -131,4 +131,5 @@ void ActionEmit_register(ActionTaskDefinition* definition) {
   definition->perform  = ActionEmit_perform;
   definition->write    = ActionEmit_write;
   definition->close    = NULL;
+  definition->beforeCall = true;
 }
@@ -54,15 +54,15 @@ static bool ActionError_argument(const char** from, void* dest,
   return Parse_enum(from, &data[0].i, errors, status);
 }
 
-static void ActionError_write(char** buffer, ActionData* data) {
+static void ActionError_write(char** buffer, const char* end, ActionData* data) {
   Parse_enumData* src = errors;
   while (src->constant) {
     if (data[0].i == src->value) {
-      *buffer += sprintf(*buffer, "error %s ", src->constant);
+      Action_print(buffer, end, "error %s ", src->constant);
       return;
     }
   }
-  *buffer += sprintf(*buffer, "error ???? ");
+  Action_print(buffer, end, "error ???? ");
 }
 
 static bool ActionError_perform(int pos, ActionData* data, SocketInfo* si,
@@ -86,4 +86,5 @@ void ActionError_register(ActionTaskDefinition* definition) {
   definition->perform  = ActionError_perform;
   definition->write    = ActionError_write;
   definition->close    = NULL;
+  definition->beforeCall = true;
 }
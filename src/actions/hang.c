@@ -37,7 +37,7 @@
 
 /* @@TYPE@@   Hang
  * @@EXPORT@@ perform
- * @@DOC@@    <b>hang [ms]</b> immediately hang the given amount of time given in milliseconds
+ * @@DOC@@    <b>hang [ms]</b> immediately hang the given amount of time given in milliseconds (on a non-blocking socket the call fails with EAGAIN until the end of the hang, and the socket is withheld from poll, select and epoll meanwhile)
  */
 
 static bool ActionHang_argument(const char** from, void* dest,
@@ -48,12 +48,11 @@ static bool ActionHang_argument(const char** from, void* dest,
 
 bool ActionHang_perform(int pos, ActionData* data, SocketInfo* si,
                         ActionCallData* state) {
-  if (!IS_BLOCKING(si, state) && state->direction == Reading && !state->done) {
-    struct ActionSocketData* socketState;
-    socketState = ActionSocketData_get(si, state->queue);
-    socketState->hanging = true;
-    socketState->pos     = pos;
-    socketState->msec    = getMSecTime() + data[0].i;
+  ActionSocketData* socketState = NULL;
+  /* Without a socket state to remember the hang, sleep as on a blocking socket */
+  if (!IS_BLOCKING(si, state) && (state->direction & Data) && !state->done
+      && (socketState = ActionSocketData_get(si, state->queue)) != NULL) {
+    ActionSocketData_hang(socketState, si, state->direction, pos, data[0].i);
     state->aborted = true;
     state->err     = EAGAIN;
     state->result  = -1;
@@ -68,8 +67,8 @@ bool ActionHang_perform(int pos, ActionData* data, SocketInfo* si,
   }
 }
 
-static void ActionHang_write(char** buffer,  ActionData* data) {
-  *buffer += sprintf(*buffer, "hang %d ", data[0].i);
+static void ActionHang_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "hang %d ", data[0].i);
 }
 
 void ActionHang_register(ActionTaskDefinition* definition) {
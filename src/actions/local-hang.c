@@ -43,8 +43,8 @@ static bool ActionLocalHang_argument(const char** from, void* dest,
   return Parse_int(from, &data[0].i, NULL, status);
 }
 
-static void ActionLocalHang_write(char** buffer,  ActionData* data) {
-  *buffer += sprintf(*buffer, "local-hang %d ", data[0].i);
+static void ActionLocalHang_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "local-hang %d ", data[0].i);
 }
 
 static bool ActionLocalHang_perform(int pos, ActionData* data,
@@ -62,7 +62,16 @@ static bool ActionLog_argument(const char** from, void* dest,
 bool ActionLog_perform(int pos, ActionData* data, SocketInfo* si,
                        ActionCallData* state) {
   FILE* file;
+  char addr[IP_ADDRESS_STRLEN];
+  char ends[2 * SOCKET_PATH_MAX + IP_ADDRESS_STRLEN + 32];
 
+  if (si->paths) {
+    (void)snprintf(ends, sizeof(ends), "unix:[%s]:[%s]", si->paths->local, si->paths->remote);
+  } else {
+    (void)IPAddress_format(&si->remote.addr, addr);
+    (void)snprintf(ends, sizeof(ends), "%s:%d:[%s]:%d", si->proto & AP_TCP ? "tcp" : "udp",
+                   si->local.port, addr, si->remote.port);
+  }
   pthread_mutex_lock(&data[2].mtx);
   file = (FILE*)data[0].p;
   if (data[1].str == NULL) {
@@ -83,18 +92,13 @@ bool ActionLog_perform(int pos, ActionData* data, SocketInfo* si,
 
   fprintf(file, "[ts %llu] [line %d] ", (long long unsigned int)getMSecTime(), pos);
   if (state->direction == Reading) {
-    fprintf(file, "read %s:%d:[%d.%d.%d.%d]:%d length=%zu\n",
-                  si->proto & AP_TCP ? "tcp" : "udp", si->local.port,
-                  SHOW_ADDR(si->remote.addr), si->remote.port, READ_BUFFER_LENGTH(state));
+    fprintf(file, "read %s length=%zu\n", ends, READ_BUFFER_LENGTH(state));
   } else if (state->direction == Writing) {
-    fprintf(file, "write %s:%d:[%d.%d.%d.%d]:%d length=%zu\n",
-                  si->proto & AP_TCP ? "tcp" : "udp", si->local.port,
-                  SHOW_ADDR(si->remote.addr), si->remote.port, READ_BUFFER_LENGTH(state));
+    fprintf(file, "write %s length=%zu\n", ends, READ_BUFFER_LENGTH(state));
   } else {
-    fprintf(file, "%s %s:%d:[%d.%d.%d.%d]:%d\n",
-                  state->direction == Connecting ? "connect" : "close",
-                  si->proto & AP_TCP ? "tcp" : "udp", si->local.port,
-                  SHOW_ADDR(si->remote.addr), si->remote.port);
+    fprintf(file, "%s %s\n",
+                  state->direction == Connecting ? "connect"
+                  : state->direction == Accepting ? "accept" : "close", ends);
   }
 
   fflush(file);
@@ -102,8 +106,8 @@ bool ActionLog_perform(int pos, ActionData* data, SocketInfo* si,
   return true;
 }
 
-static void ActionLog_write(char** buffer,  ActionData* data) {
-  *buffer += sprintf(*buffer, "log %s ", data[1].str ? data[1].str : "-");
+static void ActionLog_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "log %s ", data[1].str ? data[1].str : "-");
 }
 
 static void ActionLog_close(ActionData* data) {
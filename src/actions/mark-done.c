@@ -49,8 +49,8 @@ static bool ActionMarkDone_argument(const char** from, void* dest,
   return false;
 }
 
-static void ActionMarkDone_write(char** buffer, ActionData* data) {
-  *buffer += sprintf(*buffer, "mark-done %s %d ", data[0].i == 1 ? "call" : "socket",
+static void ActionMarkDone_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "mark-done %s %d ", data[0].i == 1 ? "call" : "socket",
                      data[1].i);
 }
 
@@ -58,11 +58,13 @@ static bool ActionMarkDone_perform(int pos, ActionData* data, SocketInfo* si,
                                  ActionCallData* state) {
   const int line = data[1].i;
   if (data[0].i == 1) {
-    (void)LigHT_put(state->calledLines, line, (void*)"OK", true, false);
+    ActionLineSet_add(&state->calledLines, line);
   } else {
     struct ActionSocketData* socketState;
-    socketState = ActionSocketData_get(si, state->queue);
-    (void)LigHT_put(socketState->calledLines, line, (void*)"OK", true, true);
+    if ((socketState = ActionSocketData_get(si, state->queue)) == NULL) {
+      return Action_error("Can't allocate the state of the socket");
+    }
+    ActionSocketData_markDone(socketState, state->queue, line);
   }
   return true;
 }
@@ -41,8 +41,8 @@ static bool ActionRemoteHang_argument(const char** from, void* dest,
   return Parse_int(from, &data[0].i, NULL, status);
 }
 
-static void ActionRemoteHang_write(char** buffer,  ActionData* data) {
-  *buffer += sprintf(*buffer, "remote-hang %d ", data[0].i);
+static void ActionRemoteHang_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "remote-hang %d ", data[0].i);
 }
 
 void ActionRemoteHang_register(ActionTaskDefinition* definition) {
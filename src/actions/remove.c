@@ -42,8 +42,8 @@ static bool ActionRemove_argument(const char** from, void* dest,
   return Parse_int(from, &data[0].i, NULL, status);
 }
 
-static void ActionRemove_write(char** buffer, ActionData* data) {
-  *buffer += sprintf(*buffer, "remove %d ", data[0].i);
+static void ActionRemove_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "remove %d ", data[0].i);
 }
 
 static bool ActionRemove_perform(int pos, ActionData* data, SocketInfo* si,
@@ -133,8 +133,8 @@ static bool ActionReplay_perform(int pos, ActionData* data, SocketInfo* si,
   return true;
 }
 
-static void ActionReplay_write(char** buffer,  ActionData* data) {
-  *buffer += sprintf(*buffer, "replay %s ", data[1].str);
+static void ActionReplay_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "replay %s ", data[1].str);
 }
 
 static void ActionReplay_close(ActionData* data) {
@@ -152,4 +152,6 @@ void ActionReplay_register(ActionTaskDefinition* definition) {
   definition->perform  = ActionReplay_perform;
   definition->write    = ActionReplay_write;
   definition->close    = ActionReplay_close;
+  definition->usesData = true;
+  definition->beforeCall = true;
 }
@@ -59,4 +59,5 @@ void ActionReset_register(ActionTaskDefinition* definition) {
   definition->perform  = ActionReset_perform;
   definition->write    = NULL;
   definition->close    = NULL;
+  definition->beforeCall = true;
 }
@@ -78,7 +78,11 @@ static bool ActionSplit_perform(int pos, ActionData* data, SocketInfo* si,
     ActionSyscall_perform(pos, data, si, state);
     if (state->result == (ssize_t)first) {
       state->done = false;
-      state->buf = (void*)((uint8_t*)state->buf + first);
+      if (buf) {
+        state->buf = (void*)((uint8_t*)state->buf + first);
+      } else {
+        state->iovOffset = first;
+      }
       state->len  = len - first;
       ActionSyscall_perform(pos, data, si, state);
       if (state->result != -1) {
@@ -89,14 +93,15 @@ static bool ActionSplit_perform(int pos, ActionData* data, SocketInfo* si,
     }
     state->buf = bufbackup;
     state->len = lenbackup;
+    state->iovOffset = 0;
     return true;
   } else {
     return false;
   }
 }
 
-static void ActionSplit_write(char** buffer,  ActionData* data) {
-  *buffer += sprintf(*buffer, "split %d ", data[0].i);
+static void ActionSplit_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "split %d ", data[0].i);
 }
 
 void ActionSplit_register(ActionTaskDefinition* definition) {
@@ -106,4 +111,5 @@ void ActionSplit_register(ActionTaskDefinition* definition) {
   definition->perform  = ActionSplit_perform;
   definition->write    = ActionSplit_write;
   definition->close    = NULL;
+  definition->beforeCall = true;
 }
@@ -43,16 +43,15 @@ bool ActionSyscall_perform(int pos, ActionData* data, SocketInfo* si,
   if (state->aborted) {
     return Action_error("Performing syscall while call aborted");
   }
-  state->result = state->callback(si->fd, READ_BUFFER(state), READ_BUFFER_LENGTH(state),
-                                          state->flags, state->data);
+  state->result = ActionCallData_syscall(state, si->fd);
   state->err = errno;
   if (state->result >= 0) {
-    if (state->buf) {
+    if (state->buf || state->iov || state->splice) {
       state->len = state->result;
     }
     state->origLen = state->result;
   } else {
-    if (state->buf) {
+    if (state->buf || state->iov || state->splice) {
       state->len = 0;
     }
     state->origLen = 0;
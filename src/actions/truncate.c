@@ -59,8 +59,8 @@ bool ActionTruncate_perform(int pos, ActionData* data, SocketInfo* si,
   return true;
 }
 
-static void ActionTruncate_write(char** buffer,  ActionData* data) {
-  *buffer += sprintf(*buffer, "trucate %d ", data[0].i);
+static void ActionTruncate_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "trucate %d ", data[0].i);
 }
 
 void ActionTruncate_register(ActionTaskDefinition* definition) {
@@ -70,4 +70,5 @@ void ActionTruncate_register(ActionTaskDefinition* definition) {
   definition->perform  = ActionTruncate_perform;
   definition->write    = ActionTruncate_write;
   definition->close    = NULL;
+  definition->beforeCall = true;
 }
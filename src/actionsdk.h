@@ -36,13 +36,16 @@
 #include <fcntl.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/time.h>
 #include <stdio.h> /* Not explicitely needed, most writers need this. */
 #include <pthread.h>
 
+#include "clock.h"
+#include "random.h"
+#include "payload.h"
 #include "parser.h"
 #include "socketinfo.h"
-#include "ligHT.h"
 #include "actions.h"
 
 /** @defgroup ActionDK Action Development Kit
@@ -91,18 +94,62 @@ typedef bool (ActionPerformer)(int pos, ActionData* data,
  * @param si        Socket informations.
  * @param direction Data transit direction.
  * @param matched   true if a rule has already been matched.
+ * @param state     Call data, NULL out of a call or while the data of the
+ *                  call is not known yet. A condition looking at the call
+ *                  or its data must match when it is NULL, it is checked
+ *                  again once the call data is available.
  * @return true if the condition match given parameters.
  */
 typedef bool (ActionMatcher)(ActionData* data, SocketInfo* si,
-                             SocketInfoDirection direction, bool matched);
+                             SocketInfoDirection direction, bool matched,
+                             ActionCallData* state);
+
+/** Callback to list the payloads searched in the data by a condition.
+ *
+ * The payloads of all the rules are compiled together in the scanner of
+ * the queue (see ActionCallData_contains).
+ *
+ * @param data     Data associated with the given condition.
+ * @param payloads Receive the payloads.
+ * @param max      Size of the payloads array.
+ * @return The number of payloads of the condition.
+ */
+typedef int (ActionPayloadLister)(ActionData* data, const Payload** payloads, int max);
+
+/** Callback to count a call in the data of a condition.
+ *
+ * It is called after each successful data call on the sockets the rule of
+ * the condition may match, while a rule reads the counters.
+ *
+ * @param data      Data associated with the given condition.
+ * @param si        Socket informations.
+ * @param direction Data transit direction (Reading or Writing).
+ * @param bytes     Bytes transferred by the call.
+ */
+typedef void (ActionCounter)(ActionData* data, SocketInfo* si,
+                             SocketInfoDirection direction, uint64_t bytes);
 
 /** Callback to print the action to the given buffer.
  *
  * @param buffer  Destination buffer. The pointer must point after the last
  *                written character after the call.
+ * @param end     End of the buffer, nothing is written from there (see
+ *                Action_print).
  * @param data    Data associated with the given element.
  */
-typedef void (ActionWriter)(char** buffer, ActionData* data);
+typedef void (ActionWriter)(char** buffer, const char* end, ActionData* data);
+
+/** Append a formatted string to a buffer.
+ *
+ * The output is truncated to the buffer, which stays null-terminated: once
+ * it is full, the following writes are ignored.
+ *
+ * @param buffer Destination buffer, moved after the written characters.
+ * @param end    End of the buffer.
+ * @param format Format of the string, as for printf.
+ */
+void Action_print(char** buffer, const char* end, const char* format, ...)
+  __attribute__((format(printf, 3, 4)));
 
 /** Register an action.
  *
@@ -141,8 +188,22 @@ union ActionData {
 struct ActionCondition {
   enum ActionConditionType type;  /**< Condition type. */
   union ActionData data[16];      /**< Condition params. */
+  bool usesData;                  /**< True if the condition looks at the data. */
+  bool usesCall;                  /**< True if the condition looks at the call state. */
+  bool countsCalls;               /**< True if the condition reads the call counters. */
 };
 
+/** Relative cost of a condition.
+ *
+ * The operands of a composite condition are checked the cheapest first.
+ */
+typedef enum ActionCost {
+  ACC_Static, /**< Only reads the socket or the call. */
+  ACC_Clock,  /**< Reads the clock. */
+  ACC_Random, /**< Draws a random number. */
+  ACC_Data    /**< Looks at the data (implied by usesData). */
+} ActionCost;
+
 /** Define the callbacks needed to parse and process a condition.
  */
 struct ActionConditionDefinition {
@@ -153,6 +214,15 @@ struct ActionConditionDefinition {
   ActionMatcher*   match;     /**< Match the situation. */
   ActionWriter*    write;     /**< Write the condition to the given buffer. */
   ActionCloser*    close;     /**< Close the condition and remove all associated date. */
+  ActionPayloadLister* payloads; /**< List the payloads of the condition (NULL if none). */
+  ActionCost       cost;      /**< Cost of the condition. */
+  bool             usesData;  /**< True if the condition looks at the data. */
+  bool             usesCall;  /**< True if the condition looks at the call state, but not
+                                   at the data (see ActionMatcher). */
+  bool             countsCalls; /**< True if the condition reads the call counters of the
+                                     socket (see SocketInfoCounters). */
+  ActionCounter*   count;     /**< Count the calls in the condition data (NULL if none,
+                                   countsCalls must be set otherwise). */
 };
 
 /** Action task.
@@ -172,19 +242,204 @@ struct ActionTaskDefinition {
   ActionPerformer* perform;   /**< Perform the corresponding action. */
   ActionWriter*    write;     /**< Write the action to the given buffer. */
   ActionCloser*    close;     /**< Close the action and remove all associated date. */
+  bool             usesData;  /**< True if the action reads or edits the data. */
+  bool             beforeCall; /**< True if the action must run before the syscall. */
 };
 
+/** Comparison operators of the counter conditions.
+ */
+typedef enum ActionComparison {
+  ACMP_Less,         /**< &lt; */
+  ACMP_LessEqual,    /**< &lt;= */
+  ACMP_Equal,        /**< == */
+  ACMP_NotEqual,     /**< != */
+  ACMP_GreaterEqual, /**< &gt;= */
+  ACMP_Greater       /**< &gt; */
+} ActionComparison;
+
+/** Parse a comparison with a value (eg. <code>&gt; 1048576</code>).
+ *
+ * The operator is stored in data[0].i and the value in data[1].ul.
+ *
+ * @param from       Pointer to the source, moved after the value.
+ * @param dest       The data of the condition.
+ * @param constraint Unused.
+ * @param status     Parse status.
+ * @return true on success.
+ */
+bool ActionComparison_parse(const char** from, void* dest, const void* constraint,
+                            ParserStatus* status);
+
+/** Write a comparison read by ActionComparison_parse.
+ *
+ * @param buffer Destination buffer, moved after the written characters.
+ * @param end    End of the buffer.
+ * @param data   The data of the condition.
+ */
+void ActionComparison_write(char** buffer, const char* end, const ActionData* data);
+
+/** Compare a value with the value of a comparison.
+ *
+ * @param data  The data of the condition (see ActionComparison_parse).
+ * @param value The value.
+ * @return true if the comparison holds.
+ */
+static inline bool ActionComparison_test(const ActionData* data, uint64_t value) {
+  switch ((ActionComparison)data[0].i) {
+   case ACMP_Less:         return value <  data[1].ul;
+   case ACMP_LessEqual:    return value <= data[1].ul;
+   case ACMP_Equal:        return value == data[1].ul;
+   case ACMP_NotEqual:     return value != data[1].ul;
+   case ACMP_GreaterEqual: return value >= data[1].ul;
+   case ACMP_Greater:      return value >  data[1].ul;
+  }
+  return false;
+}
+
+/** Scope of the window of a rate condition.
+ */
+typedef enum ActionRateScope {
+  ARS_Socket, /**< Calls of the socket. */
+  ARS_Peer,   /**< Calls of all the connections with the remote host. */
+  ARS_Rule    /**< Calls of all the sockets the rule may match. */
+} ActionRateScope;
+
+/** Parse the argument of a rate condition
+ * (eg. <code>per peer &gt; 5k/s</code>).
+ *
+ * The comparison is stored as by ActionComparison_parse, the scope in
+ * data[2].i and the window of a rule scope in data[3].p, allocated by the
+ * first call counted by ActionRate_count. The value may have
+ * a K, M or G multiplier (powers of 1000), followed by the unit given as
+ * constraint if any, and must end with <code>/s</code>.
+ *
+ * @param from       Pointer to the source, moved after the argument.
+ * @param dest       The data of the condition.
+ * @param constraint The unit of the value (a string), or NULL.
+ * @param status     Parse status.
+ * @return true on success.
+ */
+bool ActionRate_parse(const char** from, void* dest, const void* constraint,
+                      ParserStatus* status);
+
+/** Write the argument of a rate condition.
+ *
+ * @param buffer Destination buffer, moved after the written characters.
+ * @param end    End of the buffer.
+ * @param data   The data of the condition.
+ */
+void ActionRate_write(char** buffer, const char* end, const ActionData* data);
+
+/** Get the window of a rate condition for a socket.
+ *
+ * @param data The data of the condition.
+ * @param si   The socket.
+ * @return The window, NULL if the socket has none.
+ */
+static inline const RateWindow* ActionRate_window(const ActionData* data, const SocketInfo* si) {
+  switch ((ActionRateScope)data[2].i) {
+   case ARS_Peer: return si->counters.peer;
+   case ARS_Rule: return (const RateWindow*)data[3].p;
+   default:       return &si->counters.rate;
+  }
+}
+
+/** Count a call in the window of a rate condition with a rule scope,
+ * allocating the window if needed.
+ */
+ActionCounter ActionRate_count;
+
+/** Release the window of a rate condition.
+ */
+ActionCloser ActionRate_close;
+
+/** Check a composite condition (see @ref ActionExpression).
+ */
+ActionMatcher ActionExpression_match;
+
+/** Write a composite condition.
+ */
+ActionWriter ActionExpression_write;
+
+/** Release a composite condition.
+ */
+ActionCloser ActionExpression_close;
+
+/** List the payloads of the operands of a composite condition.
+ */
+ActionPayloadLister ActionExpression_payloads;
+
+/** Count a call in the operands of a composite condition.
+ */
+ActionCounter ActionExpression_count;
+
+/** Set of lines of an action queue.
+ */
+typedef struct ActionLineSet {
+  uint64_t bits[ACTION_MAX_LINES / 64]; /**< One bit per line. */
+} ActionLineSet;
+
+/** Empty a set of lines.
+ *
+ * @param set The set.
+ */
+static inline void ActionLineSet_clear(ActionLineSet* set) {
+  memset(set->bits, 0, sizeof(set->bits));
+}
+
+/** Add a line to a set of lines.
+ *
+ * @param set  The set.
+ * @param line The line (ignored if out of range).
+ */
+static inline void ActionLineSet_add(ActionLineSet* set, int line) {
+  if (line >= 0 && line < ACTION_MAX_LINES) {
+    set->bits[line >> 6] |= UINT64_C(1) << (line & 63);
+  }
+}
+
+/** Remove a line from a set of lines.
+ *
+ * @param set  The set.
+ * @param line The line (ignored if out of range).
+ */
+static inline void ActionLineSet_remove(ActionLineSet* set, int line) {
+  if (line >= 0 && line < ACTION_MAX_LINES) {
+    set->bits[line >> 6] &= ~(UINT64_C(1) << (line & 63));
+  }
+}
+
+/** Check if a line is in a set of lines.
+ *
+ * @param set  The set.
+ * @param line The line.
+ * @return true if the line belongs to the set.
+ */
+static inline bool ActionLineSet_contains(const ActionLineSet* set, int line) {
+  if (line < 0 || line >= ACTION_MAX_LINES) {
+    return false;
+  }
+  return (set->bits[line >> 6] >> (line & 63)) & 1;
+}
+
 /** CallData
  */
 struct ActionCallData {
   ActionQueue* queue;      /**< The processed queue. */
+  const struct ActionSnapshot* snapshot; /**< The rules used by the call. */
 
   /* Sys call data */
   Action_syscall* callback;/**< The callback. */
+  Action_vsyscall* vcallback; /**< The callback for vectored calls. */
   void* origBuf;           /**< Original user buffer. */
   size_t origLen;          /**< User buffer length. */
+  const struct iovec* iov; /**< User vectors (NULL if not a vectored call). */
+  int iovcnt;              /**< Number of user vectors. */
+  size_t iovOffset;        /**< Offset of the data in the vectors. */
+  ActionSplice* splice;    /**< Other end of the call (NULL if the data is in memory). */
+  size_t spliced;          /**< Data already moved on the other end of the call. */
   void* buf;               /**< Buffer for the callback. */
-  size_t len;              /**< Length of the buffer. */
+  size_t len;              /**< Length of the buffer (or of the vectored data). */
   int flags;               /**< Call flags. */
   void* data;              /**< Data for the syscall. */
   SocketInfoDirection direction; /**< Data direction (Reading|Writing) */
@@ -192,7 +447,10 @@ struct ActionCallData {
   /* Processing status */
   bool aborted;            /**< If true, indicates that the syscall has been aborted. */
   bool done;               /**< If true, indicates that hte syscall has been done. */
-  LigHT* calledLines;      /**< LigHT which mark all line executed in the current call. */
+  ActionLineSet calledLines; /**< Lines executed in the current call. */
+  PayloadScan scan;        /**< Payloads found in the data (scan.scanner is NULL
+                                if the data has not been scanned since it changed). */
+  uint64_t found[PAYLOAD_SCANNER_MAX / 64]; /**< Result bits of the scan. */
 
   /* Result */
   bool keepError;          /**< Don't remember what this stand for o_O */
@@ -203,13 +461,22 @@ struct ActionCallData {
 /** Data to be stored as context associated with a socket.
  */
 struct ActionSocketData {
-  LigHT* calledLines; /**< List line called. */
-  bool   hanging;     /**< If true indicates that the socket is currently hanging asynchronously.
-                           This only affect read operations. */
-  uint64_t msec;      /**< Start time of the timer. */
-  int      pos;       /**< Line of the instruction requesting the hang. */
+  struct ActionCandidates* volatile candidates[ACTION_DIRECTIONS]; /**< Rules that may match the socket, per direction. */
+  uint64_t done;      /**< Done flags of the first 64 do-once-per-socket lines. */
+  uint64_t* volatile moreDone; /**< Done flags of the other lines (allocated on demand). */
+  uint64_t until[2];  /**< End of the asynchronous hang on the precise clock, per direction (see HANG_SLOT). */
+  int      pos[2];    /**< Line of the instruction requesting the hang, per direction. */
+  volatile unsigned int hanging; /**< Directions (Reading|Writing) currently hanging
+                                      asynchronously. */
+  bool     listed;    /**< True if the socket is in the list of the hanging sockets. */
 };
 
+/** Index of a data direction in the hang fields of ActionSocketData.
+ *
+ * @param direction Reading or Writing.
+ */
+#define HANG_SLOT(direction) ((direction) == Writing ? 1 : 0)
+
 /** Check if a call is blocking.
  *
  * @param si Informations about the socket.
@@ -230,14 +497,18 @@ struct ActionSocketData {
  * @param state Informations about the call.
  * @return the current valid buffer length.
  */
-#define READ_BUFFER_LENGTH(state) ((state)->buf ? (state)->len : (state)->origLen)
+#define READ_BUFFER_LENGTH(state) ((state)->buf || (state)->iov || (state)->splice \
+                                   ? (state)->len : (state)->origLen)
 
-/** Build the list of arguments for printf to show an ipv4 address.
+/** Check if the data of the call is still described by the user vectors.
+ *
+ * In that case, READ_BUFFER is NULL and the data must be accessed using
+ * ActionCallData_view.
  *
- * @param addr the address
+ * @param state Informations about the call.
+ * @return true if the call is vectored and no buffer has been materialized.
  */
-#define SHOW_ADDR(addr) ((addr) >> 24) & 0xff, ((addr) >> 16) & 0xff, \
-                        ((addr) >> 8)  & 0xff, (addr) & 0xff
+#define IS_VECTORED(state) ((state)->iov != NULL && (state)->buf == NULL)
 
 /** Print an error message.
  *
@@ -247,14 +518,97 @@ struct ActionSocketData {
 bool Action_error(const char* message);
 
 /** Fetch socket infos from.
+ *
+ * The data is allocated by the first call.
+ *
+ * @return The data associated with the socket, or NULL if it can't be allocated.
  */
 ActionSocketData* ActionSocketData_get(SocketInfo*si, ActionQueue* queue);
 
+/** Check if a do-once-per-socket line has already been done on a socket.
+ *
+ * @param data  The socket data.
+ * @param queue The queue.
+ * @param line  The line.
+ * @return true if the line has been marked as done.
+ */
+bool ActionSocketData_isDone(ActionSocketData* data, ActionQueue* queue, int line);
+
+/** Mark a line as done on a socket.
+ *
+ * @param data  The socket data.
+ * @param queue The queue.
+ * @param line  The line.
+ */
+void ActionSocketData_markDone(ActionSocketData* data, ActionQueue* queue, int line);
+
+/** Make a non-blocking socket hang asynchronously.
+ *
+ * The calls in the given direction fail with EAGAIN until the end of the
+ * hang, then the processing resumes from the given line. The socket is
+ * also masked from the readiness notifications (poll, select, epoll) until
+ * the end of the hang.
+ *
+ * @param data      The socket data.
+ * @param si        The socket.
+ * @param direction Reading or Writing.
+ * @param pos       The line requesting the hang.
+ * @param msec      Duration of the hang in milliseconds.
+ */
+void ActionSocketData_hang(ActionSocketData* data, SocketInfo* si,
+                           SocketInfoDirection direction, int pos, int msec);
+
 /** Prepare the call data for data edition.
+ *
+ * For vectored calls, this gathers the data of the call in a contiguous
+ * buffer (nothing is copied for a read not performed yet). For spliced calls,
+ * the data to send is read from the other file descriptor, this fails once
+ * the data has been moved by the kernel, and the call is shortened to a
+ * bounded chunk of data. The buffer is taken from the thread arena and
+ * released at the end of the processing.
  */
 bool ActionCallData_prepareBuffer(ActionCallData* data);
 
+/** Get the vectors describing the data of the call.
+ *
+ * The vectors start at the data of the call (after the offset of a split
+ * vectored call) and cover READ_BUFFER_LENGTH bytes at most.
+ *
+ * @param data   Call data.
+ * @param single Storage for the vector when the data is contiguous.
+ * @param count  Receive the number of vectors.
+ * @return The vectors.
+ */
+const struct iovec* ActionCallData_view(ActionCallData* data, struct iovec* single,
+                                        int* count);
+
+/** Check if the patterns of a payload appear in the data of the call.
+ *
+ * The data of a read is only known once the system call has been done, so
+ * the call is performed if needed. The data is scanned once for all the
+ * payloads of the queue, further checks only look at the result until the
+ * data changes.
+ *
+ * @param data    Call data (NULL if not known yet).
+ * @param si      The socket.
+ * @param payload The payload.
+ * @return true if one of the patterns appears in the data, or if the data
+ *         is not known yet.
+ */
+bool ActionCallData_contains(ActionCallData* data, SocketInfo* si, const Payload* payload);
+
+/** Perform the system call on the current buffer.
+ *
+ * @param data  Call data.
+ * @param fd    File descriptor.
+ * @return The result of the system call.
+ */
+ssize_t ActionCallData_syscall(ActionCallData* data, int fd);
+
 /** Get current time with millisecond precision.
+ *
+ * This is the wall clock: it only stamps the records (log, dump). Rules
+ * measure time on the monotonic clock (see @ref Clock).
  *
  * @return Current time in millisecond since EPOCH
  */
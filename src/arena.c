@@ -0,0 +1,223 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "arena.h"
+
+/** Alignment of the allocations.
+ */
+#define ARENA_ALIGN 16
+
+/** Size of the smallest block (as a power of 2).
+ */
+#define ARENA_MIN_SHIFT 12
+
+/** Number of block size classes (4 KB to 1 MB).
+ */
+#define ARENA_CLASSES 9
+
+#if (1 << (ARENA_MIN_SHIFT + ARENA_CLASSES - 1)) != ARENA_LARGEST_BLOCK
+#error "ARENA_LARGEST_BLOCK does not match the size classes"
+#endif
+
+/** Number of free blocks kept per size class.
+ */
+#define ARENA_KEEP 4
+
+/** Round a size to the alignment of the arena.
+ */
+#define ARENA_ROUND(size) (((size) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+/** A block of memory.
+ */
+struct ArenaBlock {
+  struct ArenaBlock* next; /**< Previous block of the thread, or next free block. */
+  size_t size;             /**< Usable size of the block. */
+  size_t used;             /**< Bytes already allocated. */
+  int    sizeClass;        /**< Size class of the block (-1 if oversized). */
+};
+
+/** Size of the block header.
+ */
+#define ARENA_HEADER ARENA_ROUND(sizeof(struct ArenaBlock))
+
+/** Arena of a thread.
+ */
+struct ArenaThread {
+  struct ArenaBlock* top;                  /**< Block currently used. */
+  struct ArenaBlock* free[ARENA_CLASSES];  /**< Free blocks by size class. */
+  int    freeCount[ARENA_CLASSES];         /**< Number of free blocks by class. */
+  size_t inUse;                            /**< Bytes currently allocated. */
+  size_t peak;                             /**< High-water mark of the thread. */
+  int    registered;                       /**< True if the exit callback is set. */
+};
+
+static volatile size_t highWater = 0;
+
+static pthread_once_t keyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t  key;
+static __thread struct ArenaThread self;
+
+static void Arena_threadExit(void* data) {
+  struct ArenaThread* thread = (struct ArenaThread*)data;
+  int i;
+
+  while (thread->top) {
+    struct ArenaBlock* block = thread->top;
+    thread->top = block->next;
+    free(block);
+  }
+  for (i = 0 ; i < ARENA_CLASSES ; ++i) {
+    while (thread->free[i]) {
+      struct ArenaBlock* block = thread->free[i];
+      thread->free[i] = block->next;
+      free(block);
+    }
+    thread->freeCount[i] = 0;
+  }
+  thread->inUse = 0;
+}
+
+static void Arena_keyInit(void) {
+  (void)pthread_key_create(&key, Arena_threadExit);
+}
+
+/** Get the arena of the current thread, registering it if needed.
+ */
+static inline struct ArenaThread* Arena_self(void) {
+  if (!self.registered) {
+    pthread_once(&keyOnce, Arena_keyInit);
+    (void)pthread_setspecific(key, &self);
+    self.registered = 1;
+  }
+  return &self;
+}
+
+/** Get a block with at least size usable bytes.
+ */
+static struct ArenaBlock* Arena_newBlock(struct ArenaThread* thread, size_t size) {
+  struct ArenaBlock* block;
+  int sizeClass = 0;
+
+  while (sizeClass < ARENA_CLASSES
+         && ((size_t)1 << (ARENA_MIN_SHIFT + sizeClass)) - ARENA_HEADER < size) {
+    ++sizeClass;
+  }
+  if (sizeClass >= ARENA_CLASSES) {
+    block = (struct ArenaBlock*)malloc(ARENA_HEADER + size);
+    if (block == NULL) {
+      return NULL;
+    }
+    block->size      = size;
+    block->sizeClass = -1;
+  } else if (thread->free[sizeClass]) {
+    block = thread->free[sizeClass];
+    thread->free[sizeClass] = block->next;
+    --thread->freeCount[sizeClass];
+  } else {
+    block = (struct ArenaBlock*)malloc((size_t)1 << (ARENA_MIN_SHIFT + sizeClass));
+    if (block == NULL) {
+      return NULL;
+    }
+    block->size      = ((size_t)1 << (ARENA_MIN_SHIFT + sizeClass)) - ARENA_HEADER;
+    block->sizeClass = sizeClass;
+  }
+  block->used = 0;
+  return block;
+}
+
+/** Give a block back to the free lists of the thread.
+ */
+static inline void Arena_freeBlock(struct ArenaThread* thread, struct ArenaBlock* block) {
+  if (block->sizeClass < 0 || thread->freeCount[block->sizeClass] >= ARENA_KEEP) {
+    free(block);
+    return;
+  }
+  block->next = thread->free[block->sizeClass];
+  thread->free[block->sizeClass] = block;
+  ++thread->freeCount[block->sizeClass];
+}
+
+ArenaMark Arena_mark(void) {
+  struct ArenaThread* thread = Arena_self();
+  ArenaMark mark;
+
+  mark.block = thread->top;
+  mark.used  = thread->top ? thread->top->used : 0;
+  mark.inUse = thread->inUse;
+  return mark;
+}
+
+void* Arena_alloc(size_t size) {
+  struct ArenaThread* thread = Arena_self();
+  struct ArenaBlock*  block  = thread->top;
+  void* ptr;
+
+  size = ARENA_ROUND(size > 0 ? size : 1);
+  if (block == NULL || block->size - block->used < size) {
+    block = Arena_newBlock(thread, size);
+    if (block == NULL) {
+      return NULL;
+    }
+    block->next = thread->top;
+    thread->top = block;
+  }
+  ptr = (char*)block + ARENA_HEADER + block->used;
+  block->used   += size;
+  thread->inUse += size;
+  if (thread->inUse > thread->peak) {
+    size_t old;
+    thread->peak = thread->inUse;
+    while (thread->peak > (old = highWater)
+           && !__sync_bool_compare_and_swap(&highWater, old, thread->peak));
+  }
+  return ptr;
+}
+
+void Arena_release(ArenaMark mark) {
+  struct ArenaThread* thread = &self;
+
+  while (thread->top && thread->top != mark.block) {
+    struct ArenaBlock* block = thread->top;
+    thread->top = block->next;
+    Arena_freeBlock(thread, block);
+  }
+  if (thread->top) {
+    thread->top->used = mark.used;
+  }
+  thread->inUse = mark.inUse;
+}
+
+size_t Arena_highWater(void) {
+  return highWater;
+}
@@ -0,0 +1,93 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+/** @defgroup Arena Thread local arena
+ *
+ * The arena is a per-thread bump allocator for the short-lived buffers of an
+ * intercepted call. The memory is never freed object by object: the caller
+ * takes a mark before allocating and releases everything allocated since the
+ * mark at once. Marks can be nested as long as they are released in reverse
+ * order.
+ *
+ * Released blocks are kept in size-classed free lists of the thread, so a
+ * steady stream of calls does not hit malloc anymore. @{
+ */
+
+/** Size of the largest block kept in the free lists.
+ *
+ * Bigger allocations always go to malloc.
+ */
+#define ARENA_LARGEST_BLOCK (1024 * 1024)
+
+/** A position in the arena of the current thread.
+ */
+typedef struct ArenaMark {
+  void*  block;  /**< Current block when the mark was taken. */
+  size_t used;   /**< Bytes used in that block. */
+  size_t inUse;  /**< Bytes allocated by the thread. */
+} ArenaMark;
+
+/** Remember the current position of the arena of the calling thread.
+ *
+ * @return The mark.
+ */
+ArenaMark Arena_mark(void);
+
+/** Allocate memory from the arena of the calling thread.
+ *
+ * The memory is 16 bytes aligned and is valid until the release of a mark
+ * taken before the allocation.
+ *
+ * @param size Size of the memory.
+ * @return The memory or NULL if the memory is exhausted.
+ */
+void* Arena_alloc(size_t size);
+
+/** Release all the memory allocated since the given mark.
+ *
+ * @param mark A mark taken by the calling thread.
+ */
+void Arena_release(ArenaMark mark);
+
+/** Get the largest amount of memory used at once by an arena.
+ *
+ * @return The high-water mark in bytes, over all the threads.
+ */
+size_t Arena_highWater(void);
+
+/** @} */
+
+#endif
@@ -33,19 +33,34 @@
 
 #include <dlfcn.h>
 #include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/select.h>
+#include <sys/sendfile.h>
 #include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
-
-#include "ligHT.h"
+#include <stdarg.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+
+#include "binding.h"
+#include "clock.h"
+#include "random.h"
 #include "socketinfo.h"
+#include "sockettable.h"
 #include "actions.h"
 #include "conffile.h"
 #include "runtime.h"
+#include "arena.h"
 
 #ifndef RTLD_NEXT
 # error "RTLD_NEXT not defined on your system"
@@ -53,13 +68,29 @@
 
 #define DEFAULT_CONFIG "libinject.rules"
 
+/** Maximum number of messages moved by a batched call (UIO_MAXIOV).
+ */
+#define MMSG_MAX 1024
+
+/** Maximum size of the copies of the edited messages kept by a sendmmsg call.
+ */
+#define MMSG_COPY_MAX 65536
+
+#ifndef CLOSE_RANGE_CLOEXEC
+# define CLOSE_RANGE_CLOEXEC (1U << 2)
+#endif
+
+#ifndef EPOLLEXCLUSIVE
+# define EPOLLEXCLUSIVE (1U << 28)
+#endif
+
 void inj_init(void) __attribute__((constructor));
 void inj_fini(void) __attribute__((destructor));
 
 
 /*** Keeping informations about the status of file descriptors */
 
-static LigHT* sockets = NULL;
+static SocketTable* sockets = NULL;
 
 
 /*** Callbacks pointing to the overriden system function */
@@ -70,6 +101,8 @@ typedef ssize_t (recvfun)(int fd, void* buf, size_t len, int flags);
 typedef ssize_t (recvfromfun)(int fd, void* __restrict buf, size_t n, int flags,
                               struct sockaddr* __restrict addr, socklen_t* __restrict addr_len);
 typedef ssize_t (recvmsgfun)(int fd, struct msghdr* message, int flags);
+typedef int (recvmmsgfun)(int fd, struct mmsghdr* vec, unsigned int vlen, int flags,
+                          struct timespec* timeout);
 
 typedef ssize_t (writefun)(int fd, __const void* buf, size_t n);
 typedef ssize_t (writevfun)(int fd, __const struct iovec* iovec, int count);
@@ -77,32 +110,172 @@ typedef ssize_t (sendfun)(int fd, __const void* buf, size_t n, int flags);
 typedef ssize_t (sendtofun)(int fd, __const void* buf, size_t n, int flags,
                             const struct sockaddr* addr, socklen_t addr_len);
 typedef ssize_t (sendmsgfun)(int fd, __const struct msghdr* message, int flags);
+typedef int (sendmmsgfun)(int fd, struct mmsghdr* vec, unsigned int vlen, int flags);
+
+typedef ssize_t (sendfilefun)(int out, int in, off_t* offset, size_t count);
+typedef ssize_t (sendfile64fun)(int out, int in, off64_t* offset, size_t count);
+typedef ssize_t (splicefun)(int in, loff_t* inoff, int out, loff_t* outoff, size_t len,
+                            unsigned int flags);
 
 typedef int (connectfun)(int fd, const struct sockaddr* addr, socklen_t addrlen);
+typedef int (bindfun)(int fd, const struct sockaddr* addr, socklen_t addrlen);
+typedef int (listenfun)(int fd, int backlog);
 typedef ssize_t (closefun)(int fd);
+typedef int (close_rangefun)(unsigned int first, unsigned int last, int flags);
+typedef int (fclosefun)(FILE* stream);
+
+typedef int (openfun)(const char* file, int oflag, ...);
+typedef int (open64fun)(const char* file, int oflag, ...);
+typedef int (openatfun)(int dirfd, const char* file, int oflag, ...);
+typedef int (openat64fun)(int dirfd, const char* file, int oflag, ...);
+typedef int (creatfun)(const char* file, mode_t mode);
+typedef int (pipefun)(int fds[2]);
+typedef int (pipe2fun)(int fds[2], int flags);
+typedef int (socketfun)(int domain, int type, int protocol);
+typedef int (socketpairfun)(int domain, int type, int protocol, int fds[2]);
+typedef int (acceptfun)(int fd, struct sockaddr* __restrict addr,
+                        socklen_t* __restrict addr_len);
+typedef int (accept4fun)(int fd, struct sockaddr* __restrict addr,
+                         socklen_t* __restrict addr_len, int flags);
+typedef int (dupfun)(int fd);
+typedef int (dup2fun)(int fd, int fd2);
+typedef int (dup3fun)(int fd, int fd2, int flags);
+
+typedef int (fcntlfun)(int fd, int cmd, ...);
+typedef int (fcntl64fun)(int fd, int cmd, ...);
+typedef int (ioctlfun)(int fd, unsigned long request, ...);
+
+typedef int (epoll_ctlfun)(int epfd, int op, int fd, struct epoll_event* event);
+typedef int (epoll_waitfun)(int epfd, struct epoll_event* events, int maxevents,
+                            int timeout);
+typedef int (epoll_pwaitfun)(int epfd, struct epoll_event* events, int maxevents,
+                             int timeout, const sigset_t* sigmask);
+typedef int (pollfun)(struct pollfd* fds, nfds_t nfds, int timeout);
+typedef int (ppollfun)(struct pollfd* fds, nfds_t nfds, const struct timespec* timeout,
+                       const sigset_t* sigmask);
+typedef int (selectfun)(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds,
+                        struct timeval* timeout);
 
 static readfun*     sysread = NULL;
 static readvfun*    sysreadv = NULL;
 static recvfun*     sysrecv = NULL;
 static recvfromfun* sysrecvfrom = NULL;
 static recvmsgfun*  sysrecvmsg = NULL;
+static recvmmsgfun* sysrecvmmsg = NULL;
 
 static writefun*    syswrite = NULL;
 static writevfun*   syswritev = NULL;
 static sendfun*     syssend = NULL;
 static sendtofun*   syssendto = NULL;
 static sendmsgfun*  syssendmsg = NULL;
+static sendmmsgfun* syssendmmsg = NULL;
+
+static sendfilefun*   syssendfile = NULL;
+static sendfile64fun* syssendfile64 = NULL;
+static splicefun*     syssplice = NULL;
 
 static connectfun*  sysconnect = NULL;
+static bindfun*     sysbind = NULL;
+static listenfun*   syslisten = NULL;
 static closefun*    sysclose = NULL;
+static close_rangefun* sysclose_range = NULL;
+static fclosefun*   sysfclose = NULL;
+
+static openfun*       sysopen = NULL;
+static open64fun*     sysopen64 = NULL;
+static openatfun*     sysopenat = NULL;
+static openat64fun*   sysopenat64 = NULL;
+static creatfun*      syscreat = NULL;
+static pipefun*       syspipe = NULL;
+static pipe2fun*      syspipe2 = NULL;
+static socketfun*     syssocket = NULL;
+static socketpairfun* syssocketpair = NULL;
+static acceptfun*     sysaccept = NULL;
+static accept4fun*    sysaccept4 = NULL;
+static dupfun*        sysdup = NULL;
+static dup2fun*       sysdup2 = NULL;
+static dup3fun*       sysdup3 = NULL;
+
+static fcntlfun*      sysfcntl = NULL;
+static fcntl64fun*    sysfcntl64 = NULL;
+static ioctlfun*      sysioctl = NULL;
+
+static epoll_ctlfun*   sysepoll_ctl = NULL;
+static epoll_waitfun*  sysepoll_wait = NULL;
+static epoll_pwaitfun* sysepoll_pwait = NULL;
+static pollfun*        syspoll = NULL;
+static ppollfun*       sysppoll = NULL;
+static selectfun*      sysselect = NULL;
 
 static Config* config = NULL;
 
+/** Depth of the bypass sections of the thread.
+ */
+static __thread int bypass = 0;
+
 #define GET_SYSCALL(call)                                                      \
   if (sys ## call == NULL) {                                                   \
     sys ## call = (call ## fun*)dlsym(RTLD_NEXT, # call);                      \
   }
 
+/*** Internal I/O */
+
+void Binding_enter(void) {
+  ++bypass;
+}
+
+void Binding_leave(void) {
+  --bypass;
+}
+
+ssize_t Binding_read(int fd, void* buf, size_t len) {
+  GET_SYSCALL(read)
+  return sysread(fd, buf, len);
+}
+
+ssize_t Binding_write(int fd, const void* buf, size_t len) {
+  GET_SYSCALL(write)
+  return syswrite(fd, buf, len);
+}
+
+ssize_t Binding_peek(int fd, void* buf, size_t len) {
+  ssize_t ret;
+  int fds[2];
+  int flags;
+  int err;
+
+  GET_SYSCALL(pipe2)
+  GET_SYSCALL(read)
+  GET_SYSCALL(close)
+  GET_SYSCALL(fcntl)
+  if ((flags = sysfcntl(fd, F_GETFL)) == -1 || syspipe2(fds, O_CLOEXEC) == -1) {
+    return -1;
+  }
+  /* The private pipe is empty: tee only waits for the data of fd */
+  ret = tee(fd, fds[1], len, (flags & O_NONBLOCK) ? SPLICE_F_NONBLOCK : 0);
+  if (ret > 0) {
+    ret = sysread(fds[0], buf, ret);
+  }
+  err = errno;
+  (void)sysclose(fds[0]);
+  (void)sysclose(fds[1]);
+  errno = err;
+  return ret;
+}
+
+ssize_t Binding_pipeRoom(int fd) {
+  int size;
+  int used;
+
+  GET_SYSCALL(fcntl)
+  GET_SYSCALL(ioctl)
+  if ((size = sysfcntl(fd, F_GETPIPE_SZ)) == -1 || sysioctl(fd, FIONREAD, &used) == -1) {
+    return -1;
+  }
+  return size > used ? size - used : 0;
+}
+
+
 /*** Useful stuff */
 
 /** Data to pass when performing syscalls that fetch addr.
@@ -124,80 +297,159 @@ struct ConstAddrData {
     SocketInfo_unlock(si);                                                     \
   }
 
-/** Get informations about the socket.
+/** Check if a rule may match a call on a socket of the given kind.
  */
-static inline SocketInfo* getInfos(int fd) {
+static inline bool mayMatch(SocketKind kind, SocketInfoDirection direction, int port) {
+  Proto proto = SocketKind_proto(kind);
+  return ActionQueue_mayMatch(config->queue, direction, proto ? proto : AP_All, port);
+}
+
+/** Forget everything known about a file descriptor that may have been reassigned.
+ */
+static inline void forgetInfos(int fd, SocketKind kind) {
+  if (!sockets || fd < 0) {
+    return;
+  }
+  SocketTable_remove(sockets, fd);
+  SocketTable_invalidate(sockets, fd, kind);
+  Action_forgetHanging(fd, fd);
+}
+
+/** Get informations about the socket, whatever its state.
+ *
+ * The remote end of listening sockets and unconnected datagram sockets has
+ * the type AH_None. The wrappers keep the cached socket infos exact, a
+ * cached one is only checked periodically against a reassignment of its file
+ * descriptor that did not go through them (see SocketInfo_isCurrent).
+ */
+static inline SocketInfo* getSocketInfos(int fd, SocketInfoDirection direction) {
   SocketInfo* si = NULL;
-  if (!config || !sockets) {
+  SocketKind kind;
+  unsigned int stamp;
+  if (bypass || !config || !sockets) {
+    return NULL;
+  }
+  kind = SocketTable_kind(sockets, fd, &stamp);
+  if (SocketKind_class(kind) == SK_NotSocket || SocketKind_class(kind) == SK_Unsupported
+      || !mayMatch(kind, direction, -1)) {
     return NULL;
   }
-  si = (SocketInfo*)LigHT_get(sockets, fd, true);
-  si = SocketInfo_check(si, fd);
-  if (si == NULL || si->toDestroy) {
-    if ((si = SocketInfo_init(fd))) {
-      SocketInfo_lock(si);
+  si = SocketTable_get(sockets, fd);
+  if (si) {
+    if (SocketInfo_isCurrent(si)) {
+      return si;
     }
-    (void)LigHT_put(sockets, fd, si, true, true);
+    /* The file descriptor has been reassigned behind the wrappers */
+    SocketInfo_unlock(si);
+    forgetInfos(fd, SK_Unknown);
+    kind = SocketTable_kind(sockets, fd, &stamp);
+  }
+  si = SocketInfo_init(fd, &kind);
+  if (si) {
+    (void)SocketTable_put(sockets, fd, si);
+  }
+  if (SocketKind_class(kind) != SK_Unknown) {
+    (void)SocketTable_classify(sockets, fd, stamp, kind);
   }
   return si;
 }
 
-/** Get informations about the socket while connecting.
+/** Get informations about a connected socket.
  */
-static inline SocketInfo* getInfosOnConnect(int fd, const struct ConstAddrData* data) {
-  SocketInfo* si = NULL;
-  SocketInfo* old = NULL;
-  if (!sockets) {
+static inline SocketInfo* getInfos(int fd, SocketInfoDirection direction) {
+  SocketInfo* si = getSocketInfos(fd, direction);
+  if (si && si->remote.type == AH_None) {
+    /* Listening or unconnected socket */
+    SocketInfo_unlock(si);
     return NULL;
   }
-  si = SocketInfo_initLight(fd, data->addr, data->addr_len);
-  SocketInfo_lock(si);
-  old = (SocketInfo*)LigHT_get(sockets, fd, true);
-  if (old) {
-    SocketInfo_lock(old);
-    old->toDestroy = true;
-    SocketInfo_unlock(old);
-  }
-  (void)LigHT_put(sockets, fd, si, true, true);
   return si;
 }
 
+/** Get informations about the socket for a call that gives its peer.
+ *
+ * On an unconnected datagram socket, the informations are the ones of the
+ * given peer.
+ */
+static inline SocketInfo* getInfosTo(int fd, SocketInfoDirection direction,
+                                     const struct sockaddr* addr, socklen_t addr_len) {
+  SocketInfo* si = getSocketInfos(fd, direction);
+  SocketInfo* peer = NULL;
+  if (si == NULL || si->remote.type != AH_None) {
+    return si;
+  }
+  if (si->datagram) {
+    peer = SocketInfo_peer(si, addr, addr_len);
+  }
+  SocketInfo_unlock(si);
+  return peer;
+}
 
-/*** Receiving calls */
+/** Get informations about the socket for a call that receives from its peer.
+ *
+ * On an unconnected datagram socket, the sender is only known once a
+ * datagram has arrived: the function returns NULL and gives the socket in
+ * unbound, the caller peeks at the sender with peekSender() and then
+ * matches the rules against it with getInfosFromPeer().
+ *
+ * @param unbound Receive the locked unconnected datagram socket (NULL if none).
+ */
+static inline SocketInfo* getInfosFrom(int fd, SocketInfo** unbound) {
+  SocketInfo* si = getSocketInfos(fd, Reading);
+  *unbound = NULL;
+  if (si == NULL || si->remote.type != AH_None) {
+    return si;
+  }
+  if (si->datagram) {
+    *unbound = si;
+  } else {
+    SocketInfo_unlock(si);
+  }
+  return NULL;
+}
 
-/** Helper fonction to perform iovec (de)serialization
+/** Get informations about the sender of a pending datagram.
+ *
+ * Release the unconnected datagram socket given by getInfosFrom().
  */
-static inline ssize_t prepareReadIOVec(SocketInfo* si, Action_syscall call,
-                                       const struct iovec* vect, size_t count,
-                                       int flags, void* data) {
-  size_t i;
-  size_t buflen = 0;
-  void* buf = NULL;
-  ssize_t ret;
-  ssize_t lret;
-  char* pos;
+static inline SocketInfo* getInfosFromPeer(SocketInfo* unbound, ssize_t received,
+                                           const struct sockaddr* addr, socklen_t addr_len) {
+  SocketInfo* peer = NULL;
+  if (received >= 0 && addr_len > 0) {
+    peer = SocketInfo_peer(unbound, addr, addr_len);
+  }
+  SocketInfo_unlock(unbound);
+  return peer;
+}
 
-  for (i = 0 ; i < count ; ++i) {
-    buflen += vect[i].iov_len;
+/** Get informations about the socket while connecting.
+ */
+static inline SocketInfo* getInfosOnConnect(int fd, const struct ConstAddrData* data) {
+  SocketInfo* si = NULL;
+  IPAddress ip;
+  int port = -1;
+  if (bypass || !sockets) {
+    return NULL;
   }
-  pos = buf = malloc(buflen);
-  if (buf == NULL) {
-    return -2;
+  if (!IPAddress_fromSockaddr(&ip, &port, data->addr, data->addr_len)) {
+    port = -1;
   }
-  lret = ret = ActionQueue_process(config->queue, si, Reading, call,
-                                   buf, buflen, flags, data);
-  for (i = 0 ; i < count && lret > 0 ; ++i) {
-    size_t toRead;
-    toRead = lret >= (ssize_t)vect[i].iov_len ? (ssize_t)vect[i].iov_len : lret;
-    lret -= toRead;
-    memcpy(vect[i].iov_base, pos, toRead);
-    pos += toRead;
+  if (data->addr && data->addr->sa_family == AF_UNSPEC) {
+    /* A datagram socket is disconnected */
+    forgetInfos(fd, SK_Unknown);
+    return NULL;
   }
-  free(buf);
-  return ret;
+  if (!mayMatch(SocketTable_kind(sockets, fd, NULL), Connecting, port)) {
+    return NULL;
+  }
+  si = SocketInfo_initLight(fd, data->addr, data->addr_len);
+  (void)SocketTable_put(sockets, fd, si);
+  return si;
 }
 
 
+/*** Receiving calls */
+
 /* read */
 
 static ssize_t readCB(int fd, void* buf, size_t len, int flags, void* data) {
@@ -208,7 +460,7 @@ ssize_t read(int fd, void* buf, size_t len) {
   SocketInfo* si = NULL;
   ssize_t ret;
 
-  if (config && (si = getInfos(fd))) {
+  if (config && (si = getInfos(fd, Reading))) {
     ret = ActionQueue_process(config->queue, si, Reading, readCB, buf, len, 0, NULL);
   } else {
     GET_SYSCALL(read)
@@ -221,14 +473,17 @@ ssize_t read(int fd, void* buf, size_t len) {
 
 /* readv */
 
+static ssize_t readvCB(int fd, const struct iovec* iovec, int count, int flags, void* data) {
+  return sysreadv(fd, iovec, count);
+}
+
 ssize_t readv(int fd, __const struct iovec* iovec, int count) {
   SocketInfo* si = NULL;
   ssize_t ret;
 
-  if (config && (si = getInfos(fd))) {
-    if ((ret = prepareReadIOVec(si, readCB, iovec, count, 0, NULL)) == -2) {
-      ret = sysreadv(fd, iovec, count);
-    }
+  if (config && (si = getInfos(fd, Reading))) {
+    ret = ActionQueue_processv(config->queue, si, Reading, readCB, readvCB,
+                               iovec, count, 0, NULL);
   } else {
     GET_SYSCALL(readv)
     ret = sysreadv(fd, iovec, count);
@@ -248,7 +503,7 @@ ssize_t recv(int fd, void* buf, size_t len, int flags) {
   SocketInfo* si = NULL;
   ssize_t ret;
 
-  if (config && (si = getInfos(fd))) {
+  if (config && (si = getInfos(fd, Reading))) {
     ret = ActionQueue_process(config->queue, si, Reading, recvCB, buf, len, flags, NULL);
   } else {
     GET_SYSCALL(recv)
@@ -258,6 +513,28 @@ ssize_t recv(int fd, void* buf, size_t len, int flags) {
   return ret;
 }
 
+/** Get the sender of the next datagram of an unconnected socket.
+ *
+ * The datagram is only peeked at: it stays in the socket until the rules
+ * matched against its sender let the call receive it (a hang or an error
+ * must not lose it). Another thread receiving from the same socket between
+ * the two calls may make the rules see the wrong sender.
+ *
+ * @return The result of the peek, the datagram is never copied.
+ */
+static ssize_t peekSender(int fd, int flags, struct sockaddr_storage* from,
+                          socklen_t* from_len) {
+  GET_SYSCALL(recvfrom)
+  *from_len = sizeof(*from);
+  if (flags & MSG_ERRQUEUE) {
+    /* Errors have no sender to match */
+    *from_len = 0;
+    return 0;
+  }
+  return sysrecvfrom(fd, NULL, 0, MSG_PEEK | MSG_TRUNC | (flags & MSG_DONTWAIT),
+                     (struct sockaddr*)from, from_len);
+}
+
 /* recvfrom */
 
 static ssize_t recvfromCB(int fd, void* buf, size_t len, int flags, void* data) {
@@ -268,13 +545,28 @@ static ssize_t recvfromCB(int fd, void* buf, size_t len, int flags, void* data)
 ssize_t recvfrom(int fd, void* __restrict buf, size_t len, int flags,
                  struct sockaddr* __restrict addr, socklen_t* __restrict addr_len) {
   SocketInfo* si = NULL;
+  SocketInfo* unbound = NULL;
   ssize_t ret;
   struct AddrData d;
   d.addr     = addr;
   d.addr_len = addr_len;
 
-  if (config && (si = getInfos(fd))) {
+  if (config && (si = getInfosFrom(fd, &unbound))) {
     ret = ActionQueue_process(config->queue, si, Reading, recvfromCB, buf, len, flags, &d);
+  } else if (unbound) {
+    struct sockaddr_storage from;
+    socklen_t from_len;
+    ssize_t peeked = peekSender(fd, flags, &from, &from_len);
+    int err = errno;
+    if ((si = getInfosFromPeer(unbound, peeked, (struct sockaddr*)&from, from_len))) {
+      ret = ActionQueue_process(config->queue, si, Reading, recvfromCB, buf, len, flags, &d);
+    } else if (peeked < 0) {
+      errno = err;
+      ret   = peeked;
+    } else {
+      GET_SYSCALL(recvfrom)
+      ret = sysrecvfrom(fd, buf, len, flags, addr, addr_len);
+    }
   } else {
     GET_SYSCALL(recvfrom)
     ret = sysrecvfrom(fd, buf, len, flags, addr, addr_len);
@@ -286,23 +578,47 @@ ssize_t recvfrom(int fd, void* __restrict buf, size_t len, int flags,
 
 /* recvmsg */
 
-static ssize_t recvmsgCB(int fd, void* buf, size_t len, int flags, void* data) {
+static ssize_t recvmsgvCB(int fd, const struct iovec* iovec, int count, int flags,
+                          void* data) {
   struct msghdr* message = (struct msghdr*)data;
   struct msghdr  msgcpy  = *message;
-  struct iovec   vect    = { buf, len };
-  msgcpy.msg_iov    = &vect;
-  msgcpy.msg_iovlen = 1;
-  return sysrecvmsg(fd, &msgcpy, flags);
+  ssize_t ret;
+  msgcpy.msg_iov    = (struct iovec*)iovec;
+  msgcpy.msg_iovlen = count;
+  ret = sysrecvmsg(fd, &msgcpy, flags);
+  message->msg_namelen    = msgcpy.msg_namelen;
+  message->msg_controllen = msgcpy.msg_controllen;
+  message->msg_flags      = msgcpy.msg_flags;
+  return ret;
+}
+
+static ssize_t recvmsgCB(int fd, void* buf, size_t len, int flags, void* data) {
+  struct iovec vect = { buf, len };
+  return recvmsgvCB(fd, &vect, 1, flags, data);
 }
 
 ssize_t recvmsg(int fd, struct msghdr* message, int flags) {
   SocketInfo* si = NULL;
+  SocketInfo* unbound = NULL;
   ssize_t ret = 0;
 
-  if (config && (si = getInfos(fd))) {
-    if ((ret = prepareReadIOVec(si, recvmsgCB, message->msg_iov,
-                                message->msg_iovlen, flags, message)) == -2) {
-        ret = sysrecvmsg(fd, message, flags);
+  if (config && (si = getInfosFrom(fd, &unbound))) {
+    ret = ActionQueue_processv(config->queue, si, Reading, recvmsgCB, recvmsgvCB,
+                               message->msg_iov, message->msg_iovlen, flags, message);
+  } else if (unbound) {
+    struct sockaddr_storage from;
+    socklen_t from_len;
+    ssize_t peeked = peekSender(fd, flags, &from, &from_len);
+    int err = errno;
+    if ((si = getInfosFromPeer(unbound, peeked, (struct sockaddr*)&from, from_len))) {
+      ret = ActionQueue_processv(config->queue, si, Reading, recvmsgCB, recvmsgvCB,
+                                 message->msg_iov, message->msg_iovlen, flags, message);
+    } else if (peeked < 0) {
+      errno = err;
+      ret   = peeked;
+    } else {
+      GET_SYSCALL(recvmsg)
+      ret = sysrecvmsg(fd, message, flags);
     }
   } else {
     GET_SYSCALL(recvmsg)
@@ -315,35 +631,6 @@ ssize_t recvmsg(int fd, struct msghdr* message, int flags) {
 
 /*** Sending calls */
 
-/** Helper fonction to perform iovec (de)serialization
- */
-static inline ssize_t prepareWriteIOVec(SocketInfo* si, Action_syscall call,
-                                        const struct iovec* vect, size_t count,
-                                        int flags, void* data) {
-  size_t i;
-  size_t buflen = 0;
-  void* buf = NULL;
-  ssize_t ret;
-  char* pos;
-
-  for (i = 0 ; i < count ; ++i) {
-    buflen += vect[i].iov_len;
-  }
-  pos = buf = malloc(buflen);
-  if (buf == NULL) {
-    return -2;
-  }
-  for (i = 0 ; i < count ; ++i) {
-    memcpy(pos, vect[i].iov_base, vect[i].iov_len);
-    pos += vect[i].iov_len;
-  }
-  ret = ActionQueue_process(config->queue, si, Reading, call,
-                            buf, buflen, flags, data);
-  free(buf);
-  return ret;
-}
-
-
 /* write */
 
 static ssize_t writeCB(int fd, void* buf, size_t len, int flags, void* data) {
@@ -354,7 +641,7 @@ ssize_t write(int fd, __const void* buf, size_t n) {
   SocketInfo* si = NULL;
   ssize_t ret;
 
-  if (config && (si = getInfos(fd))) {
+  if (config && (si = getInfos(fd, Writing))) {
     ret = ActionQueue_process(config->queue, si, Writing, writeCB, (void*)buf, n, 0, NULL);
   } else {
     GET_SYSCALL(write)
@@ -367,14 +654,17 @@ ssize_t write(int fd, __const void* buf, size_t n) {
 
 /* writev */
 
+static ssize_t writevCB(int fd, const struct iovec* iovec, int count, int flags, void* data) {
+  return syswritev(fd, iovec, count);
+}
+
 ssize_t writev(int fd, __const struct iovec* iovec, int count) {
   SocketInfo* si = NULL;
   ssize_t ret;
 
-  if (config && (si = getInfos(fd))) {
-    if ((ret = prepareWriteIOVec(si, writeCB, iovec, count, 0, NULL)) == -2) {
-      ret =syswritev(fd, iovec, count);
-    }
+  if (config && (si = getInfos(fd, Writing))) {
+    ret = ActionQueue_processv(config->queue, si, Writing, writeCB, writevCB,
+                               iovec, count, 0, NULL);
   } else {
     GET_SYSCALL(writev)
     ret = syswritev(fd, iovec, count);
@@ -394,7 +684,7 @@ ssize_t send(int fd, __const void* buf, size_t n, int flags) {
   SocketInfo* si = NULL;
   ssize_t ret;
 
-  if (config && (si = getInfos(fd))) {
+  if (config && (si = getInfos(fd, Writing))) {
     ret = ActionQueue_process(config->queue, si, Writing, sendCB, (void*)buf, n, flags, NULL);
   } else {
     GET_SYSCALL(send)
@@ -420,7 +710,7 @@ ssize_t sendto(int fd, __const void* buf, size_t n, int flags,
   d.addr     = addr;
   d.addr_len = addr_len;
 
-  if (config && (si = getInfos(fd))) {
+  if (config && (si = getInfosTo(fd, Writing, addr, addr_len))) {
     ret = ActionQueue_process(config->queue, si, Writing, sendtoCB, (void*)buf, n, flags, &d);
   } else {
     GET_SYSCALL(sendto)
@@ -433,122 +723,1518 @@ ssize_t sendto(int fd, __const void* buf, size_t n, int flags,
 
 /* sendmsg */
 
+static ssize_t sendmsgvCB(int fd, const struct iovec* iovec, int count, int flags,
+                          void* data) {
+  struct msghdr msgcpy = *(const struct msghdr*)data;
+  msgcpy.msg_iov    = (struct iovec*)iovec;
+  msgcpy.msg_iovlen = count;
+  return syssendmsg(fd, &msgcpy, flags);
+}
+
 static ssize_t sendmsgCB(int fd, void* buf, size_t len, int flags, void* data) {
-  struct msghdr* message = (struct msghdr*)data;
-  struct msghdr  msgcpy  = *message;
-  struct iovec* vect;
-  size_t nb = 0;
-  size_t i = 0;
-  size_t blen = 0;
-  char* pos = buf;
+  struct iovec vect = { buf, len };
+  return sendmsgvCB(fd, &vect, 1, flags, data);
+}
+
+ssize_t sendmsg(int fd, __const struct msghdr* message, int flags) {
+  SocketInfo* si = NULL;
+  ssize_t ret = 0;
+
+  if (config && (si = getInfosTo(fd, Writing, (const struct sockaddr*)message->msg_name,
+                                 message->msg_namelen))) {
+    ret = ActionQueue_processv(config->queue, si, Writing, sendmsgCB, sendmsgvCB,
+                               message->msg_iov, message->msg_iovlen, flags,
+                               (void*)message);
+  } else {
+    GET_SYSCALL(sendmsg)
+    ret = syssendmsg(fd, message, flags);
+  }
+  RELEASE_SI
+  return ret;
+}
+
+
+/*** Batched calls
+ *
+ * The rules are applied to each message of the batch, the candidate rules of
+ * the socket being computed only once. The messages are still moved by a
+ * single syscall: the messages to receive are all fetched when the first one
+ * is needed, and the messages to send are staged and sent together once all
+ * of them have been processed.
+ */
+
+/* recvmmsg */
+
+/** State of a recvmmsg call.
+ */
+struct RecvMMsgData {
+  struct mmsghdr*  vec;      /**< The messages of the caller. */
+  unsigned int     vlen;     /**< Number of messages. */
+  unsigned int     current;  /**< Message being processed. */
+  int              flags;    /**< Flags of the call. */
+  struct timespec* timeout;  /**< Timeout of the call. */
+  unsigned int     first;    /**< First message fetched by the syscall. */
+  int              fetched;  /**< Number of messages fetched (-1 before the syscall). */
+};
+
+/** Get the current message of the batch, fetching the batch if needed.
+ */
+static ssize_t recvmmsgFetch(int fd, struct RecvMMsgData* d, size_t len) {
+  struct mmsghdr* msg = &d->vec[d->current];
+
+  if (d->fetched < 0) {
+    d->first   = d->current;
+    d->fetched = sysrecvmmsg(fd, msg, d->vlen - d->current, d->flags, d->timeout);
+    if (d->fetched < 0) {
+      return -1;
+    }
+  }
+  if (d->current >= d->first + (unsigned int)d->fetched) {
+    errno = EAGAIN;
+    return -1;
+  }
+  if (msg->msg_len > len) {
+    msg->msg_hdr.msg_flags |= MSG_TRUNC;
+    return len;
+  }
+  return msg->msg_len;
+}
+
+static ssize_t recvmmsgvCB(int fd, const struct iovec* iovec, int count, int flags,
+                           void* data) {
+  size_t len = 0;
+  int i;
+
+  for (i = 0 ; i < count ; ++i) {
+    len += iovec[i].iov_len;
+  }
+  return recvmmsgFetch(fd, (struct RecvMMsgData*)data, len);
+}
+
+static ssize_t recvmmsgCB(int fd, void* buf, size_t len, int flags, void* data) {
+  struct RecvMMsgData* d = (struct RecvMMsgData*)data;
+  const struct msghdr* hdr;
   ssize_t ret;
+  size_t pos = 0;
+  size_t i;
 
-  for (i = 0 ; i < (size_t)msgcpy.msg_iovlen && blen < len ; ++i) {
-    blen += msgcpy.msg_iov[i].iov_len;
-    ++nb;
+  if ((ret = recvmmsgFetch(fd, d, len)) <= 0) {
+    return ret;
   }
-  vect = (struct iovec*)malloc(nb * sizeof(struct iovec));
-  blen = len;
-  for (i = 0 ; i < nb ; ++i) {
-    vect[i].iov_base = pos;
-    vect[i].iov_len  = blen > msgcpy.msg_iov[i].iov_len ? msgcpy.msg_iov[i].iov_len : blen;
-    blen -= vect[i].iov_len;
-    pos  += vect[i].iov_len;
+  /* The message has been received in the vectors of the caller */
+  hdr = &d->vec[d->current].msg_hdr;
+  for (i = 0 ; i < hdr->msg_iovlen && pos < (size_t)ret ; ++i) {
+    size_t chunk = hdr->msg_iov[i].iov_len;
+    if (chunk > (size_t)ret - pos) {
+      chunk = ret - pos;
+    }
+    (void)memcpy((char*)buf + pos, hdr->msg_iov[i].iov_base, chunk);
+    pos += chunk;
   }
-  msgcpy.msg_iov = vect;
-  msgcpy.msg_iovlen = nb;
-  ret = sysrecvmsg(fd, &msgcpy, flags);
-  free(vect);
   return ret;
 }
 
-ssize_t sendmsg(int fd, __const struct msghdr* message, int flags) {
+int recvmmsg(int fd, struct mmsghdr* vec, unsigned int vlen, int flags,
+             struct timespec* timeout) {
   SocketInfo* si = NULL;
+  struct RecvMMsgData d;
   ssize_t ret = 0;
+  unsigned int i;
 
-  if (config && (si = getInfos(fd))) {
-    if ((ret = prepareWriteIOVec(si, sendmsgCB, message->msg_iov,
-                                 message->msg_iovlen, flags, (void*)message)) == -2) {
-        ret = syssendmsg(fd, message, flags);
+  GET_SYSCALL(recvmmsg)
+  if (!config || !(si = getInfos(fd, Reading))) {
+    return sysrecvmmsg(fd, vec, vlen, flags, timeout);
+  }
+  d.vec     = vec;
+  d.vlen    = vlen > MMSG_MAX ? MMSG_MAX : vlen;
+  d.flags   = flags;
+  d.timeout = timeout;
+  d.first   = 0;
+  d.fetched = -1;
+  for (i = 0 ; i < d.vlen ; ++i) {
+    if (d.fetched >= 0 && i >= d.first + (unsigned int)d.fetched) {
+      break;
     }
-  } else {
-    GET_SYSCALL(sendmsg)
-    ret = syssendmsg(fd, message, flags);
+    d.current = i;
+    ret = ActionQueue_processv(config->queue, si, Reading, recvmmsgCB, recvmmsgvCB,
+                               vec[i].msg_hdr.msg_iov, vec[i].msg_hdr.msg_iovlen,
+                               flags, &d);
+    if (ret < 0) {
+      break;
+    }
+    vec[i].msg_len = ret;
   }
   RELEASE_SI
+  return i == 0 && ret < 0 ? -1 : (int)i;
+}
+
+
+/* sendmmsg */
+
+/** State of a sendmmsg call.
+ */
+struct SendMMsgData {
+  struct mmsghdr* vec;         /**< The messages of the caller. */
+  unsigned int    current;     /**< Message being processed. */
+  bool            staging;     /**< True if the current message has been staged. */
+  int             flags;       /**< Flags of the call. */
+  struct mmsghdr* staged;      /**< Messages waiting to be sent. */
+  unsigned int*   origin;      /**< Message of the caller of each staged message. */
+  char*           copies;      /**< Copies of the edited data of the staged messages. */
+  size_t          copyUsed;    /**< Number of bytes of copies in use. */
+  size_t          copySize;    /**< Number of bytes of copies available. */
+  unsigned int    count;       /**< Number of staged messages. */
+  unsigned int    capacity;    /**< Maximum number of staged messages. */
+  struct iovec*   iovs;        /**< Vectors of the staged messages. */
+  size_t          iovUsed;     /**< Number of vectors in use. */
+  size_t          iovCapacity; /**< Number of vectors available. */
+  unsigned int    failed;      /**< First message of the caller that has not been sent. */
+  int             err;         /**< Error of that message. */
+};
+
+/** Allocate the staging area of a sendmmsg call in the arena.
+ */
+static bool sendmmsgInit(struct SendMMsgData* d, struct mmsghdr* vec, unsigned int vlen,
+                         int flags) {
+  unsigned int i;
+
+  d->vec         = vec;
+  d->flags       = flags;
+  d->count       = 0;
+  d->capacity    = vlen;
+  d->iovUsed     = 0;
+  d->iovCapacity = 1;
+  d->copyUsed    = 0;
+  d->copySize    = 0;
+  d->failed      = vlen;
+  d->err         = 0;
+  for (i = 0 ; i < vlen ; ++i) {
+    size_t j;
+    d->iovCapacity += vec[i].msg_hdr.msg_iovlen;
+    for (j = 0 ; j < vec[i].msg_hdr.msg_iovlen && d->copySize < MMSG_COPY_MAX ; ++j) {
+      d->copySize += vec[i].msg_hdr.msg_iov[j].iov_len;
+    }
+  }
+  if (d->copySize > MMSG_COPY_MAX) {
+    d->copySize = MMSG_COPY_MAX;
+  }
+  /* The arena of the actions is released after each message, the copies of
+   * the edited messages must outlive it until the batch is sent */
+  d->staged = (struct mmsghdr*)Arena_alloc(vlen * sizeof(struct mmsghdr));
+  d->origin = (unsigned int*)Arena_alloc(vlen * sizeof(unsigned int));
+  d->copies = (char*)Arena_alloc(d->copySize);
+  d->iovs   = (struct iovec*)Arena_alloc(d->iovCapacity * sizeof(struct iovec));
+  return d->staged && d->origin && d->copies && d->iovs;
+}
+
+/** Send the staged messages.
+ */
+static void sendmmsgFlush(int fd, struct SendMMsgData* d) {
+  unsigned int k;
+  int sent;
+  int err;
+
+  if (d->count == 0) {
+    return;
+  }
+  sent = syssendmmsg(fd, d->staged, d->count, d->flags);
+  err  = errno;
+  for (k = 0 ; k < d->count ; ++k) {
+    if ((int)k < sent) {
+      d->vec[d->origin[k]].msg_len += d->staged[k].msg_len;
+    } else if (d->origin[k] < d->failed) {
+      d->failed = d->origin[k];
+      d->err    = err;
+    }
+  }
+  d->count    = 0;
+  d->iovUsed  = 0;
+  d->copyUsed = 0;
+}
+
+static ssize_t sendmmsgvCB(int fd, const struct iovec* iovec, int count, int flags,
+                           void* data) {
+  struct SendMMsgData* d = (struct SendMMsgData*)data;
+  struct mmsghdr* msg;
+  ssize_t len = 0;
+  int i;
+
+  if (d->count == d->capacity || d->iovUsed + count > d->iovCapacity) {
+    sendmmsgFlush(fd, d);
+    if (d->failed <= d->current) {
+      errno = d->err;
+      return -1;
+    }
+  }
+  msg = &d->staged[d->count];
+  msg->msg_hdr            = d->vec[d->current].msg_hdr;
+  msg->msg_hdr.msg_iov    = d->iovs + d->iovUsed;
+  msg->msg_hdr.msg_iovlen = count;
+  msg->msg_len            = 0;
+  (void)memcpy(d->iovs + d->iovUsed, iovec, count * sizeof(struct iovec));
+  d->iovUsed += count;
+  d->origin[d->count++] = d->current;
+  d->staging = true;
+  for (i = 0 ; i < count ; ++i) {
+    len += iovec[i].iov_len;
+  }
+  return len;
+}
+
+static ssize_t sendmmsgCB(int fd, void* buf, size_t len, int flags, void* data) {
+  struct SendMMsgData* d = (struct SendMMsgData*)data;
+  struct iovec vect;
+  ssize_t ret;
+
+  vect.iov_base = buf;
+  vect.iov_len  = len;
+  if (len > d->copySize - d->copyUsed || d->count == d->capacity
+      || d->iovUsed + 1 > d->iovCapacity) {
+    /* Flush here rather than in sendmmsgvCB, which would reuse the copy */
+    sendmmsgFlush(fd, d);
+    if (d->failed <= d->current) {
+      errno = d->err;
+      return -1;
+    }
+  }
+  if (len > d->copySize) {
+    /* The edited data is released with the call state: send it at once */
+    if ((ret = sendmmsgvCB(fd, &vect, 1, flags, data)) >= 0) {
+      sendmmsgFlush(fd, d);
+      if (d->failed <= d->current) {
+        errno = d->err;
+        return -1;
+      }
+    }
+    return ret;
+  }
+  vect.iov_base = memcpy(d->copies + d->copyUsed, buf, len);
+  ret = sendmmsgvCB(fd, &vect, 1, flags, data);
+  if (ret >= 0) {
+    d->copyUsed += len;
+  }
   return ret;
 }
 
+int sendmmsg(int fd, struct mmsghdr* vec, unsigned int vlen, int flags) {
+  SocketInfo* si = NULL;
+  SocketInfo* peer;
+  struct SendMMsgData d;
+  ArenaMark mark;
+  ssize_t ret;
+  unsigned int i;
 
-/*** Want to connect to a new socket... */
+  GET_SYSCALL(sendmmsg)
+  if (vlen == 0 || !config || !(si = getSocketInfos(fd, Writing))) {
+    return syssendmmsg(fd, vec, vlen, flags);
+  }
+  if (si->remote.type == AH_None && !si->datagram) {
+    RELEASE_SI
+    return syssendmmsg(fd, vec, vlen, flags);
+  }
+  if (vlen > MMSG_MAX) {
+    vlen = MMSG_MAX;
+  }
+  mark = Arena_mark();
+  if (!sendmmsgInit(&d, vec, vlen, flags)) {
+    Arena_release(mark);
+    RELEASE_SI
+    errno = ENOMEM;
+    return -1;
+  }
+  for (i = 0 ; i < vlen && i < d.failed ; ++i) {
+    d.current = i;
+    d.staging = false;
+    vec[i].msg_len = 0;
+    if (si->remote.type != AH_None) {
+      peer = si;
+      SocketInfo_lock(peer);
+    } else {
+      /* Unconnected socket: each message is matched against its destination */
+      peer = SocketInfo_peer(si, (const struct sockaddr*)vec[i].msg_hdr.msg_name,
+                             vec[i].msg_hdr.msg_namelen);
+    }
+    if (peer) {
+      ret = ActionQueue_processv(config->queue, peer, Writing, sendmmsgCB, sendmmsgvCB,
+                                 vec[i].msg_hdr.msg_iov, vec[i].msg_hdr.msg_iovlen,
+                                 flags, &d);
+      SocketInfo_unlock(peer);
+    } else {
+      ret = sendmmsgvCB(fd, vec[i].msg_hdr.msg_iov, vec[i].msg_hdr.msg_iovlen, flags, &d);
+    }
+    if (ret < 0) {
+      if (i < d.failed) {
+        d.failed = i;
+        d.err    = errno;
+      }
+      break;
+    }
+    if (!d.staging) {
+      /* Nothing to send, the message has been dropped */
+      vec[i].msg_len = ret;
+    }
+  }
+  sendmmsgFlush(fd, &d);
+  Arena_release(mark);
+  RELEASE_SI
+  if (d.failed == 0) {
+    errno = d.err;
+    return -1;
+  }
+  return d.failed;
+}
 
-static ssize_t connectCB(int fd, void* buf, size_t len, int flags, void* data) {
-  struct ConstAddrData* d = (struct ConstAddrData*)data;
-  return sysconnect(fd, d->addr, d->addr_len);
+
+/*** Moving data between a socket and another file descriptor
+ *
+ * The data is moved by the kernel as long as the rules don't look at it.
+ * When they do, the callbacks are given a buffer and only perform the I/O on
+ * the socket (see ActionQueue_splice).
+ */
+
+/** Fill the description of the other end of a spliced call.
+ */
+#define SPLICE_INIT(splice, desc, off)                                         \
+  (splice).fd        = (desc);                                                 \
+  (splice).hasOffset = (off) != NULL;                                          \
+  (splice).offset    = (off) ? *(off) : 0;
+
+/* sendfile */
+
+static ssize_t sendfileCB(int fd, void* buf, size_t len, int flags, void* data) {
+  ActionSplice* s = (ActionSplice*)data;
+  off_t offset;
+  ssize_t ret;
+
+  if (buf) {
+    return syswrite(fd, buf, len);
+  } else if (!s->hasOffset) {
+    return syssendfile(fd, s->fd, NULL, len);
+  }
+  offset = s->offset;
+  ret = syssendfile(fd, s->fd, &offset, len);
+  s->offset = offset;
+  return ret;
 }
 
-int connect(int fd, const struct sockaddr* addr, socklen_t addrlen) {
+ssize_t sendfile(int out, int in, off_t* offset, size_t count) {
   SocketInfo* si = NULL;
-  struct ConstAddrData d;
-  int ret;
-  d.addr     = addr;
-  d.addr_len = addrlen;
+  ActionSplice s;
+  ssize_t ret;
 
-  if (config && (si = getInfosOnConnect(fd, &d))) {
-    ret = ActionQueue_process(config->queue, si, Connecting, connectCB, NULL, 0, 0, &d);
+  GET_SYSCALL(sendfile)
+  if (config && (si = getInfos(out, Writing))) {
+    SPLICE_INIT(s, in, offset)
+    ret = ActionQueue_splice(config->queue, si, Writing, sendfileCB, &s, count, 0, &s);
+    if (offset) {
+      *offset = s.offset;
+    }
   } else {
-    GET_SYSCALL(connect)
-    ret = sysconnect(fd, addr, addrlen);
+    ret = syssendfile(out, in, offset, count);
   }
   RELEASE_SI
   return ret;
 }
 
+static ssize_t sendfile64CB(int fd, void* buf, size_t len, int flags, void* data) {
+  ActionSplice* s = (ActionSplice*)data;
+  off64_t offset;
+  ssize_t ret;
 
-/*** The socket has been closed... */
-
-static ssize_t closeCB(int fd, void* buf, size_t len, int flags, void* data) {
-  return sysclose(fd);
+  if (buf) {
+    return syswrite(fd, buf, len);
+  } else if (!s->hasOffset) {
+    return syssendfile64(fd, s->fd, NULL, len);
+  }
+  offset = s->offset;
+  ret = syssendfile64(fd, s->fd, &offset, len);
+  s->offset = offset;
+  return ret;
 }
 
-int close(int fd) {
+ssize_t sendfile64(int out, int in, off64_t* offset, size_t count) {
   SocketInfo* si = NULL;
-  int ret;
+  ActionSplice s;
+  ssize_t ret;
 
-  if (config && (si = getInfos(fd))) {
-    LigHT_remove(sockets, fd, true);
-    ret = ActionQueue_process(config->queue, si, Closing, closeCB, NULL, 0, 0, NULL);
-    si->toDestroy = true;
+  GET_SYSCALL(sendfile64)
+  if (config && (si = getInfos(out, Writing))) {
+    SPLICE_INIT(s, in, offset)
+    ret = ActionQueue_splice(config->queue, si, Writing, sendfile64CB, &s, count, 0, &s);
+    if (offset) {
+      *offset = s.offset;
+    }
   } else {
-    GET_SYSCALL(close)
-    ret = sysclose(fd);
+    ret = syssendfile64(out, in, offset, count);
   }
   RELEASE_SI
   return ret;
 }
 
 
-/*** Lib initialisation */
+/* splice */
 
-/** Start the module.
+/** Data to pass when performing a splice.
  */
-void inj_init(void) {
-  srand(time(NULL));
+struct SpliceData {
+  ActionSplice splice; /**< The other end of the call. */
+  unsigned int flags;  /**< The flags of the call. */
+};
 
-  GET_SYSCALL(read)
-  GET_SYSCALL(readv)
+static ssize_t spliceInCB(int fd, void* buf, size_t len, int flags, void* data) {
+  struct SpliceData* d = (struct SpliceData*)data;
+  loff_t offset = d->splice.offset;
+  ssize_t ret;
+
+  if (buf) {
+    return sysread(fd, buf, len);
+  }
+  ret = syssplice(fd, NULL, d->splice.fd, d->splice.hasOffset ? &offset : NULL,
+                  len, d->flags);
+  d->splice.offset = offset;
+  return ret;
+}
+
+static ssize_t spliceOutCB(int fd, void* buf, size_t len, int flags, void* data) {
+  struct SpliceData* d = (struct SpliceData*)data;
+  loff_t offset = d->splice.offset;
+  ssize_t ret;
+
+  if (buf) {
+    return syswrite(fd, buf, len);
+  }
+  ret = syssplice(d->splice.fd, d->splice.hasOffset ? &offset : NULL, fd, NULL,
+                  len, d->flags);
+  d->splice.offset = offset;
+  return ret;
+}
+
+ssize_t splice(int in, loff_t* inoff, int out, loff_t* outoff, size_t len,
+               unsigned int flags) {
+  SocketInfo* si = NULL;
+  struct SpliceData d;
+  ssize_t ret;
+
+  GET_SYSCALL(splice)
+  d.flags = flags;
+  if (config && (si = getInfos(out, Writing))) {
+    SPLICE_INIT(d.splice, in, inoff)
+    ret = ActionQueue_splice(config->queue, si, Writing, spliceOutCB, &d.splice, len, 0, &d);
+    if (inoff) {
+      *inoff = d.splice.offset;
+    }
+  } else if (config && (si = getInfos(in, Reading))) {
+    SPLICE_INIT(d.splice, out, outoff)
+    ret = ActionQueue_splice(config->queue, si, Reading, spliceInCB, &d.splice, len, 0, &d);
+    if (outoff) {
+      *outoff = d.splice.offset;
+    }
+  } else {
+    ret = syssplice(in, inoff, out, outoff, len, flags);
+  }
+  RELEASE_SI
+  return ret;
+}
+
+
+/*** Want to connect to a new socket... */
+
+static ssize_t connectCB(int fd, void* buf, size_t len, int flags, void* data) {
+  struct ConstAddrData* d = (struct ConstAddrData*)data;
+  return sysconnect(fd, d->addr, d->addr_len);
+}
+
+int connect(int fd, const struct sockaddr* addr, socklen_t addrlen) {
+  SocketInfo* si = NULL;
+  struct ConstAddrData d;
+  int ret;
+  d.addr     = addr;
+  d.addr_len = addrlen;
+
+  if (config && (si = getInfosOnConnect(fd, &d))) {
+    ret = ActionQueue_process(config->queue, si, Connecting, connectCB, NULL, 0, 0, &d);
+    if (ret == 0 || errno == EINPROGRESS) {
+      /* connect binds the socket to its local address */
+      SocketInfo_update(si);
+    }
+  } else {
+    GET_SYSCALL(connect)
+    ret = sysconnect(fd, addr, addrlen);
+  }
+  RELEASE_SI
+  return ret;
+}
+
+int bind(int fd, const struct sockaddr* addr, socklen_t addrlen) {
+  SocketInfo* si = NULL;
+  int ret;
+
+  GET_SYSCALL(bind)
+  ret = sysbind(fd, addr, addrlen);
+  if (ret == 0 && sockets && (si = SocketTable_get(sockets, fd))) {
+    SocketInfo_update(si);
+  }
+  RELEASE_SI
+  return ret;
+}
+
+
+/*** The socket has been closed... */
+
+static ssize_t closeCB(int fd, void* buf, size_t len, int flags, void* data) {
+  return sysclose(fd);
+}
+
+int close(int fd) {
+  SocketInfo* si = NULL;
+  int ret;
+
+  if (config && (si = getInfos(fd, Closing))) {
+    SocketTable_remove(sockets, fd);
+    ret = ActionQueue_process(config->queue, si, Closing, closeCB, NULL, 0, 0, NULL);
+  } else {
+    GET_SYSCALL(close)
+    ret = sysclose(fd);
+  }
+  forgetInfos(fd, SK_Unknown);
+  RELEASE_SI
+  return ret;
+}
+
+int fclose(FILE* stream) {
+  int fd;
+  int ret;
+
+  fd = fileno(stream);
+  GET_SYSCALL(fclose)
+  ret = sysfclose(stream);
+  forgetInfos(fd, SK_Unknown);
+  return ret;
+}
+
+int close_range(unsigned int first, unsigned int last, int flags) {
+  int ret;
+
+  GET_SYSCALL(close_range)
+  if (sysclose_range == NULL) {
+    errno = ENOSYS;
+    return -1;
+  }
+  ret = sysclose_range(first, last, flags);
+  if (ret == 0 && sockets && !(flags & CLOSE_RANGE_CLOEXEC)) {
+    SocketTable_clear(sockets, first, last);
+    Action_forgetHanging(first, last);
+  }
+  return ret;
+}
+
+
+/*** Tracking the creation of file descriptors
+ *
+ * Classifying a file descriptor when it is created avoids a fstat() on its
+ * first use, and invalidating the cache when a descriptor number is reused
+ * keeps the non-socket cache accurate.
+ */
+
+#ifdef O_TMPFILE
+# define OPEN_NEEDS_MODE(oflag) (((oflag) & O_CREAT) || ((oflag) & O_TMPFILE) == O_TMPFILE)
+#else
+# define OPEN_NEEDS_MODE(oflag) ((oflag) & O_CREAT)
+#endif
+
+#define OPEN_GET_MODE(oflag, mode)                                             \
+  if (OPEN_NEEDS_MODE(oflag)) {                                                \
+    va_list ap;                                                                \
+    va_start(ap, oflag);                                                       \
+    mode = va_arg(ap, mode_t);                                                 \
+    va_end(ap);                                                                \
+  }
+
+/** Get the kind of a socket from its creation parameters.
+ */
+static inline SocketKind socketKind(int domain, int type) {
+  type &= ~(SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if ((domain != AF_INET && domain != AF_INET6 && domain != AF_UNIX)
+      || (type != SOCK_STREAM && type != SOCK_DGRAM)) {
+    return SK_Unsupported;
+  }
+  if (domain == AF_UNIX) {
+    return SocketKind_make(SK_Unknown, AP_UNIX);
+  }
+  return SocketKind_make(SK_Unknown, type == SOCK_STREAM ? AP_TCP : AP_UDP);
+}
+
+/** Get the kind of a file descriptor created from another one.
+ *
+ * Duplicated and accepted sockets share the family and the protocol of the
+ * original socket, but their SocketInfo must be built again.
+ */
+static inline SocketKind dupKind(int fd) {
+  SocketKind kind;
+  if (!sockets) {
+    return SK_Unknown;
+  }
+  kind = SocketTable_kind(sockets, fd, NULL);
+  return SocketKind_class(kind) == SK_Socket ? (SocketKind)(kind & ~SK_Class) : kind;
+}
+
+int open(const char* file, int oflag, ...) {
+  mode_t mode = 0;
+  int ret;
+
+  OPEN_GET_MODE(oflag, mode)
+  GET_SYSCALL(open)
+  ret = sysopen(file, oflag, mode);
+  forgetInfos(ret, SK_NotSocket);
+  return ret;
+}
+
+int open64(const char* file, int oflag, ...) {
+  mode_t mode = 0;
+  int ret;
+
+  OPEN_GET_MODE(oflag, mode)
+  GET_SYSCALL(open64)
+  ret = sysopen64(file, oflag, mode);
+  forgetInfos(ret, SK_NotSocket);
+  return ret;
+}
+
+int openat(int dirfd, const char* file, int oflag, ...) {
+  mode_t mode = 0;
+  int ret;
+
+  OPEN_GET_MODE(oflag, mode)
+  GET_SYSCALL(openat)
+  ret = sysopenat(dirfd, file, oflag, mode);
+  forgetInfos(ret, SK_NotSocket);
+  return ret;
+}
+
+int openat64(int dirfd, const char* file, int oflag, ...) {
+  mode_t mode = 0;
+  int ret;
+
+  OPEN_GET_MODE(oflag, mode)
+  GET_SYSCALL(openat64)
+  ret = sysopenat64(dirfd, file, oflag, mode);
+  forgetInfos(ret, SK_NotSocket);
+  return ret;
+}
+
+int creat(const char* file, mode_t mode) {
+  int ret;
+
+  GET_SYSCALL(creat)
+  ret = syscreat(file, mode);
+  forgetInfos(ret, SK_NotSocket);
+  return ret;
+}
+
+int pipe(int fds[2]) {
+  int ret;
+
+  GET_SYSCALL(pipe)
+  if ((ret = syspipe(fds)) == 0) {
+    forgetInfos(fds[0], SK_NotSocket);
+    forgetInfos(fds[1], SK_NotSocket);
+  }
+  return ret;
+}
+
+int pipe2(int fds[2], int flags) {
+  int ret;
+
+  GET_SYSCALL(pipe2)
+  if ((ret = syspipe2(fds, flags)) == 0) {
+    forgetInfos(fds[0], SK_NotSocket);
+    forgetInfos(fds[1], SK_NotSocket);
+  }
+  return ret;
+}
+
+int socket(int domain, int type, int protocol) {
+  int ret;
+
+  GET_SYSCALL(socket)
+  ret = syssocket(domain, type, protocol);
+  forgetInfos(ret, socketKind(domain, type));
+  return ret;
+}
+
+int socketpair(int domain, int type, int protocol, int fds[2]) {
+  int ret;
+
+  GET_SYSCALL(socketpair)
+  if ((ret = syssocketpair(domain, type, protocol, fds)) == 0) {
+    forgetInfos(fds[0], socketKind(domain, type));
+    forgetInfos(fds[1], socketKind(domain, type));
+  }
+  return ret;
+}
+
+int dup(int fd) {
+  int ret;
+
+  GET_SYSCALL(dup)
+  ret = sysdup(fd);
+  forgetInfos(ret, dupKind(fd));
+  return ret;
+}
+
+int dup2(int fd, int fd2) {
+  int ret;
+
+  GET_SYSCALL(dup2)
+  ret = sysdup2(fd, fd2);
+  if (ret != -1 && fd != fd2) {
+    forgetInfos(ret, dupKind(fd));
+  }
+  return ret;
+}
+
+int dup3(int fd, int fd2, int flags) {
+  int ret;
+
+  GET_SYSCALL(dup3)
+  ret = sysdup3(fd, fd2, flags);
+  forgetInfos(ret, dupKind(fd));
+  return ret;
+}
+
+
+/*** Tracking the changes of the file descriptors flags */
+
+/** Update the blocking flag of a known socket.
+ */
+static inline void setBlocking(int fd, bool blocking) {
+  SocketInfo* si;
+  if (!sockets || (si = SocketTable_get(sockets, fd)) == NULL) {
+    return;
+  }
+  si->blocking = blocking;
+  SocketInfo_unlock(si);
+}
+
+/** Track the effects of a fcntl call.
+ */
+static inline int fcntlInfos(int fd, int cmd, void* arg, int ret) {
+  if (ret == -1) {
+    return ret;
+  }
+  switch (cmd) {
+    case F_SETFL:
+      setBlocking(fd, !((long)arg & O_NONBLOCK));
+      break;
+    case F_DUPFD:
+    case F_DUPFD_CLOEXEC:
+      forgetInfos(ret, dupKind(fd));
+      break;
+  }
+  return ret;
+}
+
+/* fcntl arguments are either an int, a long or a pointer, glibc always passes
+ * them as a pointer.
+ */
+#define FCNTL_GET_ARG(cmd, arg)                                                \
+  {                                                                            \
+    va_list ap;                                                                \
+    va_start(ap, cmd);                                                         \
+    arg = va_arg(ap, void*);                                                   \
+    va_end(ap);                                                                \
+  }
+
+int fcntl(int fd, int cmd, ...) {
+  void* arg;
+
+  FCNTL_GET_ARG(cmd, arg)
+  GET_SYSCALL(fcntl)
+  return fcntlInfos(fd, cmd, arg, sysfcntl(fd, cmd, arg));
+}
+
+int fcntl64(int fd, int cmd, ...) {
+  void* arg;
+
+  FCNTL_GET_ARG(cmd, arg)
+  GET_SYSCALL(fcntl64)
+  if (sysfcntl64 == NULL) {
+    GET_SYSCALL(fcntl)
+    return fcntlInfos(fd, cmd, arg, sysfcntl(fd, cmd, arg));
+  }
+  return fcntlInfos(fd, cmd, arg, sysfcntl64(fd, cmd, arg));
+}
+
+int ioctl(int fd, unsigned long request, ...) {
+  void* arg;
+  va_list ap;
+  int ret;
+
+  va_start(ap, request);
+  arg = va_arg(ap, void*);
+  va_end(ap);
+  GET_SYSCALL(ioctl)
+  ret = sysioctl(fd, request, arg);
+  if (ret != -1 && request == FIONBIO && arg) {
+    setBlocking(fd, !*(int*)arg);
+  }
+  return ret;
+}
+
+
+/*** Readiness calls
+ *
+ * A hang on a non-blocking socket makes the calls fail with EAGAIN until its
+ * end. In order not to wake up the caller in a loop, the socket is withheld
+ * from the readiness calls in the hanging direction while the hang lasts. The
+ * calls are split to wake up at the end of the hang and unmask the socket.
+ */
+
+/** Get the current time of the monotonic clock in milliseconds.
+ */
+static inline int64_t nowMSec(void) {
+  return (int64_t)Clock_toMSec(Clock_now());
+}
+
+/** Convert the timeout of a call to milliseconds.
+ *
+ * The timeout is rounded up, so that a short wait does not turn into a busy
+ * loop, and clamped to INT_MAX, so that a long one does not become infinite.
+ *
+ * @param sec  The seconds of the timeout.
+ * @param nsec The nanoseconds of the timeout.
+ * @return The timeout in milliseconds.
+ */
+static inline int timeoutMSec(time_t sec, long nsec) {
+  const int64_t msec = (nsec + 999999) / 1000000;
+
+  if (sec < 0) {
+    return 0;
+  }
+  if ((int64_t)sec > (INT_MAX - msec) / 1000) {
+    return INT_MAX;
+  }
+  return (int)(sec * 1000 + msec);
+}
+
+/** Get the deadline of a call given its timeout in milliseconds (-1 for none).
+ */
+static inline int64_t waitDeadline(int timeout) {
+  return timeout < 0 ? -1 : nowMSec() + timeout;
+}
+
+/** Get the time to wait before the deadline of the call or the end of a hang.
+ *
+ * @param deadline The deadline of the call (-1 for none).
+ * @param hang     The remaining time of the earliest hang (0 for none).
+ * @return The time to wait in milliseconds (-1 for infinite).
+ */
+static inline int waitTime(int64_t deadline, int hang) {
+  int64_t remaining = -1;
+
+  if (deadline >= 0) {
+    remaining = deadline - nowMSec();
+    if (remaining < 0) {
+      remaining = 0;
+    }
+  }
+  if (hang > 0 && (remaining < 0 || hang < remaining)) {
+    return hang;
+  }
+  return (int)remaining;
+}
+
+/** Get the remaining hang of the socket bound to a file descriptor.
+ *
+ * @param list      The hanging sockets.
+ * @param count     The number of hanging sockets.
+ * @param fd        The file descriptor.
+ * @param direction The direction of the hang.
+ * @return The remaining time in milliseconds, 0 if the socket does not hang.
+ */
+static inline int hangDelay(SocketInfo** list, int count, int fd,
+                            SocketInfoDirection direction) {
+  int i;
+
+  for (i = 0 ; i < count ; ++i) {
+    if (list[i]->fd == fd) {
+      return Action_hangDelay(list[i], direction);
+    }
+  }
+  return 0;
+}
+
+/** Release the hanging sockets.
+ */
+static inline void releaseHanging(SocketInfo** list, int count) {
+  int i;
+
+  for (i = 0 ; i < count ; ++i) {
+    SocketInfo_unlock(list[i]);
+  }
+}
+
+
+/* epoll */
+
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event* event) {
+  SocketInfoWatch* watch;
+  SocketInfo* si = NULL;
+  int ret;
+
+  GET_SYSCALL(epoll_ctl)
+  ret = sysepoll_ctl(epfd, op, fd, event);
+  if (ret != 0 || !config || !(si = getInfos(fd, Data))) {
+    return ret;
+  }
+  if (op == EPOLL_CTL_DEL) {
+    if ((watch = SocketInfo_watch(si, epfd, false)) != NULL) {
+      watch->masked = 0;
+      watch->epfd   = -1;
+    }
+  } else if (event && (event->events & EPOLLEXCLUSIVE)) {
+    /* Such a registration cannot be changed by EPOLL_CTL_MOD */
+    fprintf(stderr, "WARN socket %d is registered with EPOLLEXCLUSIVE in epoll %d,"
+            " it is not withheld from the set while hanging\n", fd, epfd);
+  } else if (event) {
+    if ((watch = SocketInfo_watch(si, epfd, true)) != NULL) {
+      watch->events = event->events;
+      watch->data   = event->data.u64;
+      watch->masked = 0;
+    } else {
+      fprintf(stderr, "WARN socket %d is registered in more than %d epoll sets,"
+              " it is not withheld from epoll %d while hanging\n", fd, SOCKETINFO_WATCHES, epfd);
+    }
+  }
+  RELEASE_SI
+  return ret;
+}
+
+/** Check that a socket still owns its file descriptor.
+ *
+ * The closes seen by the library drop the socket from the hanging sockets,
+ * this protects the registration of a descriptor reassigned behind our back.
+ */
+static inline bool epollOwns(SocketInfo* si) {
+  SocketInfo* current = SocketTable_get(sockets, si->fd);
+
+  if (current) {
+    SocketInfo_unlock(current);
+  }
+  return current == si;
+}
+
+/** Withhold the hanging sockets from an epoll set.
+ *
+ * The registration of the sockets whose hang started is modified to remove
+ * the events of the hanging direction, the registration of the sockets whose
+ * hang ended is restored.
+ *
+ * @param epfd The epoll set.
+ * @return The remaining time of the earliest hang, 0 if no socket is withheld.
+ */
+static int epollMask(int epfd) {
+  SocketInfo** list;
+  ArenaMark mark;
+  int count;
+  int delay = 0;
+  int i;
+
+  mark = Arena_mark();
+  list = Action_hangingSockets(&count);
+  for (i = 0 ; i < count ; ++i) {
+    SocketInfo* si = list[i];
+    const int reading = Action_hangDelay(si, Reading);
+    const int writing = Action_hangDelay(si, Writing);
+    SocketInfoWatch* watch = SocketInfo_watch(si, epfd, false);
+    unsigned int masked;
+    unsigned int wanted = 0;
+    struct epoll_event event;
+
+    if (watch == NULL) {
+      continue;
+    }
+    if (!epollOwns(si)) {
+      SocketInfo_unwatch(si);
+      continue;
+    }
+    masked = watch->masked;
+    if (reading > 0 && (watch->events & (EPOLLIN | EPOLLRDNORM))) {
+      wanted |= Reading;
+    }
+    if (writing > 0 && (watch->events & (EPOLLOUT | EPOLLWRNORM))) {
+      wanted |= Writing;
+    }
+    if (wanted != masked && __sync_bool_compare_and_swap(&watch->masked, masked, wanted)) {
+      event.events   = watch->events;
+      event.data.u64 = watch->data;
+      if (wanted & Reading) {
+        event.events &= ~(EPOLLIN | EPOLLRDNORM);
+      }
+      if (wanted & Writing) {
+        event.events &= ~(EPOLLOUT | EPOLLWRNORM);
+      }
+      if (sysepoll_ctl(epfd, EPOLL_CTL_MOD, si->fd, &event) != 0) {
+        /* The socket left the set */
+        watch->masked = 0;
+        continue;
+      }
+    }
+    if ((wanted & Reading) && (delay == 0 || reading < delay)) {
+      delay = reading;
+    }
+    if ((wanted & Writing) && (delay == 0 || writing < delay)) {
+      delay = writing;
+    }
+  }
+  releaseHanging(list, count);
+  Arena_release(mark);
+  return delay;
+}
+
+/** Wait for events on an epoll set, withholding the hanging sockets.
+ */
+static int epollWait(int epfd, struct epoll_event* events, int maxevents, int timeout,
+                     const sigset_t* sigmask) {
+  const int64_t deadline = waitDeadline(timeout);
+  int err = errno;
+  int delay;
+  int ret;
+
+  do {
+    delay = epollMask(epfd);
+    errno = err;
+    ret   = sysepoll_pwait(epfd, events, maxevents, waitTime(deadline, delay), sigmask);
+  } while (ret == 0 && delay > 0 && (deadline < 0 || nowMSec() < deadline));
+  return ret;
+}
+
+int epoll_wait(int epfd, struct epoll_event* events, int maxevents, int timeout) {
+  GET_SYSCALL(epoll_wait)
+  GET_SYSCALL(epoll_pwait)
+  GET_SYSCALL(epoll_ctl)
+  if (!config || !Action_hanging()) {
+    return sysepoll_wait(epfd, events, maxevents, timeout);
+  }
+  return epollWait(epfd, events, maxevents, timeout, NULL);
+}
+
+int epoll_pwait(int epfd, struct epoll_event* events, int maxevents, int timeout,
+                const sigset_t* sigmask) {
+  GET_SYSCALL(epoll_pwait)
+  GET_SYSCALL(epoll_ctl)
+  if (!config || !Action_hanging()) {
+    return sysepoll_pwait(epfd, events, maxevents, timeout, sigmask);
+  }
+  return epollWait(epfd, events, maxevents, timeout, sigmask);
+}
+
+
+/* poll */
+
+/** Wait for events on a set of file descriptors, withholding the hanging sockets.
+ *
+ * @return -2 if the call has not been performed.
+ */
+static int pollWait(struct pollfd* fds, nfds_t nfds, int timeout, const sigset_t* sigmask) {
+  const int64_t deadline = waitDeadline(timeout);
+  const int err = errno;
+  struct pollfd* copy;
+  SocketInfo** list;
+  ArenaMark mark;
+  bool masking = true;
+  int count;
+  int delay;
+  int ret;
+  nfds_t i;
+
+  mark = Arena_mark();
+  if ((copy = (struct pollfd*)Arena_alloc(nfds * sizeof(struct pollfd))) == NULL) {
+    Arena_release(mark);
+    return -2;
+  }
+  do {
+    ArenaMark inner = Arena_mark();
+    struct timespec ts;
+    int wait;
+
+    delay = 0;
+    list  = Action_hangingSockets(&count);
+    for (i = 0 ; i < nfds ; ++i) {
+      const int reading = hangDelay(list, count, fds[i].fd, Reading);
+      const int writing = hangDelay(list, count, fds[i].fd, Writing);
+
+      copy[i] = fds[i];
+      if (reading > 0 && (copy[i].events & (POLLIN | POLLRDNORM))) {
+        copy[i].events &= ~(POLLIN | POLLRDNORM);
+        delay = delay == 0 || reading < delay ? reading : delay;
+      }
+      if (writing > 0 && (copy[i].events & (POLLOUT | POLLWRNORM))) {
+        copy[i].events &= ~(POLLOUT | POLLWRNORM);
+        delay = delay == 0 || writing < delay ? writing : delay;
+      }
+    }
+    releaseHanging(list, count);
+    Arena_release(inner);
+    if (delay == 0 && masking) {
+      /* Nothing is withheld, let the caller perform the call */
+      Arena_release(mark);
+      return -2;
+    }
+    masking = false;
+    wait  = waitTime(deadline, delay);
+    ts.tv_sec  = wait / 1000;
+    ts.tv_nsec = (wait % 1000) * 1000000;
+    errno = err;
+    ret   = sysppoll(copy, nfds, wait < 0 ? NULL : &ts, sigmask);
+  } while (ret == 0 && delay > 0 && (deadline < 0 || nowMSec() < deadline));
+  if (ret >= 0) {
+    for (i = 0 ; i < nfds ; ++i) {
+      fds[i].revents = copy[i].revents;
+    }
+  }
+  Arena_release(mark);
+  return ret;
+}
+
+int poll(struct pollfd* fds, nfds_t nfds, int timeout) {
+  int ret;
+
+  GET_SYSCALL(poll)
+  GET_SYSCALL(ppoll)
+  if (!config || !Action_hanging()
+      || (ret = pollWait(fds, nfds, timeout, NULL)) == -2) {
+    return syspoll(fds, nfds, timeout);
+  }
+  return ret;
+}
+
+int ppoll(struct pollfd* fds, nfds_t nfds, const struct timespec* timeout,
+          const sigset_t* sigmask) {
+  int ret;
+
+  GET_SYSCALL(ppoll)
+  if (!config || !Action_hanging()
+      || (ret = pollWait(fds, nfds,
+                         timeout ? timeoutMSec(timeout->tv_sec, timeout->tv_nsec) : -1,
+                         sigmask)) == -2) {
+    return sysppoll(fds, nfds, timeout, sigmask);
+  }
+  return ret;
+}
+
+
+/* select */
+
+int select(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds,
+           struct timeval* timeout) {
+  const int64_t deadline = timeout ? waitDeadline(timeoutMSec(timeout->tv_sec,
+                                                              timeout->tv_usec * 1000L))
+                                   : -1;
+  const int err = errno;
+  fd_set rcopy, wcopy, ecopy;
+  struct timeval tv;
+  SocketInfo** list;
+  ArenaMark mark;
+  bool masking = true;
+  int count;
+  int delay;
+  int ret;
+  int i;
+
+  GET_SYSCALL(select)
+  if (!config || !Action_hanging() || nfds > FD_SETSIZE) {
+    return sysselect(nfds, readfds, writefds, exceptfds, timeout);
+  }
+  do {
+    delay = 0;
+    mark  = Arena_mark();
+    list  = Action_hangingSockets(&count);
+    FD_ZERO(&rcopy);
+    FD_ZERO(&wcopy);
+    FD_ZERO(&ecopy);
+    for (i = 0 ; i < count ; ++i) {
+      const int fd = list[i]->fd;
+      const int reading = Action_hangDelay(list[i], Reading);
+      const int writing = Action_hangDelay(list[i], Writing);
+
+      if (fd < 0 || fd >= nfds) {
+        continue;
+      }
+      if (reading > 0 && readfds && FD_ISSET(fd, readfds)) {
+        FD_SET(fd, &rcopy);
+        delay = delay == 0 || reading < delay ? reading : delay;
+      }
+      if (writing > 0 && writefds && FD_ISSET(fd, writefds)) {
+        FD_SET(fd, &wcopy);
+        delay = delay == 0 || writing < delay ? writing : delay;
+      }
+    }
+    releaseHanging(list, count);
+    Arena_release(mark);
+    if (delay == 0 && masking) {
+      /* Nothing is withheld, let the caller perform the call */
+      return sysselect(nfds, readfds, writefds, exceptfds, timeout);
+    }
+    masking = false;
+
+    /* The copies hold the withheld descriptors, turn them into the sets to wait for */
+    for (i = 0 ; i < nfds ; ++i) {
+      if (readfds && FD_ISSET(i, readfds) != FD_ISSET(i, &rcopy)) {
+        FD_SET(i, &rcopy);
+      } else {
+        FD_CLR(i, &rcopy);
+      }
+      if (writefds && FD_ISSET(i, writefds) != FD_ISSET(i, &wcopy)) {
+        FD_SET(i, &wcopy);
+      } else {
+        FD_CLR(i, &wcopy);
+      }
+      if (exceptfds && FD_ISSET(i, exceptfds)) {
+        FD_SET(i, &ecopy);
+      }
+    }
+    i = waitTime(deadline, delay);
+    tv.tv_sec  = i / 1000;
+    tv.tv_usec = (i % 1000) * 1000;
+    errno = err;
+    ret   = sysselect(nfds, readfds ? &rcopy : NULL, writefds ? &wcopy : NULL,
+                      exceptfds ? &ecopy : NULL, i < 0 ? NULL : &tv);
+  } while (ret == 0 && delay > 0 && (deadline < 0 || nowMSec() < deadline));
+  if (ret >= 0) {
+    if (readfds) {
+      *readfds = rcopy;
+    }
+    if (writefds) {
+      *writefds = wcopy;
+    }
+    if (exceptfds) {
+      *exceptfds = ecopy;
+    }
+    if (timeout) {
+      i = waitTime(deadline, 0);
+      timeout->tv_sec  = i / 1000;
+      timeout->tv_usec = (i % 1000) * 1000;
+    }
+  }
+  return ret;
+}
+
+
+/*** A new connection has been accepted... */
+
+static ssize_t acceptCB(int fd, void* buf, size_t len, int flags, void* data) {
+  return *(int*)data;
+}
+
+/** Get informations about a listening socket.
+ */
+static inline SocketInfo* getListenerInfos(int fd) {
+  SocketInfo* si = SocketTable_get(sockets, fd);
+  if (si && si->remote.type == AH_None) {
+    return si;
+  }
+  SocketInfo_unlock(si);
+  si = SocketInfo_initListener(fd);
+  if (si) {
+    (void)SocketTable_put(sockets, fd, si);
+  }
+  return si;
+}
+
+int listen(int fd, int backlog) {
+  SocketInfo* si = NULL;
+  SocketKind kind;
+  int ret;
+
+  GET_SYSCALL(listen)
+  ret = syslisten(fd, backlog);
+  if (ret == 0 && !bypass && config && sockets
+      && SocketKind_class(kind = SocketTable_kind(sockets, fd, NULL)) == SK_Unknown
+      && mayMatch(kind, Accepting, -1)) {
+    /* Build the listener infos now rather than on the first accept */
+    si = getListenerInfos(fd);
+  }
+  RELEASE_SI
+  return ret;
+}
+
+/** Register an accepted socket and process the accepting rules.
+ *
+ * The SocketInfo of the new socket is built from the address returned by
+ * accept and from the listening socket, unless no rule may match it: it is
+ * then built by the first call that needs it. If a rule aborts the call, the
+ * accepted socket is closed.
+ *
+ * @param fd       The listening socket.
+ * @param ret      The result of accept.
+ * @param addr     The address of the peer.
+ * @param size     The size of the address buffer.
+ * @param addr_len The length of the address.
+ * @param blocking True if the accepted socket is blocking.
+ * @return The result of the call.
+ */
+static int acceptInfos(int fd, int ret, struct sockaddr* addr, socklen_t size,
+                       socklen_t* addr_len, bool blocking) {
+  SocketInfo* listener = NULL;
+  SocketInfo* si = NULL;
+  SocketKind kind;
+  unsigned int stamp;
+  ssize_t res;
+
+  if (ret < 0) {
+    return ret;
+  }
+  kind = dupKind(fd);
+  forgetInfos(ret, kind);
+  if (bypass || !config || !sockets || SocketKind_class(kind) != SK_Unknown) {
+    return ret;
+  }
+  if (size >= *addr_len && (listener = getListenerInfos(fd)) != NULL) {
+    (void)SocketTable_kind(sockets, ret, &stamp);
+    if (ActionQueue_mayMatch(config->queue, Accepting | Data | Closing, listener->proto, -1)) {
+      si = SocketInfo_initAccepted(ret, listener, addr, *addr_len, blocking);
+    } else {
+      /* No rule needs the socket yet, its infos are built on its first use */
+      (void)SocketTable_classify(sockets, ret, stamp,
+                                 SocketKind_make(SK_Socket | SK_Accepted, listener->proto));
+    }
+    SocketInfo_unlock(listener);
+  }
+  if (si == NULL) {
+    return ret;
+  }
+  (void)SocketTable_put(sockets, ret, si);
+  (void)SocketTable_classify(sockets, ret, stamp, SocketKind_make(SK_Socket, si->proto));
+  if (ActionQueue_mayMatch(config->queue, Accepting, si->proto, -1)) {
+    res = ActionQueue_process(config->queue, si, Accepting, acceptCB, NULL, 0, 0, &ret);
+    if (res != ret) {
+      int err = res < 0 ? errno : ECONNABORTED;
+      forgetInfos(ret, SK_Unknown);
+      sysclose(ret);
+      errno = err;
+      ret = -1;
+    }
+  }
+  SocketInfo_unlock(si);
+  return ret;
+}
+
+int accept(int fd, struct sockaddr* __restrict addr, socklen_t* __restrict addr_len) {
+  struct sockaddr_storage peer;
+  socklen_t peerlen = sizeof(peer);
+  socklen_t size;
+  int ret;
+
+  GET_SYSCALL(accept)
+  if (addr == NULL) {
+    addr     = (struct sockaddr*)&peer;
+    addr_len = &peerlen;
+  }
+  size = addr_len ? *addr_len : 0;
+  ret  = sysaccept(fd, addr, addr_len);
+  return acceptInfos(fd, ret, addr, size, addr_len, true);
+}
+
+int accept4(int fd, struct sockaddr* __restrict addr, socklen_t* __restrict addr_len,
+            int flags) {
+  struct sockaddr_storage peer;
+  socklen_t peerlen = sizeof(peer);
+  socklen_t size;
+  int ret;
+
+  GET_SYSCALL(accept4)
+  if (addr == NULL) {
+    addr     = (struct sockaddr*)&peer;
+    addr_len = &peerlen;
+  }
+  size = addr_len ? *addr_len : 0;
+  ret  = sysaccept4(fd, addr, addr_len, flags);
+  return acceptInfos(fd, ret, addr, size, addr_len, !(flags & SOCK_NONBLOCK));
+}
+
+
+/*** Lib initialisation */
+
+/** Seed the random generator.
+ *
+ * The seed is taken from the LIBINJ_SEED variable, then from the
+ * configuration, a new one is drawn without them. The seed is always logged,
+ * with its origin, so that any run can be replayed.
+ */
+static void seedRandom(void) {
+  const char* env = getenv("LIBINJ_SEED");
+  const char* origin = "given";
+  uint64_t seed;
+
+  if (env != NULL && *env != '\0') {
+    seed = strtoull(env, NULL, 0);
+  } else if (config->seeded) {
+    seed = config->seed;
+  } else {
+    seed = Clock_now() ^ ((uint64_t)getpid() << 32) ^ (uint64_t)time(NULL);
+    origin = "drawn";
+  }
+  Binding_enter();
+  fprintf(stderr, "INFO random seed %llu %s (replay with LIBINJ_SEED)\n",
+          (unsigned long long)seed, origin);
+  Binding_leave();
+  Random_seed(seed);
+}
+
+/** Start the module.
+ */
+void inj_init(void) {
+  GET_SYSCALL(read)
+  GET_SYSCALL(readv)
   GET_SYSCALL(recv)
   GET_SYSCALL(recvfrom)
   GET_SYSCALL(recvmsg)
+  GET_SYSCALL(recvmmsg)
 
   GET_SYSCALL(write)
   GET_SYSCALL(writev)
   GET_SYSCALL(send)
   GET_SYSCALL(sendto)
   GET_SYSCALL(sendmsg)
+  GET_SYSCALL(sendmmsg)
+
+  GET_SYSCALL(sendfile)
+  GET_SYSCALL(sendfile64)
+  GET_SYSCALL(splice)
 
   GET_SYSCALL(connect)
+  GET_SYSCALL(bind)
+  GET_SYSCALL(listen)
   GET_SYSCALL(close)
+  GET_SYSCALL(close_range)
+  GET_SYSCALL(fclose)
+
+  GET_SYSCALL(open)
+  GET_SYSCALL(open64)
+  GET_SYSCALL(openat)
+  GET_SYSCALL(openat64)
+  GET_SYSCALL(creat)
+  GET_SYSCALL(pipe)
+  GET_SYSCALL(pipe2)
+  GET_SYSCALL(socket)
+  GET_SYSCALL(socketpair)
+  GET_SYSCALL(accept)
+  GET_SYSCALL(accept4)
+  GET_SYSCALL(dup)
+  GET_SYSCALL(dup2)
+  GET_SYSCALL(dup3)
+
+  GET_SYSCALL(fcntl)
+  GET_SYSCALL(fcntl64)
+  GET_SYSCALL(ioctl)
+
+  GET_SYSCALL(epoll_ctl)
+  GET_SYSCALL(epoll_wait)
+  GET_SYSCALL(epoll_pwait)
+  GET_SYSCALL(poll)
+  GET_SYSCALL(ppoll)
+  GET_SYSCALL(select)
 
   ActionSet_init();
 
@@ -556,12 +2242,13 @@ void inj_init(void) {
     config  = NULL;
     sockets = NULL;
   } else {
-    sockets = LigHT_init(16380, NULL);
+    sockets = SocketTable_init();
     if ((config = Config_init(getenv("LIBINJ_CONFIG"))) == NULL) {
       config = Config_init(DEFAULT_CONFIG);
     }
   }
   if (config) {
+    seedRandom();
     Runtime_start(config);
   }
 }
@@ -570,7 +2257,7 @@ void inj_init(void) {
  */
 void inj_fini(void) {
   if (sockets) {
-    LigHT_destroy(sockets);
+    SocketTable_destroy(sockets);
   }
   if (config) {
     Config_destroy(config);
@@ -0,0 +1,84 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#ifndef _BINDING_H_
+#define _BINDING_H_
+
+#include <sys/types.h>
+
+/** @defgroup Binding Internal I/O of the library
+ *
+ * The library performs its own I/O (logs, runtime interface, spliced data)
+ * through the same functions it intercepts. The calls issued by the library
+ * must not be seen by the rules: they are performed either in a bypass
+ * section, in which the wrappers go straight to the syscall after a single
+ * thread-local check, or directly through the syscalls resolved by the
+ * wrappers. @{
+ */
+
+/** Enter a bypass section.
+ *
+ * All the calls performed by the current thread until the matching
+ * Binding_leave are forwarded to the syscall without looking at the rules.
+ * The file descriptors opened and closed in the section are still tracked.
+ * Sections can be nested.
+ */
+void Binding_enter(void);
+
+/** Leave a bypass section.
+ */
+void Binding_leave(void);
+
+/** Read from a file descriptor without interception.
+ */
+ssize_t Binding_read(int fd, void* buf, size_t len);
+
+/** Write to a file descriptor without interception.
+ */
+ssize_t Binding_write(int fd, const void* buf, size_t len);
+
+/** Copy the data at the head of a pipe without consuming it.
+ *
+ * @return The number of bytes copied, or -1 on error (EINVAL if the file
+ *         descriptor is not a pipe).
+ */
+ssize_t Binding_peek(int fd, void* buf, size_t len);
+
+/** Get the room left in a pipe.
+ *
+ * @return The number of bytes the pipe can take without blocking, or -1 if
+ *         the file descriptor is not a pipe.
+ */
+ssize_t Binding_pipeRoom(int fd);
+
+/** @} */
+
+#endif
@@ -0,0 +1,91 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#ifndef _CLOCK_H_
+#define _CLOCK_H_
+
+#include <stdint.h>
+#include <time.h>
+
+/** @defgroup Clock Time source
+ *
+ * The rules measure time on the monotonic clock, so that a step of the wall
+ * clock does not shift their deadlines. Times are given in nanoseconds.
+ *
+ * Two reads are available: Clock_now is precise and is used to time the
+ * hangs, Clock_coarse only has the resolution of the scheduler tick (a few
+ * milliseconds) but is much cheaper and is used by the conditions, which are
+ * checked on every call. The two clocks must not be compared. @{
+ */
+
+/** Number of nanoseconds in a millisecond.
+ */
+#define CLOCK_NSEC_PER_MSEC UINT64_C(1000000)
+
+/** Convert milliseconds to a clock duration.
+ */
+#define Clock_fromMSec(msec) ((uint64_t)(msec) * CLOCK_NSEC_PER_MSEC)
+
+/** Convert a clock time to milliseconds (rounded down).
+ */
+#define Clock_toMSec(nsec) ((nsec) / CLOCK_NSEC_PER_MSEC)
+
+/** Read a clock in nanoseconds.
+ */
+static inline uint64_t Clock_read(clockid_t clock) {
+  struct timespec ts;
+  (void)clock_gettime(clock, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/** Get the precise time of the monotonic clock.
+ *
+ * @return The time in nanoseconds.
+ */
+static inline uint64_t Clock_now(void) {
+  return Clock_read(CLOCK_MONOTONIC);
+}
+
+/** Get the coarse time of the monotonic clock.
+ *
+ * @return The time in nanoseconds, at the resolution of the scheduler tick.
+ */
+static inline uint64_t Clock_coarse(void) {
+#ifdef CLOCK_MONOTONIC_COARSE
+  return Clock_read(CLOCK_MONOTONIC_COARSE);
+#else
+  return Clock_read(CLOCK_MONOTONIC);
+#endif
+}
+
+/** @} */
+
+#endif
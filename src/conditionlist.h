@@ -0,0 +1,244 @@
+/* This file is automatically generated from the contents
+ * of the "conditions" directory
+ */
+
+#ifndef _AUTO_ActionCondition_H_
+#define _AUTO_ActionCondition_H_
+
+/** @defgroup ActionCondition Action conditions
+ *
+ * Automatically generated list of ActionCondition. @{
+ */
+
+/** List ActionCondition types.
+ */
+enum ActionConditionType {
+  
+  ACT_After = 0, /**<
+            <b>after [time]</b> The condition is true once the first [time]
+          milliseconds of the life of the rule are over. */
+  ACT_Age = 1, /**<
+            <b>age [op] [msec]</b> compare the time elapsed since the socket has
+          been seen first with a value in milliseconds, <b>op</b> is one of
+          &lt;, &lt;=, ==, !=, &gt;= and &gt; (eg. <code>age &gt; 30000</code>). */
+  ACT_Always = 2, /**<
+            <b>always</b> always true */
+  ACT_Before = 3, /**<
+            <b>before [time]</b> The condition is true during the first [time]
+          milliseconds of the life of the rule. */
+  ACT_Between = 4, /**<
+            <b>between [time1] [time2]</b> The condition is true between [time1]
+          and [time2], these times being number of milliseconds since the
+          creation of the rule. */
+  ACT_BytesRead = 5, /**<
+            <b>bytes-read [op] [bytes]</b> compare the number of bytes read on the
+          socket before the current call with a value, <b>op</b> is one of
+          &lt;, &lt;=, ==, !=, &gt;= and &gt; (eg. <code>bytes-read &gt; 1048576</code>). */
+  ACT_BytesWritten = 6, /**<
+            <b>bytes-written [op] [bytes]</b> compare the number of bytes written on the
+          socket before the current call with a value, <b>op</b> is one of
+          &lt;, &lt;=, ==, !=, &gt;= and &gt; (eg. <code>bytes-written &gt;= 65536</code>). */
+  ACT_CallsRead = 7, /**<
+            <b>calls-read [op] [calls]</b> compare the number of successful reads on the
+          socket before the current call with a value, <b>op</b> is one of
+          &lt;, &lt;=, ==, !=, &gt;= and &gt; (<code>calls-read == 2</code>
+          matches the third read). */
+  ACT_CallsWritten = 8, /**<
+            <b>calls-written [op] [calls]</b> compare the number of successful writes on the
+          socket before the current call with a value, <b>op</b> is one of
+          &lt;, &lt;=, ==, !=, &gt;= and &gt; (<code>calls-written == 2</code>
+          matches the third write). */
+  ACT_Contains = 9, /**<
+            <b>contains "[pattern]"</b> the data of the call contains the
+          pattern. The escapes \\, \", \n, \r, \t, \0 and \xHH are allowed
+          in the pattern. A read is performed before the condition is checked,
+          so the rules acting before the call (error, drop, truncate...) are
+          skipped on a read from there.
+          The patterns of all the rules are looked for in a single pass; the
+          data is skipped fastest when they start with at most 3 different
+          bytes, and the conditions beyond the first 2048 are searched alone. */
+  ACT_Cycle = 10, /**<
+            <b>cycle [first] [firsttime] [sndtime]</b> This condition is
+          alternatively true or false depending on the time elapsed since
+          the creation of the rule. [firsttime] is the during which the
+          condition will have the value of [first], [sndtime] is the duration
+          of the contrary. eg <code>cycle true 10000 5000</code> will be
+          true during 10 seconds, then false during 5 seconds, and then
+          true for 10 seconds again... */
+  ACT_Expression = 11, /**<
+            <b>[cond] and [cond]</b>, <b>[cond] or [cond]</b>, <b>not [cond]</b>,
+          <b>( [cond] )</b> combine conditions, <b>and</b> binding tighter than
+          <b>or</b> (eg. <code>prob 5 and after 60000 and not matched</code>).
+          The operands are checked the cheapest first and the evaluation
+          stops once the result is known. At most 8 conditions are allowed. */
+  ACT_Len = 12, /**<
+            <b>len [op] [bytes]</b> compare the length of the call with a value:
+          the size of the data of a write, the size of the buffer of a read
+          or of the received data once the read has been performed (eg.
+          <code>len &gt; 65536</code>). The operators are the ones of bytes-read. */
+  ACT_Matched = 13, /**<
+            <b>matched</b> the socket has matched a previous rule */
+  ACT_MatchesAny = 14, /**<
+            <b>matches-any @[file]</b> the data of the call contains one of
+          the patterns of the file (one per line, empty lines and lines
+          starting with # are ignored, a line starting with " is read as in
+          <code>contains</code>). A read is performed before the condition is checked
+          (see <code>contains</code>). */
+  ACT_Never = 15, /**<
+            <b>never</b> can be useful */
+  ACT_NthConnection = 16, /**<
+            <b>nth-connection [rank]</b> the socket is the given connection with
+          its peer, starting at 1. The peer is the remote host and the service:
+          the remote port of an outgoing connection, the local port of an
+          accepted one (eg. <code>nth-connection 2</code> matches the second
+          connection to a server). */
+  ACT_Port = 17, /**<
+            <b>port [op] [port]</b> compare the remote port of the socket with a
+          value (eg. <code>port != 53</code>). The operators are the ones of
+          bytes-read, the sockets without port never match. */
+  ACT_Prob = 18, /**<
+            <b>prob [percent]</b> probability of the condition to be truc
+          <code>prob 100</code> is the same as always and <code>prod 0</code>
+          is 'never'. The draws are reproducible: see LIBINJ_SEED. */
+  ACT_RateBytes = 19, /**<
+            <b>rate-bytes [scope] [op] [bytes]/s</b> compare the number of bytes
+          transferred during the last second with a value. The scope is the
+          one of rate-ops, the value may be followed by K, M or G and by B
+          (eg. <code>rate-bytes &gt; 100MB/s</code>). */
+  ACT_RateOps = 20, /**<
+            <b>rate-ops [scope] [op] [calls]/s</b> compare the number of successful
+          data calls of the last second with a value. The optional <b>scope</b>
+          is <b>per socket</b> (the default), <b>per peer</b> (all the connections
+          with the remote host) or <b>per rule</b> (all the sockets the rule may
+          match), the value may be followed by K, M or G
+          (eg. <code>rate-ops per peer &gt; 5K/s</code>). */
+  ACT_Unmatched = 21, /**<
+            <b>unmatched</b> the socket has not matched a rule yet */
+  ACT_Number = 22   /**< Number of ActionConditionType */
+};
+
+
+/** Register After
+ */
+ActionConditionRegisterer ActionAfter_register;
+
+/** Register Age
+ */
+ActionConditionRegisterer ActionAge_register;
+
+/** Register Always
+ */
+ActionConditionRegisterer ActionAlways_register;
+
+/** Register Before
+ */
+ActionConditionRegisterer ActionBefore_register;
+
+/** Register Between
+ */
+ActionConditionRegisterer ActionBetween_register;
+
+/** Register BytesRead
+ */
+ActionConditionRegisterer ActionBytesRead_register;
+
+/** Register BytesWritten
+ */
+ActionConditionRegisterer ActionBytesWritten_register;
+
+/** Register CallsRead
+ */
+ActionConditionRegisterer ActionCallsRead_register;
+
+/** Register CallsWritten
+ */
+ActionConditionRegisterer ActionCallsWritten_register;
+
+/** Register Contains
+ */
+ActionConditionRegisterer ActionContains_register;
+
+/** Register Cycle
+ */
+ActionConditionRegisterer ActionCycle_register;
+
+/** Register Expression
+ */
+ActionConditionRegisterer ActionExpression_register;
+
+/** Register Len
+ */
+ActionConditionRegisterer ActionLen_register;
+
+/** Register Matched
+ */
+ActionConditionRegisterer ActionMatched_register;
+
+/** Register MatchesAny
+ */
+ActionConditionRegisterer ActionMatchesAny_register;
+
+/** Register Never
+ */
+ActionConditionRegisterer ActionNever_register;
+
+/** Register NthConnection
+ */
+ActionConditionRegisterer ActionNthConnection_register;
+
+/** Register Port
+ */
+ActionConditionRegisterer ActionPort_register;
+
+/** Register Prob
+ */
+ActionConditionRegisterer ActionProb_register;
+/** match Prob
+ */
+ActionMatcher   ActionProb_match;
+
+/** Register RateBytes
+ */
+ActionConditionRegisterer ActionRateBytes_register;
+
+/** Register RateOps
+ */
+ActionConditionRegisterer ActionRateOps_register;
+
+/** Register Unmatched
+ */
+ActionConditionRegisterer ActionUnmatched_register;
+
+
+/** Macro to run to register all the ActionCondition
+ *
+ * @param set The definition set to initialize.
+ */
+#define BUILD_INIT_AC(set) \
+  ActionAfter_register((set) + ACT_After); \
+  ActionAge_register((set) + ACT_Age); \
+  ActionAlways_register((set) + ACT_Always); \
+  ActionBefore_register((set) + ACT_Before); \
+  ActionBetween_register((set) + ACT_Between); \
+  ActionBytesRead_register((set) + ACT_BytesRead); \
+  ActionBytesWritten_register((set) + ACT_BytesWritten); \
+  ActionCallsRead_register((set) + ACT_CallsRead); \
+  ActionCallsWritten_register((set) + ACT_CallsWritten); \
+  ActionContains_register((set) + ACT_Contains); \
+  ActionCycle_register((set) + ACT_Cycle); \
+  ActionExpression_register((set) + ACT_Expression); \
+  ActionLen_register((set) + ACT_Len); \
+  ActionMatched_register((set) + ACT_Matched); \
+  ActionMatchesAny_register((set) + ACT_MatchesAny); \
+  ActionNever_register((set) + ACT_Never); \
+  ActionNthConnection_register((set) + ACT_NthConnection); \
+  ActionPort_register((set) + ACT_Port); \
+  ActionProb_register((set) + ACT_Prob); \
+  ActionRateBytes_register((set) + ACT_RateBytes); \
+  ActionRateOps_register((set) + ACT_RateOps); \
+  ActionUnmatched_register((set) + ACT_Unmatched); \
+  
+
+/** @} */
+
+#endif
@@ -32,24 +32,37 @@
 #include "../actionsdk.h"
 
 /* @@TYPE@@ After
- * @@DOC@@  <b>before [time]</b> The condition is true during the first [time]
- * @@DOC@@  milliseconds of the life of the rule.
+ * @@DOC@@  <b>after [time]</b> The condition is true once the first [time]
+ * @@DOC@@  milliseconds of the life of the rule are over.
  */
 
 static bool ActionAfter_argument(const char** from, void* dest,
                                  const void* constraint, ParserStatus* status) {
   ActionData* data = (ActionData*)dest;
-  data[1].ul = getMSecTime();
-  return Parse_int(from, &data[0].i, NULL, status);
+  if (!Parse_int(from, &data[0].i, NULL, status)) {
+    return false;
+  }
+  /* Deadline of the condition, 0 once it is over */
+  data[1].ul = Clock_coarse() + Clock_fromMSec(data[0].i < 0 ? 0 : data[0].i);
+  return true;
 }
 
-static void ActionAfter_write(char** buffer, ActionData* data) {
-  *buffer += sprintf(*buffer, "after %d ", data[0].i);
+static void ActionAfter_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "after %d ", data[0].i);
 }
 
 static bool ActionAfter_match(ActionData* data, SocketInfo* si,
-                              SocketInfoDirection direction, bool matched) {
-  return (getMSecTime() - data[1].ul) >= (uint64_t)data[0].i;
+                              SocketInfoDirection direction, bool matched,
+                              ActionCallData* state) {
+  if (data[1].ul == 0) {
+    return true;
+  }
+  if (Clock_coarse() < data[1].ul) {
+    return false;
+  }
+  /* The condition is true forever, stop reading the clock */
+  data[1].ul = 0;
+  return true;
 }
 
 void ActionAfter_register(ActionConditionDefinition* definition) {
@@ -59,4 +72,5 @@ void ActionAfter_register(ActionConditionDefinition* definition) {
   definition->match    = ActionAfter_match;
   definition->write    = ActionAfter_write;
   definition->close    = NULL;
+  definition->cost     = ACC_Clock;
 }
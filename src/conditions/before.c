@@ -39,17 +39,30 @@
 static bool ActionBefore_argument(const char** from, void* dest,
                                   const void* constraint, ParserStatus* status) {
   ActionData* data = (ActionData*)dest;
-  data[1].ul = getMSecTime();
-  return Parse_int(from, &data[0].i, NULL, status);
+  if (!Parse_int(from, &data[0].i, NULL, status)) {
+    return false;
+  }
+  /* Deadline of the condition, 0 once it is over */
+  data[1].ul = Clock_coarse() + Clock_fromMSec(data[0].i < 0 ? 0 : data[0].i);
+  return true;
 }
 
-static void ActionBefore_write(char** buffer, ActionData* data) {
-  *buffer += sprintf(*buffer, "before %d ", data[0].i);
+static void ActionBefore_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "before %d ", data[0].i);
 }
 
 static bool ActionBefore_match(ActionData* data, SocketInfo* si,
-                              SocketInfoDirection direction, bool matched) {
-  return (getMSecTime() - data[1].ul) < (uint64_t)data[0].i;
+                              SocketInfoDirection direction, bool matched,
+                              ActionCallData* state) {
+  if (data[1].ul == 0) {
+    return false;
+  }
+  if (Clock_coarse() < data[1].ul) {
+    return true;
+  }
+  /* The condition is false forever, stop reading the clock */
+  data[1].ul = 0;
+  return false;
 }
 
 void ActionBefore_register(ActionConditionDefinition* definition) {
@@ -59,4 +72,5 @@ void ActionBefore_register(ActionConditionDefinition* definition) {
   definition->match    = ActionBefore_match;
   definition->write    = ActionBefore_write;
   definition->close    = NULL;
+  definition->cost     = ACC_Clock;
 }
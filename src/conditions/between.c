@@ -45,21 +45,35 @@ static bool ActionBetween_argument(const char** from, void* dest,
   if (Parse_int(&source, &data[0].i, NULL, status)
       && Parse_space(&source, NULL, NULL, status)
       && Parse_int(&source, &data[1].i, NULL, status)) {
-    data[2].ul = getMSecTime();
+    const uint64_t now = Clock_coarse();
+    /* Start and end of the window, the end is 0 once it is over */
+    data[2].ul = now + Clock_fromMSec(data[0].i < 0 ? 0 : data[0].i);
+    data[3].ul = now + Clock_fromMSec(data[1].i < 0 ? 0 : data[1].i);
     *from = source;
     return true;
   }
   return false;
 }
 
-static void ActionBetween_write(char** buffer, ActionData* data) {
-  *buffer += sprintf(*buffer, "between %d %d ", data[0].i, data[1].i);
+static void ActionBetween_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "between %d %d ", data[0].i, data[1].i);
 }
 
 static bool ActionBetween_match(ActionData* data, SocketInfo* si,
-                              SocketInfoDirection direction, bool matched) {
-  uint64_t t = (getMSecTime() - data[1].ul);
-  return t >= (uint64_t)data[0].i && t < (uint64_t)data[1].i;
+                              SocketInfoDirection direction, bool matched,
+                              ActionCallData* state) {
+  uint64_t now;
+
+  if (data[3].ul == 0) {
+    return false;
+  }
+  now = Clock_coarse();
+  if (now >= data[3].ul) {
+    /* The window is over, stop reading the clock */
+    data[3].ul = 0;
+    return false;
+  }
+  return now >= data[2].ul;
 }
 
 void ActionBetween_register(ActionConditionDefinition* definition) {
@@ -69,4 +83,5 @@ void ActionBetween_register(ActionConditionDefinition* definition) {
   definition->match    = ActionBetween_match;
   definition->write    = ActionBetween_write;
   definition->close    = NULL;
+  definition->cost     = ACC_Clock;
 }
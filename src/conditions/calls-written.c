@@ -0,0 +1,60 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#include "../actionsdk.h"
+
+/* @@TYPE@@   CallsWritten
+ * @@DOC@@    <b>calls-written [op] [calls]</b> compare the number of successful writes on the
+ * @@DOC@@    socket before the current call with a value, <b>op</b> is one of
+ * @@DOC@@    &lt;, &lt;=, ==, !=, &gt;= and &gt; (<code>calls-written == 2</code>
+ * @@DOC@@    matches the third write).
+ */
+
+static void ActionCallsWritten_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "calls-written ");
+  ActionComparison_write(buffer, end, data);
+}
+
+static bool ActionCallsWritten_match(ActionData* data, SocketInfo* si,
+                                     SocketInfoDirection direction, bool matched,
+                                     ActionCallData* state) {
+  return ActionComparison_test(data, si->counters.calls[COUNTER_SLOT(Writing)]);
+}
+
+void ActionCallsWritten_register(ActionConditionDefinition* definition) {
+  definition->type        = ACT_CallsWritten;
+  definition->name        = "calls-written";
+  definition->argument    = ActionComparison_parse;
+  definition->match       = ActionCallsWritten_match;
+  definition->write       = ActionCallsWritten_write;
+  definition->close       = NULL;
+  definition->countsCalls = true;
+}
@@ -0,0 +1,84 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#include "../actionsdk.h"
+
+/* @@TYPE@@   Contains
+ * @@DOC@@    <b>contains "[pattern]"</b> the data of the call contains the
+ * @@DOC@@    pattern. The escapes \\, \", \n, \r, \t, \0 and \xHH are allowed
+ * @@DOC@@    in the pattern. A read is performed before the condition is checked,
+ * @@DOC@@    so the rules acting before the call (error, drop, truncate...) are
+ * @@DOC@@    skipped on a read from there.
+ * @@DOC@@    The patterns of all the rules are looked for in a single pass; the
+ * @@DOC@@    data is skipped fastest when they start with at most 3 different
+ * @@DOC@@    bytes, and the conditions beyond the first 2048 are searched alone.
+ */
+
+static bool ActionContains_argument(const char** from, void* dest,
+                                    const void* constraint, ParserStatus* status) {
+  ActionData* data = (ActionData*)dest;
+  return Payload_parse(from, &data[0].p, NULL, status);
+}
+
+static void ActionContains_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "contains ");
+  Payload_write(buffer, end, (Payload*)data[0].p);
+  Action_print(buffer, end, " ");
+}
+
+static bool ActionContains_match(ActionData* data, SocketInfo* si,
+                                 SocketInfoDirection direction, bool matched,
+                                 ActionCallData* state) {
+  return ActionCallData_contains(state, si, (Payload*)data[0].p);
+}
+
+static int ActionContains_payloads(ActionData* data, const Payload** payloads, int max) {
+  if (max == 0) {
+    return 0;
+  }
+  payloads[0] = (Payload*)data[0].p;
+  return 1;
+}
+
+static void ActionContains_close(ActionData* data) {
+  Payload_destroy((Payload*)data[0].p);
+}
+
+void ActionContains_register(ActionConditionDefinition* definition) {
+  definition->type     = ACT_Contains;
+  definition->name     = "contains";
+  definition->argument = ActionContains_argument;
+  definition->match    = ActionContains_match;
+  definition->write    = ActionContains_write;
+  definition->close    = ActionContains_close;
+  definition->payloads = ActionContains_payloads;
+  definition->usesData = true;
+}
@@ -57,22 +57,49 @@ static bool ActionCycle_argument(const char** from, void* dest,
   if (!ret) {
     return false;
   }
-  data[3].ul = getMSecTime();
+  if (data[1].i < 0 || data[2].i < 0 || data[1].i + data[2].i == 0) {
+    return SET_PARSE_ERROR(*from, "Invalid cycle durations");
+  }
+  data[3].ul = Clock_coarse();
+  data[4].ul = 0;
   *from = source;
   return true;
 }
 
-static void ActionCycle_write(char** buffer, ActionData* data) {
-  *buffer += sprintf(*buffer, "cycle %s %d %d ", data[0].i ? "true" : "false",
+static void ActionCycle_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "cycle %s %d %d ", data[0].i ? "true" : "false",
                                                  data[1].i, data[2].i);
 }
 
+/** Compute the state of the cycle at the given time.
+ *
+ * @return The next transition shifted left by one, with the value of the
+ *         condition until that transition in the low bit.
+ */
+static uint64_t ActionCycle_state(const ActionData* data, uint64_t now) {
+  const uint64_t first  = Clock_fromMSec(data[1].i);
+  const uint64_t period = first + Clock_fromMSec(data[2].i);
+  const uint64_t phase  = (now - data[3].ul) % period;
+  const uint64_t start  = now - phase;
+
+  if (phase < first) {
+    return ((start + first) << 1) | !!data[0].i;
+  }
+  return ((start + period) << 1) | !data[0].i;
+}
+
 static bool ActionCycle_match(ActionData* data, SocketInfo* si,
-                              SocketInfoDirection direction, bool matched) {
-  uint32_t t;
-  t = (uint32_t)(uint64_t)(getMSecTime() - data[3].ul);
-  t %= data[1].i + data[2].i;
-  return (t < (uint32_t)data[1].i) ? !!data[0].i : !data[0].i;
+                              SocketInfoDirection direction, bool matched,
+                              ActionCallData* state) {
+  /* The state is a single word so that concurrent updates can't mix two
+   * states, the modulo is only computed on transitions */
+  uint64_t current = data[4].ul;
+  const uint64_t now = Clock_coarse();
+
+  if (now >= (current >> 1)) {
+    data[4].ul = current = ActionCycle_state(data, now);
+  }
+  return current & 1;
 }
 
 void ActionCycle_register(ActionConditionDefinition* definition) {
@@ -82,4 +109,5 @@ void ActionCycle_register(ActionConditionDefinition* definition) {
   definition->match    = ActionCycle_match;
   definition->write    = ActionCycle_write;
   definition->close    = NULL;
+  definition->cost     = ACC_Clock;
 }
@@ -0,0 +1,52 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+
+#include "../actionsdk.h"
+
+/* @@TYPE@@   Expression
+ * @@DOC@@    <b>[cond] and [cond]</b>, <b>[cond] or [cond]</b>, <b>not [cond]</b>,
+ * @@DOC@@    <b>( [cond] )</b> combine conditions, <b>and</b> binding tighter than
+ * @@DOC@@    <b>or</b> (eg. <code>prob 5 and after 60000 and not matched</code>).
+ * @@DOC@@    The operands are checked the cheapest first and the evaluation
+ * @@DOC@@    stops once the result is known. At most 8 conditions are allowed.
+ */
+
+void ActionExpression_register(ActionConditionDefinition* definition) {
+  definition->type     = ACT_Expression;
+  definition->name     = "expression";
+  definition->argument = NULL;
+  definition->match    = ActionExpression_match;
+  definition->write    = ActionExpression_write;
+  definition->close    = ActionExpression_close;
+  definition->payloads = ActionExpression_payloads;
+  definition->count    = ActionExpression_count;
+}
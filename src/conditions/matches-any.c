@@ -0,0 +1,81 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#include "../actionsdk.h"
+
+/* @@TYPE@@   MatchesAny
+ * @@DOC@@    <b>matches-any @[file]</b> the data of the call contains one of
+ * @@DOC@@    the patterns of the file (one per line, empty lines and lines
+ * @@DOC@@    starting with # are ignored, a line starting with " is read as in
+ * @@DOC@@    <code>contains</code>). A read is performed before the condition is checked
+ * @@DOC@@    (see <code>contains</code>).
+ */
+
+static bool ActionMatchesAny_argument(const char** from, void* dest,
+                                      const void* constraint, ParserStatus* status) {
+  ActionData* data = (ActionData*)dest;
+  return Payload_parseFile(from, &data[0].p, NULL, status);
+}
+
+static void ActionMatchesAny_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "matches-any ");
+  Payload_write(buffer, end, (Payload*)data[0].p);
+  Action_print(buffer, end, " ");
+}
+
+static bool ActionMatchesAny_match(ActionData* data, SocketInfo* si,
+                                   SocketInfoDirection direction, bool matched,
+                                   ActionCallData* state) {
+  return ActionCallData_contains(state, si, (Payload*)data[0].p);
+}
+
+static int ActionMatchesAny_payloads(ActionData* data, const Payload** payloads, int max) {
+  if (max == 0) {
+    return 0;
+  }
+  payloads[0] = (Payload*)data[0].p;
+  return 1;
+}
+
+static void ActionMatchesAny_close(ActionData* data) {
+  Payload_destroy((Payload*)data[0].p);
+}
+
+void ActionMatchesAny_register(ActionConditionDefinition* definition) {
+  definition->type     = ACT_MatchesAny;
+  definition->name     = "matches-any";
+  definition->argument = ActionMatchesAny_argument;
+  definition->match    = ActionMatchesAny_match;
+  definition->write    = ActionMatchesAny_write;
+  definition->close    = ActionMatchesAny_close;
+  definition->payloads = ActionMatchesAny_payloads;
+  definition->usesData = true;
+}
@@ -0,0 +1,70 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#include "../actionsdk.h"
+
+/* @@TYPE@@   NthConnection
+ * @@DOC@@    <b>nth-connection [rank]</b> the socket is the given connection with
+ * @@DOC@@    its peer, starting at 1. The peer is the remote host and the service:
+ * @@DOC@@    the remote port of an outgoing connection, the local port of an
+ * @@DOC@@    accepted one (eg. <code>nth-connection 2</code> matches the second
+ * @@DOC@@    connection to a server).
+ */
+
+static bool ActionNthConnection_argument(const char** from, void* dest,
+                                         const void* constraint, ParserStatus* status) {
+  ActionData* data = (ActionData*)dest;
+  const char* source = *from;
+  if (Parse_int(&source, &data[0].i, NULL, status) && data[0].i > 0) {
+    *from = source;
+    return true;
+  }
+  return SET_PARSE_ERROR(*from, "The rank of a connection must be positive");
+}
+
+static void ActionNthConnection_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "nth-connection %d ", data[0].i);
+}
+
+static bool ActionNthConnection_match(ActionData* data, SocketInfo* si,
+                                      SocketInfoDirection direction, bool matched,
+                                      ActionCallData* state) {
+  return si->counters.ordinal == (unsigned int)data[0].i;
+}
+
+void ActionNthConnection_register(ActionConditionDefinition* definition) {
+  definition->type     = ACT_NthConnection;
+  definition->name     = "nth-connection";
+  definition->argument = ActionNthConnection_argument;
+  definition->match    = ActionNthConnection_match;
+  definition->write    = ActionNthConnection_write;
+  definition->close    = NULL;
+}
@@ -0,0 +1,59 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+
+#include "../actionsdk.h"
+
+/* @@TYPE@@   Port
+ * @@DOC@@    <b>port [op] [port]</b> compare the remote port of the socket with a
+ * @@DOC@@    value (eg. <code>port != 53</code>). The operators are the ones of
+ * @@DOC@@    bytes-read, the sockets without port never match.
+ */
+
+static void ActionPort_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "port ");
+  ActionComparison_write(buffer, end, data);
+}
+
+static bool ActionPort_match(ActionData* data, SocketInfo* si,
+                             SocketInfoDirection direction, bool matched,
+                             ActionCallData* state) {
+  return si->remote.port >= 0 && ActionComparison_test(data, (uint64_t)si->remote.port);
+}
+
+void ActionPort_register(ActionConditionDefinition* definition) {
+  definition->type     = ACT_Port;
+  definition->name     = "port";
+  definition->argument = ActionComparison_parse;
+  definition->match    = ActionPort_match;
+  definition->write    = ActionPort_write;
+  definition->close    = NULL;
+}
@@ -35,7 +35,7 @@
  * @@EXPORT@@ match
  * @@DOC@@    <b>prob [percent]</b> probability of the condition to be truc
  * @@DOC@@    <code>prob 100</code> is the same as always and <code>prod 0</code>
- * @@DOC@@    is 'never'
+ * @@DOC@@    is 'never'. The draws are reproducible: see LIBINJ_SEED.
  */
 
 static bool ActionProb_argument(const char** from, void* dest,
@@ -44,20 +44,21 @@ static bool ActionProb_argument(const char** from, void* dest,
   const char* source = *from;
   if (Parse_int(&source, &data[0].i, NULL, status)
       && data[0].i >= 0 && data[0].i <= 100) {
+    data[1].ul = Random_threshold(data[0].i, 100);
     *from = source;
     return true;
   }
   return SET_PARSE_ERROR(*from, "Probability must be between 0 and 100");
 }
 
-static void ActionProb_write(char** buffer, ActionData* data) {
-  *buffer += sprintf(*buffer, "prob %d ", data[0].i);
+static void ActionProb_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "prob %d ", data[0].i);
 }
 
 bool ActionProb_match(ActionData* data, SocketInfo* si,
-                      SocketInfoDirection direction, bool matched) {
-  unsigned int val = rand();
-  return (val % 100) <= (unsigned int)data[0].i;
+                      SocketInfoDirection direction, bool matched,
+                      ActionCallData* state) {
+  return Random_chance(data[1].ul);
 }
 
 void ActionProb_register(ActionConditionDefinition* definition) {
@@ -67,4 +68,5 @@ void ActionProb_register(ActionConditionDefinition* definition) {
   definition->match    = ActionProb_match;
   definition->write    = ActionProb_write;
   definition->close    = NULL;
+  definition->cost     = ACC_Random;
 }
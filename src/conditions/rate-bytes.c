@@ -0,0 +1,69 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+
+#include "../actionsdk.h"
+
+/* @@TYPE@@   RateBytes
+ * @@DOC@@    <b>rate-bytes [scope] [op] [bytes]/s</b> compare the number of bytes
+ * @@DOC@@    transferred during the last second with a value. The scope is the
+ * @@DOC@@    one of rate-ops, the value may be followed by K, M or G and by B
+ * @@DOC@@    (eg. <code>rate-bytes &gt; 100MB/s</code>).
+ */
+
+static bool ActionRateBytes_argument(const char** from, void* dest,
+                                     const void* constraint, ParserStatus* status) {
+  return ActionRate_parse(from, dest, "B", status);
+}
+
+static void ActionRateBytes_write(char** buffer, const char* end, ActionData* data) {
+  Action_print(buffer, end, "rate-bytes ");
+  ActionRate_write(buffer, end, data);
+}
+
+static bool ActionRateBytes_match(ActionData* data, SocketInfo* si,
+                                  SocketInfoDirection direction, bool matched,
+                                  ActionCallData* state) {
+  const RateWindow* window = ActionRate_window(data, si);
+  return ActionComparison_test(data, window ? RateWindow_bytes(window, Clock_coarse()) : 0);
+}
+
+void ActionRateBytes_register(ActionConditionDefinition* definition) {
+  definition->type        = ACT_RateBytes;
+  definition->name        = "rate-bytes";
+  definition->argument    = ActionRateBytes_argument;
+  definition->match       = ActionRateBytes_match;
+  definition->write       = ActionRateBytes_write;
+  definition->close       = ActionRate_close;
+  definition->cost        = ACC_Clock;
+  definition->countsCalls = true;
+  definition->count       = ActionRate_count;
+}
@@ -36,7 +36,8 @@
  */
 
 static bool ActionUnmatched_match(ActionData* data, SocketInfo* si,
-                                SocketInfoDirection direction, bool matched) {
+                                SocketInfoDirection direction, bool matched,
+                                ActionCallData* state) {
   return !matched;
 }
 
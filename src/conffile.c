@@ -110,6 +110,8 @@ Config* Config_init(const char* file) {
   config->runtime.type = RT_None;
   config->runtime.file = NULL;
   config->command      = NULL;
+  config->seeded       = false;
+  config->seed         = 0;
   config->queue = ActionQueue_init(2000);
   status = ParserStatus_init();
 
@@ -157,7 +159,7 @@ Config* Config_init(const char* file) {
         break;
       }
     } else if (section == S_Runtime) {
-      static Parse_enumData d[] = { { "tcp", RT_TCP }, { "udp", RT_UDP }, { "pipe", RT_Pipe }, { "command", 2000 }, { NULL, RT_None } };
+      static Parse_enumData d[] = { { "tcp", RT_TCP }, { "udp", RT_UDP }, { "pipe", RT_Pipe }, { "command", 2000 }, { "seed", 2001 }, { NULL, RT_None } };
       static int type;
       static int port;
       static char* readfile = NULL;
@@ -177,6 +179,16 @@ Config* Config_init(const char* file) {
         break;
       } else if (type == 2000) {
         config->command = readfile;
+      } else if (type == 2001) {
+        if (readfile != NULL) {
+          fprintf(stderr, "Invalid seed: \"%s\"\n", line);
+          free(readfile);
+          readfile = NULL;
+          ok = false;
+          break;
+        }
+        config->seeded = true;
+        config->seed   = (uint64_t)port;
       } else {
         config->runtime.type = type;
         config->runtime.port = port;
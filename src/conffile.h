@@ -66,6 +66,8 @@ struct Config {
   ActionQueue*   queue;   /**< Message rule set. */
   struct Runtime runtime; /**< Runtime update source. */
   char*          command; /**< Path to the command to which the rules should be applied. */
+  bool           seeded;  /**< True if the file gives the seed of the random generator. */
+  uint64_t       seed;    /**< Seed of the random generator. */
 };
 
 /** Parse a configuration file...
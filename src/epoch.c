@@ -0,0 +1,203 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "epoch.h"
+
+/** Number of epochs that must elapse before an object can be freed.
+ */
+#define EPOCH_GRACE 2
+
+/** Number of retired objects that trigger a collection.
+ */
+#define EPOCH_COLLECT_THRESHOLD 64
+
+/** Per thread reader state.
+ */
+struct EpochThread {
+  volatile unsigned long epoch;  /**< Global epoch seen when entering. */
+  volatile int  active;          /**< Nesting level of the critical section. */
+  volatile int  used;            /**< True if the record is owned by a thread. */
+  struct EpochThread* next;      /**< Next record of the registry. */
+};
+
+/** A retired object.
+ */
+struct EpochRetired {
+  void*         ptr;             /**< The object. */
+  EpochFree*    free;            /**< The callback to release it. */
+  unsigned long epoch;           /**< Epoch of the retirement. */
+  struct EpochRetired* next;     /**< Next retired object. */
+};
+
+static volatile unsigned long globalEpoch = 0;
+static struct EpochThread* volatile threads = NULL;
+
+static pthread_mutex_t      retiredLock = PTHREAD_MUTEX_INITIALIZER;
+static struct EpochRetired* retired     = NULL;
+static size_t               retiredCount = 0;
+
+static pthread_once_t keyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t  key;
+static __thread struct EpochThread* self = NULL;
+
+static void Epoch_threadExit(void* data) {
+  struct EpochThread* thread = (struct EpochThread*)data;
+  thread->active = 0;
+  __sync_synchronize();
+  thread->used = 0;
+}
+
+static void Epoch_keyInit(void) {
+  (void)pthread_key_create(&key, Epoch_threadExit);
+}
+
+/** Get the record of the current thread, registering it if needed.
+ *
+ * Records are never freed: the record of an exited thread is reused by
+ * the next registering thread.
+ */
+static struct EpochThread* Epoch_self(void) {
+  struct EpochThread* thread;
+  if (self) {
+    return self;
+  }
+  pthread_once(&keyOnce, Epoch_keyInit);
+  for (thread = threads ; thread != NULL ; thread = thread->next) {
+    if (!thread->used && __sync_bool_compare_and_swap(&thread->used, 0, 1)) {
+      break;
+    }
+  }
+  if (thread == NULL) {
+    thread = (struct EpochThread*)malloc(sizeof(struct EpochThread));
+    if (thread == NULL) {
+      abort();
+    }
+    thread->active = 0;
+    thread->epoch  = 0;
+    thread->used   = 1;
+    do {
+      thread->next = threads;
+    } while (!__sync_bool_compare_and_swap(&threads, thread->next, thread));
+  }
+  (void)pthread_setspecific(key, thread);
+  self = thread;
+  return thread;
+}
+
+void Epoch_enter(void) {
+  struct EpochThread* thread = Epoch_self();
+  if (thread->active++ == 0) {
+    thread->epoch = globalEpoch;
+    __sync_synchronize();
+  }
+}
+
+void Epoch_leave(void) {
+  struct EpochThread* thread = self;
+  __sync_synchronize();
+  --thread->active;
+}
+
+/** Try to move to the next epoch.
+ *
+ * The epoch can move forward only if all the threads that are in a critical
+ * section have seen the current epoch.
+ */
+static unsigned long Epoch_tryAdvance(void) {
+  struct EpochThread* thread;
+  unsigned long epoch = globalEpoch;
+
+  __sync_synchronize();
+  for (thread = threads ; thread != NULL ; thread = thread->next) {
+    if (thread->used && thread->active && thread->epoch != epoch) {
+      return epoch;
+    }
+  }
+  (void)__sync_bool_compare_and_swap(&globalEpoch, epoch, epoch + 1);
+  return globalEpoch;
+}
+
+void Epoch_collect(void) {
+  struct EpochRetired*  ready = NULL;
+  struct EpochRetired** pos;
+  unsigned long epoch;
+
+  pthread_mutex_lock(&retiredLock);
+  epoch = Epoch_tryAdvance();
+  pos   = &retired;
+  while (*pos) {
+    struct EpochRetired* item = *pos;
+    if (epoch - item->epoch >= EPOCH_GRACE) {
+      *pos = item->next;
+      item->next = ready;
+      ready = item;
+      --retiredCount;
+    } else {
+      pos = &item->next;
+    }
+  }
+  pthread_mutex_unlock(&retiredLock);
+
+  while (ready) {
+    struct EpochRetired* item = ready;
+    ready = item->next;
+    item->free(item->ptr);
+    free(item);
+  }
+}
+
+void Epoch_retire(void* ptr, EpochFree* cb) {
+  struct EpochRetired* item;
+  bool collect;
+
+  if (ptr == NULL) {
+    return;
+  }
+  item = (struct EpochRetired*)malloc(sizeof(struct EpochRetired));
+  if (item == NULL) {
+    abort();
+  }
+  item->ptr  = ptr;
+  item->free = cb;
+  pthread_mutex_lock(&retiredLock);
+  item->epoch = globalEpoch;
+  item->next  = retired;
+  retired     = item;
+  collect     = ++retiredCount >= EPOCH_COLLECT_THRESHOLD;
+  pthread_mutex_unlock(&retiredLock);
+  if (collect) {
+    Epoch_collect();
+  }
+}
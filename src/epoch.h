@@ -0,0 +1,87 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#ifndef _EPOCH_H_
+#define _EPOCH_H_
+
+#include <stdbool.h>
+
+/** @defgroup Epoch Epoch based reclamation
+ *
+ * Readers of shared lock-free structures enter a critical section before
+ * loading a shared pointer and leave it once they do not use the pointed
+ * object anymore. Writers unpublish an object and retire it instead of
+ * freeing it: the object is released only when every thread that could
+ * have loaded the pointer has left its critical section.
+ *
+ * Entering and leaving a critical section only writes thread local data,
+ * so readers never wait on writers and never write on shared cache lines.
+ * Critical sections can be nested. @{
+ */
+
+/** Callback used to release a retired object.
+ *
+ * @param ptr The retired object.
+ */
+typedef void (EpochFree)(void* ptr);
+
+/** Enter a read critical section.
+ *
+ * Objects loaded from a shared structure inside the critical section stay
+ * valid until the matching Epoch_leave.
+ */
+void Epoch_enter(void);
+
+/** Leave a read critical section.
+ */
+void Epoch_leave(void);
+
+/** Retire an object.
+ *
+ * The object must already be unreachable for new readers. It will be released
+ * using the given callback once all the current readers are gone. This can be
+ * called from inside a critical section.
+ *
+ * @param ptr The object to release.
+ * @param cb  The callback used to release the object.
+ */
+void Epoch_retire(void* ptr, EpochFree* cb);
+
+/** Try to release the retired objects.
+ *
+ * This is called automatically by Epoch_retire, but can be called explicitly
+ * to flush the objects that are now safe to release.
+ */
+void Epoch_collect(void);
+
+/** @} */
+
+#endif
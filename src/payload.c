@@ -0,0 +1,687 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "payload.h"
+
+/** Longest line of a pattern file.
+ */
+#define PAYLOAD_LINE_MAX 4096
+
+/** Largest transition table of a scanner (in entries).
+ */
+#define PAYLOAD_TABLE_MAX (1 << 26)
+
+/** Largest number of bytes starting the patterns looked for a word at a
+ * time (like memchr2 and memchr3), the scan checks each byte beyond.
+ */
+#define PAYLOAD_PREFILTER_MAX 3
+
+/** A byte repeated in each byte of a word.
+ */
+#define PAYLOAD_SPLAT(byte) (UINT64_C(0x0101010101010101) * (uint8_t)(byte))
+
+/** Non zero if a word has a zero byte (may also flag the bytes above it).
+ */
+#define PAYLOAD_HAS_ZERO(word) (((word) - UINT64_C(0x0101010101010101)) & ~(word) \
+                                & UINT64_C(0x8080808080808080))
+
+/** Add a pattern to a payload.
+ *
+ * @return false if the memory is exhausted.
+ */
+static bool Payload_add(Payload* payload, const char* pattern, size_t len) {
+  char**  patterns;
+  size_t* lengths;
+  char*   copy;
+
+  patterns = (char**)realloc(payload->patterns, (payload->count + 1) * sizeof(char*));
+  if (patterns == NULL) {
+    return false;
+  }
+  payload->patterns = patterns;
+  lengths = (size_t*)realloc(payload->lengths, (payload->count + 1) * sizeof(size_t));
+  if (lengths == NULL) {
+    return false;
+  }
+  payload->lengths = lengths;
+  copy = (char*)malloc(len);
+  if (copy == NULL) {
+    return false;
+  }
+  memcpy(copy, pattern, len);
+  payload->patterns[payload->count] = copy;
+  payload->lengths[payload->count]  = len;
+  ++payload->count;
+  return true;
+}
+
+/** Get the value of an hexadecimal digit.
+ *
+ * @return The value, or -1 if the character is not a digit.
+ */
+static inline int Payload_hex(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  } else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+/** Read a quoted literal.
+ *
+ * @param from   Pointer on the opening quote, moved after the closing quote.
+ * @param buffer Receive the bytes of the literal (PAYLOAD_LITERAL_MAX bytes).
+ * @param len    Receive the length of the literal.
+ * @return NULL on success, or an error message.
+ */
+static const char* Payload_literal(const char** from, char* buffer, size_t* len) {
+  const char* pos = *from;
+
+  if (*pos != '"') {
+    return "Quoted pattern expected";
+  }
+  ++pos;
+  *len = 0;
+  while (*pos != '"') {
+    char c = *pos++;
+    if (c == '\0') {
+      return "Unterminated pattern";
+    }
+    if (c == '\\') {
+      switch (*pos++) {
+       case '\\': c = '\\'; break;
+       case '"':  c = '"';  break;
+       case 'n':  c = '\n'; break;
+       case 'r':  c = '\r'; break;
+       case 't':  c = '\t'; break;
+       case '0':  c = '\0'; break;
+       case 'x':
+        if (Payload_hex(pos[0]) < 0 || Payload_hex(pos[1]) < 0) {
+          return "Invalid hexadecimal escape";
+        }
+        c = (char)(Payload_hex(pos[0]) << 4 | Payload_hex(pos[1]));
+        pos += 2;
+        break;
+       default:
+        return "Invalid escape sequence";
+      }
+    }
+    if (*len == PAYLOAD_LITERAL_MAX) {
+      return "Pattern too long";
+    }
+    buffer[(*len)++] = c;
+  }
+  if (*len == 0) {
+    return "Empty pattern";
+  }
+  *from = pos + 1;
+  return NULL;
+}
+
+bool Payload_parse(const char** from, void* dest, const void* constraint,
+                   ParserStatus* status) {
+  char buffer[PAYLOAD_LITERAL_MAX];
+  const char* pos = *from;
+  const char* error;
+  Payload* payload;
+  size_t len;
+
+  *(Payload**)dest = NULL;
+  if ((error = Payload_literal(&pos, buffer, &len)) != NULL) {
+    return SET_PARSE_ERROR(*from, error);
+  }
+  payload = (Payload*)calloc(1, sizeof(Payload));
+  if (payload == NULL || !Payload_add(payload, buffer, len)) {
+    Payload_destroy(payload);
+    return SET_PARSE_ERROR(*from, "Not enough memory");
+  }
+  *(Payload**)dest = payload;
+  *from = pos;
+  return CLEAR_PARSE_ERROR;
+}
+
+/** Read the patterns of a file.
+ *
+ * @return NULL on success, or an error message.
+ */
+static const char* Payload_load(Payload* payload, const char* path) {
+  char line[PAYLOAD_LINE_MAX];
+  char buffer[PAYLOAD_LITERAL_MAX];
+  const char* error = NULL;
+  FILE* file;
+
+  file = fopen(path, "r");
+  if (file == NULL) {
+    return "Can't open the pattern file";
+  }
+  while (error == NULL && fgets(line, sizeof(line), file) != NULL) {
+    size_t len = strlen(line);
+    if (len == sizeof(line) - 1 && line[len - 1] != '\n') {
+      error = "Pattern too long in the pattern file";
+      break;
+    }
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+      line[--len] = '\0';
+    }
+    if (len == 0 || line[0] == '#') {
+      continue;
+    }
+    if (line[0] == '"') {
+      const char* pos = line;
+      if ((error = Payload_literal(&pos, buffer, &len)) != NULL) {
+        break;
+      }
+      if (!Payload_add(payload, buffer, len)) {
+        error = "Not enough memory";
+      }
+    } else if (!Payload_add(payload, line, len)) {
+      error = "Not enough memory";
+    }
+  }
+  fclose(file);
+  if (error == NULL && payload->count == 0) {
+    error = "No pattern in the pattern file";
+  }
+  return error;
+}
+
+bool Payload_parseFile(const char** from, void* dest, const void* constraint,
+                       ParserStatus* status) {
+  const char* pos = *from;
+  const char* error;
+  Payload* payload;
+  char* path;
+
+  *(Payload**)dest = NULL;
+  if (*pos != '@') {
+    return SET_PARSE_ERROR(*from, "Pattern file expected (@file)");
+  }
+  ++pos;
+  if (!Parse_word(&pos, &path, NULL, status)) {
+    return false;
+  }
+  payload = (Payload*)calloc(1, sizeof(Payload));
+  if (payload == NULL) {
+    free(path);
+    return SET_PARSE_ERROR(*from, "Not enough memory");
+  }
+  payload->file = path;
+  if ((error = Payload_load(payload, path)) != NULL) {
+    Payload_destroy(payload);
+    return SET_PARSE_ERROR(*from, error);
+  }
+  *(Payload**)dest = payload;
+  *from = pos;
+  return CLEAR_PARSE_ERROR;
+}
+
+/** Append a string to a buffer if it fits in whole.
+ *
+ * @return true if the string has been written.
+ */
+static bool Payload_append(char** buffer, const char* end, const char* text) {
+  const size_t len = strlen(text);
+
+  if (len >= (size_t)(end - *buffer)) {
+    return false;
+  }
+  (void)memcpy(*buffer, text, len + 1);
+  *buffer += len;
+  return true;
+}
+
+void Payload_write(char** buffer, const char* end, const Payload* payload) {
+  const unsigned char* pattern;
+  char escaped[5];
+  size_t i;
+
+  if (*buffer >= end) {
+    return;
+  }
+  **buffer = '\0';
+  if (payload->file) {
+    (void)(Payload_append(buffer, end, "@") && Payload_append(buffer, end, payload->file));
+    return;
+  }
+  pattern = (const unsigned char*)payload->patterns[0];
+  if (!Payload_append(buffer, end, "\"")) {
+    return;
+  }
+  for (i = 0 ; i < payload->lengths[0] ; ++i) {
+    switch (pattern[i]) {
+     case '\\': (void)strcpy(escaped, "\\\\"); break;
+     case '"':  (void)strcpy(escaped, "\\\""); break;
+     case '\n': (void)strcpy(escaped, "\\n"); break;
+     case '\r': (void)strcpy(escaped, "\\r"); break;
+     case '\t': (void)strcpy(escaped, "\\t"); break;
+     default:
+      if (isprint(pattern[i])) {
+        escaped[0] = pattern[i];
+        escaped[1] = '\0';
+      } else {
+        (void)sprintf(escaped, "\\x%02x", pattern[i]);
+      }
+    }
+    if (!Payload_append(buffer, end, escaped)) {
+      return;
+    }
+  }
+  (void)Payload_append(buffer, end, "\"");
+}
+
+bool Payload_search(const Payload* payload, const void* data, size_t len) {
+  const char* end = (const char*)data + len;
+  int i;
+
+  for (i = 0 ; i < payload->count ; ++i) {
+    const size_t plen = payload->lengths[i];
+    const char*  pos  = (const char*)data;
+    while (plen <= (size_t)(end - pos)) {
+      pos = (const char*)memchr(pos, payload->patterns[i][0], end - pos - plen + 1);
+      if (pos == NULL) {
+        break;
+      }
+      if (memcmp(pos, payload->patterns[i], plen) == 0) {
+        return true;
+      }
+      ++pos;
+    }
+  }
+  return false;
+}
+
+void Payload_destroy(Payload* payload) {
+  int i;
+
+  if (payload == NULL) {
+    return;
+  }
+  for (i = 0 ; i < payload->count ; ++i) {
+    free(payload->patterns[i]);
+  }
+  free(payload->patterns);
+  free(payload->lengths);
+  free(payload->file);
+  free(payload);
+}
+
+
+/** Payload reported when reaching a state of the automaton.
+ */
+struct PayloadOutput {
+  int slot; /**< Slot of the payload. */
+  int next; /**< Next output of the same state (or -1). */
+};
+
+/** The automaton.
+ *
+ * The transitions of a state are stored in a row of @c classes entries.
+ * An entry is <tt>(row << 1) | hit</tt> where @c row is the offset of the
+ * row of the target state and @c hit is set if reaching the target reports
+ * payloads. Rows are used instead of state indexes so that the scan loop
+ * only does one lookup per byte.
+ */
+struct PayloadScanner {
+  int       classes;   /**< Number of byte classes (bytes found in the patterns + 1). */
+  int       states;    /**< Number of states. */
+  int       payloads;  /**< Number of payloads. */
+  int       first;     /**< The only byte starting a pattern, or -1. */
+  int       prefilter; /**< Number of bytes starting a pattern, if at most PAYLOAD_PREFILTER_MAX. */
+  uint64_t  splat[PAYLOAD_PREFILTER_MAX]; /**< Bytes starting a pattern, one per byte of a word. */
+  uint16_t  byteClass[256]; /**< Class of each byte (0 for the bytes absent from the patterns). */
+  bool      starts[256];    /**< Bytes starting a pattern. */
+  uint32_t* next;      /**< Transitions. */
+  int*      outputs;   /**< First output of each state (-1 if none). */
+  int*      links;     /**< Longest proper suffix of each state having outputs (-1 if none). */
+  struct PayloadOutput* output; /**< Outputs. */
+  const Payload** sorted; /**< Payloads sorted by address, the index is the slot. */
+};
+
+static int PayloadScanner_compare(const void* a, const void* b) {
+  const uintptr_t x = (uintptr_t)*(const Payload* const*)a;
+  const uintptr_t y = (uintptr_t)*(const Payload* const*)b;
+  return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/** Compute the failure links and turn the trie into a complete automaton.
+ *
+ * The states are visited in breadth first order, so the row of the failure
+ * state of a state is complete when the state is visited.
+ *
+ * @param scanner The scanner, the missing transitions of the trie are -1.
+ * @param next    The transitions, as state indexes.
+ * @return false if the memory is exhausted.
+ */
+static bool PayloadScanner_link(PayloadScanner* scanner, int* next) {
+  const int classes = scanner->classes;
+  int* fail;
+  int* queue;
+  int head = 0;
+  int tail = 0;
+  int c;
+
+  fail  = (int*)malloc(scanner->states * sizeof(int));
+  queue = (int*)malloc(scanner->states * sizeof(int));
+  if (fail == NULL || queue == NULL) {
+    free(fail);
+    free(queue);
+    return false;
+  }
+  fail[0] = 0;
+  scanner->links[0] = -1;
+  for (c = 0 ; c < classes ; ++c) {
+    const int child = next[c];
+    if (child < 0) {
+      next[c] = 0;
+    } else {
+      fail[child] = 0;
+      scanner->links[child] = -1;
+      queue[tail++] = child;
+    }
+  }
+  while (head < tail) {
+    const int state = queue[head++];
+    const int* from = next + fail[state] * classes;
+    int* row = next + state * classes;
+    for (c = 0 ; c < classes ; ++c) {
+      const int child = row[c];
+      if (child < 0) {
+        row[c] = from[c];
+        continue;
+      }
+      fail[child] = from[c];
+      scanner->links[child] = scanner->outputs[fail[child]] >= 0
+                            ? fail[child] : scanner->links[fail[child]];
+      queue[tail++] = child;
+    }
+  }
+  free(fail);
+  free(queue);
+  return true;
+}
+
+/** Add the patterns of the payloads to the trie.
+ *
+ * @return The number of states.
+ */
+static int PayloadScanner_insert(PayloadScanner* scanner, int* next) {
+  int states = 1;
+  int outputs = 0;
+  int slot;
+  int i;
+
+  for (slot = 0 ; slot < scanner->payloads ; ++slot) {
+    const Payload* payload = scanner->sorted[slot];
+    for (i = 0 ; i < payload->count ; ++i) {
+      const unsigned char* pattern = (const unsigned char*)payload->patterns[i];
+      int state = 0;
+      size_t j;
+      for (j = 0 ; j < payload->lengths[i] ; ++j) {
+        int* entry = next + state * scanner->classes + scanner->byteClass[pattern[j]];
+        if (*entry < 0) {
+          scanner->outputs[states] = -1;
+          *entry = states++;
+        }
+        state = *entry;
+      }
+      scanner->output[outputs].slot = slot;
+      scanner->output[outputs].next = scanner->outputs[state];
+      scanner->outputs[state] = outputs++;
+      scanner->starts[pattern[0]] = true;
+    }
+  }
+  return states;
+}
+
+PayloadScanner* PayloadScanner_init(const Payload* const* payloads, int count) {
+  PayloadScanner* scanner;
+  bool present[256];
+  size_t bytes = 0;
+  int patterns = 0;
+  int* next;
+  int starts  = 0;
+  int skipped = 0;
+  int i;
+  size_t j;
+
+  if (count == 0) {
+    return NULL;
+  }
+  scanner = (PayloadScanner*)calloc(1, sizeof(PayloadScanner));
+  if (scanner == NULL) {
+    return NULL;
+  }
+  scanner->sorted = (const Payload**)malloc(count * sizeof(Payload*));
+  if (scanner->sorted == NULL) {
+    free(scanner);
+    return NULL;
+  }
+  memcpy(scanner->sorted, payloads, count * sizeof(Payload*));
+  qsort(scanner->sorted, count, sizeof(Payload*), PayloadScanner_compare);
+  for (i = 0 ; i < count ; ++i) {
+    if (i > 0 && scanner->sorted[i] == scanner->sorted[i - 1]) {
+      continue;
+    }
+    if (scanner->payloads < PAYLOAD_SCANNER_MAX) {
+      scanner->sorted[scanner->payloads++] = scanner->sorted[i];
+    } else {
+      ++skipped;
+    }
+  }
+  if (skipped > 0) {
+    fprintf(stderr, "WARN %d payloads beyond the first %d are searched alone\n",
+            skipped, PAYLOAD_SCANNER_MAX);
+  }
+
+  /* Bytes absent from the patterns share a single class */
+  memset(present, 0, sizeof(present));
+  for (i = 0 ; i < scanner->payloads ; ++i) {
+    const Payload* payload = scanner->sorted[i];
+    int k;
+    for (k = 0 ; k < payload->count ; ++k) {
+      for (j = 0 ; j < payload->lengths[k] ; ++j) {
+        present[(unsigned char)payload->patterns[k][j]] = true;
+      }
+      bytes += payload->lengths[k];
+      ++patterns;
+    }
+  }
+  scanner->classes = 1;
+  for (j = 0 ; j < 256 ; ++j) {
+    scanner->byteClass[j] = present[j] ? scanner->classes++ : 0;
+  }
+  if ((bytes + 1) * scanner->classes > PAYLOAD_TABLE_MAX) {
+    PayloadScanner_destroy(scanner);
+    return NULL;
+  }
+
+  next = (int*)malloc((bytes + 1) * scanner->classes * sizeof(int));
+  scanner->outputs = (int*)malloc((bytes + 1) * sizeof(int));
+  scanner->links   = (int*)malloc((bytes + 1) * sizeof(int));
+  scanner->output  = (struct PayloadOutput*)malloc(patterns * sizeof(struct PayloadOutput));
+  if (next == NULL || scanner->outputs == NULL || scanner->links == NULL
+      || scanner->output == NULL) {
+    free(next);
+    PayloadScanner_destroy(scanner);
+    return NULL;
+  }
+  memset(next, 0xff, (bytes + 1) * scanner->classes * sizeof(int));
+  scanner->outputs[0] = -1;
+  scanner->states = PayloadScanner_insert(scanner, next);
+  if (!PayloadScanner_link(scanner, next)) {
+    free(next);
+    PayloadScanner_destroy(scanner);
+    return NULL;
+  }
+
+  /* Encode the transitions as rows, with the hit flag */
+  scanner->next = (uint32_t*)malloc(scanner->states * scanner->classes * sizeof(uint32_t));
+  if (scanner->next == NULL) {
+    free(next);
+    PayloadScanner_destroy(scanner);
+    return NULL;
+  }
+  for (i = 0 ; i < scanner->states * scanner->classes ; ++i) {
+    const int target = next[i];
+    const bool hit = scanner->outputs[target] >= 0 || scanner->links[target] >= 0;
+    scanner->next[i] = ((uint32_t)(target * scanner->classes) << 1) | (hit ? 1 : 0);
+  }
+  free(next);
+
+  scanner->first = -1;
+  for (j = 0 ; j < 256 ; ++j) {
+    if (scanner->starts[j]) {
+      if (starts < PAYLOAD_PREFILTER_MAX) {
+        scanner->splat[starts] = PAYLOAD_SPLAT(j);
+      }
+      scanner->first = j;
+      ++starts;
+    }
+  }
+  scanner->prefilter = starts <= PAYLOAD_PREFILTER_MAX ? starts : 0;
+  if (starts > 1) {
+    scanner->first = -1;
+  }
+  return scanner;
+}
+
+int PayloadScanner_find(const PayloadScanner* scanner, const Payload* payload) {
+  const Payload** found;
+
+  found = (const Payload**)bsearch(&payload, scanner->sorted, scanner->payloads,
+                                   sizeof(Payload*), PayloadScanner_compare);
+  return found ? (int)(found - scanner->sorted) : -1;
+}
+
+void PayloadScan_start(PayloadScan* scan, const PayloadScanner* scanner, uint64_t* found) {
+  scan->scanner = scanner;
+  scan->state   = 0;
+  scan->missing = scanner->payloads;
+  scan->found   = found;
+  memset(found, 0, PAYLOAD_SCANNER_MAX / 8);
+}
+
+/** Skip the data that can't start a pattern.
+ *
+ * memchr is vectorized by the C library, so most of the data is skipped at
+ * memory speed when a single byte starts all the patterns. A few starting
+ * bytes are looked for a word at a time, more are checked byte per byte.
+ *
+ * @return The first byte starting a pattern, or end.
+ */
+static const unsigned char* PayloadScan_skip(const PayloadScanner* scanner,
+                                             const unsigned char* pos,
+                                             const unsigned char* end) {
+  if (scanner->first >= 0) {
+    pos = (const unsigned char*)memchr(pos, scanner->first, end - pos);
+    return pos ? pos : end;
+  }
+  if (scanner->prefilter > 0) {
+    while (end - pos >= (ptrdiff_t)sizeof(uint64_t)) {
+      uint64_t word;
+      uint64_t hit = 0;
+      int k;
+      (void)memcpy(&word, pos, sizeof(word));
+      for (k = 0 ; k < scanner->prefilter ; ++k) {
+        hit |= PAYLOAD_HAS_ZERO(word ^ scanner->splat[k]);
+      }
+      if (hit) {
+        break;
+      }
+      pos += sizeof(word);
+    }
+  }
+  while (pos < end && !scanner->starts[*pos]) {
+    ++pos;
+  }
+  return pos;
+}
+
+/** Report the payloads of a state and of its suffixes.
+ */
+static void PayloadScan_report(PayloadScan* scan, int state) {
+  const PayloadScanner* scanner = scan->scanner;
+
+  for ( ; state >= 0 ; state = scanner->links[state]) {
+    int out;
+    for (out = scanner->outputs[state] ; out >= 0 ; out = scanner->output[out].next) {
+      const int slot = scanner->output[out].slot;
+      const uint64_t bit = UINT64_C(1) << (slot & 63);
+      if (!(scan->found[slot >> 6] & bit)) {
+        scan->found[slot >> 6] |= bit;
+        --scan->missing;
+      }
+    }
+  }
+}
+
+void PayloadScan_feed(PayloadScan* scan, const void* data, size_t len) {
+  const PayloadScanner* scanner = scan->scanner;
+  const unsigned char* pos = (const unsigned char*)data;
+  const unsigned char* end = pos + len;
+  uint32_t row = scan->state;
+
+  while (pos < end && scan->missing > 0) {
+    uint32_t entry;
+    if (row == 0) {
+      /* Out of any pattern: jump to the next byte starting one */
+      if ((pos = PayloadScan_skip(scanner, pos, end)) == end) {
+        break;
+      }
+    }
+    entry = scanner->next[row + scanner->byteClass[*pos++]];
+    row = entry >> 1;
+    if (entry & 1) {
+      PayloadScan_report(scan, row / scanner->classes);
+    }
+  }
+  scan->state = row;
+}
+
+void PayloadScanner_destroy(PayloadScanner* scanner) {
+  if (scanner == NULL) {
+    return;
+  }
+  free(scanner->next);
+  free(scanner->outputs);
+  free(scanner->links);
+  free(scanner->output);
+  free(scanner->sorted);
+  free(scanner);
+}
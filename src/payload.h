@@ -0,0 +1,193 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#ifndef _PAYLOAD_H_
+#define _PAYLOAD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "parser.h"
+
+/** @defgroup Payload Payload patterns
+ *
+ * A payload is a set of byte strings searched in the data of the calls. It
+ * is either a single literal (<tt>"GET /api"</tt>) or the lines of a pattern
+ * file (<tt>@@patterns.txt</tt>).
+ *
+ * The payloads of a whole ruleset are compiled together in a single
+ * Aho-Corasick automaton, the PayloadScanner: the data of a call is read
+ * once whatever the number of rules and patterns, and the scan tells which
+ * of the payloads appear in it. @{
+ */
+
+/** Longest literal pattern (longer patterns must be put in a file).
+ */
+#define PAYLOAD_LITERAL_MAX 128
+
+/** A set of patterns.
+ */
+typedef struct Payload {
+  int     count;    /**< Number of patterns. */
+  char**  patterns; /**< The patterns (not NUL terminated). */
+  size_t* lengths;  /**< Length of each pattern. */
+  char*   file;     /**< File the patterns have been read from (NULL for a literal). */
+} Payload;
+
+/** Parse a quoted literal.
+ *
+ * The literal is enclosed in double quotes. The escapes \\\\, \\", \\n, \\r,
+ * \\t, \\0 and \\xHH are recognized.
+ *
+ * @param from       Pointer to the source, moved after the literal.
+ * @param dest       Receive a new Payload*.
+ * @param constraint Unused.
+ * @param status     Parse status.
+ * @return true on success.
+ */
+bool Payload_parse(const char** from, void* dest, const void* constraint,
+                   ParserStatus* status);
+
+/** Parse a reference to a pattern file and load the file.
+ *
+ * The reference is a path preceded by '@'. Each line of the file is a
+ * pattern, empty lines and lines starting with '#' are ignored and a line
+ * starting with a double quote is read as a literal (see Payload_parse).
+ *
+ * @param from       Pointer to the source, moved after the reference.
+ * @param dest       Receive a new Payload*.
+ * @param constraint Unused.
+ * @param status     Parse status.
+ * @return true on success.
+ */
+bool Payload_parseFile(const char** from, void* dest, const void* constraint,
+                       ParserStatus* status);
+
+/** Write the payload as it has been parsed.
+ *
+ * The output is truncated to the buffer, which stays null-terminated.
+ *
+ * @param buffer  Destination buffer, moved after the written characters.
+ * @param end     End of the buffer.
+ * @param payload The payload.
+ */
+void Payload_write(char** buffer, const char* end, const Payload* payload);
+
+/** Search the patterns of a payload in a contiguous buffer.
+ *
+ * This is the slow path used for payloads not compiled in a scanner.
+ *
+ * @param payload The payload.
+ * @param data    The data.
+ * @param len     Length of the data.
+ * @return true if one of the patterns appears in the data.
+ */
+bool Payload_search(const Payload* payload, const void* data, size_t len);
+
+/** Free a payload.
+ */
+void Payload_destroy(Payload* payload);
+
+
+/** Aho-Corasick automaton searching several payloads at once.
+ */
+typedef struct PayloadScanner PayloadScanner;
+
+/** Largest number of payloads in a scanner.
+ */
+#define PAYLOAD_SCANNER_MAX 2048
+
+/** Progress of a scan.
+ *
+ * A scan can be fed with several pieces of data (the vectors of a call),
+ * the patterns spanning two pieces are found.
+ */
+typedef struct PayloadScan {
+  const PayloadScanner* scanner; /**< The scanner. */
+  int       state;   /**< Row of the current state of the automaton. */
+  int       missing; /**< Number of payloads not found yet. */
+  uint64_t* found;   /**< One bit per payload (PAYLOAD_SCANNER_MAX bits). */
+} PayloadScan;
+
+/** Compile payloads in a scanner.
+ *
+ * The payloads must stay valid as long as the scanner is used. Duplicates
+ * are ignored, and only the first PAYLOAD_SCANNER_MAX payloads are compiled
+ * (the number of the others is logged).
+ *
+ * @param payloads The payloads.
+ * @param count    Number of payloads.
+ * @return The scanner or NULL on error (or if there's no pattern).
+ */
+PayloadScanner* PayloadScanner_init(const Payload* const* payloads, int count);
+
+/** Get the slot of a payload in a scanner.
+ *
+ * @param scanner The scanner.
+ * @param payload The payload.
+ * @return The index of the bit of the payload in PayloadScan::found, or -1
+ *         if the payload is not compiled in the scanner.
+ */
+int PayloadScanner_find(const PayloadScanner* scanner, const Payload* payload);
+
+/** Start a scan.
+ *
+ * @param scan    The scan.
+ * @param scanner The scanner.
+ * @param found   The result bits (PAYLOAD_SCANNER_MAX bits, cleared here).
+ */
+void PayloadScan_start(PayloadScan* scan, const PayloadScanner* scanner, uint64_t* found);
+
+/** Feed data to a scan.
+ *
+ * @param scan The scan.
+ * @param data The data.
+ * @param len  Length of the data.
+ */
+void PayloadScan_feed(PayloadScan* scan, const void* data, size_t len);
+
+/** Check if a payload has been found by a scan.
+ *
+ * @param scan The scan.
+ * @param slot The slot of the payload (see PayloadScanner_find).
+ */
+static inline bool PayloadScan_found(const PayloadScan* scan, int slot) {
+  return slot >= 0 && ((scan->found[slot >> 6] >> (slot & 63)) & 1);
+}
+
+/** Free a scanner.
+ */
+void PayloadScanner_destroy(PayloadScanner* scanner);
+
+/** @} */
+
+#endif
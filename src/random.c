@@ -0,0 +1,119 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#include "random.h"
+
+/** State of the generator of a thread.
+ */
+struct RandomState {
+  uint64_t     s[4];       /**< xoshiro256** state. */
+  unsigned int generation; /**< Generation of the seed the state derives from. */
+};
+
+static volatile uint64_t     seed       = 0;
+static volatile unsigned int generation = 1;
+static volatile unsigned int rank       = 0;
+static __thread struct RandomState state = { { 0, 0, 0, 0 }, 0 };
+
+static inline uint64_t Random_rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+/** Step of the splitmix64 generator, used to expand the seed.
+ */
+static inline uint64_t Random_splitmix(uint64_t* x) {
+  uint64_t z = (*x += UINT64_C(0x9e3779b97f4a7c15));
+  z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+  return z ^ (z >> 31);
+}
+
+/** Derive the state of the current thread from the seed.
+ */
+static void Random_reset(void) {
+  const unsigned int gen = generation;
+  uint64_t stream = __sync_fetch_and_add(&rank, 1);
+  uint64_t x;
+  int i;
+
+  /* The rank selects a distinct stream of the seed for each thread */
+  x = seed ^ Random_splitmix(&stream);
+  for (i = 0 ; i < 4 ; ++i) {
+    state.s[i] = Random_splitmix(&x);
+  }
+  state.generation = gen;
+}
+
+void Random_seed(uint64_t value) {
+  seed = value;
+  rank = 0;
+  __sync_synchronize();
+  (void)__sync_add_and_fetch(&generation, 1);
+}
+
+uint64_t Random_getSeed(void) {
+  return seed;
+}
+
+uint64_t Random_next(void) {
+  uint64_t* s = state.s;
+  uint64_t result;
+  uint64_t t;
+
+  if (state.generation != generation) {
+    Random_reset();
+  }
+  result = Random_rotl(s[1] * 5, 7) * 9;
+  t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = Random_rotl(s[3], 45);
+  return result;
+}
+
+uint32_t Random_below(uint32_t bound) {
+  /* Lemire's multiply and reject: the rare draws that would favor the
+   * lowest values are rejected */
+  uint64_t m = (Random_next() >> 32) * bound;
+  uint32_t low = (uint32_t)m;
+
+  if (low < bound) {
+    const uint32_t limit = -bound % bound;
+    while (low < limit) {
+      m = (Random_next() >> 32) * bound;
+      low = (uint32_t)m;
+    }
+  }
+  return (uint32_t)(m >> 32);
+}
@@ -0,0 +1,96 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#ifndef _RANDOM_H_
+#define _RANDOM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** @defgroup Random Random generator
+ *
+ * Each thread draws from its own xoshiro256** generator, so that the draws
+ * never take a lock. The generators are all derived from a single seed: a
+ * thread gets the stream of the rank in which it first draws after the seed
+ * is set. A run of a single threaded program is thus replayed exactly with
+ * the same seed, and so is a multithreaded one as long as its threads start
+ * drawing in the same order. @{
+ */
+
+/** Denominator of the thresholds given to Random_chance.
+ */
+#define RANDOM_CHANCE_ONE (UINT64_C(1) << 32)
+
+/** Set the seed of the generators.
+ *
+ * The generators of all the threads are reset.
+ *
+ * @param seed The seed.
+ */
+void Random_seed(uint64_t seed);
+
+/** Get the current seed.
+ */
+uint64_t Random_getSeed(void);
+
+/** Draw a random number.
+ *
+ * @return 64 random bits.
+ */
+uint64_t Random_next(void);
+
+/** Draw a number in a range without bias.
+ *
+ * @param bound The upper bound, must not be 0.
+ * @return A number in [0, bound).
+ */
+uint32_t Random_below(uint32_t bound);
+
+/** Compute the threshold of a probability.
+ *
+ * @param num The numerator of the probability.
+ * @param den The denominator of the probability.
+ * @return The threshold to give to Random_chance.
+ */
+#define Random_threshold(num, den) ((uint64_t)(num) * RANDOM_CHANCE_ONE / (uint64_t)(den))
+
+/** Draw an event of the given probability.
+ *
+ * @param threshold The probability as computed by Random_threshold.
+ * @return true with the given probability.
+ */
+static inline bool Random_chance(uint64_t threshold) {
+  return (Random_next() >> 32) < threshold;
+}
+
+/** @} */
+
+#endif
@@ -0,0 +1,176 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+
+#ifndef _RATE_H_
+#define _RATE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "clock.h"
+
+/** @defgroup Rate Sliding rates
+ *
+ * A rate window counts the calls and the bytes of the last second in a ring
+ * of RATE_SLOTS slots of RATE_SLOT_MSEC milliseconds. Each slot packs the
+ * tick it belongs to with its count, so that a slot left from a previous
+ * turn of the ring is recycled by the first writer of the new tick with a
+ * compare and swap, and the following writers only do an atomic add. No
+ * lock is ever taken and the memory of a window is fixed. @{
+ */
+
+/** Number of slots of a window.
+ */
+#define RATE_SLOTS 8
+
+/** Duration of a slot, the slots of a window cover one second.
+ */
+#define RATE_SLOT_MSEC (1000 / RATE_SLOTS)
+
+/** Number of bits of the count of a slot, the other bits hold the tick.
+ */
+#define RATE_COUNT_BITS 40
+
+/** Mask of the count of a slot.
+ */
+#define RATE_COUNT_MASK ((UINT64_C(1) << RATE_COUNT_BITS) - 1)
+
+/** Mask of the tick of a slot (the tick wraps after a few weeks, a slot
+ * is then only misread if it has not been written for a whole wrap).
+ */
+#define RATE_TICK_MASK ((UINT64_C(1) << (64 - RATE_COUNT_BITS)) - 1)
+
+/** Number of peers whose rate can be followed.
+ */
+#define RATE_PEERS 1024
+
+/** Calls and bytes of the last second.
+ */
+typedef struct RateWindow {
+  volatile uint64_t calls[RATE_SLOTS]; /**< Calls per slot (count and tick). */
+  volatile uint64_t bytes[RATE_SLOTS]; /**< Bytes per slot (count and tick). */
+} RateWindow;
+
+/** Get the tick of a time.
+ *
+ * @param now The time (see Clock_coarse).
+ * @return The tick, truncated to the bits stored in a slot.
+ */
+static inline uint64_t Rate_tick(uint64_t now) {
+  return (Clock_toMSec(now) / RATE_SLOT_MSEC) & RATE_TICK_MASK;
+}
+
+/** Add a count to the slot of a tick.
+ *
+ * @param slot  The slot.
+ * @param tick  The current tick.
+ * @param count The count to add.
+ */
+static inline void Rate_slotAdd(volatile uint64_t* slot, uint64_t tick, uint64_t count) {
+  uint64_t old = *slot;
+
+  count &= RATE_COUNT_MASK;
+  while ((old >> RATE_COUNT_BITS) != tick) {
+    const uint64_t seen = __sync_val_compare_and_swap(slot, old,
+                                                      (tick << RATE_COUNT_BITS) | count);
+    if (seen == old) {
+      return;
+    }
+    old = seen;
+  }
+  (void)__sync_fetch_and_add(slot, count);
+}
+
+/** Sum the slots of the last second.
+ *
+ * @param slots The slots of a window.
+ * @param tick  The current tick.
+ * @return The sum of the counts of the slots of the ticks of the last second.
+ */
+static inline uint64_t Rate_sum(const volatile uint64_t* slots, uint64_t tick) {
+  uint64_t sum = 0;
+  int i;
+
+  for (i = 0 ; i < RATE_SLOTS ; ++i) {
+    const uint64_t slot = slots[i];
+    if (((tick - (slot >> RATE_COUNT_BITS)) & RATE_TICK_MASK) < RATE_SLOTS) {
+      sum += slot & RATE_COUNT_MASK;
+    }
+  }
+  return sum;
+}
+
+/** Count a call in a window.
+ *
+ * @param window The window.
+ * @param now    The current time (see Clock_coarse).
+ * @param bytes  The number of bytes transferred by the call.
+ */
+static inline void RateWindow_add(RateWindow* window, uint64_t now, uint64_t bytes) {
+  const uint64_t tick = Rate_tick(now);
+  const int slot = (int)(tick % RATE_SLOTS);
+
+  Rate_slotAdd(&window->calls[slot], tick, 1);
+  Rate_slotAdd(&window->bytes[slot], tick, bytes);
+}
+
+/** Get the number of calls of the last second.
+ *
+ * @param window The window.
+ * @param now    The current time (see Clock_coarse).
+ */
+static inline uint64_t RateWindow_calls(const RateWindow* window, uint64_t now) {
+  return Rate_sum(window->calls, Rate_tick(now));
+}
+
+/** Get the number of bytes of the last second.
+ *
+ * @param window The window.
+ * @param now    The current time (see Clock_coarse).
+ */
+static inline uint64_t RateWindow_bytes(const RateWindow* window, uint64_t now) {
+  return Rate_sum(window->bytes, Rate_tick(now));
+}
+
+/** Get the window shared by the sockets of a peer.
+ *
+ * The windows are taken from a fixed table filled without lock. Once the
+ * table is full, the new peers get no window.
+ *
+ * @param key Hash of the peer, must not be 0.
+ * @return The window, or NULL if the table is full.
+ */
+RateWindow* RateWindow_peer(uint64_t key);
+
+/** @} */
+
+#endif
@@ -44,6 +44,8 @@
 
 #include "runtime.h"
 #include "parser.h"
+#include "arena.h"
+#include "binding.h"
 
 typedef int  (Runtime_getter)(int fd);
 typedef void (Runtime_worker)(int fd);
@@ -69,7 +71,7 @@ static void RuntimeAll_close(int fd) {
   int flags;
   flags = fcntl(fd, F_GETFL, 0);
   fcntl(fd, F_SETFL, flags | O_NONBLOCK);
-  while (read(fd, buffer, 1024) > 0);
+  while (Binding_read(fd, buffer, 1024) > 0);
   close(fd);
 }
 
@@ -86,7 +88,7 @@ static int RuntimeAll_writeStderr(int fd) {
 }
 
 static void RuntimeAll_write(int fd, const char* string) {
-  write(fd, string, strlen(string));
+  (void)Binding_write(fd, string, strlen(string));
 }
 
 
@@ -163,7 +165,8 @@ enum Runtime_Command {
   RC_Remove   = 4,
   RC_Close    = 5,
   RC_Exit     = 6,
-  RC_Help     = 7
+  RC_Help     = 7,
+  RC_Stats    = 8
 };
 
 static inline void Runtime_greeting(int fd, struct RuntimeData* d) {
@@ -180,6 +183,7 @@ static inline void Runtime_greeting(int fd, struct RuntimeData* d) {
                "|    replace: rule   Add or replace a line to the ruleset.                                       |\n"
                "|    remove: line    Remove given line                                                           |\n"
                "|    list:           List all rules                                                              |\n"
+               "|    stats:          Print memory statistics                                                     |\n"
                "|    quit:           Close the connection (no effect for pipes)                                  |\n"
                "|    exit:           Close the program injected program                                          |\n"
                "|    help:           Print this help                                                             |\n"
@@ -193,7 +197,8 @@ static void* Runtime_thread(void* d) {
   ParserStatus* status;
   Parse_enumData ed[] = { { "list", RC_List }, { "add", RC_Add },
     { "replace", RC_Replace }, { "remove", RC_Remove }, { "quit", RC_Close },
-    { "exit", RC_Exit }, { "help", RC_Help }, { NULL, RC_None } };
+    { "exit", RC_Exit }, { "help", RC_Help }, { "stats", RC_Stats },
+    { NULL, RC_None } };
   enum Runtime_Command command;
   int    fd;
   char   buffer[1024];
@@ -201,6 +206,9 @@ static void* Runtime_thread(void* d) {
 
   buffer[1023] = '\0';
 
+  /* Nothing done by this thread must be seen by the rules */
+  Binding_enter();
+
   /* Build the parser */
   parser = Parser_init();
   Parser_add(parser, Parse_enum, &command, ed, NULL);
@@ -215,7 +223,7 @@ static void* Runtime_thread(void* d) {
     bool closeCon = false;
 
     Runtime_greeting(fd, data);
-    while (!closeCon && (r = read(fd, buffer, 1023)) >= 0) {
+    while (!closeCon && (r = Binding_read(fd, buffer, 1023)) >= 0) {
       char* pos  = buffer;
       buffer[r] = '\0';
       if (r <= 3) {
@@ -291,6 +299,14 @@ static void* Runtime_thread(void* d) {
          case RC_Help:
            Runtime_greeting(fd, data);
            break;
+         case RC_Stats:
+         {
+          char stats[128];
+          snprintf(stats, sizeof(stats), "Arena high-water mark: %lu bytes\n\n",
+                   (unsigned long)Arena_highWater());
+          RuntimeAll_write(data->writer(fd), stats);
+          break;
+         }
          default:
           RuntimeAll_write(data->writer(fd), "Warning: command not yet implemented\n\n");
           break;
@@ -308,6 +324,7 @@ static void* Runtime_thread(void* d) {
   }
   ParserStatus_destroy(status);
   Parser_destroy(parser);
+  Binding_leave();
   return NULL;
 }
 
@@ -320,20 +337,18 @@ bool Runtime_start(Config* config) {
 
   switch (config->runtime.type) {
    case RT_TCP:
+    Binding_enter();
     data->fd          = RuntimeTCP_create(config->runtime.port);
+    Binding_leave();
     data->accept      = RuntimeTCP_accept;
     data->localClose  = RuntimeAll_close;
     data->globalClose = RuntimeAll_close;
     data->writer      = RuntimeAll_id;
-    {
-      char buffer[1024];
-      buffer[1023] = '\0';
-      snprintf(buffer, 1023, "0 on tcp with me port %d do nop stop", config->runtime.port);
-      ActionQueue_put(config->queue, buffer, NULL, true, false);
-    }
     break;
    case RT_Pipe:
+    Binding_enter();
     data->fd          = RuntimePipe_create(config->runtime.file);
+    Binding_leave();
     data->accept      = RuntimeAll_id;
     data->localClose  = RuntimeAll_nop;
     data->globalClose = RuntimeAll_close;
@@ -38,8 +38,8 @@
  *
  * This functions run a thread that wait for input from the user in order to
  * update the ruleset. Their are currently two possible kinds of input:
- *    - A network socket. In that cause, the socket is whitelisted in the queue
- *    in order to avoid alteration of the input.
+ *    - A network socket. The I/O of the interface bypasses the rules in order
+ *    to avoid alteration of the input.
  *    - A pipe.
  *
  * The pipe can be useful for scripting whereas the socket way brings more
@@ -0,0 +1,157 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "slab.h"
+
+/** Size of the blocks allocated by the slab.
+ */
+#define SLAB_BLOCK_SIZE 65536
+
+/** Alignment of the objects.
+ */
+#define SLAB_ALIGN 16
+
+/** A block of objects.
+ */
+struct SlabBlock {
+  struct SlabBlock* next;    /**< Next block of the slab. */
+  char pad[SLAB_ALIGN - sizeof(struct SlabBlock*)]; /**< Keep the objects aligned. */
+};
+
+/** A free object.
+ */
+struct SlabFree {
+  struct SlabFree* next;     /**< Next free object. */
+};
+
+/** The slab.
+ */
+struct Slab {
+  size_t size;               /**< Size of an object. */
+  size_t perBlock;           /**< Number of objects per block. */
+  struct SlabFree*  free;    /**< List of free objects. */
+  struct SlabBlock* blocks;  /**< List of allocated blocks. */
+  pthread_mutex_t   lock;    /**< Lock protecting the lists. */
+};
+
+Slab* Slab_init(size_t size) {
+  Slab* slab;
+
+  if (size < sizeof(struct SlabFree)) {
+    size = sizeof(struct SlabFree);
+  }
+  size = (size + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1);
+  if (size > SLAB_BLOCK_SIZE - sizeof(struct SlabBlock)) {
+    return NULL;
+  }
+  slab = (Slab*)malloc(sizeof(Slab));
+  if (slab == NULL) {
+    return NULL;
+  }
+  slab->size     = size;
+  slab->perBlock = (SLAB_BLOCK_SIZE - sizeof(struct SlabBlock)) / size;
+  slab->free     = NULL;
+  slab->blocks   = NULL;
+  pthread_mutex_init(&slab->lock, NULL);
+  return slab;
+}
+
+void Slab_destroy(Slab* slab) {
+  struct SlabBlock* block;
+
+  if (!slab) {
+    return;
+  }
+  block = slab->blocks;
+  while (block) {
+    struct SlabBlock* next = block->next;
+    free(block);
+    block = next;
+  }
+  pthread_mutex_destroy(&slab->lock);
+  free(slab);
+}
+
+/** Allocate a new block and put its objects in the free list.
+ *
+ * Must be called with the lock held.
+ *
+ * @param slab The slab.
+ * @return false if the allocation failed.
+ */
+static bool Slab_grow(Slab* slab) {
+  struct SlabBlock* block;
+  char* pos;
+  size_t i;
+
+  block = (struct SlabBlock*)malloc(SLAB_BLOCK_SIZE);
+  if (block == NULL) {
+    return false;
+  }
+  block->next  = slab->blocks;
+  slab->blocks = block;
+  pos = (char*)(block + 1);
+  for (i = 0 ; i < slab->perBlock ; ++i) {
+    struct SlabFree* object = (struct SlabFree*)pos;
+    object->next = slab->free;
+    slab->free   = object;
+    pos += slab->size;
+  }
+  return true;
+}
+
+void* Slab_alloc(Slab* slab) {
+  struct SlabFree* object = NULL;
+
+  pthread_mutex_lock(&slab->lock);
+  if (slab->free != NULL || Slab_grow(slab)) {
+    object     = slab->free;
+    slab->free = object->next;
+  }
+  pthread_mutex_unlock(&slab->lock);
+  return object;
+}
+
+void Slab_free(Slab* slab, void* ptr) {
+  struct SlabFree* object = (struct SlabFree*)ptr;
+
+  if (object == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&slab->lock);
+  object->next = slab->free;
+  slab->free   = object;
+  pthread_mutex_unlock(&slab->lock);
+}
@@ -0,0 +1,81 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#ifndef _SLAB_H_
+#define _SLAB_H_
+
+#include <stddef.h>
+
+/** @defgroup Slab Slab allocator
+ *
+ * A slab allocates objects of a fixed size from large blocks. Freed objects
+ * are kept in a free list and reused by the next allocations, so small
+ * objects that are created and destroyed very often neither pay the malloc
+ * overhead per object nor fragment the heap. Memory is only given back to
+ * the system when the slab is destroyed. @{
+ */
+
+/** A slab.
+ */
+typedef struct Slab Slab;
+
+/** Build a new slab.
+ *
+ * @param size Size of the objects allocated by the slab.
+ * @return A new slab or NULL on error.
+ */
+Slab* Slab_init(size_t size);
+
+/** Destroy the slab and all the objects it contains.
+ *
+ * @param slab The slab.
+ */
+void Slab_destroy(Slab* slab);
+
+/** Allocate an object.
+ *
+ * The content of the object is undefined.
+ *
+ * @param slab The slab.
+ * @return A new object or NULL if the memory is exhausted.
+ */
+void* Slab_alloc(Slab* slab);
+
+/** Give an object back to the slab.
+ *
+ * @param slab The slab.
+ * @param ptr  An object allocated from the slab (or NULL).
+ */
+void Slab_free(Slab* slab, void* ptr);
+
+/** @} */
+
+#endif
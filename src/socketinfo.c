@@ -35,146 +35,649 @@
 #include <stdbool.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/un.h>
+#include <stddef.h>
+#include <string.h>
 #include <fcntl.h>
 #include <pthread.h>
 
 #include "socketinfo.h"
+#include "clock.h"
+#include "slab.h"
 
 typedef int (getsockinfofun)(int s, struct sockaddr* name, socklen_t* namelen);
 
+/** Number of peers cached for an unconnected socket.
+ */
+#define SOCKET_INFO_PEERS 8
 
-static inline bool SocketInfo_fetchData(int fd, getsockinfofun* callback,
-                                        HostAddress* host) {
-  struct sockaddr_in saddr;
-  socklen_t size = sizeof(struct sockaddr_in);
+struct SocketInfoPeers {
+  volatile int lock;                    /**< Spin lock of the cache. */
+  unsigned int next;                    /**< Next entry to be replaced. */
+  SocketInfo*  peers[SOCKET_INFO_PEERS]; /**< The peers (one reference each). */
+};
 
-  if (callback(fd, (struct sockaddr*)&saddr, &size) == -1) {
+/** Number of peers whose connections are ranked.
+ */
+#define SOCKET_INFO_RANKS 4096
+
+/** Number of entries probed to find a peer in the rank table.
+ */
+#define SOCKET_INFO_PROBES 32
+
+/** Number of connections with a peer.
+ */
+struct SocketInfoRank {
+  volatile uint64_t     key;   /**< Hash of the peer (0 if the entry is free). */
+  volatile unsigned int count; /**< Connections seen with the peer. */
+};
+
+/** Connections per peer, in an open addressing table filled without lock.
+ * Once the table is full, the connections with new peers are not ranked.
+ */
+static struct SocketInfoRank ranks[SOCKET_INFO_RANKS];
+
+static pthread_once_t slabOnce = PTHREAD_ONCE_INIT;
+static Slab* slab = NULL;
+
+static void SocketInfo_slabInit(void) {
+  slab = Slab_init(sizeof(SocketInfo));
+}
+
+/** Allocate a socket info.
+ *
+ * Socket infos are created on each connection (and on each connect), so they
+ * are taken from a slab instead of the heap.
+ */
+static inline SocketInfo* SocketInfo_alloc(void) {
+  pthread_once(&slabOnce, SocketInfo_slabInit);
+  return slab ? (SocketInfo*)Slab_alloc(slab) : NULL;
+}
+
+
+void IPAddress_fromV4(IPAddress* ip, uint32_t addr) {
+  memset(ip->bytes, 0, 10);
+  ip->bytes[10] = 0xff;
+  ip->bytes[11] = 0xff;
+  ip->bytes[12] = (addr >> 24) & 0xff;
+  ip->bytes[13] = (addr >> 16) & 0xff;
+  ip->bytes[14] = (addr >> 8) & 0xff;
+  ip->bytes[15] = addr & 0xff;
+}
+
+bool IPAddress_isV4(const IPAddress* ip) {
+  static const uint8_t mapped[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+  return memcmp(ip->bytes, mapped, sizeof(mapped)) == 0;
+}
+
+bool IPAddress_fromSockaddr(IPAddress* ip, int* port, const struct sockaddr* addr,
+                            socklen_t addrlen) {
+  if (addr == NULL) {
     return false;
   }
-  if (saddr.sin_family != AF_INET) {
+  if (addr->sa_family == AF_INET && addrlen >= (socklen_t)sizeof(struct sockaddr_in)) {
+    const struct sockaddr_in* saddr = (const struct sockaddr_in*)addr;
+    IPAddress_fromV4(ip, ntohl(saddr->sin_addr.s_addr));
+    if (port) {
+      *port = ntohs(saddr->sin_port);
+    }
+    return true;
+  }
+  if (addr->sa_family == AF_INET6 && addrlen >= (socklen_t)sizeof(struct sockaddr_in6)) {
+    const struct sockaddr_in6* saddr = (const struct sockaddr_in6*)addr;
+    memcpy(ip->bytes, saddr->sin6_addr.s6_addr, sizeof(ip->bytes));
+    if (port) {
+      *port = ntohs(saddr->sin6_port);
+    }
+    return true;
+  }
+  return false;
+}
+
+bool IPAddress_inPrefix(const IPAddress* ip, const IPAddress* prefix, int bits) {
+  const int bytes = bits / 8;
+  const int rest  = bits % 8;
+
+  if (memcmp(ip->bytes, prefix->bytes, bytes) != 0) {
     return false;
   }
-  host->addr = ntohl(saddr.sin_addr.s_addr);
-  host->port = ntohs(saddr.sin_port);
-  return true;
+  return rest == 0
+      || ((ip->bytes[bytes] ^ prefix->bytes[bytes]) & (0xff << (8 - rest)) & 0xff) == 0;
+}
+
+const char* IPAddress_format(const IPAddress* ip, char* buf) {
+  if (IPAddress_isV4(ip)) {
+    return inet_ntop(AF_INET, ip->bytes + 12, buf, IP_ADDRESS_STRLEN);
+  }
+  return inet_ntop(AF_INET6, ip->bytes, buf, IP_ADDRESS_STRLEN);
+}
+
+
+/** Read the path of a Unix socket address.
+ *
+ * @param path    Receive the path, at least SOCKET_PATH_MAX bytes long.
+ * @param addr    The socket address.
+ * @param addrlen The length of the addr structure.
+ */
+static void SocketInfo_unixPath(char* path, const struct sockaddr_un* addr, socklen_t addrlen) {
+  const char* name = addr->sun_path;
+  size_t len = 0;
+  size_t i;
+
+  if (addrlen > offsetof(struct sockaddr_un, sun_path)) {
+    len = addrlen - offsetof(struct sockaddr_un, sun_path);
+  }
+  if (len > sizeof(addr->sun_path)) {
+    len = sizeof(addr->sun_path);
+  }
+  if (len > 0 && name[0] == '\0') {
+    /* Abstract name, shown the way ss does */
+    path[0] = '@';
+    for (i = 1 ; i < len ; ++i) {
+      path[i] = name[i] == '\0' ? '@' : name[i];
+    }
+    path[len] = '\0';
+    return;
+  }
+  for (i = 0 ; i < len && name[i] != '\0' ; ++i) {
+    path[i] = name[i];
+  }
+  path[i] = '\0';
+}
+
+/** Read a socket address.
+ *
+ * @param host    Receive the address and the port (-1 for a Unix address).
+ * @param path    Receive the path of a Unix address.
+ * @param addr    The socket address.
+ * @param addrlen The length of the addr structure.
+ * @return The family of the address, AF_UNSPEC if it is not supported.
+ */
+static int SocketInfo_readAddress(HostAddress* host, char* path,
+                                  const struct sockaddr* addr, socklen_t addrlen) {
+  if (addr != NULL && addr->sa_family == AF_UNIX) {
+    memset(&host->addr, 0, sizeof(host->addr));
+    host->port = -1;
+    SocketInfo_unixPath(path, (const struct sockaddr_un*)addr, addrlen);
+    return AF_UNIX;
+  }
+  path[0] = '\0';
+  return IPAddress_fromSockaddr(&host->addr, &host->port, addr, addrlen) ? addr->sa_family
+                                                                          : AF_UNSPEC;
+}
+
+static inline int SocketInfo_fetchData(int fd, getsockinfofun* callback,
+                                       HostAddress* host, char* path, SocketKind* kind) {
+  struct sockaddr_storage saddr;
+  socklen_t size = sizeof(saddr);
+  int family;
+
+  if (callback(fd, (struct sockaddr*)&saddr, &size) == -1) {
+    return AF_UNSPEC;
+  }
+  if ((family = SocketInfo_readAddress(host, path, (struct sockaddr*)&saddr, size)) == AF_UNSPEC) {
+    if (kind) {
+      *kind = SK_Unsupported;
+    }
+  }
+  return family;
 }
 
-static SocketInfo* SocketInfo_setup(SocketInfo* si, int fd, int err) {
+/** Fill the fields of a socket info once the addresses are known.
+ */
+static inline SocketInfo* SocketInfo_fill(SocketInfo* si, int fd, Proto proto,
+                                          bool datagram, bool blocking) {
+  int i;
+
+  si->proto = proto;
+  si->datagram = datagram;
+  si->local.type = AH_Me;
+  si->local.prefix  = IP_ADDRESS_BITS;
+  si->remote.prefix = IP_ADDRESS_BITS;
+  si->local.path  = NULL;
+  si->remote.path = NULL;
+  if (proto == AP_UNIX) {
+    si->remote.type = AH_Path;
+  } else {
+    si->remote.type = (si->remote.port == 53 || si->local.port == 53) ? AH_DNS : AH_Address;
+  }
+  si->blocking = blocking;
+  for (i = 0 ; i < SOCKETINFO_WATCHES ; ++i) {
+    si->watch[i].epfd   = -1;
+    si->watch[i].events = 0;
+    si->watch[i].data   = 0;
+    si->watch[i].masked = 0;
+  }
+  si->peers = NULL;
+  si->paths = NULL;
+  memset(&si->counters, 0, sizeof(si->counters));
+  si->counters.created = Clock_coarse();
+  si->inode   = 0;
+  si->checked = si->counters.created;
+  si->fd   = fd;
+  si->data = NULL;
+  si->free = NULL;
+  si->sem  = 1;
+  return si;
+}
+
+/** Attach the paths of its ends to the socket info of a Unix socket.
+ *
+ * The socket info is released if the paths can't be allocated.
+ */
+static SocketInfo* SocketInfo_setPaths(SocketInfo* si, const char* local, const char* remote) {
+  if (si == NULL || si->proto != AP_UNIX) {
+    return si;
+  }
+  if ((si->paths = (SocketInfoPaths*)malloc(sizeof(SocketInfoPaths))) == NULL) {
+    Slab_free(slab, si);
+    return NULL;
+  }
+  strcpy(si->paths->local, local);
+  strcpy(si->paths->remote, remote);
+  return si;
+}
+
+/** Hash some bytes into a FNV-1a hash.
+ */
+static inline uint64_t SocketInfo_hash(uint64_t hash, const void* data, size_t len) {
+  const uint8_t* pos = (const uint8_t*)data;
+  size_t i;
+
+  for (i = 0 ; i < len ; ++i) {
+    hash = (hash ^ pos[i]) * UINT64_C(0x100000001b3);
+  }
+  return hash;
+}
+
+/** Rank a new connection among the connections with the same peer.
+ *
+ * The peer of a connection is the remote host and the service: the remote
+ * port (or path) of an outgoing connection, the local port (or path) of an
+ * accepted one. The rate window of the remote host, whatever the service,
+ * is attached to the connection as well. Listening and unconnected sockets
+ * are not connections and are not ranked.
+ *
+ * @param si       The socket info of the connection.
+ * @param accepted True if the connection has been accepted.
+ * @return si.
+ */
+static SocketInfo* SocketInfo_rank(SocketInfo* si, bool accepted) {
+  const HostAddress* service;
+  const uint8_t tag = accepted;
+  uint64_t key = UINT64_C(0xcbf29ce484222325);
+  unsigned int i;
+
+  if (si == NULL || si->remote.type == AH_None) {
+    return si;
+  }
+  service = accepted ? &si->local : &si->remote;
+  key = SocketInfo_hash(key, &si->remote.addr, sizeof(si->remote.addr));
+  if (si->paths) {
+    key = SocketInfo_hash(key, si->paths->remote, strlen(si->paths->remote));
+  }
+  si->counters.peer = RateWindow_peer(key ? key : 1);
+  key = SocketInfo_hash(key, &tag, sizeof(tag));
+  key = SocketInfo_hash(key, &service->port, sizeof(service->port));
+  if (si->paths) {
+    const char* path = accepted ? si->paths->local : si->paths->remote;
+    key = SocketInfo_hash(key, path, strlen(path));
+  }
+  if (key == 0) {
+    key = 1;
+  }
+  for (i = 0 ; i < SOCKET_INFO_PROBES ; ++i) {
+    struct SocketInfoRank* rank = &ranks[(key + i) % SOCKET_INFO_RANKS];
+    if (rank->key == key || __sync_bool_compare_and_swap(&rank->key, 0, key)
+        || rank->key == key) {
+      si->counters.ordinal = __sync_add_and_fetch(&rank->count, 1);
+      break;
+    }
+  }
+  return si;
+}
+
+static SocketInfo* SocketInfo_setup(SocketInfo* si, int fd, int family, int err) {
   int type = 0;
+  int flags;
   socklen_t len = sizeof(int);
+  Proto proto;
 
   if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) == -1 ||
       (type != SOCK_STREAM && type != SOCK_DGRAM)) {
-    free(si);
+    Slab_free(slab, si);
     errno = err;
     return NULL;
   }
-  si->proto = type == SOCK_STREAM ? AP_TCP : AP_UDP;
-  if ((type = fcntl(fd, F_GETFL, 0)) == -1) {
-    free(si);
+  if ((flags = fcntl(fd, F_GETFL, 0)) == -1) {
+    Slab_free(slab, si);
     errno = err;
     return NULL;
   }
-  si->local.type = AH_Me;
-  si->remote.type = (si->remote.port == 53 || si->local.port == 53) ? AH_DNS : AH_Address;
-  si->blocking = !(type & O_NONBLOCK);
-  si->fd   = fd;
-  si->data = NULL;
-  si->free = NULL;
-  pthread_mutex_init(&si->semLock, NULL);
-  si->sem  = 0;
-  si->toDestroy = false;
   errno = err;
-  return si;
+  if (family == AF_UNIX) {
+    proto = AP_UNIX;
+  } else {
+    proto = type == SOCK_STREAM ? AP_TCP : AP_UDP;
+  }
+  return SocketInfo_fill(si, fd, proto, type == SOCK_DGRAM, !(flags & O_NONBLOCK));
 }
 
-SocketInfo* SocketInfo_init(int fd) {
+SocketInfo* SocketInfo_init(int fd, SocketKind* kind) {
   SocketInfo* si;
   int err = errno;
+  int family;
   struct stat s;
+  SocketKind dummy = SK_Unknown;
+  char local[SOCKET_PATH_MAX];
+  char remote[SOCKET_PATH_MAX];
+  bool accepted;
 
-  if (fstat(fd, &s) == -1 || !S_ISSOCK(s.st_mode)) {
+  if (kind == NULL) {
+    kind = &dummy;
+  }
+  accepted = (*kind & SK_Accepted) != 0;
+  *kind = SK_Unknown;
+  if (fstat(fd, &s) == -1) {
+    errno = err;
+    return NULL;
+  }
+  if (!S_ISSOCK(s.st_mode)) {
+    *kind = SK_NotSocket;
     errno = err;
     return NULL;
   }
 
-  si = (SocketInfo*)malloc(sizeof(SocketInfo));
-  if (!SocketInfo_fetchData(fd, getpeername, &si->remote)
-      || !SocketInfo_fetchData(fd, getsockname, &si->local)) {
-    free(si);
+  si = SocketInfo_alloc();
+  if (si == NULL) {
     errno = err;
     return NULL;
   }
-  return SocketInfo_setup(si, fd, err);
+  if ((family = SocketInfo_fetchData(fd, getsockname, &si->local, local, kind)) == AF_UNSPEC) {
+    Slab_free(slab, si);
+    errno = err;
+    return NULL;
+  }
+  if (SocketInfo_fetchData(fd, getpeername, &si->remote, remote, kind) == AF_UNSPEC) {
+    if (errno != ENOTCONN || *kind == SK_Unsupported) {
+      Slab_free(slab, si);
+      errno = err;
+      return NULL;
+    }
+    /* Only an unconnected datagram socket is usable, its peer is given by each call */
+    memset(&si->remote.addr, 0, sizeof(si->remote.addr));
+    si->remote.port = -1;
+    remote[0] = '\0';
+    si = SocketInfo_setup(si, fd, family, err);
+    if (si && !si->datagram) {
+      Slab_free(slab, si);
+      si = NULL;
+    }
+    if (si) {
+      si->remote.type = AH_None;
+      si = SocketInfo_setPaths(si, local, remote);
+    }
+    if (si) {
+      si->inode = s.st_ino;
+      *kind = SocketKind_make(SK_Socket, si->proto);
+    }
+    errno = err;
+    return si;
+  }
+  si = SocketInfo_rank(SocketInfo_setPaths(SocketInfo_setup(si, fd, family, err),
+                                           local, remote), accepted);
+  *kind = si ? SocketKind_make(SK_Socket, si->proto) : SK_Unsupported;
+  if (si && accepted) {
+    *kind = (SocketKind)(*kind | SK_Accepted);
+  }
+  if (si) {
+    si->inode = s.st_ino;
+  }
+  errno = err;
+  return si;
 }
 
 SocketInfo* SocketInfo_initLight(int fd, const struct sockaddr* addr, socklen_t addrlen) {
   SocketInfo* si;
   int err = errno;
+  int family;
   struct stat s;
-  struct sockaddr_in* saddr = (struct sockaddr_in*)addr;
+  char remote[SOCKET_PATH_MAX];
 
   if (fstat(fd, &s) == -1 || !S_ISSOCK(s.st_mode)) {
     errno = err;
     return NULL;
   }
 
-  si = (SocketInfo*)malloc(sizeof(SocketInfo));
-  if (!SocketInfo_fetchData(fd, getsockname, &si->local)) {
-    free(si);
+  si = SocketInfo_alloc();
+  if (si == NULL) {
+    errno = err;
+    return NULL;
+  }
+  if ((family = SocketInfo_readAddress(&si->remote, remote, addr, addrlen)) == AF_UNSPEC) {
+    Slab_free(slab, si);
+    errno = err;
+    return NULL;
+  }
+  memset(&si->local.addr, 0, sizeof(si->local.addr));
+  si->local.port  = family == AF_UNIX ? -1 : 0;
+  si = SocketInfo_rank(SocketInfo_setPaths(SocketInfo_setup(si, fd, family, err),
+                                           "", remote), false);
+  if (si) {
+    si->inode = s.st_ino;
+  }
+  errno = err;
+  return si;
+}
+
+bool SocketInfo_isCurrent(SocketInfo* si) {
+  const uint64_t now = Clock_coarse();
+  struct stat s;
+  int err;
+
+  if (now - si->checked < SOCKET_INFO_CHECK_PERIOD) {
+    return true;
+  }
+  err = errno;
+  if (fstat(si->fd, &s) == -1 || !S_ISSOCK(s.st_mode)
+      || (si->inode != 0 && s.st_ino != si->inode)) {
+    errno = err;
+    return false;
+  }
+  errno = err;
+  /* Accepted sockets learn their inode on their first check */
+  si->inode   = s.st_ino;
+  si->checked = now;
+  return true;
+}
+
+SocketInfo* SocketInfo_initAccepted(int fd, const SocketInfo* listener,
+                                    const struct sockaddr* addr, socklen_t addrlen,
+                                    bool blocking) {
+  SocketInfo* si;
+  HostAddress remote;
+  char path[SOCKET_PATH_MAX];
+
+  if (SocketInfo_readAddress(&remote, path, addr, addrlen) == AF_UNSPEC
+      || (si = SocketInfo_alloc()) == NULL) {
+    return NULL;
+  }
+  si->local       = listener->local;
+  si->remote.addr = remote.addr;
+  si->remote.port = remote.port;
+  (void)SocketInfo_fill(si, fd, listener->proto, listener->datagram, blocking);
+  return SocketInfo_rank(SocketInfo_setPaths(si, listener->paths ? listener->paths->local : "",
+                                             path), true);
+}
+
+SocketInfo* SocketInfo_initListener(int fd) {
+  SocketInfo* si;
+  int err = errno;
+  int family;
+  char local[SOCKET_PATH_MAX];
+
+  si = SocketInfo_alloc();
+  if (si == NULL) {
+    return NULL;
+  }
+  if ((family = SocketInfo_fetchData(fd, getsockname, &si->local, local, NULL)) == AF_UNSPEC) {
+    Slab_free(slab, si);
     errno = err;
     return NULL;
   }
-  si->remote.addr = ntohl(saddr->sin_addr.s_addr);
-  si->remote.port = ntohs(saddr->sin_port);
-  si->local.addr  = 0;
-  si->local.port  = 0;
-  return SocketInfo_setup(si, fd, err);
+  memset(&si->remote.addr, 0, sizeof(si->remote.addr));
+  si->remote.port = -1;
+  si = SocketInfo_setPaths(SocketInfo_setup(si, fd, family, err), local, "");
+  if (si) {
+    si->remote.type = AH_None;
+  }
+  errno = err;
+  return si;
+}
+
+/** Check if the cached local address of a peer is the one of its socket.
+ */
+static inline bool SocketInfo_sameLocal(const SocketInfo* peer, const SocketInfo* si) {
+  if (si->paths) {
+    return strcmp(peer->paths->local, si->paths->local) == 0;
+  }
+  return peer->local.port == si->local.port
+      && memcmp(&peer->local.addr, &si->local.addr, sizeof(IPAddress)) == 0;
+}
+
+SocketInfo* SocketInfo_peer(SocketInfo* si, const struct sockaddr* addr, socklen_t addrlen) {
+  struct SocketInfoPeers* cache;
+  SocketInfo* peer = NULL;
+  SocketInfo* old  = NULL;
+  HostAddress remote;
+  char path[SOCKET_PATH_MAX];
+  int i;
+
+  if (SocketInfo_readAddress(&remote, path, addr, addrlen) == AF_UNSPEC
+      || (si->paths != NULL) != (addr->sa_family == AF_UNIX)) {
+    return NULL;
+  }
+  if (si->local.port == 0) {
+    /* The socket is bound by its first datagram */
+    SocketInfo_update(si);
+  }
+  if ((cache = si->peers) == NULL) {
+    if ((cache = (struct SocketInfoPeers*)calloc(1, sizeof(struct SocketInfoPeers))) == NULL) {
+      return NULL;
+    }
+    if (!__sync_bool_compare_and_swap(&si->peers, NULL, cache)) {
+      free(cache);
+      cache = si->peers;
+    }
+  }
+
+  while (__sync_lock_test_and_set(&cache->lock, 1)) {
+    /* Spin: the section only scans the cache */
+  }
+  for (i = 0 ; i < SOCKET_INFO_PEERS ; ++i) {
+    if (cache->peers[i] && cache->peers[i]->remote.port == remote.port
+        && memcmp(&cache->peers[i]->remote.addr, &remote.addr, sizeof(IPAddress)) == 0
+        && (si->paths == NULL || strcmp(cache->peers[i]->paths->remote, path) == 0)) {
+      peer = cache->peers[i];
+      break;
+    }
+  }
+  if (peer == NULL && (peer = SocketInfo_alloc()) != NULL) {
+    peer->local       = si->local;
+    peer->remote.addr = remote.addr;
+    peer->remote.port = remote.port;
+    (void)SocketInfo_fill(peer, si->fd, si->proto, si->datagram, si->blocking);
+    if ((peer = SocketInfo_setPaths(peer, si->paths ? si->paths->local : "", path)) != NULL) {
+      old = cache->peers[cache->next];
+      cache->peers[cache->next] = peer;
+      cache->next = (cache->next + 1) % SOCKET_INFO_PEERS;
+    }
+  }
+  if (peer) {
+    if (!SocketInfo_sameLocal(peer, si)) {
+      peer->local = si->local;
+      if (si->paths) {
+        strcpy(peer->paths->local, si->paths->local);
+      }
+    }
+    peer->blocking = si->blocking;
+    SocketInfo_lock(peer);
+  }
+  __sync_lock_release(&cache->lock);
+  SocketInfo_unlock(old);
+  return peer;
 }
 
 void SocketInfo_destroy(SocketInfo* si) {
+  int i;
+
   if (!si) {
     return;
   }
   if (si->free) {
     si->free(si);
   }
-  pthread_mutex_destroy(&si->semLock);
-  free(si);
+  if (si->peers) {
+    for (i = 0 ; i < SOCKET_INFO_PEERS ; ++i) {
+      SocketInfo_unlock(si->peers->peers[i]);
+    }
+    free(si->peers);
+  }
+  free(si->paths);
+  Slab_free(slab, si);
 }
 
-#include <stdio.h>
-
-SocketInfo* SocketInfo_check(SocketInfo* si, int fd) {
-  int type = 0;
-  socklen_t len = sizeof(int);
+void SocketInfo_update(SocketInfo* si) {
   int err = errno;
+  char path[SOCKET_PATH_MAX];
 
-#define RELEASE_SI                                                             \
-  si->toDestroy  = true;                                                       \
-  SocketInfo_unlock(si);                                                       \
-  errno = err;                                                                 \
-  return NULL;
+  if (si) {
+    /* The path is rewritten in place: readers may see a partial path but never
+     * a released one */
+    (void)SocketInfo_fetchData(si->fd, getsockname, &si->local,
+                               si->paths ? si->paths->local : path, NULL);
+  }
+  errno = err;
+}
 
-  if (si == NULL) {
-    return NULL;
+SocketInfoWatch* SocketInfo_watch(SocketInfo* si, int epfd, bool add) {
+  int i;
+
+  for (i = 0 ; i < SOCKETINFO_WATCHES ; ++i) {
+    if (si->watch[i].epfd == epfd) {
+      return &si->watch[i];
+    }
   }
-  SocketInfo_lock(si);
-  if (si->toDestroy) {
-    RELEASE_SI
+  for (i = 0 ; add && i < SOCKETINFO_WATCHES ; ++i) {
+    /* Another thread may register the socket in another set meanwhile */
+    if (__sync_bool_compare_and_swap(&si->watch[i].epfd, -1, epfd)) {
+      si->watch[i].masked = 0;
+      return &si->watch[i];
+    }
   }
-  if (si->proto == AP_UDP &&
-      (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) == -1
-       || (type != SOCK_STREAM && type != SOCK_DGRAM)
-       || (si->proto != (type == SOCK_STREAM ? AP_TCP : AP_UDP)))) {
-    RELEASE_SI
+  return NULL;
+}
+
+void SocketInfo_unwatch(SocketInfo* si) {
+  int i;
+
+  for (i = 0 ; i < SOCKETINFO_WATCHES ; ++i) {
+    si->watch[i].epfd   = -1;
+    si->watch[i].masked = 0;
   }
-  if (si->local.port == 0 && !SocketInfo_fetchData(fd, getsockname, &si->local)) {
-    RELEASE_SI
+}
+
+bool SocketInfo_masked(const SocketInfo* si) {
+  int i;
+
+  for (i = 0 ; i < SOCKETINFO_WATCHES ; ++i) {
+    if (si->watch[i].masked != 0) {
+      return true;
+    }
   }
-  errno = err;
-#undef RELEASE_SI
-  return si;
+  return false;
 }
 
 void SocketInfo_setData(SocketInfo* si, void* data, SocketInfoDataFree* cb) {
@@ -186,21 +689,14 @@ void SocketInfo_lock(SocketInfo* si) {
   if (!si) {
     return;
   }
-  pthread_mutex_lock(&si->semLock);
-  ++si->sem;
-  pthread_mutex_unlock(&si->semLock);
+  (void)__sync_add_and_fetch(&si->sem, 1);
 }
 
 void SocketInfo_unlock(SocketInfo* si) {
-  bool toDestroy;
   if (!si) {
     return;
   }
-  pthread_mutex_lock(&si->semLock);
-  si->sem--;
-  toDestroy = si->toDestroy && si->sem == 0;
-  pthread_mutex_unlock(&si->semLock);
-  if (toDestroy) {
+  if (__sync_sub_and_fetch(&si->sem, 1) == 0) {
     SocketInfo_destroy(si);
   }
 }
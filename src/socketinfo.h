@@ -32,9 +32,12 @@
 #ifndef _SOCKET_INFO_H_
 #define _SOCKET_INFO_H_
 
+#include <sys/types.h>
 #include <sys/socket.h>
 #include <stdint.h>
 
+#include "rate.h"
+
 /** @defgroup SocketInfo Socket informations
  *
  * A socket information structure stores informations related to a given socket.
@@ -61,19 +64,51 @@ typedef enum {
   Writing    = 2,                    /**< Writing data to the socket. */
   Connecting = 4,                    /**< Connecting a socket. */
   Closing    = 8,                    /**< Closing a socket. */
+  Accepting  = 16,                   /**< Accepting a socket. */
   Data       = Reading | Writing,    /**< Data operation (read or write). */
-  Connection = Connecting | Closing, /**< Operation impacting connection state. */
+  Connection = Connecting | Closing | Accepting, /**< Operation impacting connection state. */
   Any_Dir    = Data | Connection     /**< Any operation. */
 } SocketInfoDirection;
 
 /** Protocole.
  */
 typedef enum Proto {
-  AP_TCP = 1,               /**< TCP socket */
-  AP_UDP = 2,               /**< UDP socket */
-  AP_IP  = AP_TCP | AP_UDP  /**< IP socket (TCP or UDP) */
+  AP_TCP  = 1,               /**< TCP socket */
+  AP_UDP  = 2,               /**< UDP socket */
+  AP_IP   = AP_TCP | AP_UDP, /**< IP socket (TCP or UDP) */
+  AP_UNIX = 4,               /**< Unix domain socket (stream or datagram) */
+  AP_All  = AP_IP | AP_UNIX  /**< Any socket */
 } Proto;
 
+/** Kind of file descriptor.
+ *
+ * The kind may be combined with the protocol of the socket when it is known
+ * (see SocketKind_proto).
+ */
+typedef enum SocketKind {
+  SK_Unknown     = 0, /**< Not classified yet (or not connected). */
+  SK_Socket      = 1, /**< A socket we can handle. */
+  SK_NotSocket   = 2, /**< Not a socket (regular file, pipe, eventfd...). */
+  SK_Unsupported = 3, /**< A socket of an unsupported family or type. */
+  SK_Class       = 3, /**< Mask of the kind without the protocol. */
+  SK_TCP         = AP_TCP << 2, /**< The socket is a TCP socket. */
+  SK_UDP         = AP_UDP << 2, /**< The socket is a UDP socket. */
+  SK_UNIX        = AP_UNIX << 2, /**< The socket is a Unix domain socket. */
+  SK_Accepted    = 1 << 5 /**< The socket has been accepted (its infos may be built later). */
+} SocketKind;
+
+/** Get the kind of a file descriptor without the protocol.
+ */
+#define SocketKind_class(kind) ((SocketKind)((kind) & SK_Class))
+
+/** Get the protocol of a socket from its kind (0 if unknown).
+ */
+#define SocketKind_proto(kind) ((Proto)(((kind) >> 2) & AP_All))
+
+/** Build the kind of a socket of the given protocol.
+ */
+#define SocketKind_make(kind, proto) ((SocketKind)((kind) | ((proto) << 2)))
+
 /** Host type.
  */
 typedef enum Host {
@@ -81,29 +116,165 @@ typedef enum Host {
   AH_Me      = 1,  /**< I am ze host. */
   AH_DNS     = 2,  /**< I love DNS. */
   AH_Address = 4,  /**< Let's give me your IP address and I'll start hacking you. */
-  AH_Any     = AH_Me | AH_DNS | AH_Address /**< Any address */
+  AH_Any     = AH_Me | AH_DNS | AH_Address, /**< Any address */
+  AH_Path    = 8   /**< A path of a Unix domain socket (rules only). */
 } Host;
 
+/** Number of bits of an IP address.
+ */
+#define IP_ADDRESS_BITS 128
+
+/** Length of the prefix of the IPv4-mapped IPv6 addresses (::ffff:0:0/96).
+ */
+#define IP_V4_PREFIX 96
+
+/** Size of a buffer that can hold any formatted IP address.
+ */
+#define IP_ADDRESS_STRLEN 46
+
+/** An IP address.
+ *
+ * IPv4 addresses are stored as IPv4-mapped IPv6 addresses, so that the two
+ * families share the same prefixes.
+ */
+typedef struct IPAddress {
+  uint8_t bytes[IP_ADDRESS_BITS / 8]; /**< The address in network order. */
+} IPAddress;
+
 /** Struct HostAddress.
  */
 typedef struct HostAddress {
-  enum Host type; /**< The kind of host. */
-  uint32_t  addr; /**< IP address if the kind of host requires it. */
-  int       port; /**< The host port (or -1 if all the port are matched). */
+  enum Host type;   /**< The kind of host. */
+  IPAddress addr;   /**< IP address if the kind of host requires it. */
+  int       prefix; /**< Number of significant bits of the address (IP_ADDRESS_BITS for a single host). */
+  int       port;   /**< The host port (or -1 if all the port are matched). */
+  char*     path;   /**< Path pattern of a Unix socket (rules only, NULL otherwise). */
 } HostAddress;
 
+/** Size of a buffer that can hold the path of any Unix socket.
+ *
+ * Abstract names are shown with a leading '@' instead of their leading
+ * null byte, so the longest name takes the whole sun_path plus the final
+ * null byte.
+ */
+#define SOCKET_PATH_MAX 109
+
+/** Period of the checks of the file descriptor of a socket info, in nanoseconds.
+ *
+ * See SocketInfo_isCurrent.
+ */
+#define SOCKET_INFO_CHECK_PERIOD UINT64_C(1000000000)
+
+/** Paths of the ends of a Unix domain socket.
+ *
+ * An unnamed end (unbound socket, socketpair) has an empty path.
+ */
+typedef struct SocketInfoPaths {
+  char local[SOCKET_PATH_MAX];  /**< Path of the local end. */
+  char remote[SOCKET_PATH_MAX]; /**< Path of the remote end. */
+} SocketInfoPaths;
+
+/** Build an IP address from an IPv4 address.
+ *
+ * @param ip   Receive the address.
+ * @param addr The IPv4 address in host order.
+ */
+void IPAddress_fromV4(IPAddress* ip, uint32_t addr);
+
+/** Check if an address is an IPv4-mapped address.
+ *
+ * @param ip The address.
+ * @return true if the address is an IPv4 address.
+ */
+bool IPAddress_isV4(const IPAddress* ip);
+
+/** Read the address and the port of a socket address.
+ *
+ * @param ip      Receive the address.
+ * @param port    If not NULL, receive the port.
+ * @param addr    The socket address.
+ * @param addrlen The length of the addr structure.
+ * @return false if the address is neither an IPv4 nor an IPv6 address.
+ */
+bool IPAddress_fromSockaddr(IPAddress* ip, int* port, const struct sockaddr* addr,
+                            socklen_t addrlen);
+
+/** Check if an address belongs to a prefix.
+ *
+ * @param ip     The address.
+ * @param prefix The prefix.
+ * @param bits   The length of the prefix.
+ * @return true if the first bits of the two addresses are the same.
+ */
+bool IPAddress_inPrefix(const IPAddress* ip, const IPAddress* prefix, int bits);
+
+/** Format an address.
+ *
+ * IPv4-mapped addresses are shown in the IPv4 notation.
+ *
+ * @param ip  The address.
+ * @param buf The buffer, at least IP_ADDRESS_STRLEN bytes long.
+ * @return buf.
+ */
+const char* IPAddress_format(const IPAddress* ip, char* buf);
+
+/** Number of epoll sets in which the registration of a socket is followed.
+ */
+#define SOCKETINFO_WATCHES 4
+
+/** Registration of a socket in an epoll set.
+ */
+typedef struct SocketInfoWatch {
+  int      epfd;              /**< The epoll set (-1 if the slot is free). */
+  uint32_t events;            /**< Events requested by the user. */
+  uint64_t data;              /**< User data of the registration. */
+  volatile unsigned int masked; /**< Directions withheld from the set while hanging. */
+} SocketInfoWatch;
+
+/** Cache of the peers of an unconnected datagram socket.
+ */
+struct SocketInfoPeers;
+
+/** Index of a data direction in the fields of SocketInfoCounters.
+ *
+ * @param direction Reading or Writing.
+ */
+#define COUNTER_SLOT(direction) ((direction) == Writing ? 1 : 0)
+
+/** Activity of a socket.
+ *
+ * The calls are only counted while a rule of the queue reads the counters
+ * (see ActionQueue_process).
+ */
+typedef struct SocketInfoCounters {
+  volatile uint64_t bytes[2]; /**< Bytes transferred by the calls done, per direction
+                                   (see COUNTER_SLOT). */
+  volatile uint64_t calls[2]; /**< Successful calls done, per direction. */
+  RateWindow   rate;          /**< Calls and bytes of the last second, both directions. */
+  RateWindow*  peer;          /**< Calls and bytes of the last second with the remote host
+                                   (NULL if not a connection or if too many peers). */
+  uint64_t     created;       /**< Time the socket has been seen first (see Clock_coarse). */
+  unsigned int ordinal;       /**< Rank of the socket among the connections with the same
+                                   peer, starting at 1 (0 if the socket is not a connection). */
+} SocketInfoCounters;
+
 /** Definition of the SocketInfo structure
  */
 struct SocketInfo {
   int         fd;             /**< File descriptor of the socket. */
   Proto       proto;          /**< The socket is TCP. */
+  bool        datagram;       /**< The socket preserves the message boundaries. */
   HostAddress local;          /**< Local address. */
   HostAddress remote;         /**< Remote address. */
   bool        blocking;       /**< If true, the socket is blocking. */
+  SocketInfoWatch watch[SOCKETINFO_WATCHES]; /**< Registrations of the socket in epoll sets. */
+  struct SocketInfoPeers* peers; /**< Peers of an unconnected datagram socket. */
+  SocketInfoPaths* paths;     /**< Paths of a Unix socket (NULL for an IP socket). */
+  SocketInfoCounters counters; /**< Activity of the socket. */
+  ino_t       inode;          /**< Inode of the socket (0 if not known yet). */
+  volatile uint64_t checked;  /**< Coarse time of the last check of the file descriptor. */
 
-  bool        toDestroy;      /**< If true, the info can be destroied. */
-  int         sem;            /**< Number of accessors. */
-  pthread_mutex_t semLock;    /**< Lock to access the number of accessors. */
+  volatile int sem;           /**< Number of references (atomically updated). */
 
   void* data;                 /**< User data associated with the socket. */
   SocketInfoDataFree* free;   /**< Callback used to clear the user data. */
@@ -113,12 +284,54 @@ struct SocketInfo {
 /** Build a new socket info.
  *
  * Fetch informations about the given socket and fill a light SocketInfo
- * structure.
+ * structure. The new SocketInfo holds one reference owned by the caller.
+ *
+ * An unconnected datagram socket gets a socket info whose remote end has the
+ * type AH_None, the peer of each call is given by SocketInfo_peer.
+ *
+ * The paths of the ends of a Unix domain socket are fetched along with its
+ * addresses and kept in the paths field of the socket info.
+ *
+ * A connected socket is ranked among the connections with the same peer
+ * (see SocketInfoCounters::ordinal) when its socket info is built.
  *
  * @param fd File descriptor of the socket.
+ * @param kind If not NULL, the kind of the file descriptor known so far (a
+ *             socket flagged SK_Accepted is ranked as an accepted one), and
+ *             receive its kind. SK_Unknown is reported when the kind may
+ *             change later (invalid file descriptor, socket not connected
+ *             yet...).
  * @return A new SocketInfo structure or NULL if the fd is not a valid socket.
  */
-SocketInfo* SocketInfo_init(int fd);
+SocketInfo* SocketInfo_init(int fd, SocketKind* kind);
+
+/** Check that the file descriptor of a socket info still refers to its socket.
+ *
+ * A file descriptor closed and reassigned through calls that are not
+ * wrapped (raw syscalls, io_uring...) leaves a stale socket info. The check
+ * compares the inode of the file descriptor with the one of the socket, it
+ * is only performed once per SOCKET_INFO_CHECK_PERIOD so that it costs a
+ * coarse clock read on most calls.
+ *
+ * @param si The socket info.
+ * @return false if the file descriptor now refers to another file.
+ */
+bool SocketInfo_isCurrent(SocketInfo* si);
+
+/** Get the socket info of a peer of an unconnected datagram socket.
+ *
+ * The socket info of the last peers of the socket are kept in a small cache,
+ * so that the address of a peer is not classified on each datagram. The
+ * socket info of a peer shares the file descriptor and the local address of
+ * the socket.
+ *
+ * @param si      The unconnected socket.
+ * @param addr    The address of the peer.
+ * @param addrlen The length of the addr structure.
+ * @return A new reference on the socket info of the peer, NULL if the address
+ *         is not supported.
+ */
+SocketInfo* SocketInfo_peer(SocketInfo* si, const struct sockaddr* addr, socklen_t addrlen);
 
 /** Build a new socket info from data given by the user.
  *
@@ -134,19 +347,72 @@ SocketInfo* SocketInfo_init(int fd);
  */
 SocketInfo* SocketInfo_initLight(int fd, const struct sockaddr* addr, socklen_t addrlen);
 
+/** Build the socket info of an accepted socket.
+ *
+ * No syscall is performed: the local address and the protocol are inherited
+ * from the listening socket and the remote address is the one returned by
+ * accept.
+ *
+ * @param fd       File descriptor of the accepted socket.
+ * @param listener Socket info of the listening socket.
+ * @param addr     The address of the peer.
+ * @param addrlen  The length of the addr structure.
+ * @param blocking True if the accepted socket is blocking.
+ * @return A new SocketInfo structure or NULL if the address is not supported.
+ */
+SocketInfo* SocketInfo_initAccepted(int fd, const SocketInfo* listener,
+                                    const struct sockaddr* addr, socklen_t addrlen,
+                                    bool blocking);
+
+/** Build the socket info of a listening socket.
+ *
+ * The remote end of a listening socket has the type AH_None.
+ *
+ * @param fd File descriptor of the socket.
+ * @return A new SocketInfo structure or NULL if the fd is not a valid socket.
+ */
+SocketInfo* SocketInfo_initListener(int fd);
+
 /** Free the content of a socket info.
  *
  * @param si SocketInfo to free
  */
 void SocketInfo_destroy(SocketInfo* si);
 
-/** Check the SocketInfo is really associated to the given socket.
+/** Refresh the local address of a socket info.
+ *
+ * The local address of a socket is only known once it has been bound,
+ * explicitly or by connect. The cached address is updated by the wrappers
+ * of these calls, so that it never has to be checked again on data
+ * transfers.
  *
  * @param si The socket info.
- * @param fd File descriptor of the socket.
- * @return The socket info if the check pass, NULL if an error occured.
  */
-SocketInfo* SocketInfo_check(SocketInfo* si, int fd);
+void SocketInfo_update(SocketInfo* si);
+
+/** Get the registration of a socket in an epoll set.
+ *
+ * @param si   The socket info.
+ * @param epfd The epoll set.
+ * @param add  If true and the socket is not followed in the set yet, claim
+ *             a free slot for it.
+ * @return The registration, NULL if it is not followed (or if all the slots
+ *         are used).
+ */
+SocketInfoWatch* SocketInfo_watch(SocketInfo* si, int epfd, bool add);
+
+/** Forget the registrations of a socket in the epoll sets.
+ *
+ * @param si The socket info.
+ */
+void SocketInfo_unwatch(SocketInfo* si);
+
+/** Check whether a socket is withheld from an epoll set.
+ *
+ * @param si The socket info.
+ * @return true if some direction of the socket is masked in some set.
+ */
+bool SocketInfo_masked(const SocketInfo* si);
 
 /** Set socket info user data and register the corresponding remover.
  *
@@ -157,6 +423,10 @@ SocketInfo* SocketInfo_check(SocketInfo* si, int fd);
 void SocketInfo_setData(SocketInfo* si, void* data, SocketInfoDataFree* cb);
 
 /** Register a new user.
+ *
+ * This takes a new reference on the socket info. This is lock-free, but the
+ * caller must already own a reference or be sure the socket info can't be
+ * released concurrently (see @ref SocketTable).
  *
  * @param si The socket info.
  */
@@ -164,7 +434,7 @@ void SocketInfo_lock(SocketInfo* si);
 
 /** Unregister a user.
  *
- * If the toDestroy flag has been set, the socket info will be destroyed.
+ * Release a reference. The socket info is destroyed with its last reference.
  *
  * @param si The socket info.
  */
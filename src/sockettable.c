@@ -0,0 +1,209 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "sockettable.h"
+#include "epoch.h"
+
+/** Number of slots in a chunk (must be a power of 2).
+ */
+#define CHUNK_SIZE  1024
+#define CHUNK_SHIFT 10
+
+/** Maximum number of chunks (limits the file descriptors to 4M).
+ */
+#define CHUNK_COUNT 4096
+
+/** Number of bits of a kind stamp used to store the kind.
+ */
+#define KIND_BITS 6
+#define KIND_MASK ((1u << KIND_BITS) - 1)
+
+/** A chunk of slots.
+ */
+struct SocketTableChunk {
+  SocketInfo* volatile slots[CHUNK_SIZE];   /**< The published socket infos. */
+  volatile unsigned int kinds[CHUNK_SIZE];  /**< Generation and kind of the fds. */
+};
+
+/** The socket table.
+ */
+struct SocketTable {
+  struct SocketTableChunk* volatile chunks[CHUNK_COUNT]; /**< The chunks. */
+};
+
+SocketTable* SocketTable_init(void) {
+  return (SocketTable*)calloc(1, sizeof(SocketTable));
+}
+
+void SocketTable_destroy(SocketTable* table) {
+  size_t i, j;
+  for (i = 0 ; i < CHUNK_COUNT ; ++i) {
+    struct SocketTableChunk* chunk = table->chunks[i];
+    if (chunk == NULL) {
+      continue;
+    }
+    for (j = 0 ; j < CHUNK_SIZE ; ++j) {
+      SocketInfo_unlock(chunk->slots[j]);
+    }
+    free(chunk);
+  }
+  free(table);
+}
+
+/** Get the chunk containing the given file descriptor.
+ *
+ * @param table The table.
+ * @param fd    The file descriptor.
+ * @param alloc If true, allocate the chunk if it does not exist yet.
+ * @return The chunk or NULL.
+ */
+static inline struct SocketTableChunk* SocketTable_chunk(SocketTable* table, int fd,
+                                                         bool alloc) {
+  struct SocketTableChunk* chunk;
+  unsigned int pos = ((unsigned int)fd) >> CHUNK_SHIFT;
+
+  if (fd < 0 || pos >= CHUNK_COUNT) {
+    return NULL;
+  }
+  chunk = table->chunks[pos];
+  if (chunk == NULL && alloc) {
+    chunk = (struct SocketTableChunk*)calloc(1, sizeof(struct SocketTableChunk));
+    if (chunk == NULL) {
+      return NULL;
+    }
+    if (!__sync_bool_compare_and_swap(&table->chunks[pos], NULL, chunk)) {
+      free(chunk);
+      chunk = table->chunks[pos];
+    }
+  }
+  return chunk;
+}
+
+SocketInfo* SocketTable_get(SocketTable* table, int fd) {
+  struct SocketTableChunk* chunk;
+  SocketInfo* si = NULL;
+
+  chunk = SocketTable_chunk(table, fd, false);
+  if (chunk == NULL) {
+    return NULL;
+  }
+  Epoch_enter();
+  si = chunk->slots[fd & (CHUNK_SIZE - 1)];
+  SocketInfo_lock(si);
+  Epoch_leave();
+  return si;
+}
+
+static void SocketTable_release(void* si) {
+  SocketInfo_unlock((SocketInfo*)si);
+}
+
+bool SocketTable_put(SocketTable* table, int fd, SocketInfo* si) {
+  struct SocketTableChunk* chunk;
+  SocketInfo* volatile* slot;
+  SocketInfo* old;
+
+  chunk = SocketTable_chunk(table, fd, si != NULL);
+  if (chunk == NULL) {
+    return si == NULL;
+  }
+  SocketInfo_lock(si);
+  slot = &chunk->slots[fd & (CHUNK_SIZE - 1)];
+  do {
+    old = *slot;
+  } while (!__sync_bool_compare_and_swap(slot, old, si));
+  Epoch_retire(old, SocketTable_release);
+  return true;
+}
+
+SocketKind SocketTable_kind(SocketTable* table, int fd, unsigned int* stamp) {
+  struct SocketTableChunk* chunk;
+  unsigned int value = 0;
+
+  chunk = SocketTable_chunk(table, fd, false);
+  if (chunk != NULL) {
+    value = chunk->kinds[fd & (CHUNK_SIZE - 1)];
+  }
+  if (stamp) {
+    *stamp = value;
+  }
+  return (SocketKind)(value & KIND_MASK);
+}
+
+bool SocketTable_classify(SocketTable* table, int fd, unsigned int stamp, SocketKind kind) {
+  struct SocketTableChunk* chunk;
+
+  chunk = SocketTable_chunk(table, fd, true);
+  if (chunk == NULL) {
+    return false;
+  }
+  return __sync_bool_compare_and_swap(&chunk->kinds[fd & (CHUNK_SIZE - 1)], stamp,
+                                      (stamp & ~KIND_MASK) | (unsigned int)kind);
+}
+
+void SocketTable_invalidate(SocketTable* table, int fd, SocketKind kind) {
+  struct SocketTableChunk* chunk;
+  volatile unsigned int* slot;
+  unsigned int old;
+
+  chunk = SocketTable_chunk(table, fd, true);
+  if (chunk == NULL) {
+    return;
+  }
+  slot = &chunk->kinds[fd & (CHUNK_SIZE - 1)];
+  do {
+    old = *slot;
+  } while (!__sync_bool_compare_and_swap(slot, old,
+                                         ((old & ~KIND_MASK) + (1u << KIND_BITS))
+                                         | (unsigned int)kind));
+}
+
+void SocketTable_clear(SocketTable* table, unsigned int first, unsigned int last) {
+  unsigned int pos;
+  unsigned int fd;
+
+  if (last >= CHUNK_COUNT * CHUNK_SIZE) {
+    last = CHUNK_COUNT * CHUNK_SIZE - 1;
+  }
+  for (fd = first ; fd <= last ; ) {
+    pos = fd >> CHUNK_SHIFT;
+    if (table->chunks[pos] == NULL) {
+      fd = (pos + 1) << CHUNK_SHIFT;
+      continue;
+    }
+    SocketTable_remove(table, (int)fd);
+    SocketTable_invalidate(table, (int)fd, SK_Unknown);
+    ++fd;
+  }
+}
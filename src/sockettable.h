@@ -0,0 +1,155 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#ifndef _SOCKET_TABLE_H_
+#define _SOCKET_TABLE_H_
+
+#include "socketinfo.h"
+
+/** @defgroup SocketTable Socket table
+ *
+ * The socket table associates file descriptors with their @ref SocketInfo.
+ * It is directly indexed by the file descriptor: the slots are stored in
+ * chunks that are allocated on demand and never move, so the table can grow
+ * without blocking the readers.
+ *
+ * Lookups are lock-free: a slot is read inside an @ref Epoch critical section
+ * and the returned SocketInfo is referenced before leaving it. The table owns
+ * one reference on each SocketInfo it contains, this reference is released
+ * through the epoch reclamation when the SocketInfo is replaced or removed,
+ * so updates never wait for the readers.
+ *
+ * Each slot also caches the @ref SocketKind of its file descriptor, so that
+ * file descriptors known not to be sockets can be skipped with a single load.
+ * The kind is stamped with a generation number: invalidating a slot bumps the
+ * generation, so a classification computed from a stale stamp is discarded.
+ *
+ * The table only learns the reassignments of the file descriptors that go
+ * through the wrapped calls: the entry of a file descriptor closed and
+ * reused behind them (raw syscalls, io_uring...) stays in the table until
+ * its owner notices it (see SocketInfo_isCurrent). @{
+ */
+
+/** A socket table.
+ */
+typedef struct SocketTable SocketTable;
+
+/** Build a new empty socket table.
+ *
+ * @return A new SocketTable, or NULL on error.
+ */
+SocketTable* SocketTable_init(void);
+
+/** Destroy the table and release all the SocketInfo it references.
+ *
+ * @param table The table.
+ */
+void SocketTable_destroy(SocketTable* table);
+
+/** Get the SocketInfo associated with a file descriptor.
+ *
+ * The returned SocketInfo is locked (@ref SocketInfo_lock) and must be
+ * released using SocketInfo_unlock.
+ *
+ * @param table The table.
+ * @param fd    The file descriptor.
+ * @return The socket info, or NULL if none is registered.
+ */
+SocketInfo* SocketTable_get(SocketTable* table, int fd);
+
+/** Associate a SocketInfo with a file descriptor.
+ *
+ * The table takes its own reference on @p si. The SocketInfo previously
+ * associated with the file descriptor is released once the current readers
+ * are gone.
+ *
+ * @param table The table.
+ * @param fd    The file descriptor.
+ * @param si    The socket info (or NULL to clear the slot).
+ * @return false if the slot can't be allocated.
+ */
+bool SocketTable_put(SocketTable* table, int fd, SocketInfo* si);
+
+/** Remove the SocketInfo associated with a file descriptor.
+ *
+ * @param table The table.
+ * @param fd    The file descriptor.
+ */
+#define SocketTable_remove(table, fd) ((void)SocketTable_put(table, fd, NULL))
+
+/** Get the cached kind of a file descriptor.
+ *
+ * @param table The table.
+ * @param fd    The file descriptor.
+ * @param stamp If not NULL, receive the stamp to give to SocketTable_classify.
+ * @return The kind of the file descriptor (SK_Unknown if not classified).
+ */
+SocketKind SocketTable_kind(SocketTable* table, int fd, unsigned int* stamp);
+
+/** Store the kind of a file descriptor.
+ *
+ * The kind is only stored if the slot has not been invalidated since
+ * @p stamp has been fetched using SocketTable_kind.
+ *
+ * @param table The table.
+ * @param fd    The file descriptor.
+ * @param stamp The stamp returned by SocketTable_kind.
+ * @param kind  The kind of the file descriptor.
+ * @return true if the kind has been stored.
+ */
+bool SocketTable_classify(SocketTable* table, int fd, unsigned int stamp, SocketKind kind);
+
+/** Forget the kind of a file descriptor.
+ *
+ * Must be called each time the file descriptor may have been reassigned.
+ *
+ * @param table The table.
+ * @param fd    The file descriptor.
+ * @param kind  The new kind of the file descriptor, if known (or SK_Unknown).
+ */
+void SocketTable_invalidate(SocketTable* table, int fd, SocketKind kind);
+
+/** Forget everything known about a range of file descriptors.
+ *
+ * The SocketInfo of the file descriptors are removed and their kinds are
+ * invalidated. Only the chunks that already exist are visited, so clearing
+ * a huge range (as done by close_range) costs nothing for the unused file
+ * descriptors.
+ *
+ * @param table The table.
+ * @param first The first file descriptor of the range.
+ * @param last  The last file descriptor of the range (included).
+ */
+void SocketTable_clear(SocketTable* table, unsigned int first, unsigned int last);
+
+/** @} */
+
+#endif
@@ -0,0 +1,377 @@
+/******************************************************************************/
+/*                          libinject                                         */
+/*                                                                            */
+/*  Redistribution and use in source and binary forms, with or without        */
+/*  modification, are permitted provided that the following conditions        */
+/*  are met:                                                                  */
+/*                                                                            */
+/*  1. Redistributions of source code must retain the above copyright         */
+/*     notice, this list of conditions and the following disclaimer.          */
+/*  2. Redistributions in binary form must reproduce the above copyright      */
+/*     notice, this list of conditions and the following disclaimer in the    */
+/*     documentation and/or other materials provided with the distribution.   */
+/*  3. The names of its contributors may not be used to endorse or promote    */
+/*     products derived from this software without specific prior written     */
+/*     permission.                                                            */
+/*                                                                            */
+/*  THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS   */
+/*  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED         */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE    */
+/*  DISCLAIMED.  IN NO EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY         */
+/*  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL        */
+/*  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS   */
+/*  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)     */
+/*  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,       */
+/*  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN  */
+/*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/*  POSSIBILITY OF SUCH DAMAGE.                                               */
+/*                                                                            */
+/*   Copyright (c) 2007-2010 Exalead S.A.                                     */
+/******************************************************************************/
+
+#define _GNU_SOURCE /* Needed for sendmmsg and recvmmsg */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "../testlib/testlib.h"
+#include "../src/binding.h"
+
+/* These tests go through the wrappers of the library, loaded with the rules
+ * of testbinding.rules. The ports below must match the ones of the rules.
+ */
+#define PORT_RECEIVER  42431 /**< Receiver of the datagram tests. */
+#define PORT_TRUNCATED 42432 /**< Sender whose datagrams are truncated. */
+#define PORT_CLEAN     42433 /**< Sender whose datagrams are left untouched. */
+#define PORT_MMSG_CUT  42434 /**< Receiver of truncated sendmmsg messages. */
+#define PORT_MMSG      42435 /**< Receiver of untouched sendmmsg messages. */
+#define PORT_DROPPED   42436 /**< Receiver of the bypass tests. */
+#define PORT_HANGING   42437 /**< Sender whose datagrams hang. */
+#define MMSG_COUNT     4     /**< Maximum number of messages of a mmsg test. */
+
+/** Open an UDP socket bound to the given port of the loopback.
+ */
+static int testUdp(int port) {
+  struct sockaddr_in addr;
+  int fd;
+
+  if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) == -1) {
+    return -1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/** Send a datagram to the given port of the loopback.
+ */
+static ssize_t testSendTo(int fd, int port, const char* data) {
+  struct sockaddr_in addr;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  return sendto(fd, data, strlen(data), 0, (struct sockaddr*)&addr, sizeof(addr));
+}
+
+/** Data for the datagram sender tests.
+ */
+struct FromCase {
+  int  port;    /**< Port of the sender. */
+  bool recvmsg; /**< True to receive with recvmsg in two buffers. */
+};
+
+static bool testFrom(TestFeed data, TestFeed result) {
+  const struct FromCase* test = (const struct FromCase*)data.p;
+  struct sockaddr_in from;
+  socklen_t fromlen = sizeof(from);
+  char buf[8];
+  ssize_t ret = -1;
+  int receiver;
+  int sender;
+  bool ok;
+
+  receiver = testUdp(PORT_RECEIVER);
+  sender   = testUdp(test->port);
+  ok = receiver != -1 && sender != -1 && testSendTo(sender, PORT_RECEIVER, "hello") == 5;
+  memset(&from, 0, sizeof(from));
+  if (ok && test->recvmsg) {
+    struct msghdr msg;
+    struct iovec iov[2];
+    iov[0].iov_base = buf;
+    iov[0].iov_len  = 3;
+    iov[1].iov_base = buf + 3;
+    iov[1].iov_len  = sizeof(buf) - 3;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name    = &from;
+    msg.msg_namelen = fromlen;
+    msg.msg_iov     = iov;
+    msg.msg_iovlen  = 2;
+    ret = recvmsg(receiver, &msg, 0);
+  } else if (ok) {
+    ret = recvfrom(receiver, buf, sizeof(buf), 0, (struct sockaddr*)&from, &fromlen);
+  }
+  /* The rule is chosen on the sender of the datagram actually received */
+  ok = ok && ret == result.i && ntohs(from.sin_port) == test->port
+          && memcmp(buf, "hello", ret) == 0;
+  if (receiver != -1) {
+    close(receiver);
+  }
+  if (sender != -1) {
+    close(sender);
+  }
+  return ok;
+}
+
+/** Data for the sendmmsg tests.
+ */
+struct MMsgCase {
+  int port;  /**< Port of the receiver. */
+  int count; /**< Number of messages sent in a single call. */
+};
+
+static bool testMMsg(TestFeed data, TestFeed result) {
+  const struct MMsgCase* test = (const struct MMsgCase*)data.p;
+  struct mmsghdr msgs[MMSG_COUNT];
+  struct iovec iov[MMSG_COUNT];
+  struct sockaddr_in addr;
+  char bufs[MMSG_COUNT][16];
+  int receiver;
+  int sender;
+  int ret;
+  int i;
+  bool ok;
+
+  receiver = testUdp(test->port);
+  sender   = testUdp(0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(test->port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  memset(msgs, 0, sizeof(msgs));
+  for (i = 0 ; i < test->count ; ++i) {
+    strcpy(bufs[i], "message0");
+    bufs[i][7] = (char)('0' + i);
+    iov[i].iov_base = bufs[i];
+    iov[i].iov_len  = 8;
+    msgs[i].msg_hdr.msg_name    = &addr;
+    msgs[i].msg_hdr.msg_namelen = sizeof(addr);
+    msgs[i].msg_hdr.msg_iov     = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen  = 1;
+  }
+  ok = receiver != -1 && sender != -1
+    && sendmmsg(sender, msgs, test->count, 0) == test->count;
+  for (i = 0 ; ok && i < test->count ; ++i) {
+    ok = msgs[i].msg_len == (unsigned int)result.i;
+  }
+
+  /* Each message reaches the receiver on its own, with its own content */
+  memset(msgs, 0, sizeof(msgs));
+  memset(bufs, 0, sizeof(bufs));
+  for (i = 0 ; i < MMSG_COUNT ; ++i) {
+    iov[i].iov_base = bufs[i];
+    iov[i].iov_len  = sizeof(bufs[i]);
+    msgs[i].msg_hdr.msg_iov    = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  ret = ok ? recvmmsg(receiver, msgs, MMSG_COUNT, MSG_DONTWAIT, NULL) : -1;
+  ok = ok && ret == test->count;
+  for (i = 0 ; ok && i < test->count ; ++i) {
+    ok = msgs[i].msg_len == (unsigned int)result.i
+      && memcmp(bufs[i], "message", result.i < 7 ? result.i : 7) == 0
+      && (result.i < 8 || bufs[i][7] == (char)('0' + i));
+  }
+  if (receiver != -1) {
+    close(receiver);
+  }
+  if (sender != -1) {
+    close(sender);
+  }
+  return ok;
+}
+
+static bool testBypass(TestFeed data, TestFeed result) {
+  const bool bypass = data.i != 0;
+  char buf[8];
+  int receiver;
+  int sender;
+  bool ok;
+
+  receiver = testUdp(PORT_DROPPED);
+  sender   = testUdp(0);
+  ok = receiver != -1 && sender != -1;
+  if (ok && bypass) {
+    /* The calls of a bypass section never see the rules */
+    Binding_enter();
+    ok = testSendTo(sender, PORT_DROPPED, "data") == 4;
+    Binding_leave();
+  } else if (ok) {
+    ok = testSendTo(sender, PORT_DROPPED, "data") == 4;
+  }
+  ok = ok && recv(receiver, buf, sizeof(buf), MSG_DONTWAIT) == result.i;
+  ok = ok && (result.i != -1 || errno == EAGAIN);
+  if (receiver != -1) {
+    close(receiver);
+  }
+  if (sender != -1) {
+    close(sender);
+  }
+  return ok;
+}
+
+static bool testHang(TestFeed data, TestFeed result) {
+  struct timespec wait;
+  char buf[8];
+  int receiver;
+  int sender;
+  bool ok;
+
+  receiver = testUdp(PORT_RECEIVER);
+  sender   = testUdp(PORT_HANGING);
+  ok = receiver != -1 && sender != -1 && testSendTo(sender, PORT_RECEIVER, "hello") == 5;
+
+  /* The hang fails the call before the datagram is received */
+  ok = ok && recvfrom(receiver, buf, sizeof(buf), MSG_DONTWAIT, NULL, NULL) == -1
+          && errno == EAGAIN;
+  wait.tv_sec  = 0;
+  wait.tv_nsec = data.i * 1000000L;
+  nanosleep(&wait, NULL);
+  ok = ok && recvfrom(receiver, buf, sizeof(buf), MSG_DONTWAIT, NULL, NULL) == result.i
+          && memcmp(buf, "hello", result.i) == 0;
+  if (receiver != -1) {
+    close(receiver);
+  }
+  if (sender != -1) {
+    close(sender);
+  }
+  return ok;
+}
+
+/** Count the epoll sets reporting a socket as readable.
+ */
+static int testReady(const int* sets, int count) {
+  struct epoll_event event;
+  int ready = 0;
+  int i;
+
+  for (i = 0 ; i < count ; ++i) {
+    if (epoll_wait(sets[i], &event, 1, 0) == 1 && (event.events & EPOLLIN)) {
+      ++ready;
+    }
+  }
+  return ready;
+}
+
+static bool testEpoll(TestFeed data, TestFeed result) {
+  struct sockaddr_in addr;
+  struct epoll_event event;
+  struct timespec wait;
+  int sets[2] = { -1, -1 };
+  char buf[8];
+  int receiver;
+  int sender;
+  int i;
+  bool ok;
+
+  receiver = testUdp(PORT_RECEIVER);
+  sender   = testUdp(PORT_HANGING);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(PORT_HANGING);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  /* The receiver is connected, so that the hang is kept by its own socket */
+  ok = receiver != -1 && sender != -1
+    && connect(receiver, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+  for (i = 0 ; ok && i < 2 ; ++i) {
+    /* The last set is registered exclusively when asked */
+    event.events  = EPOLLIN | (i == 1 && data.i ? EPOLLEXCLUSIVE : 0);
+    event.data.fd = receiver;
+    ok = (sets[i] = epoll_create1(0)) != -1
+      && epoll_ctl(sets[i], EPOLL_CTL_ADD, receiver, &event) == 0;
+  }
+  ok = ok && testSendTo(sender, PORT_RECEIVER, "hello") == 5;
+
+  /* The hanging socket is withheld from every set it can be masked in */
+  ok = ok && recvfrom(receiver, buf, sizeof(buf), MSG_DONTWAIT, NULL, NULL) == -1
+          && errno == EAGAIN
+          && testReady(sets, 2) == result.i;
+  wait.tv_sec  = 0;
+  wait.tv_nsec = 200000000L;
+  nanosleep(&wait, NULL);
+  ok = ok && testReady(sets, 2) == 2
+          && recvfrom(receiver, buf, sizeof(buf), MSG_DONTWAIT, NULL, NULL) == 5;
+  for (i = 0 ; i < 2 ; ++i) {
+    if (sets[i] != -1) {
+      close(sets[i]);
+    }
+  }
+  if (receiver != -1) {
+    close(receiver);
+  }
+  if (sender != -1) {
+    close(sender);
+  }
+  return ok;
+}
+
+int main(void) {
+  static const struct FromCase fromCases[] = {
+    { PORT_TRUNCATED, false },
+    { PORT_CLEAN,     false },
+    { PORT_TRUNCATED, true },
+    { PORT_CLEAN,     true }
+  };
+  static const struct MMsgCase mmsgCases[] = {
+    { PORT_MMSG_CUT, 1 },
+    { PORT_MMSG_CUT, MMSG_COUNT },
+    { PORT_MMSG,     1 },
+    { PORT_MMSG,     MMSG_COUNT }
+  };
+  TestSet* set;
+  testid tid;
+
+  set = TestSet_init("Binding");
+
+  /* Build datagram sender tests */
+  tid = TestSet_registerTest(set, "from", testFrom);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&fromCases[0]), INT_FEED(2));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&fromCases[1]), INT_FEED(5));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&fromCases[2]), INT_FEED(2));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&fromCases[3]), INT_FEED(5));
+
+  /* Build sendmmsg tests */
+  tid = TestSet_registerTest(set, "mmsg", testMMsg);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&mmsgCases[0]), INT_FEED(3));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&mmsgCases[1]), INT_FEED(3));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&mmsgCases[2]), INT_FEED(8));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&mmsgCases[3]), INT_FEED(8));
+
+  /* Build bypass section tests */
+  tid = TestSet_registerTest(set, "bypass", testBypass);
+  TestSet_registerTestData(set, tid, true, INT_FEED(0), INT_FEED(-1));
+  TestSet_registerTestData(set, tid, true, INT_FEED(1), INT_FEED(4));
+
+  /* Build unconnected hang tests */
+  tid = TestSet_registerTest(set, "hang", testHang);
+  TestSet_registerTestData(set, tid, true, INT_FEED(200), INT_FEED(5));
+
+  /* Build epoll hang tests */
+  tid = TestSet_registerTest(set, "epoll", testEpoll);
+  TestSet_registerTestData(set, tid, true, INT_FEED(0), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, INT_FEED(1), INT_FEED(1));
+
+  /* Process all this... and return. */
+  return TestSet_run(set) ? 0 : 1;
+}
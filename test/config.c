@@ -29,11 +29,29 @@
 /*   Copyright (c) 2007-2010 Exalead S.A.                                     */
 /******************************************************************************/
 
+#define _GNU_SOURCE /* Needed for pipe2 */
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include "../testlib/testlib.h"
 #include "../src/conffile.h"
 #include "../src/actions.h"
+#include "../src/socketinfo.h"
+#include "../src/sockettable.h"
+#include "../src/random.h"
+#include "../src/payload.h"
+#include "../src/clock.h"
+#include "../src/arena.h"
+#include "../src/epoch.h"
 
 static bool testParser(TestFeed data, TestFeed result) {
   Action* action;
@@ -48,6 +66,345 @@ static bool testParser(TestFeed data, TestFeed result) {
   return false;
 }
 
+static bool testQueue(TestFeed data, TestFeed result) {
+  ActionQueue* queue;
+  bool ok;
+
+  queue = ActionQueue_init(2000);
+  if (!queue) {
+    return false;
+  }
+  ok = ActionQueue_put(queue, (char*)data.p, NULL, true, false);
+  ActionQueue_destroy(queue);
+  return ok;
+}
+
+/** Socket description for the match tests.
+ */
+struct MatchCase {
+  Proto proto;                   /**< Protocol of the socket. */
+  SocketInfoDirection direction; /**< Direction of the call. */
+  int port;                      /**< Remote port of the socket. */
+};
+
+static ActionQueue* matchQueue = NULL;
+
+static bool testMatch(TestFeed data, TestFeed result) {
+  const struct MatchCase* test = (const struct MatchCase*)data.p;
+  SocketInfo si;
+  Action* action;
+
+  memset(&si, 0, sizeof(si));
+  si.proto       = test->proto;
+  si.local.type  = AH_Me;
+  IPAddress_fromV4(&si.local.addr, 0x7f000001);
+  si.local.port  = 1234;
+  si.remote.type = test->port == 53 ? AH_DNS : AH_Address;
+  IPAddress_fromV4(&si.remote.addr, 0x7f000001);
+  si.remote.port = test->port;
+  action = ActionQueue_getFirstMatch(matchQueue, &si, test->direction, false);
+  if (result.i == -1) {
+    return action == NULL;
+  }
+  return action != NULL && action == ActionQueue_get(matchQueue, result.i, false);
+}
+
+/** Socket description for the prefix tests.
+ */
+struct PrefixCase {
+  SocketInfoDirection direction; /**< Direction of the call. */
+  const char* remote;            /**< Remote address of the socket. */
+};
+
+static ActionQueue* prefixQueue = NULL;
+
+static bool testPrefix(TestFeed data, TestFeed result) {
+  const struct PrefixCase* test = (const struct PrefixCase*)data.p;
+  SocketInfo si;
+  Action* action;
+
+  memset(&si, 0, sizeof(si));
+  si.proto       = AP_TCP;
+  si.local.type  = AH_Me;
+  IPAddress_fromV4(&si.local.addr, 0x7f000001);
+  si.local.port  = 1234;
+  si.remote.type = AH_Address;
+  si.remote.port = 80;
+  if (strchr(test->remote, ':')) {
+    (void)inet_pton(AF_INET6, test->remote, si.remote.addr.bytes);
+  } else {
+    uint32_t addr = 0;
+    (void)inet_pton(AF_INET, test->remote, &addr);
+    IPAddress_fromV4(&si.remote.addr, ntohl(addr));
+  }
+  action = ActionQueue_getFirstMatch(prefixQueue, &si, test->direction, false);
+  if (result.i == -1) {
+    return action == NULL;
+  }
+  return action != NULL && action == ActionQueue_get(prefixQueue, result.i, false);
+}
+
+/** Socket description for the Unix path tests.
+ */
+struct PathCase {
+  SocketInfoDirection direction; /**< Direction of the call. */
+  const char* local;             /**< Path of the local end. */
+  const char* remote;            /**< Path of the remote end. */
+};
+
+static ActionQueue* pathQueue = NULL;
+
+static bool testPath(TestFeed data, TestFeed result) {
+  const struct PathCase* test = (const struct PathCase*)data.p;
+  SocketInfoPaths paths;
+  SocketInfo si;
+  Action* action;
+
+  memset(&si, 0, sizeof(si));
+  si.proto       = AP_UNIX;
+  si.local.type  = AH_Me;
+  si.local.port  = -1;
+  si.remote.type = AH_Path;
+  si.remote.port = -1;
+  si.paths       = &paths;
+  strcpy(paths.local, test->local);
+  strcpy(paths.remote, test->remote);
+  action = ActionQueue_getFirstMatch(pathQueue, &si, test->direction, false);
+  if (result.i == -1) {
+    return action == NULL;
+  }
+  return action != NULL && action == ActionQueue_get(pathQueue, result.i, false);
+}
+
+static bool testTime(TestFeed data, TestFeed result) {
+  SocketInfo si;
+  Action* action;
+  bool matched;
+
+  action = Action_init((const char*)data.p, NULL);
+  if (action == NULL) {
+    return false;
+  }
+  memset(&si, 0, sizeof(si));
+  si.proto       = AP_TCP;
+  si.local.type  = AH_Me;
+  si.remote.type = AH_Address;
+  si.remote.port = 80;
+  matched = Action_match(action, &si, Reading, false);
+  Action_destroy(action);
+  return matched == (result.i != 0);
+}
+
+static bool testRandom(TestFeed data, TestFeed result) {
+  uint64_t first[16];
+  int i;
+
+  Random_seed(data.i);
+  for (i = 0 ; i < 16 ; ++i) {
+    first[i] = Random_next();
+  }
+  Random_seed(data.i);
+  for (i = 0 ; i < 16 ; ++i) {
+    if (Random_next() != first[i]) {
+      return false;
+    }
+  }
+  for (i = 0 ; i < 10000 ; ++i) {
+    if (Random_below(result.i) >= (uint32_t)result.i) {
+      return false;
+    }
+  }
+  return Random_chance(Random_threshold(100, 100)) && !Random_chance(Random_threshold(0, 100));
+}
+
+/** Data for the counter tests.
+ */
+struct CounterCase {
+  const char*  rule;      /**< The rule. */
+  uint64_t     bytesRead; /**< Bytes read on the socket. */
+  uint64_t     writes;    /**< Writes done on the socket. */
+  uint64_t     age;       /**< Age of the socket in milliseconds. */
+  unsigned int ordinal;   /**< Rank of the connection. */
+};
+
+static bool testCounter(TestFeed data, TestFeed result) {
+  const struct CounterCase* test = (const struct CounterCase*)data.p;
+  SocketInfo si;
+  Action* action;
+  bool matched;
+
+  action = Action_init(test->rule, NULL);
+  if (action == NULL) {
+    return false;
+  }
+  memset(&si, 0, sizeof(si));
+  si.proto       = AP_TCP;
+  si.local.type  = AH_Me;
+  si.remote.type = AH_Address;
+  si.remote.port = 80;
+  si.counters.bytes[COUNTER_SLOT(Reading)] = test->bytesRead;
+  si.counters.calls[COUNTER_SLOT(Writing)] = test->writes;
+  si.counters.created = Clock_coarse() - Clock_fromMSec(test->age);
+  si.counters.ordinal = test->ordinal;
+  matched = Action_match(action, &si, Reading, false);
+  Action_destroy(action);
+  return matched == (result.i != 0);
+}
+
+/** Data for the rate tests.
+ */
+struct RateCase {
+  const char* rule;  /**< The rule. */
+  int         calls; /**< Calls done on the socket. */
+  uint64_t    bytes; /**< Bytes transferred by each call. */
+  uint64_t    age;   /**< Time since the calls in milliseconds. */
+  bool        peer;  /**< True if the calls are done with the peer on another socket. */
+};
+
+static bool testRate(TestFeed data, TestFeed result) {
+  const struct RateCase* test = (const struct RateCase*)data.p;
+  const uint64_t when = Clock_coarse() - Clock_fromMSec(test->age);
+  RateWindow peer;
+  SocketInfo si;
+  Action* action;
+  bool matched;
+  int i;
+
+  action = Action_init(test->rule, NULL);
+  if (action == NULL) {
+    return false;
+  }
+  memset(&si, 0, sizeof(si));
+  memset(&peer, 0, sizeof(peer));
+  si.proto       = AP_TCP;
+  si.local.type  = AH_Me;
+  si.remote.type = AH_Address;
+  si.remote.port = 80;
+  if (test->peer) {
+    si.counters.peer = &peer;
+  }
+  for (i = 0 ; i < test->calls ; ++i) {
+    RateWindow_add(test->peer ? &peer : &si.counters.rate, when, test->bytes);
+  }
+  matched = Action_match(action, &si, Reading, false);
+  Action_destroy(action);
+  return matched == (result.i != 0);
+}
+
+/** Data for the rate window tests.
+ */
+struct WindowCase {
+  int adds[4]; /**< Times of the calls in milliseconds (-1 terminated). */
+  int at;      /**< Time of the query in milliseconds. */
+};
+
+static bool testWindow(TestFeed data, TestFeed result) {
+  const struct WindowCase* test = (const struct WindowCase*)data.p;
+  /* A time aligned on the slots, far from the start of the clock */
+  const uint64_t base = Clock_fromMSec(1000 * RATE_SLOT_MSEC * RATE_SLOTS);
+  RateWindow window;
+  int i;
+
+  memset(&window, 0, sizeof(window));
+  for (i = 0 ; i < 4 && test->adds[i] >= 0 ; ++i) {
+    RateWindow_add(&window, base + Clock_fromMSec(test->adds[i]), 10);
+  }
+  return RateWindow_calls(&window, base + Clock_fromMSec(test->at)) == (uint64_t)result.i
+      && RateWindow_bytes(&window, base + Clock_fromMSec(test->at)) == 10 * (uint64_t)result.i;
+}
+
+static bool testExpression(TestFeed data, TestFeed result) {
+  SocketInfo si;
+  Action* action;
+  bool matched;
+
+  action = Action_init((const char*)data.p, NULL);
+  if (action == NULL) {
+    return false;
+  }
+  memset(&si, 0, sizeof(si));
+  si.proto       = AP_TCP;
+  si.local.type  = AH_Me;
+  si.remote.type = AH_Address;
+  si.remote.port = 80;
+  matched = Action_match(action, &si, Reading, false);
+  Action_destroy(action);
+  return matched == (result.i != 0);
+}
+
+static bool testCompile(TestFeed data, TestFeed result) {
+  char buffer[1024];
+  Action* action;
+  ssize_t len;
+  int fds[2];
+
+  action = Action_init((const char*)data.p, NULL);
+  if (action == NULL || pipe(fds) != 0) {
+    Action_destroy(action);
+    return false;
+  }
+  Action_show(action, fds[1]);
+  Action_destroy(action);
+  len = read(fds[0], buffer, sizeof(buffer) - 1);
+  close(fds[0]);
+  close(fds[1]);
+  if (len <= 0) {
+    return false;
+  }
+  buffer[len] = '\0';
+  return strstr(buffer, (const char*)result.p) != NULL;
+}
+
+/** Data for the payload tests.
+ */
+struct PayloadCase {
+  const char* data;  /**< The data. */
+  size_t      len;   /**< Length of the data. */
+  size_t      split; /**< Length of the first piece given to the scan. */
+  int         count; /**< Number of payloads compiled (the first ones). */
+};
+
+static Payload* payloads[4];
+static PayloadScanner* scanner = NULL;
+static PayloadScanner* prefilterScanner = NULL; /* Patterns starting with 3 bytes */
+
+static bool testPayload(TestFeed data, TestFeed result) {
+  const struct PayloadCase* test = (const struct PayloadCase*)data.p;
+  const PayloadScanner* used = test->count == 4 ? scanner : prefilterScanner;
+  uint64_t found[PAYLOAD_SCANNER_MAX / 64];
+  PayloadScan scan;
+  int i;
+
+  PayloadScan_start(&scan, used, found);
+  PayloadScan_feed(&scan, test->data, test->split);
+  PayloadScan_feed(&scan, test->data + test->split, test->len - test->split);
+  for (i = 0 ; i < test->count ; ++i) {
+    const bool expected = (result.i >> i) & 1;
+    if (PayloadScan_found(&scan, PayloadScanner_find(used, payloads[i])) != expected
+        || Payload_search(payloads[i], test->data, test->len) != expected) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static ActionQueue* summaryQueue = NULL;
+static ActionQueue* countedQueue = NULL;
+
+static bool testSummary(TestFeed data, TestFeed result) {
+  const struct MatchCase* test = (const struct MatchCase*)data.p;
+
+  return ActionQueue_mayMatch(summaryQueue, test->direction, test->proto, test->port)
+      == (result.i != 0);
+}
+
+static bool testCounted(TestFeed data, TestFeed result) {
+  const struct MatchCase* test = (const struct MatchCase*)data.p;
+
+  return ActionQueue_mayMatch(countedQueue, test->direction, test->proto, test->port)
+      == (result.i != 0);
+}
+
 static bool testFile(TestFeed data, TestFeed result) {
   Config* config;
   char* file;
@@ -60,9 +417,859 @@ static bool testFile(TestFeed data, TestFeed result) {
   return true;
 }
 
+/** Build the socket info of one end of a new socket pair.
+ */
+static SocketInfo* testSocket(int fds[2]) {
+  SocketInfo* si;
+
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    return NULL;
+  }
+  if ((si = SocketInfo_init(fds[0], NULL)) == NULL) {
+    close(fds[0]);
+    close(fds[1]);
+  }
+  return si;
+}
+
+/** Data for the socket table tests.
+ */
+struct TableCase {
+  int          fd;         /**< Slot of the socket info. */
+  bool         invalidate; /**< True if the slot is invalidated after the stamp is taken. */
+  bool         clear;      /**< True if a range of slots is cleared. */
+  unsigned int first;      /**< First slot of the range. */
+  unsigned int last;       /**< Last slot of the range. */
+};
+
+static bool testTable(TestFeed data, TestFeed result) {
+  const struct TableCase* test = (const struct TableCase*)data.p;
+  /* The largest kind must fit in the slot */
+  const SocketKind kind = SocketKind_make(SK_Socket | SK_Accepted, AP_UNIX);
+  SocketTable* table;
+  SocketInfo* found;
+  SocketInfo* si;
+  unsigned int stamp;
+  int fds[2];
+  int got = 0;
+
+  if ((si = testSocket(fds)) == NULL) {
+    return false;
+  }
+  if ((table = SocketTable_init()) == NULL) {
+    SocketInfo_unlock(si);
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+  if (SocketTable_kind(table, test->fd, &stamp) == SK_Unknown
+      && SocketTable_get(table, test->fd) == NULL
+      && SocketTable_put(table, test->fd, si)) {
+    if (test->invalidate) {
+      SocketTable_invalidate(table, test->fd, SK_Unknown);
+    }
+    if (test->clear) {
+      SocketTable_clear(table, test->first, test->last);
+    }
+    if (SocketTable_classify(table, test->fd, stamp, kind)
+        && SocketTable_kind(table, test->fd, NULL) == kind) {
+      got |= 2;
+    }
+    if ((found = SocketTable_get(table, test->fd)) != NULL) {
+      got |= found == si ? 1 : 4;
+      SocketInfo_unlock(found);
+    }
+  } else {
+    got = -1;
+  }
+  SocketTable_destroy(table);
+  SocketInfo_unlock(si);
+  close(fds[0]);
+  close(fds[1]);
+  return got == result.i;
+}
+
+/** Accept a new TCP connection to a listener of the loopback.
+ *
+ * @return The accepted socket, or -1 on error (client receives the other end).
+ */
+static int testAccept(int listener, const struct sockaddr_in* addr, int* client) {
+  int fd;
+
+  if ((*client = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
+    return -1;
+  }
+  if (connect(*client, (const struct sockaddr*)addr, sizeof(*addr)) == -1
+      || (fd = accept(listener, NULL, NULL)) == -1) {
+    close(*client);
+    return -1;
+  }
+  return fd;
+}
+
+static bool testRank(TestFeed data, TestFeed result) {
+  const bool accepted = data.i != 0;
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  SocketInfo* si[2] = { NULL, NULL };
+  int clients[2] = { -1, -1 };
+  int fds[2] = { -1, -1 };
+  int listener;
+  int i;
+  bool ok;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ok = (listener = socket(AF_INET, SOCK_STREAM, 0)) != -1
+    && bind(listener, (struct sockaddr*)&addr, sizeof(addr)) == 0
+    && listen(listener, 2) == 0
+    && getsockname(listener, (struct sockaddr*)&addr, &len) == 0;
+
+  /* Both connections come from different ports to the same service */
+  for (i = 0 ; ok && i < 2 ; ++i) {
+    SocketKind kind = accepted ? SocketKind_make(SK_Socket | SK_Accepted, AP_TCP) : SK_Unknown;
+    ok = (fds[i] = testAccept(listener, &addr, &clients[i])) != -1
+      && (si[i] = SocketInfo_init(fds[i], &kind)) != NULL
+      && (kind & SK_Accepted) == (accepted ? SK_Accepted : 0);
+  }
+  ok = ok && (int)(si[1]->counters.ordinal - si[0]->counters.ordinal) == result.i;
+  for (i = 0 ; i < 2 ; ++i) {
+    if (si[i]) {
+      SocketInfo_unlock(si[i]);
+    }
+    if (fds[i] != -1) {
+      close(fds[i]);
+      close(clients[i]);
+    }
+  }
+  if (listener != -1) {
+    close(listener);
+  }
+  return ok;
+}
+
+static ssize_t testWriteCB(int fd, void* buf, size_t len, int flags, void* data) {
+  return len;
+}
+
+static bool testState(TestFeed data, TestFeed result) {
+  ActionQueue* queue;
+  SocketInfo* si;
+  char buf[3] = "abc";
+  int fds[2];
+  bool ok;
+
+  if ((si = testSocket(fds)) == NULL) {
+    return false;
+  }
+  queue = ActionQueue_init(2000);
+  ok = queue != NULL && ActionQueue_put(queue, (const char*)data.p, NULL, true, false)
+    && ActionQueue_process(queue, si, Writing, testWriteCB, buf, 3, 0, NULL) == 3
+    && ActionQueue_process(queue, si, Writing, testWriteCB, buf, 3, 0, NULL) == 3;
+
+  /* The rules only keep a state for the sockets they may match */
+  ok = ok && (si->data != NULL) == (result.i != 0);
+  SocketInfo_unlock(si);
+  close(fds[0]);
+  close(fds[1]);
+  if (queue) {
+    ActionQueue_destroy(queue);
+  }
+  return ok;
+}
+
+static bool testFeed(TestFeed data, TestFeed result) {
+  ActionQueue* queue;
+  SocketInfo* si;
+  char buf[3] = "abc";
+  int fds[2];
+  int calls = 0;
+  bool ok;
+
+  if ((si = testSocket(fds)) == NULL) {
+    return false;
+  }
+  queue = ActionQueue_init(2000);
+  ok = queue != NULL && ActionQueue_put(queue, (const char*)data.p, NULL, true, false);
+
+  /* The calls that don't trigger the rule are still counted by its condition */
+  while (ok && calls < 5
+         && ActionQueue_process(queue, si, Writing, testWriteCB, buf, 3, 0, NULL) == 3) {
+    ++calls;
+  }
+  SocketInfo_unlock(si);
+  close(fds[0]);
+  close(fds[1]);
+  if (queue) {
+    ActionQueue_destroy(queue);
+  }
+  return ok && calls == result.i;
+}
+
+static bool testShow(TestFeed data, TestFeed result) {
+  static const char prefix[] = "10 on tcp with any do echo ";
+  static const char suffix[] = " continue";
+  const int word = data.i;
+  char* rule;
+  char out[16384];
+  Action* action;
+  ssize_t len;
+  int fds[2];
+  bool ok;
+
+  rule = (char*)malloc(sizeof(prefix) + word + sizeof(suffix));
+  if (rule == NULL || pipe(fds) != 0) {
+    free(rule);
+    return false;
+  }
+  strcpy(rule, prefix);
+  memset(rule + strlen(prefix), 'a', word);
+  strcpy(rule + strlen(prefix) + word, suffix);
+  action = Action_init(rule, NULL);
+  ok = action != NULL;
+  if (ok) {
+    Action_show(action, fds[1]);
+    Action_destroy(action);
+  }
+  close(fds[1]);
+  len = ok ? read(fds[0], out, sizeof(out) - 1) : -1;
+  close(fds[0]);
+  free(rule);
+
+  /* A rule too long to be shown is truncated, but the line is complete */
+  if (len <= 0 || len >= 8192 || out[len - 1] != '\n') {
+    return false;
+  }
+  out[len] = '\0';
+  return (strstr(out, "continue\n") != NULL) == (result.i != 0);
+}
+
+/** Data for the do-once tests.
+ */
+struct OnceCase {
+  bool fire;    /**< True if the do-once rule is triggered. */
+  bool replace; /**< True if the rule is replaced before the queue is modified. */
+};
+
+static bool testOnce(TestFeed data, TestFeed result) {
+  static const char* rule = "10 on unix talk-with any do-once truncate 1 continue";
+  const struct OnceCase* test = (const struct OnceCase*)data.p;
+  ActionQueue* queue;
+  SocketInfo* si;
+  char buf[3] = "abc";
+  int fds[2];
+  int got = 0;
+  bool ok = true;
+
+  if ((si = testSocket(fds)) == NULL) {
+    return false;
+  }
+  queue = ActionQueue_init(2000);
+  ok = queue != NULL && ActionQueue_put(queue, rule, NULL, true, true);
+  if (ok && test->fire) {
+    /* The rule fires once, and stays in the queue until it is modified */
+    ok = ActionQueue_process(queue, si, Writing, testWriteCB, buf, 3, 0, NULL) == 1
+      && ActionQueue_process(queue, si, Writing, testWriteCB, buf, 3, 0, NULL) == 3
+      && ActionQueue_get(queue, 10, true) != NULL;
+  }
+  if (ok && test->replace) {
+    ok = ActionQueue_put(queue, rule, NULL, true, true);
+  }
+  if (ok) {
+    ok = ActionQueue_put(queue, "20 on unix talk-with any do nop continue", NULL, true, true);
+    if (ActionQueue_get(queue, 10, true) != NULL) {
+      got |= 1;
+    }
+    if (ActionQueue_process(queue, si, Writing, testWriteCB, buf, 3, 0, NULL) == 1) {
+      got |= 2;
+    }
+  }
+  SocketInfo_unlock(si);
+  close(fds[0]);
+  close(fds[1]);
+  if (queue) {
+    ActionQueue_destroy(queue);
+  }
+  return ok && got == result.i;
+}
+
+/** Data moved by the callbacks of the vector tests.
+ */
+struct TestStream {
+  const char* source; /**< Data given to the reads. */
+  size_t      pos;    /**< Data already read. */
+  char        sink[64]; /**< Data received by the writes. */
+  size_t      len;    /**< Length of the data written. */
+};
+
+static ssize_t testStreamvCB(int fd, const struct iovec* iov, int count, int flags,
+                             void* data) {
+  struct TestStream* stream = (struct TestStream*)data;
+  ssize_t done = 0;
+  int i;
+
+  for (i = 0 ; i < count ; ++i) {
+    size_t len = iov[i].iov_len;
+    if (stream->source) {
+      if (len > strlen(stream->source) - stream->pos) {
+        len = strlen(stream->source) - stream->pos;
+      }
+      memcpy(iov[i].iov_base, stream->source + stream->pos, len);
+      stream->pos += len;
+    } else {
+      memcpy(stream->sink + stream->len, iov[i].iov_base, len);
+      stream->len += len;
+    }
+    done += len;
+  }
+  return done;
+}
+
+static ssize_t testStreamCB(int fd, void* buf, size_t len, int flags, void* data) {
+  struct iovec vect;
+  vect.iov_base = buf;
+  vect.iov_len  = len;
+  return testStreamvCB(fd, &vect, 1, flags, data);
+}
+
+/** Data for the vectored call tests.
+ */
+struct VectorCase {
+  const char* rules[4];          /**< The rules (NULL terminated). */
+  SocketInfoDirection direction; /**< Direction of the call. */
+  size_t      lens[3];           /**< Lengths of the vectors of the call. */
+  const char* data;              /**< Data expected in the vectors (read) or written,
+                                      NULL if the data read must have been altered. */
+};
+
+static bool testVector(TestFeed data, TestFeed result) {
+  static const char* source = "abcdefghij";
+  const struct VectorCase* test = (const struct VectorCase*)data.p;
+  struct TestStream stream;
+  struct iovec iov[3];
+  char buffer[10];
+  ActionQueue* queue;
+  SocketInfo* si;
+  ssize_t ret;
+  size_t pos = 0;
+  int fds[2];
+  int i;
+  bool ok = true;
+
+  if ((si = testSocket(fds)) == NULL) {
+    return false;
+  }
+  queue = ActionQueue_init(2000);
+  for (i = 0 ; ok && test->rules[i] != NULL ; ++i) {
+    ok = queue != NULL && ActionQueue_put(queue, test->rules[i], NULL, true, false);
+  }
+  memset(&stream, 0, sizeof(stream));
+  memset(buffer, '.', sizeof(buffer));
+  if (test->direction == Writing) {
+    memcpy(buffer, source, sizeof(buffer));
+  } else {
+    stream.source = source;
+  }
+  for (i = 0 ; i < 3 ; ++i) {
+    iov[i].iov_base = buffer + pos;
+    iov[i].iov_len  = test->lens[i];
+    pos += test->lens[i];
+  }
+  Random_seed(42);
+  ret = ok ? ActionQueue_processv(queue, si, test->direction, testStreamCB, testStreamvCB,
+                                  iov, 3, 0, &stream) : -1;
+  if (test->direction == Writing) {
+    ok = ok && stream.len == strlen(test->data)
+      && memcmp(stream.sink, test->data, stream.len) == 0;
+  } else if (test->data == NULL) {
+    /* The altered data has been copied back to the vectors */
+    ok = ok && ret > 0 && memcmp(buffer, source, ret) != 0;
+  } else {
+    /* The data is in place in the vectors, the rest is untouched */
+    ok = ok && memcmp(buffer, test->data, strlen(test->data)) == 0;
+    for (pos = strlen(test->data) ; ok && pos < sizeof(buffer) ; ++pos) {
+      ok = buffer[pos] == '.';
+    }
+  }
+  SocketInfo_unlock(si);
+  close(fds[0]);
+  close(fds[1]);
+  if (queue) {
+    ActionQueue_destroy(queue);
+  }
+  return ok && ret == result.i;
+}
+
+/** Data for the spliced call tests.
+ */
+struct SpliceCase {
+  const char* rule;   /**< The rule. */
+  bool        pipe;   /**< True if the other end is a pipe instead of a file. */
+  size_t      count;  /**< Length requested by the spliced call. */
+  size_t      accept; /**< Length accepted by the call (0 for all). */
+  int         called; /**< Expected call: 0 none, 1 moved by the kernel, 2 sent from a buffer. */
+  size_t      len;    /**< Length expected by the call. */
+  int64_t     offset; /**< Expected offset of the other end after the call. */
+};
+
+/** Call seen by the callback of the spliced call tests.
+ */
+struct SpliceCall {
+  int    called; /**< Kind of call (see SpliceCase::called). */
+  size_t len;    /**< Length of the call. */
+  size_t accept; /**< Length accepted by the call (0 for all). */
+};
+
+static ssize_t testSpliceCB(int fd, void* buf, size_t len, int flags, void* data) {
+  struct SpliceCall* call = (struct SpliceCall*)data;
+  call->called = buf == NULL ? 1 : memcmp(buf, "0123456789", len) == 0 ? 2 : -1;
+  call->len    = len;
+  return call->accept != 0 && call->accept < len ? call->accept : len;
+}
+
+static bool testSplice(TestFeed data, TestFeed result) {
+  const struct SpliceCase* test = (const struct SpliceCase*)data.p;
+  char path[] = "/tmp/libinjectXXXXXX";
+  struct SpliceCall call;
+  ActionSplice splice;
+  ActionQueue* queue;
+  SocketInfo* si;
+  ssize_t ret = -1;
+  int pipefds[2] = { -1, -1 };
+  int left = 0;
+  int fds[2];
+  bool ok;
+
+  if ((si = testSocket(fds)) == NULL) {
+    return false;
+  }
+  if (test->pipe) {
+    /* Not seekable: only the data actually sent may be consumed */
+    splice.fd = pipe2(pipefds, O_NONBLOCK) == 0 ? pipefds[0] : -1;
+  } else {
+    splice.fd = mkstemp(path);
+  }
+  splice.hasOffset = !test->pipe;
+  splice.offset    = 0;
+  call.called      = 0;
+  call.len         = 0;
+  call.accept      = test->accept;
+  queue = ActionQueue_init(2000);
+  ok = queue != NULL && splice.fd >= 0
+    && write(test->pipe ? pipefds[1] : splice.fd, "0123456789", 10) == 10
+    && ActionQueue_put(queue, test->rule, NULL, true, false);
+  if (ok) {
+    ret = ActionQueue_splice(queue, si, Writing, testSpliceCB, &splice, test->count, 0,
+                             &call);
+  }
+  if (test->pipe) {
+    ok = ok && ioctl(pipefds[0], FIONREAD, &left) == 0;
+    splice.offset = 10 - left;
+    close(pipefds[0]);
+    close(pipefds[1]);
+  } else if (splice.fd >= 0) {
+    close(splice.fd);
+    unlink(path);
+  }
+  SocketInfo_unlock(si);
+  close(fds[0]);
+  close(fds[1]);
+  if (queue) {
+    ActionQueue_destroy(queue);
+  }
+  /* A huge call is never bounced at once */
+  return ok && ret == result.i && call.called == test->called
+      && (test->called == 0 || call.len == test->len) && splice.offset == test->offset
+      && Arena_highWater() <= ARENA_LARGEST_BLOCK;
+}
+
+/** Data for the asynchronous hang tests.
+ */
+struct HangCase {
+  int     msec;   /**< Duration of the hang. */
+  int     wait;   /**< Time waited after the start of the hang, in milliseconds. */
+  bool    close;  /**< True if the socket is closed during the hang. */
+  ssize_t second; /**< Expected result of a second read (0 for no second read). */
+};
+
+/** Check if a socket is in the list of the hanging sockets.
+ */
+static bool testHangListed(SocketInfo* si) {
+  const ArenaMark mark = Arena_mark();
+  SocketInfo** list;
+  bool found = false;
+  int count;
+  int i;
+
+  list = Action_hangingSockets(&count);
+  for (i = 0 ; i < count ; ++i) {
+    found = found || list[i] == si;
+    SocketInfo_unlock(list[i]);
+  }
+  Arena_release(mark);
+  return found;
+}
+
+static bool testHang(TestFeed data, TestFeed result) {
+  const struct HangCase* test = (const struct HangCase*)data.p;
+  struct TestStream stream;
+  ActionQueue* queue;
+  SocketInfo* si;
+  char rule[64];
+  char buf[3];
+  int fds[2];
+  bool ok;
+
+  if ((si = testSocket(fds)) == NULL) {
+    return false;
+  }
+  /* The hang is asynchronous on non-blocking sockets only */
+  si->blocking = false;
+  memset(&stream, 0, sizeof(stream));
+  stream.source = "abc";
+  sprintf(rule, "10 on unix talk-with any do hang %d continue", test->msec);
+  queue = ActionQueue_init(2000);
+  ok = queue != NULL && ActionQueue_put(queue, rule, NULL, true, false)
+    && ActionQueue_process(queue, si, Reading, testStreamCB, buf, 3, 0, &stream) == -1
+    && errno == EAGAIN && Action_hanging() && testHangListed(si);
+  if (ok && test->close) {
+    /* The hang ends with the file descriptor */
+    Action_forgetHanging(fds[0], fds[0]);
+    ok = Action_hangDelay(si, Reading) == 0;
+  }
+  if (ok && test->wait > 0) {
+    (void)usleep(test->wait * 1000);
+  }
+  if (ok && test->second != 0) {
+    ok = ActionQueue_process(queue, si, Reading, testStreamCB, buf, 3, 0, &stream)
+         == test->second;
+  }
+  /* A hang that ended on the data path must not stay in the list */
+  ok = ok && Action_hanging() == (result.i != 0);
+  Action_forgetHanging(fds[0], fds[0]);
+  SocketInfo_unlock(si);
+  close(fds[0]);
+  close(fds[1]);
+  if (queue) {
+    ActionQueue_destroy(queue);
+  }
+  return ok && !Action_hanging();
+}
+
+/** Data for the reclamation tests.
+ */
+struct EpochCase {
+  const char* rule;  /**< Rule applied to the call. */
+  bool        block; /**< True if the syscall blocks until the end of the test. */
+};
+
+/** A call performed by another thread.
+ */
+struct TestCall {
+  ActionQueue*  queue;   /**< The rules. */
+  SocketInfo*   si;      /**< The socket. */
+  bool          block;   /**< True if the syscall blocks until the pipe is written. */
+  int           pipe[2]; /**< Pipe the syscall waits on. */
+  volatile int  state;   /**< 1 once in the syscall, 2 once the call returned. */
+  ssize_t       ret;     /**< Result of the call. */
+};
+
+static ssize_t testBlockCB(int fd, void* buf, size_t len, int flags, void* data) {
+  struct TestCall* call = (struct TestCall*)data;
+  char c;
+
+  if (call->block) {
+    call->state = 1;
+    if (read(call->pipe[0], &c, 1) != 1) {
+      return -1;
+    }
+  }
+  return len;
+}
+
+static void* testCallThread(void* data) {
+  struct TestCall* call = (struct TestCall*)data;
+  char buf[3] = "abc";
+
+  call->ret   = ActionQueue_process(call->queue, call->si, Writing, testBlockCB, buf, 3, 0,
+                                    call);
+  call->state = 2;
+  return NULL;
+}
+
+static void testMarkFreed(void* ptr) {
+  *(volatile int*)ptr = 1;
+}
+
+static bool testEpoch(TestFeed data, TestFeed result) {
+  const struct EpochCase* test = (const struct EpochCase*)data.p;
+  struct TestCall call;
+  pthread_t thread;
+  volatile int freed = 0;
+  int fds[2];
+  int i;
+  bool ok;
+
+  memset(&call, 0, sizeof(call));
+  if ((call.si = testSocket(fds)) == NULL) {
+    return false;
+  }
+  call.block = test->block;
+  call.queue = ActionQueue_init(2000);
+  ok = call.queue != NULL && ActionQueue_put(call.queue, test->rule, NULL, true, true)
+    && pipe(call.pipe) == 0 && pthread_create(&thread, NULL, testCallThread, &call) == 0;
+  if (ok) {
+    /* Wait until the other thread sleeps in the rules or blocks in the syscall */
+    for (i = 0 ; i < 100 && call.state == 0 && test->block ; ++i) {
+      (void)usleep(10000);
+    }
+    if (!test->block) {
+      (void)usleep(100000);
+    }
+    Epoch_retire((void*)&freed, testMarkFreed);
+    for (i = 0 ; i < 4 ; ++i) {
+      Epoch_collect();
+    }
+    /* The objects are reclaimed while the call is still in progress */
+    ok = freed == 1 && call.state != 2;
+    if (write(call.pipe[1], "x", 1) != 1) {
+      ok = false;
+    }
+    (void)pthread_join(thread, NULL);
+    ok = ok && call.ret == result.i;
+  }
+  if (call.pipe[0] > 0) {
+    close(call.pipe[0]);
+    close(call.pipe[1]);
+  }
+  SocketInfo_unlock(call.si);
+  close(fds[0]);
+  close(fds[1]);
+  if (call.queue) {
+    ActionQueue_destroy(call.queue);
+  }
+  return ok;
+}
+
 int main(void) {
+  static const char* matchRules[] = {
+    "10 on tcp connect to any port 80 do nop continue",
+    "20 on udp with any port 5000 do nop continue",
+    "30 on tcp from any port 443 to any do nop continue",
+    "40 on ip talk-with dns do nop continue",
+    "50 on tcp talk-with any do nop continue",
+    "60 on tcp accept to any port 1234 do nop continue",
+    NULL
+  };
+  static const struct MatchCase matchCases[] = {
+    { AP_TCP, Connecting, 80 },
+    { AP_TCP, Connecting, 81 },
+    { AP_UDP, Reading,    5000 },
+    { AP_UDP, Reading,    5001 },
+    { AP_TCP, Reading,    443 },
+    { AP_TCP, Writing,    443 },
+    { AP_UDP, Reading,    53 },
+    { AP_TCP, Reading,    22 },
+    { AP_TCP, Accepting,  22 },
+    { AP_UDP, Accepting,  5001 }
+  };
+  static const char* prefixRules[] = {
+    "10 on tcp from 10.2.0.0/16 to any do nop continue",
+    "20 on tcp connect to fd00::/8 do nop continue",
+    "30 on tcp connect to 127.0.0.1 do nop continue",
+    "40 on tcp connect to 10.0.0.0/8 do nop continue",
+    NULL
+  };
+  static const struct PrefixCase prefixCases[] = {
+    { Reading,    "10.2.3.4" },
+    { Reading,    "10.3.0.1" },
+    { Connecting, "fd00::1" },
+    { Connecting, "fe80::1" },
+    { Connecting, "127.0.0.1" },
+    { Connecting, "127.0.0.2" },
+    { Connecting, "10.2.3.4" }
+  };
+  static const char* pathRules[] = {
+    "10 on unix from any to /run/side*.sock do nop continue",
+    "20 on unix connect to @agent?? do nop continue",
+    "30 on unix talk-with /var/*/x*.sock do nop continue",
+    "40 on tcp talk-with any do nop continue",
+    NULL
+  };
+  static const struct PathCase pathCases[] = {
+    { Writing,    "",                  "/run/sidecar.sock" },
+    { Writing,    "",                  "/run/other.sock" },
+    { Reading,    "",                  "/run/sidecar.sock" },
+    { Reading,    "/run/sidecar.sock", "" },
+    { Reading,    "/var/lib/xyz.sock", "" },
+    { Connecting, "",                  "@agent01" },
+    { Connecting, "",                  "@agent1" }
+  };
+  static const char* payloadSources[] = {
+    "\"GET /api\"", "\"api/search\"", "\"\\0\\xff\"", "@testpatterns.txt"
+  };
+  static const struct PayloadCase payloadCases[] = {
+    { "GET /api/search?q=1", 19, 0,  4 },
+    { "GET /api/x",          10, 7,  4 },
+    { "ushers",               6, 3,  4 },
+    { "xx\0\xffyy",            6, 3,  4 },
+    { "a\tb",                 3, 0,  4 },
+    { "GET /apx",             8, 0,  4 },
+    { "nothing here",        12, 12, 4 },
+    { "nothing there, just GET /apx and ap", 35, 0, 3 },
+    { "the first lines of the reply, GET /api", 38, 0, 3 },
+    { "a longer body to skip before api/search", 39, 9, 3 },
+    { "and some binary data \0\xff at the end", 34, 0, 3 }
+  };
+  static const struct CounterCase counterCases[] = {
+    { "1 on tcp with any when bytes-read > 1048576 do nop continue", 1048577, 0, 0, 1 },
+    { "1 on tcp with any when bytes-read > 1048576 do nop continue", 1048576, 0, 0, 1 },
+    { "1 on tcp with any when calls-written == 2 do nop continue",   0, 2, 0, 1 },
+    { "1 on tcp with any when calls-written != 2 do nop continue",   0, 2, 0, 1 },
+    { "1 on tcp with any when age >= 30000 do nop continue",         0, 0, 60000, 1 },
+    { "1 on tcp with any when age < 30000 do nop continue",          0, 0, 60000, 1 },
+    { "1 on tcp with any when nth-connection 3 do nop continue",     0, 0, 0, 3 },
+    { "1 on tcp with any when nth-connection 3 do nop continue",     0, 0, 0, 0 }
+  };
+  static const struct RateCase rateCases[] = {
+    { "1 on tcp with any when rate-ops > 5/s do nop continue",                6, 0,   0,    false },
+    { "1 on tcp with any when rate-ops > 5/s do nop continue",                5, 0,   0,    false },
+    { "1 on tcp with any when rate-ops > 5/s do nop continue",                6, 0,   2000, false },
+    { "1 on tcp with any when rate-bytes >= 1KB/s do nop continue",           2, 500, 0,    false },
+    { "1 on tcp with any when rate-bytes per peer >= 1KB/s do nop continue",  2, 500, 0,    false },
+    { "1 on tcp with any when rate-bytes per peer >= 1KB/s do nop continue",  2, 500, 0,    true },
+    { "1 on tcp with any when rate-ops per rule < 1/s do nop continue",       6, 0,   0,    false }
+  };
+  static const struct WindowCase windowCases[] = {
+    { { 0, 0, 100, -1 },  100 },
+    { { 0, -1 },          999 },
+    { { 0, -1 },          1000 },
+    { { 0, 0, 1000, -1 }, 1000 },
+    { { 0, 500, 1200, -1 }, 1200 },
+    { { 0, -1 },          5000 }
+  };
+  static const char* countedRules[] = {
+    "10 on tcp from any to me when bytes-read >= 10 do nop continue",
+    NULL
+  };
+  static const struct MatchCase countedCases[] = {
+    { AP_TCP, Writing,    -1 },
+    { AP_UDP, Writing,    -1 },
+    { AP_TCP, Connecting, -1 }
+  };
+  static const char* summaryRules[] = {
+    "10 on tcp connect to any port 80 do nop continue",
+    "20 on udp with any port 5000 do nop continue",
+    NULL
+  };
+  static const struct MatchCase summaryCases[] = {
+    { AP_TCP, Connecting, 80 },
+    { AP_TCP, Connecting, 81 },
+    { AP_TCP, Connecting, -1 },
+    { AP_UDP, Connecting, 81 },
+    { AP_TCP, Reading,    -1 },
+    { AP_UDP, Reading,    -1 },
+    { AP_IP,  Reading,    -1 },
+    { AP_TCP, Closing,    -1 },
+    { AP_UNIX, Reading,   -1 },
+    { AP_All, Reading,    -1 }
+  };
+  static const struct TableCase tableCases[] = {
+    { 3,     false, false, 0,    0 },
+    { 3,     true,  false, 0,    0 },
+    { 3,     false, true,  0,    10 },
+    { 5000,  false, true,  4096, 8191 },
+    { 5000,  false, true,  0,    4999 },
+    { 70000, false, true,  3,    UINT_MAX }
+  };
+  static const struct OnceCase onceCases[] = {
+    { true,  false },
+    { true,  true },
+    { false, false }
+  };
+  static const struct VectorCase vectorCases[] = {
+    { { "10 on unix talk-with any do alter 0 continue", NULL },
+      Reading, { 3, 3, 4 }, "abcdefghij" },
+    { { "10 on unix talk-with any do truncate 7 continue", NULL },
+      Reading, { 3, 3, 4 }, "abcdefg" },
+    { { "10 on unix talk-with any do truncate 7 continue",
+        "20 on unix talk-with any do alter 0 continue", NULL },
+      Reading, { 3, 3, 4 }, "abcdefg" },
+    { { "10 on unix talk-with any do alter 500000 continue", NULL },
+      Reading, { 3, 3, 4 }, NULL },
+    { { "10 on unix talk-with any when contains \"cde\" do nop continue",
+        "20 on unix talk-with any do error EIO continue",
+        "30 on unix talk-with any do alter 500000 continue", NULL },
+      Reading, { 3, 3, 4 }, NULL },
+    { { "10 on unix talk-with any do split 50 continue", NULL },
+      Writing, { 3, 3, 4 }, "abcdefghij" },
+    { { "10 on unix talk-with any do split 50 continue", NULL },
+      Writing, { 1, 8, 1 }, "abcdefghij" },
+    { { "10 on unix talk-with any do split 100 continue", NULL },
+      Writing, { 3, 3, 4 }, "abcdefghij" },
+    { { "10 on unix talk-with any when contains \"cdefg\" do drop stop", NULL },
+      Writing, { 3, 3, 4 }, "" },
+    { { "10 on unix talk-with any when contains \"xyz\" do drop stop", NULL },
+      Writing, { 3, 3, 4 }, "abcdefghij" }
+  };
+  static const struct SpliceCase spliceCases[] = {
+    { "10 on unix talk-with any do nop continue",                    false, 10,      0, 1, 10, 0 },
+    { "10 on unix talk-with any do truncate 4 continue",             false, 10,      0, 1, 4,  0 },
+    { "10 on unix talk-with any when contains \"345\" do drop stop", false, 10,      0, 0, 0,  10 },
+    { "10 on unix talk-with any when contains \"xyz\" do drop stop", false, 10,      0, 2, 10, 10 },
+    { "10 on unix talk-with any when contains \"xyz\" do drop stop", false, 1 << 30, 0, 2, 10, 10 },
+    { "10 on unix talk-with any when contains \"xyz\" do drop stop", false, 10,      4, 2, 10, 4 },
+    { "10 on unix talk-with any when contains \"345\" do drop stop", true,  10,      0, 0, 0,  10 },
+    { "10 on unix talk-with any when contains \"xyz\" do drop stop", true,  10,      4, 2, 10, 4 }
+  };
+  static const struct HangCase hangCases[] = {
+    { 60000, 0,  false, -1 },
+    { 60000, 0,  true,  0 },
+    { 1,     20, false, 3 }
+  };
+  static const struct EpochCase epochCases[] = {
+    { "10 on unix talk-with any do nop continue",  true },
+    { "10 on unix talk-with any do hang 300 continue", false }
+  };
   TestSet* set;
   testid   tid;
+  int      i;
+  bool     ok;
+
+  ActionSet_init();
+  matchQueue = ActionQueue_init(2000);
+  for (i = 0 ; matchRules[i] != NULL ; ++i) {
+    ActionQueue_put(matchQueue, matchRules[i], NULL, true, false);
+  }
+  prefixQueue = ActionQueue_init(2000);
+  for (i = 0 ; prefixRules[i] != NULL ; ++i) {
+    ActionQueue_put(prefixQueue, prefixRules[i], NULL, true, false);
+  }
+  pathQueue = ActionQueue_init(2000);
+  for (i = 0 ; pathRules[i] != NULL ; ++i) {
+    ActionQueue_put(pathQueue, pathRules[i], NULL, true, false);
+  }
+  for (i = 0 ; i < 4 ; ++i) {
+    const char* source = payloadSources[i];
+    ParserStatus* status = ParserStatus_init();
+    if (source[0] == '@') {
+      Payload_parseFile(&source, &payloads[i], NULL, status);
+    } else {
+      Payload_parse(&source, &payloads[i], NULL, status);
+    }
+    ParserStatus_destroy(status);
+  }
+  scanner = PayloadScanner_init((const Payload* const*)payloads, 4);
+  prefilterScanner = PayloadScanner_init((const Payload* const*)payloads, 3);
+  countedQueue = ActionQueue_init(2000);
+  for (i = 0 ; countedRules[i] != NULL ; ++i) {
+    ActionQueue_put(countedQueue, countedRules[i], NULL, true, false);
+  }
+  summaryQueue = ActionQueue_init(2000);
+  for (i = 0 ; summaryRules[i] != NULL ; ++i) {
+    ActionQueue_put(summaryQueue, summaryRules[i], NULL, true, false);
+  }
 
   set = TestSet_init("config");
 
@@ -74,13 +1281,261 @@ int main(void) {
   TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on tcp from any port 234 to any when prob 50 do-once nop next"), INT_FEED(0));
   TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip from any port ftp to 192.168.0.1 when cycle true 10000 10000 do-once-per-call nop stop  "), INT_FEED(0));
   TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip from 224.0.0.1 to 192.168.0.1 port 2222 when prob 75 do-once-per-socket nop exec 1000"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on tcp with any when contains \"GET /api\" do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on tcp with any when matches-any @testpatterns.txt do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on tcp with any when contains \"\" do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on tcp with any when contains \"a\\q\" do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on tcp with any when matches-any @idontexists do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on tcp with any when bytes-written <= 18446744073709551615 do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on tcp with any when bytes-read 10 do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on tcp with any when calls-read > 18446744073709551616 do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on tcp with any when nth-connection 0 do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on tcp with any when rate-ops > 5000/s do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on tcp with any when rate-bytes per rule > 100MB/s do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on tcp with any when rate-ops > 5000 do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on tcp with any when rate-ops > 5MB/s do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on tcp with any when rate-bytes > 18446744073709552G/s do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on tcp with any when prob 5 and after 60000 and not matched do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on tcp with any when (len > 100 or port == 80) and not contains \"x\" do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on tcp with any when prob 5 and do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on tcp with any when (prob 5 or matched do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on tcp with any when always and always and always and always and always and always and always and always and always do nop continue"), INT_FEED(0));
   TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip with any continue"), INT_FEED(0));
   TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip talk-with any continue"), INT_FEED(0));
   TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip close to any continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on tcp accept to me port 80 do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on tcp accept from any to me do nop continue"), INT_FEED(0));
   TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip with 224.0.0.1 port 2222 do truncate 10 continue"), INT_FEED(0));
   TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on ip with 224.0.0.1 port 2222 to any do truncate 10 continue"), INT_FEED(0));
   TestSet_registerTestData(set, tid, false,  POINTER_FEED("i on udp from me to any when always do nop continue"), INT_FEED(0));
   TestSet_registerTestData(set, tid, false,  POINTER_FEED("1000 on udp from me to any when always do nop continue 10"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip from 10.2.0.0/16 to any do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on tcp connect to fd00::/8 port 80 do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on ip from 10.2.0.0/33 to any do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on ip from 10.2.0.0/ to any do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on unix talk-with /run/*.sock do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on unix connect to @sidecar do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on tcp connect to /run/sidecar.sock do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on unix connect to 10.0.0.1 do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on unix connect to /run/sidecar.sock port 80 do nop continue"), INT_FEED(0));
+
+  /* Build queue tests */
+  tid = TestSet_registerTest(set, "queue", testQueue);
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("0 on ip with any do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1999 on ip with any do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("2000 on ip with any do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("-1 on ip with any do nop continue"), INT_FEED(0));
+
+  /* Build match tests */
+  tid = TestSet_registerTest(set, "match", testMatch);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&matchCases[0]), INT_FEED(10));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&matchCases[1]), INT_FEED(-1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&matchCases[2]), INT_FEED(20));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&matchCases[3]), INT_FEED(-1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&matchCases[4]), INT_FEED(30));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&matchCases[5]), INT_FEED(50));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&matchCases[6]), INT_FEED(40));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&matchCases[7]), INT_FEED(50));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&matchCases[8]), INT_FEED(60));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&matchCases[9]), INT_FEED(-1));
+
+  /* Build prefix tests */
+  tid = TestSet_registerTest(set, "prefix", testPrefix);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&prefixCases[0]), INT_FEED(10));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&prefixCases[1]), INT_FEED(-1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&prefixCases[2]), INT_FEED(20));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&prefixCases[3]), INT_FEED(-1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&prefixCases[4]), INT_FEED(30));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&prefixCases[5]), INT_FEED(-1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&prefixCases[6]), INT_FEED(40));
+
+  /* Build Unix path tests */
+  tid = TestSet_registerTest(set, "path", testPath);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&pathCases[0]), INT_FEED(10));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&pathCases[1]), INT_FEED(-1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&pathCases[2]), INT_FEED(-1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&pathCases[3]), INT_FEED(10));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&pathCases[4]), INT_FEED(30));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&pathCases[5]), INT_FEED(20));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&pathCases[6]), INT_FEED(-1));
+
+  /* Build time condition tests */
+  tid = TestSet_registerTest(set, "time", testTime);
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip with any when before 100000 do nop continue"), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip with any when before 0 do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip with any when after 100000 do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip with any when after 0 do nop continue"), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip with any when between 0 100000 do nop continue"), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip with any when between 50000 100000 do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip with any when cycle true 100000 1000 do nop continue"), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip with any when cycle false 100000 1000 do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, false, POINTER_FEED("1 on ip with any when cycle true 0 0 do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip with any when prob 0 do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,  POINTER_FEED("1 on ip with any when prob 100 do nop continue"), INT_FEED(1));
+
+  /* Build random generator tests */
+  tid = TestSet_registerTest(set, "random", testRandom);
+  TestSet_registerTestData(set, tid, true, INT_FEED(42), INT_FEED(7));
+  TestSet_registerTestData(set, tid, true, INT_FEED(0), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, INT_FEED(-1), INT_FEED(3000000));
+
+
+  /* Build counter tests */
+  tid = TestSet_registerTest(set, "counter", testCounter);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&counterCases[0]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&counterCases[1]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&counterCases[2]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&counterCases[3]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&counterCases[4]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&counterCases[5]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&counterCases[6]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&counterCases[7]), INT_FEED(0));
+
+  /* Build rate tests */
+  tid = TestSet_registerTest(set, "rate", testRate);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&rateCases[0]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&rateCases[1]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&rateCases[2]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&rateCases[3]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&rateCases[4]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&rateCases[5]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&rateCases[6]), INT_FEED(1));
+
+  /* Build composite condition tests */
+  tid = TestSet_registerTest(set, "expression", testExpression);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED("1 on tcp with any when always and never do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED("1 on tcp with any when never or always do nop continue"), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED("1 on tcp with any when not matched do nop continue"), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED("1 on tcp with any when port == 80 and not (never or port != 80) do nop continue"), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED("1 on tcp with any when port == 81 or (matched and always) do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED("1 on tcp with any when never and len > 10 do nop continue"), INT_FEED(1));
+
+  /* Build compiled condition tests */
+  tid = TestSet_registerTest(set, "compile", testCompile);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED("1 on tcp with any when prob 5 and (after 1000 or port == 80) and not matched do nop continue"),
+                           POINTER_FEED("when not matched and ( port == 80 or after 1000 ) and prob 5 do"));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED("1 on tcp with any when contains \"x\" and (prob 5 and never) do nop continue"),
+                           POINTER_FEED("when never and prob 5 and contains \"x\" do"));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED("1 on tcp with any when (prob 5) do nop continue"),
+                           POINTER_FEED("when prob 5 do"));
+
+  /* Build payload scanner tests */
+  tid = TestSet_registerTest(set, "payload", testPayload);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&payloadCases[0]), INT_FEED(3));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&payloadCases[1]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&payloadCases[2]), INT_FEED(8));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&payloadCases[3]), INT_FEED(4));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&payloadCases[4]), INT_FEED(8));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&payloadCases[5]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&payloadCases[6]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&payloadCases[7]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&payloadCases[8]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&payloadCases[9]), INT_FEED(2));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&payloadCases[10]), INT_FEED(4));
+
+  /* Build rate window tests */
+  tid = TestSet_registerTest(set, "window", testWindow);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&windowCases[0]), INT_FEED(3));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&windowCases[1]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&windowCases[2]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&windowCases[3]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&windowCases[4]), INT_FEED(2));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&windowCases[5]), INT_FEED(0));
+
+  /* Build summary tests */
+  tid = TestSet_registerTest(set, "summary", testSummary);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&summaryCases[0]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&summaryCases[1]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&summaryCases[2]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&summaryCases[3]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&summaryCases[4]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&summaryCases[5]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&summaryCases[6]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&summaryCases[7]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&summaryCases[8]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&summaryCases[9]), INT_FEED(1));
+
+  /* Build rule display tests */
+  tid = TestSet_registerTest(set, "show", testShow);
+  TestSet_registerTestData(set, tid, true, INT_FEED(100), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, INT_FEED(10000), INT_FEED(0));
+
+  /* Build counted calls tests */
+  tid = TestSet_registerTest(set, "counted", testCounted);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&countedCases[0]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&countedCases[1]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&countedCases[2]), INT_FEED(0));
+
+  /* Build socket table tests */
+  tid = TestSet_registerTest(set, "table", testTable);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&tableCases[0]), INT_FEED(3));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&tableCases[1]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&tableCases[2]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&tableCases[3]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&tableCases[4]), INT_FEED(3));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&tableCases[5]), INT_FEED(0));
+
+  /* Build connection rank tests */
+  tid = TestSet_registerTest(set, "rank", testRank);
+  TestSet_registerTestData(set, tid, true, INT_FEED(1), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, INT_FEED(0), INT_FEED(0));
+
+  /* Build per-socket state tests */
+  tid = TestSet_registerTest(set, "state", testState);
+  TestSet_registerTestData(set, tid, true,
+                           POINTER_FEED("10 on tcp with any do nop continue"), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true,
+                           POINTER_FEED("10 on unix talk-with any do nop continue"), INT_FEED(1));
+
+  /* Build counted calls tests */
+  tid = TestSet_registerTest(set, "feed", testFeed);
+  TestSet_registerTestData(set, tid, true,
+                           POINTER_FEED("10 on unix talk-with any when rate-ops per rule >= 2/s do truncate 1 continue"),
+                           INT_FEED(2));
+  TestSet_registerTestData(set, tid, true,
+                           POINTER_FEED("10 on tcp with any when rate-ops per rule >= 2/s do truncate 1 continue"),
+                           INT_FEED(5));
+
+  /* Build do-once tests */
+  tid = TestSet_registerTest(set, "once", testOnce);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&onceCases[0]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&onceCases[1]), INT_FEED(3));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&onceCases[2]), INT_FEED(3));
+
+  /* Build vectored calls tests */
+  tid = TestSet_registerTest(set, "vector", testVector);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&vectorCases[0]), INT_FEED(10));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&vectorCases[1]), INT_FEED(7));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&vectorCases[2]), INT_FEED(7));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&vectorCases[3]), INT_FEED(10));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&vectorCases[4]), INT_FEED(10));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&vectorCases[5]), INT_FEED(10));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&vectorCases[6]), INT_FEED(10));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&vectorCases[7]), INT_FEED(10));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&vectorCases[8]), INT_FEED(10));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&vectorCases[9]), INT_FEED(10));
+
+  /* Build spliced calls tests */
+  tid = TestSet_registerTest(set, "splice", testSplice);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&spliceCases[0]), INT_FEED(10));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&spliceCases[1]), INT_FEED(4));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&spliceCases[2]), INT_FEED(10));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&spliceCases[3]), INT_FEED(10));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&spliceCases[4]), INT_FEED(10));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&spliceCases[5]), INT_FEED(4));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&spliceCases[6]), INT_FEED(10));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&spliceCases[7]), INT_FEED(4));
+
+  /* Build asynchronous hang tests */
+  tid = TestSet_registerTest(set, "hang", testHang);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&hangCases[0]), INT_FEED(1));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&hangCases[1]), INT_FEED(0));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&hangCases[2]), INT_FEED(0));
+
+  /* Build reclamation tests */
+  tid = TestSet_registerTest(set, "epoch", testEpoch);
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&epochCases[0]), INT_FEED(3));
+  TestSet_registerTestData(set, tid, true, POINTER_FEED(&epochCases[1]), INT_FEED(3));
 
   /* Build int test */
   tid = TestSet_registerTest(set, "file", testFile);
@@ -91,5 +1546,16 @@ int main(void) {
   TestSet_registerTestData(set, tid, false, POINTER_FEED("idontexists"), INT_FEED(0));
 
   /* Process all this... and return. */
-  return TestSet_run(set) ? 0 : 1;
+  ok = TestSet_run(set);
+  ActionQueue_destroy(matchQueue);
+  ActionQueue_destroy(prefixQueue);
+  ActionQueue_destroy(pathQueue);
+  ActionQueue_destroy(summaryQueue);
+  ActionQueue_destroy(countedQueue);
+  PayloadScanner_destroy(scanner);
+  PayloadScanner_destroy(prefilterScanner);
+  for (i = 0 ; i < 4 ; ++i) {
+    Payload_destroy(payloads[i]);
+  }
+  return ok ? 0 : 1;
 }
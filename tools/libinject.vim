@@ -2,17 +2,21 @@ if exists("main_syntax")
   let main_syntax = 'libinject'
 endif
 
-syn keyword ruleKeyword on from to when with port contained
+syn keyword ruleKeyword on from to when with port and or not contained
 syn match   ruleKeyword "talk-with" contained
-syn keyword ruleTransport pipe ip tcp udp port any dns me command connect contained
+syn keyword ruleTransport pipe ip tcp udp unix port any dns me command connect close accept contained
 syn keyword ruleNext continue goto next stop exec contained
 syn match   ruleDo "do\(-once\(-per-\(call\|socket\)\)\?\)\?" contained
-syn keyword ruleCond matched unmatched before after between never always cycle prob contained
+syn keyword ruleCond matched unmatched before after between never always cycle prob contains age len contained
+syn match   ruleCond "matches-any" contained
+syn match   ruleCond "bytes-read\|bytes-written\|calls-read\|calls-written\|nth-connection\|rate-ops\|rate-bytes" contained
+syn match   ruleCond "per \(socket\|peer\|rule\)" contained
+syn region  ruleString start=/"/ skip=/\\./ end=/"/ contained
 syn keyword ruleAction nop echo syscall hang remove dump log truncate split drop contained
 syn match ruleAction "\(cancel-syscall\|local-hang\|remote-hang\|mark-done\)" contained
 syn keyword ruleBool true false contained
 syn match ruleLine "-\?[0-9]\+" contained
-syn region rule start=/^/ end=/$/ contains=ruleLine,ruleKeyword,ruleTransport,ruleDo,ruleNext,ruleAction,ruleCond,ruleBool
+syn region rule start=/^/ end=/$/ contains=ruleLine,ruleKeyword,ruleTransport,ruleDo,ruleNext,ruleAction,ruleCond,ruleBool,ruleString
 syn region ruleSection start=/^\[/ end=/]/
 syn region ruleComment start=/^;/ end=/$/ contains=@Spell
 
@@ -20,6 +24,7 @@ syn region ruleComment start=/^;/ end=/$/ contains=@Spell
 command -nargs=+ HiLink hi def link <args>
 HiLink ruleLine    Constant
 HiLink ruleBool    Constant
+HiLink ruleString  String
 HiLink ruleComment Comment
 HiLink ruleKeyword Operator
 HiLink ruleTransport Type
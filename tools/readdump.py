@@ -36,6 +36,8 @@ def showEntry(time, type, proto, lport, a1, a2, a3, a4, port, success, length, d
   """
   if proto == 1:
     addr = "tcp:"
+  elif proto == 4:
+    addr = "unix:"
   else:
     addr = "udp:"
   addr += str(lport) + ":[" + str(a4) + "." + str(a3) + "." + str(a2) + "." + str(a1) + "]:" + str(port)
@@ -47,6 +49,8 @@ def showEntry(time, type, proto, lport, a1, a2, a3, a4, port, success, length, d
     text = "connect"
   elif type == 8:
     text = "close"
+  elif type == 16:
+    text = "accept"
   else:
     text = "unknown-action"
   tlen = ""